@@ -53,6 +53,20 @@ An opaque type representing a network address.
 */
 typedef ArchNetAddressImpl* ArchNetAddress;
 
+/*!
+\class ArchPollSetImpl
+\brief Internal poll set data.
+An architecture dependent type holding the necessary data for a poll set.
+*/
+class ArchPollSetImpl;
+
+/*!
+\var ArchPollSet
+\brief Opaque poll set type.
+An opaque type representing a persistent set of sockets to poll.
+*/
+typedef ArchPollSetImpl* ArchPollSet;
+
 //! Interface for architecture dependent networking
 /*!
 This interface defines the networking operations required by
@@ -101,6 +115,26 @@ public:
         unsigned short    m_revents;
     };
 
+    //! A buffer for \c readSocketV() and \c writeSocketV()
+    class IOBuffer {
+    public:
+        //! The first byte of the buffer
+        void*            m_data;
+
+        //! The size of the buffer in bytes
+        size_t            m_size;
+    };
+
+    //! A result from \c waitPollSet()
+    class PollSetEntry {
+    public:
+        //! The data given when the socket was added to the poll set
+        void*            m_data;
+
+        //! The result events
+        unsigned short    m_revents;
+    };
+
     //! @name manipulators
     //@{
 
@@ -196,6 +230,61 @@ public:
     */
     virtual void        unblockPollSocket(ArchThread thread) = 0;
 
+    //! Create a poll set
+    /*!
+    Returns a new, empty poll set.  Unlike \c pollSocket(), a poll set
+    keeps its sockets registered between waits so only changes in
+    interest have to be passed to the system.  Returns NULL if the
+    architecture has no support for poll sets, in which case callers
+    must use \c pollSocket() instead.
+    */
+    virtual ArchPollSet    newPollSet() = 0;
+
+    //! Destroy a poll set
+    /*!
+    Destroys a poll set created by \c newPollSet().  Sockets in the set
+    are not affected.
+    */
+    virtual void        closePollSet(ArchPollSet set) = 0;
+
+    //! Add socket to poll set
+    /*!
+    Adds socket \c s to poll set \c set, querying for \c events (any
+    combination of kPOLLIN and kPOLLOUT).  \c kPOLLERR is always
+    queried.  \c data is returned in \c m_data by \c waitPollSet().
+    The socket must not already be in the set.
+    */
+    virtual void        addToPollSet(ArchPollSet set, ArchSocket s,
+                            unsigned short events, void* data) = 0;
+
+    //! Change socket in poll set
+    /*!
+    Changes the events queried for and the data returned for socket
+    \c s, which must already be in poll set \c set.
+    */
+    virtual void        modifyPollSet(ArchPollSet set, ArchSocket s,
+                            unsigned short events, void* data) = 0;
+
+    //! Remove socket from poll set
+    /*!
+    Removes socket \c s from poll set \c set.  The socket must be
+    removed before it's closed.
+    */
+    virtual void        removeFromPollSet(ArchPollSet set, ArchSocket s) = 0;
+
+    //! Wait on poll set
+    /*!
+    Waits up to \c timeout seconds (or indefinitely if \c timeout < 0)
+    for some socket in \c set to become readable, writable or to be in
+    an error state.  Fills in at most \c num entries and returns the
+    number filled in.  As with \c pollSocket(), \c unblockPollSocket()
+    causes the waiting thread to return early.
+
+    (Cancellation point)
+    */
+    virtual int            waitPollSet(ArchPollSet set,
+                            PollSetEntry[], int num, double timeout) = 0;
+
     //! Read data from socket
     /*!
     Read up to \c len bytes from socket \c s in \c buf and return the
@@ -215,6 +304,22 @@ public:
     virtual size_t        writeSocket(ArchSocket s,
                             const void* buf, size_t len) = 0;
 
+    //! Read data from socket into several buffers
+    /*!
+    Like \c readSocket() but fills the \c num buffers in \c bufs in
+    order with a single read.
+    */
+    virtual size_t        readSocketV(ArchSocket s,
+                            const IOBuffer bufs[], int num) = 0;
+
+    //! Write data to socket from several buffers
+    /*!
+    Like \c writeSocket() but writes the \c num buffers in \c bufs in
+    order with a single write.
+    */
+    virtual size_t        writeSocketV(ArchSocket s,
+                            const IOBuffer bufs[], int num) = 0;
+
     //! Check error on socket
     /*!
     If the socket \c s is in an error state then throws an appropriate
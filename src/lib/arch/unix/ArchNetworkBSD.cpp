@@ -25,6 +25,7 @@
 #if HAVE_UNISTD_H
 #    include <unistd.h>
 #endif
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <netdb.h>
 #if !defined(TCP_NODELAY)
@@ -46,6 +47,10 @@
 #    endif
 #endif
 
+#if HAVE_SYS_EPOLL_H
+#    include <sys/epoll.h>
+#endif
+
 #if !HAVE_INET_ATON
 #    include <stdio.h>
 #endif
@@ -508,6 +513,217 @@ ArchNetworkBSD::unblockPollSocket(ArchThread thread)
     }
 }
 
+#if HAVE_SYS_EPOLL_H
+
+// the most events returned by a single waitPollSet().  any others are
+// returned by the next wait.
+static const int s_maxPollSetEvents = 64;
+
+static
+uint32_t
+toEpollEvents(unsigned short events)
+{
+    uint32_t result = 0;
+    if ((events & IArchNetwork::kPOLLIN) != 0) {
+        result |= EPOLLIN;
+    }
+    if ((events & IArchNetwork::kPOLLOUT) != 0) {
+        result |= EPOLLOUT;
+    }
+    return result;
+}
+
+ArchPollSet
+ArchNetworkBSD::newPollSet()
+{
+    int fd = epoll_create1(EPOLL_CLOEXEC);
+    if (fd == -1) {
+        throwError(errno);
+    }
+
+    ArchPollSetImpl* set = new ArchPollSetImpl;
+    set->m_fd            = fd;
+    set->m_unblockFd     = -1;
+    return set;
+}
+
+void
+ArchNetworkBSD::closePollSet(ArchPollSet set)
+{
+    assert(set != NULL);
+
+    close(set->m_fd);
+    delete set;
+}
+
+void
+ArchNetworkBSD::addToPollSet(ArchPollSet set, ArchSocket s,
+                unsigned short events, void* data)
+{
+    assert(set != NULL);
+    assert(s   != NULL);
+
+    struct epoll_event ev;
+    ev.events   = toEpollEvents(events);
+    ev.data.ptr = data;
+    if (epoll_ctl(set->m_fd, EPOLL_CTL_ADD, s->m_fd, &ev) == -1) {
+        throwError(errno);
+    }
+}
+
+void
+ArchNetworkBSD::modifyPollSet(ArchPollSet set, ArchSocket s,
+                unsigned short events, void* data)
+{
+    assert(set != NULL);
+    assert(s   != NULL);
+
+    struct epoll_event ev;
+    ev.events   = toEpollEvents(events);
+    ev.data.ptr = data;
+    if (epoll_ctl(set->m_fd, EPOLL_CTL_MOD, s->m_fd, &ev) == -1) {
+        throwError(errno);
+    }
+}
+
+void
+ArchNetworkBSD::removeFromPollSet(ArchPollSet set, ArchSocket s)
+{
+    assert(set != NULL);
+    assert(s   != NULL);
+
+    // kernels before 2.6.9 require a non-NULL event even though it's
+    // ignored
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    if (epoll_ctl(set->m_fd, EPOLL_CTL_DEL, s->m_fd, &ev) == -1) {
+        throwError(errno);
+    }
+}
+
+int
+ArchNetworkBSD::waitPollSet(ArchPollSet set,
+                PollSetEntry pe[], int num, double timeout)
+{
+    assert(set != NULL);
+    assert(pe  != NULL || num == 0);
+
+    // the unblock pipe belongs to the waiting thread so add it to the
+    // set the first time that thread waits.  it's identified by using
+    // the set itself as the event data.  finding the pipe locks the
+    // thread list so skip it while the same thread keeps waiting.
+    if (set->m_unblockFd == -1 ||
+        !pthread_equal(set->m_unblockThread, pthread_self())) {
+        const int* unblockPipe = getUnblockPipe();
+        if (unblockPipe != NULL && unblockPipe[0] != set->m_unblockFd) {
+            struct epoll_event ev;
+            ev.events   = EPOLLIN;
+            ev.data.ptr = set;
+            if (set->m_unblockFd != -1) {
+                epoll_ctl(set->m_fd, EPOLL_CTL_DEL, set->m_unblockFd, &ev);
+            }
+            if (epoll_ctl(set->m_fd,
+                            EPOLL_CTL_ADD, unblockPipe[0], &ev) == -1) {
+                throwError(errno);
+            }
+            set->m_unblockFd     = unblockPipe[0];
+            set->m_unblockThread = pthread_self();
+        }
+    }
+
+    // prepare timeout
+    int t = (timeout < 0.0) ? -1 : static_cast<int>(1000.0 * timeout);
+
+    // do the wait
+    struct epoll_event events[s_maxPollSetEvents];
+    if (num > s_maxPollSetEvents) {
+        num = s_maxPollSetEvents;
+    }
+    int n = epoll_wait(set->m_fd, events, num, t);
+
+    // handle results
+    if (n == -1) {
+        if (errno == EINTR) {
+            // interrupted system call
+            ARCH->testCancelThread();
+            return 0;
+        }
+        throwError(errno);
+    }
+
+    // translate back
+    int j = 0;
+    for (int i = 0; i < n; ++i) {
+        if (events[i].data.ptr == set) {
+            // the unblock event was signalled.  flush the pipe, which
+            // is non-blocking, until it's empty.
+            char dummy[100];
+            while (read(set->m_unblockFd, dummy, sizeof(dummy)) > 0) {
+                // keep reading
+            }
+            continue;
+        }
+
+        pe[j].m_data    = events[i].data.ptr;
+        pe[j].m_revents = 0;
+        if ((events[i].events & EPOLLIN) != 0) {
+            pe[j].m_revents |= kPOLLIN;
+        }
+        if ((events[i].events & EPOLLOUT) != 0) {
+            pe[j].m_revents |= kPOLLOUT;
+        }
+        if ((events[i].events & EPOLLERR) != 0) {
+            pe[j].m_revents |= kPOLLERR;
+        }
+        ++j;
+    }
+
+    return j;
+}
+
+#else
+
+ArchPollSet
+ArchNetworkBSD::newPollSet()
+{
+    // no persistent poll set on this system.  callers fall back to
+    // pollSocket().
+    return NULL;
+}
+
+void
+ArchNetworkBSD::closePollSet(ArchPollSet)
+{
+    assert(0 && "poll sets are not supported");
+}
+
+void
+ArchNetworkBSD::addToPollSet(ArchPollSet, ArchSocket, unsigned short, void*)
+{
+    assert(0 && "poll sets are not supported");
+}
+
+void
+ArchNetworkBSD::modifyPollSet(ArchPollSet, ArchSocket, unsigned short, void*)
+{
+    assert(0 && "poll sets are not supported");
+}
+
+void
+ArchNetworkBSD::removeFromPollSet(ArchPollSet, ArchSocket)
+{
+    assert(0 && "poll sets are not supported");
+}
+
+int
+ArchNetworkBSD::waitPollSet(ArchPollSet, PollSetEntry[], int, double)
+{
+    assert(0 && "poll sets are not supported");
+    return 0;
+}
+
+#endif
+
 size_t
 ArchNetworkBSD::readSocket(ArchSocket s, void* buf, size_t len)
 {
@@ -538,6 +754,55 @@ ArchNetworkBSD::writeSocket(ArchSocket s, const void* buf, size_t len)
     return n;
 }
 
+// the most buffers passed to one readv() or writev()
+static const int s_maxIOBuffers = 16;
+
+static
+int
+toIOVec(struct iovec* vec, const IArchNetwork::IOBuffer bufs[], int num)
+{
+    if (num > s_maxIOBuffers) {
+        num = s_maxIOBuffers;
+    }
+    for (int i = 0; i < num; ++i) {
+        vec[i].iov_base = bufs[i].m_data;
+        vec[i].iov_len  = bufs[i].m_size;
+    }
+    return num;
+}
+
+size_t
+ArchNetworkBSD::readSocketV(ArchSocket s, const IOBuffer bufs[], int num)
+{
+    assert(s != NULL);
+
+    struct iovec vec[s_maxIOBuffers];
+    ssize_t n = readv(s->m_fd, vec, toIOVec(vec, bufs, num));
+    if (n == -1) {
+        if (errno == EINTR || errno == EAGAIN) {
+            return 0;
+        }
+        throwError(errno);
+    }
+    return n;
+}
+
+size_t
+ArchNetworkBSD::writeSocketV(ArchSocket s, const IOBuffer bufs[], int num)
+{
+    assert(s != NULL);
+
+    struct iovec vec[s_maxIOBuffers];
+    ssize_t n = writev(s->m_fd, vec, toIOVec(vec, bufs, num));
+    if (n == -1) {
+        if (errno == EINTR || errno == EAGAIN) {
+            return 0;
+        }
+        throwError(errno);
+    }
+    return n;
+}
+
 void
 ArchNetworkBSD::throwErrorOnSocket(ArchSocket s)
 {
@@ -27,6 +27,7 @@
 #if HAVE_SYS_SOCKET_H
 #    include <sys/socket.h>
 #endif
+#include <pthread.h>
 
 #if !HAVE_SOCKLEN_T
 typedef int socklen_t;
@@ -45,6 +46,13 @@ public:
     int                    m_refCount;
 };
 
+class ArchPollSetImpl {
+public:
+    int                    m_fd;
+    int                    m_unblockFd;
+    pthread_t            m_unblockThread;
+};
+
 class ArchNetAddressImpl {
 public:
     ArchNetAddressImpl() : m_len(sizeof(m_addr)) { }
@@ -73,9 +81,22 @@ public:
     virtual bool        connectSocket(ArchSocket s, ArchNetAddress name);
     virtual int            pollSocket(PollEntry[], int num, double timeout);
     virtual void        unblockPollSocket(ArchThread thread);
+    virtual ArchPollSet    newPollSet();
+    virtual void        closePollSet(ArchPollSet set);
+    virtual void        addToPollSet(ArchPollSet set, ArchSocket s,
+                            unsigned short events, void* data);
+    virtual void        modifyPollSet(ArchPollSet set, ArchSocket s,
+                            unsigned short events, void* data);
+    virtual void        removeFromPollSet(ArchPollSet set, ArchSocket s);
+    virtual int            waitPollSet(ArchPollSet set,
+                            PollSetEntry[], int num, double timeout);
     virtual size_t        readSocket(ArchSocket s, void* buf, size_t len);
     virtual size_t        writeSocket(ArchSocket s,
                             const void* buf, size_t len);
+    virtual size_t        readSocketV(ArchSocket s,
+                            const IOBuffer bufs[], int num);
+    virtual size_t        writeSocketV(ArchSocket s,
+                            const IOBuffer bufs[], int num);
     virtual void        throwErrorOnSocket(ArchSocket);
     virtual bool        setNoDelayOnSocket(ArchSocket, bool noDelay);
     virtual bool        setReuseAddrOnSocket(ArchSocket, bool reuse);
@@ -544,6 +544,45 @@ ArchNetworkWinsock::unblockPollSocket(ArchThread thread)
     }
 }
 
+ArchPollSet
+ArchNetworkWinsock::newPollSet()
+{
+    // winsock has no persistent poll set.  callers fall back to
+    // pollSocket().
+    return NULL;
+}
+
+void
+ArchNetworkWinsock::closePollSet(ArchPollSet)
+{
+    assert(0 && "poll sets are not supported");
+}
+
+void
+ArchNetworkWinsock::addToPollSet(ArchPollSet, ArchSocket, unsigned short, void*)
+{
+    assert(0 && "poll sets are not supported");
+}
+
+void
+ArchNetworkWinsock::modifyPollSet(ArchPollSet, ArchSocket, unsigned short, void*)
+{
+    assert(0 && "poll sets are not supported");
+}
+
+void
+ArchNetworkWinsock::removeFromPollSet(ArchPollSet, ArchSocket)
+{
+    assert(0 && "poll sets are not supported");
+}
+
+int
+ArchNetworkWinsock::waitPollSet(ArchPollSet, PollSetEntry[], int, double)
+{
+    assert(0 && "poll sets are not supported");
+    return 0;
+}
+
 size_t
 ArchNetworkWinsock::readSocket(ArchSocket s, void* buf, size_t len)
 {
@@ -580,6 +619,56 @@ ArchNetworkWinsock::writeSocket(ArchSocket s, const void* buf, size_t len)
     return static_cast<size_t>(n);
 }
 
+size_t
+ArchNetworkWinsock::readSocketV(ArchSocket s, const IOBuffer bufs[], int num)
+{
+    // read each buffer in turn until one isn't filled
+    size_t total = 0;
+    for (int i = 0; i < num; ++i) {
+        size_t n;
+        try {
+            n = readSocket(s, bufs[i].m_data, bufs[i].m_size);
+        }
+        catch (XArchNetwork&) {
+            // report what got through, the error will come up again
+            if (total > 0) {
+                return total;
+            }
+            throw;
+        }
+        total += n;
+        if (n < bufs[i].m_size) {
+            break;
+        }
+    }
+    return total;
+}
+
+size_t
+ArchNetworkWinsock::writeSocketV(ArchSocket s, const IOBuffer bufs[], int num)
+{
+    // write each buffer in turn until one isn't all written
+    size_t total = 0;
+    for (int i = 0; i < num; ++i) {
+        size_t n;
+        try {
+            n = writeSocket(s, bufs[i].m_data, bufs[i].m_size);
+        }
+        catch (XArchNetwork&) {
+            // report what got through, the error will come up again
+            if (total > 0) {
+                return total;
+            }
+            throw;
+        }
+        total += n;
+        if (n < bufs[i].m_size) {
+            break;
+        }
+    }
+    return total;
+}
+
 void
 ArchNetworkWinsock::throwErrorOnSocket(ArchSocket s)
 {
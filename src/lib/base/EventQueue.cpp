@@ -49,6 +49,9 @@ EVENT_TYPE_ACCESSOR(IScreen)
 EVENT_TYPE_ACCESSOR(Clipboard)
 EVENT_TYPE_ACCESSOR(File)
 
+// the heap index of a timer that isn't in the heap
+static const size_t s_notInHeap = static_cast<size_t>(-1);
+
 // interrupt handler.  this just adds a quit event to the queue.
 static
 void
@@ -66,6 +69,7 @@ interrupt(Arch::ESignal, void* data)
 EventQueue::EventQueue() :
     m_systemTarget(0),
     m_nextType(Event::kLast),
+    m_handlers(new HandlerTable),
     m_typesForClient(NULL),
     m_typesForIStream(NULL),
     m_typesForIpcClient(NULL),
@@ -97,6 +101,9 @@ EventQueue::EventQueue() :
 
 EventQueue::~EventQueue()
 {
+    for (Timers::iterator i = m_timers.begin(); i != m_timers.end(); ++i) {
+        delete i->second;
+    }
     delete m_buffer;
     delete m_readyCondVar;
     delete m_readyMutex;
@@ -113,7 +120,7 @@ EventQueue::loop()
     {
         Lock lock(m_readyMutex);
         *m_readyCondVar = true;
-        m_readyCondVar->signal();
+        m_readyCondVar->broadcast();
     }
     LOG((CLOG_DEBUG "event queue is ready"));
     while (!m_pending.empty()) {
@@ -179,16 +186,17 @@ EventQueue::adoptBuffer(IEventQueueBuffer* buffer)
 
     LOG((CLOG_DEBUG "adopting new buffer"));
 
-    if (m_events.size() != 0) {
+    size_t saved = m_events.size() - m_oldEventIDs.size();
+    if (saved != 0) {
         // this can come as a nasty surprise to programmers expecting
         // their events to be raised, only to have them deleted.
-        LOG((CLOG_DEBUG "discarding %d event(s)", m_events.size()));
+        LOG((CLOG_DEBUG "discarding %d event(s)", saved));
     }
 
     // discard old buffer and old events
     delete m_buffer;
     for (EventTable::iterator i = m_events.begin(); i != m_events.end(); ++i) {
-        Event::deleteData(i->second);
+        Event::deleteData(*i);
     }
     m_events.clear();
     m_oldEventIDs.clear();
@@ -262,16 +270,23 @@ retry:
 bool
 EventQueue::dispatchEvent(const Event& event)
 {
-    void* target   = event.getTarget();
-    IEventJob* job = getHandler(event.getType(), target);
-    if (job == NULL) {
-        job = getHandler(Event::kUnknown, target);
+    // look up the target once for both its handler for the type and
+    // its handler for any type
+    HandlerTablePtr handlers = getHandlers();
+    HandlerTable::const_iterator index = handlers->find(event.getTarget());
+    if (index == handlers->end()) {
+        return false;
     }
-    if (job != NULL) {
-        job->run(event);
-        return true;
+    const TypeHandlerTable& typeHandlers = index->second;
+    TypeHandlerTable::const_iterator index2 = typeHandlers.find(event.getType());
+    if (index2 == typeHandlers.end()) {
+        index2 = typeHandlers.find(Event::kUnknown);
+        if (index2 == typeHandlers.end()) {
+            return false;
+        }
     }
-    return false;
+    index2->second->run(event);
+    return true;
 }
 
 void
@@ -319,66 +334,46 @@ EventQueue::addEventToBuffer(const Event& event)
 EventQueueTimer*
 EventQueue::newTimer(double duration, void* target)
 {
-    assert(duration > 0.0);
-
-    EventQueueTimer* timer = m_buffer->newTimer(duration, false);
-    if (target == NULL) {
-        target = timer;
-    }
-    ArchMutexLock lock(m_mutex);
-    m_timers.insert(timer);
-    // initial duration is requested duration plus whatever's on
-    // the clock currently because the latter will be subtracted
-    // the next time we check for timers.
-    m_timerQueue.push(Timer(timer, duration,
-                            duration + m_time.getTime(), target, false));
-    return timer;
+    return addTimer(duration, target, false);
 }
 
 EventQueueTimer*
 EventQueue::newOneShotTimer(double duration, void* target)
 {
-    assert(duration > 0.0);
-
-    EventQueueTimer* timer = m_buffer->newTimer(duration, true);
-    if (target == NULL) {
-        target = timer;
-    }
-    ArchMutexLock lock(m_mutex);
-    m_timers.insert(timer);
-    // initial duration is requested duration plus whatever's on
-    // the clock currently because the latter will be subtracted
-    // the next time we check for timers.
-    m_timerQueue.push(Timer(timer, duration,
-                            duration + m_time.getTime(), target, true));
-    return timer;
+    return addTimer(duration, target, true);
 }
 
 void
 EventQueue::deleteTimer(EventQueueTimer* timer)
 {
-    ArchMutexLock lock(m_mutex);
-    for (TimerQueue::iterator index = m_timerQueue.begin();
-                            index != m_timerQueue.end(); ++index) {
-        if (index->getTimer() == timer) {
-            m_timerQueue.erase(index);
-            break;
+    {
+        ArchMutexLock lock(m_mutex);
+        Timers::iterator index = m_timers.find(timer);
+        if (index != m_timers.end()) {
+            Timer* queued = index->second;
+            if (queued->getIndex() != s_notInHeap) {
+                removeTimerFromHeap(queued);
+            }
+            delete queued;
+            m_timers.erase(index);
         }
     }
-    Timers::iterator index = m_timers.find(timer);
-    if (index != m_timers.end()) {
-        m_timers.erase(index);
-    }
     m_buffer->deleteTimer(timer);
 }
 
 void
 EventQueue::adoptHandler(Event::Type type, void* target, IEventJob* handler)
 {
-    ArchMutexLock lock(m_mutex);
-    IEventJob*& job = m_handlers[target][type];
-    delete job;
-    job = handler;
+    IEventJob* oldHandler = NULL;
+    {
+        ArchMutexLock lock(m_mutex);
+        HandlerTable* handlers = new HandlerTable(*m_handlers);
+        IEventJob*& job = (*handlers)[target][type];
+        oldHandler = job;
+        job = handler;
+        setHandlers(handlers);
+    }
+    delete oldHandler;
 }
 
 void
@@ -387,14 +382,17 @@ EventQueue::removeHandler(Event::Type type, void* target)
     IEventJob* handler = NULL;
     {
         ArchMutexLock lock(m_mutex);
-        HandlerTable::iterator index = m_handlers.find(target);
-        if (index != m_handlers.end()) {
-            TypeHandlerTable& typeHandlers = index->second;
+        HandlerTable::const_iterator index = m_handlers->find(target);
+        if (index != m_handlers->end() && index->second.count(type) != 0) {
+            HandlerTable* handlers = new HandlerTable(*m_handlers);
+            TypeHandlerTable& typeHandlers = (*handlers)[target];
             TypeHandlerTable::iterator index2 = typeHandlers.find(type);
-            if (index2 != typeHandlers.end()) {
-                handler = index2->second;
-                typeHandlers.erase(index2);
+            handler = index2->second;
+            typeHandlers.erase(index2);
+            if (typeHandlers.empty()) {
+                handlers->erase(target);
             }
+            setHandlers(handlers);
         }
     }
     delete handler;
@@ -406,15 +404,17 @@ EventQueue::removeHandlers(void* target)
     std::vector<IEventJob*> handlers;
     {
         ArchMutexLock lock(m_mutex);
-        HandlerTable::iterator index = m_handlers.find(target);
-        if (index != m_handlers.end()) {
-            // copy to handlers array and clear table for target
-            TypeHandlerTable& typeHandlers = index->second;
-            for (TypeHandlerTable::iterator index2 = typeHandlers.begin();
+        HandlerTable::const_iterator index = m_handlers->find(target);
+        if (index != m_handlers->end()) {
+            // copy to handlers array and remove the target from the table
+            const TypeHandlerTable& typeHandlers = index->second;
+            for (TypeHandlerTable::const_iterator index2 = typeHandlers.begin();
                             index2 != typeHandlers.end(); ++index2) {
                 handlers.push_back(index2->second);
             }
-            typeHandlers.clear();
+            HandlerTable* newHandlers = new HandlerTable(*m_handlers);
+            newHandlers->erase(target);
+            setHandlers(newHandlers);
         }
     }
 
@@ -434,9 +434,9 @@ EventQueue::isEmpty() const
 IEventJob*
 EventQueue::getHandler(Event::Type type, void* target) const
 {
-    ArchMutexLock lock(m_mutex);
-    HandlerTable::const_iterator index = m_handlers.find(target);
-    if (index != m_handlers.end()) {
+    HandlerTablePtr handlers = getHandlers();
+    HandlerTable::const_iterator index = handlers->find(target);
+    if (index != handlers->end()) {
         const TypeHandlerTable& typeHandlers = index->second;
         TypeHandlerTable::const_iterator index2 = typeHandlers.find(type);
         if (index2 != typeHandlers.end()) {
@@ -446,6 +446,20 @@ EventQueue::getHandler(Event::Type type, void* target) const
     return NULL;
 }
 
+EventQueue::HandlerTablePtr
+EventQueue::getHandlers() const
+{
+    return std::atomic_load(&m_handlers);
+}
+
+void
+EventQueue::setHandlers(HandlerTable* handlers)
+{
+    // note -- m_mutex must be locked on entry
+
+    std::atomic_store(&m_handlers, HandlerTablePtr(handlers));
+}
+
 UInt32
 EventQueue::saveEvent(const Event& event)
 {
@@ -455,14 +469,13 @@ EventQueue::saveEvent(const Event& event)
         // reuse an id
         id = m_oldEventIDs.back();
         m_oldEventIDs.pop_back();
+        m_events[id] = event;
     }
     else {
         // make a new id
         id = static_cast<UInt32>(m_events.size());
+        m_events.push_back(event);
     }
-
-    // save data
-    m_events[id] = event;
     return id;
 }
 
@@ -470,14 +483,14 @@ Event
 EventQueue::removeEvent(UInt32 eventID)
 {
     // look up id
-    EventTable::iterator index = m_events.find(eventID);
-    if (index == m_events.end()) {
+    if (eventID >= m_events.size() ||
+        m_events[eventID].getType() == Event::kUnknown) {
         return Event();
     }
 
     // get data
-    Event event = index->second;
-    m_events.erase(index);
+    Event event = m_events[eventID];
+    m_events[eventID] = Event();
 
     // save old id for reuse
     m_oldEventIDs.push_back(eventID);
@@ -488,40 +501,32 @@ EventQueue::removeEvent(UInt32 eventID)
 bool
 EventQueue::hasTimerExpired(Event& event)
 {
-    // return true if there's a timer in the timer priority queue that
-    // has expired.  if returning true then fill in event appropriately
-    // and reset and reinsert the timer.
-    if (m_timerQueue.empty()) {
+    // return true if the timer at the top of the heap has expired.  if
+    // returning true then fill in event appropriately and reset the
+    // timer, or take it out of the heap if it's a one-shot.
+    ArchMutexLock lock(m_mutex);
+    if (m_timerHeap.empty()) {
         return false;
     }
 
-    // get time elapsed since last check
-    const double time = m_time.getTime();
-    m_time.reset();
-
-    // countdown elapsed time
-    for (TimerQueue::iterator index = m_timerQueue.begin();
-                            index != m_timerQueue.end(); ++index) {
-        (*index) -= time;
-    }
-
     // done if no timers are expired
-    if (m_timerQueue.top() > 0.0) {
+    const double now = m_time.getTime();
+    Timer* timer     = m_timerHeap.front();
+    if (timer->getDeadline() > now) {
         return false;
     }
 
-    // remove timer from queue
-    Timer timer = m_timerQueue.top();
-    m_timerQueue.pop();
-
-    // prepare event and reset the timer's clock
-    timer.fillEvent(m_timerEvent);
-    event = Event(Event::kTimer, timer.getTarget(), &m_timerEvent);
-    timer.reset();
+    // prepare event
+    timer->fillEvent(m_timerEvent, now);
+    event = Event(Event::kTimer, timer->getTarget(), &m_timerEvent);
 
-    // reinsert timer into queue if it's not a one-shot
-    if (!timer.isOneShot()) {
-        m_timerQueue.push(timer);
+    // restart the timer unless it's a one-shot
+    if (timer->isOneShot()) {
+        removeTimerFromHeap(timer);
+    }
+    else {
+        timer->reset(now);
+        moveTimerDown(0);
     }
 
     return true;
@@ -531,15 +536,107 @@ double
 EventQueue::getNextTimerTimeout() const
 {
     // return -1 if no timers, 0 if the top timer has expired, otherwise
-    // the time until the top timer in the timer priority queue will
-    // expire.
-    if (m_timerQueue.empty()) {
+    // the time until the top timer in the heap will expire.
+    ArchMutexLock lock(m_mutex);
+    if (m_timerHeap.empty()) {
         return -1.0;
     }
-    if (m_timerQueue.top() <= 0.0) {
+    double timeout = m_timerHeap.front()->getDeadline() - m_time.getTime();
+    if (timeout <= 0.0) {
         return 0.0;
     }
-    return m_timerQueue.top();
+    return timeout;
+}
+
+EventQueueTimer*
+EventQueue::addTimer(double duration, void* target, bool oneShot)
+{
+    assert(duration > 0.0);
+
+    EventQueueTimer* timer = m_buffer->newTimer(duration, oneShot);
+    if (target == NULL) {
+        target = timer;
+    }
+    ArchMutexLock lock(m_mutex);
+    Timer* queued = new Timer(timer, duration,
+                            m_time.getTime() + duration, target, oneShot);
+    m_timers[timer] = queued;
+    addTimerToHeap(queued);
+    return timer;
+}
+
+void
+EventQueue::addTimerToHeap(Timer* timer)
+{
+    // note -- m_mutex must be locked on entry
+
+    timer->setIndex(m_timerHeap.size());
+    m_timerHeap.push_back(timer);
+    moveTimerUp(timer->getIndex());
+}
+
+void
+EventQueue::removeTimerFromHeap(Timer* timer)
+{
+    // note -- m_mutex must be locked on entry
+
+    // fill the hole with the last timer and move that into place
+    size_t index = timer->getIndex();
+    Timer* last  = m_timerHeap.back();
+    m_timerHeap.pop_back();
+    timer->setIndex(s_notInHeap);
+    if (last != timer) {
+        m_timerHeap[index] = last;
+        last->setIndex(index);
+        moveTimerUp(index);
+        moveTimerDown(last->getIndex());
+    }
+}
+
+void
+EventQueue::moveTimerUp(size_t index)
+{
+    // note -- m_mutex must be locked on entry
+
+    Timer* timer = m_timerHeap[index];
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (m_timerHeap[parent]->getDeadline() <= timer->getDeadline()) {
+            break;
+        }
+        m_timerHeap[index] = m_timerHeap[parent];
+        m_timerHeap[index]->setIndex(index);
+        index = parent;
+    }
+    m_timerHeap[index] = timer;
+    timer->setIndex(index);
+}
+
+void
+EventQueue::moveTimerDown(size_t index)
+{
+    // note -- m_mutex must be locked on entry
+
+    Timer* timer = m_timerHeap[index];
+    const size_t n = m_timerHeap.size();
+    for (;;) {
+        size_t child = 2 * index + 1;
+        if (child >= n) {
+            break;
+        }
+        if (child + 1 < n && m_timerHeap[child + 1]->getDeadline() <
+                            m_timerHeap[child]->getDeadline()) {
+            ++child;
+        }
+        if (timer->getDeadline() <= m_timerHeap[child]->getDeadline()) {
+            break;
+        }
+        m_timerHeap[index] = m_timerHeap[child];
+        m_timerHeap[index]->setIndex(index);
+        index = child;
+    }
+    m_timerHeap[index] = timer;
+    timer->setIndex(index);
 }
 
 Event::Type
@@ -565,10 +662,12 @@ EventQueue::waitForReady() const
     double timeout = ARCH->time() + 10;
     Lock lock(m_readyMutex);
     
-    while (!m_readyCondVar->wait()) {
-        if (ARCH->time() > timeout) {
-            throw std::runtime_error("event queue is not ready within 5 sec");
+    while (!*m_readyCondVar) {
+        double remaining = timeout - ARCH->time();
+        if (remaining <= 0.0) {
+            throw std::runtime_error("event queue is not ready within 10 sec");
         }
+        m_readyCondVar->wait(remaining);
     }
 }
 
@@ -577,12 +676,13 @@ EventQueue::waitForReady() const
 //
 
 EventQueue::Timer::Timer(EventQueueTimer* timer, double timeout,
-                double initialTime, void* target, bool oneShot) :
+                double deadline, void* target, bool oneShot) :
     m_timer(timer),
     m_timeout(timeout),
     m_target(target),
     m_oneShot(oneShot),
-    m_time(initialTime)
+    m_deadline(deadline),
+    m_index(s_notInHeap)
 {
     assert(m_timeout > 0.0);
 }
@@ -593,21 +693,15 @@ EventQueue::Timer::~Timer()
 }
 
 void
-EventQueue::Timer::reset()
-{
-    m_time = m_timeout;
-}
-
-EventQueue::Timer&
-EventQueue::Timer::operator-=(double dt)
+EventQueue::Timer::reset(double now)
 {
-    m_time -= dt;
-    return *this;
+    m_deadline = now + m_timeout;
 }
 
-EventQueue::Timer::operator double() const
+void
+EventQueue::Timer::setIndex(size_t index)
 {
-    return m_time;
+    m_index = index;
 }
 
 bool
@@ -628,18 +722,26 @@ EventQueue::Timer::getTarget() const
     return m_target;
 }
 
+double
+EventQueue::Timer::getDeadline() const
+{
+    return m_deadline;
+}
+
+size_t
+EventQueue::Timer::getIndex() const
+{
+    return m_index;
+}
+
 void
-EventQueue::Timer::fillEvent(TimerEvent& event) const
+EventQueue::Timer::fillEvent(TimerEvent& event, double now) const
 {
+    // count the periods since the timer was last reset
     event.m_timer = m_timer;
     event.m_count = 0;
-    if (m_time <= 0.0) {
-        event.m_count = static_cast<UInt32>((m_timeout - m_time) / m_timeout);
+    if (m_deadline <= now) {
+        event.m_count = static_cast<UInt32>(
+                            (m_timeout + now - m_deadline) / m_timeout);
     }
 }
-
-bool
-EventQueue::Timer::operator<(const Timer& t) const
-{
-    return m_time < t.m_time;
-}
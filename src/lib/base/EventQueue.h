@@ -22,11 +22,12 @@
 #include "arch/IArchMultithread.h"
 #include "base/IEventQueue.h"
 #include "base/Event.h"
-#include "base/PriorityQueue.h"
 #include "base/Stopwatch.h"
 #include "common/stdmap.h"
 #include "common/stdset.h"
+#include "common/stdvector.h"
 
+#include <memory>
 #include <queue>
 
 class Mutex;
@@ -76,40 +77,50 @@ private:
 private:
     class Timer {
     public:
-        Timer(EventQueueTimer*, double timeout, double initialTime,
+        Timer(EventQueueTimer*, double timeout, double deadline,
                             void* target, bool oneShot);
         ~Timer();
 
-        void            reset();
-
-        Timer&            operator-=(double);
-
-                        operator double() const;
+        void            reset(double now);
+        void            setIndex(size_t);
 
         bool            isOneShot() const;
         EventQueueTimer*
                         getTimer() const;
         void*            getTarget() const;
-        void            fillEvent(TimerEvent&) const;
-
-        bool            operator<(const Timer&) const;
+        double            getDeadline() const;
+        size_t            getIndex() const;
+        void            fillEvent(TimerEvent&, double now) const;
 
     private:
         EventQueueTimer*    m_timer;
         double                m_timeout;
         void*                m_target;
         bool                m_oneShot;
-        double                m_time;
+        double                m_deadline;
+        size_t                m_index;
     };
 
-    typedef std::set<EventQueueTimer*> Timers;
-    typedef PriorityQueue<Timer> TimerQueue;
-    typedef std::map<UInt32, Event> EventTable;
+    // timers by handle, and a heap of the same timers ordered by
+    // deadline.  each timer knows its place in the heap so it can be
+    // removed without searching.
+    typedef std::map<EventQueueTimer*, Timer*> Timers;
+    typedef std::vector<Timer*> TimerHeap;
+    typedef std::vector<Event> EventTable;
     typedef std::vector<UInt32> EventIDList;
     typedef std::map<Event::Type, const char*> TypeMap;
     typedef std::map<String, Event::Type> NameMap;
     typedef std::map<Event::Type, IEventJob*> TypeHandlerTable;
     typedef std::map<void*, TypeHandlerTable> HandlerTable;
+    typedef std::shared_ptr<const HandlerTable> HandlerTablePtr;
+
+    HandlerTablePtr        getHandlers() const;
+    void                setHandlers(HandlerTable* handlers);
+    EventQueueTimer*    addTimer(double duration, void* target, bool oneShot);
+    void                addTimerToHeap(Timer*);
+    void                removeTimerFromHeap(Timer*);
+    void                moveTimerUp(size_t index);
+    void                moveTimerDown(size_t index);
 
     int                    m_systemTarget;
     ArchMutex            m_mutex;
@@ -122,18 +133,21 @@ private:
     // buffer of events
     IEventQueueBuffer*    m_buffer;
 
-    // saved events
+    // saved events, indexed by id.  unused slots hold kUnknown events
+    // and their ids are in m_oldEventIDs.
     EventTable            m_events;
     EventIDList        m_oldEventIDs;
 
-    // timers
+    // timers.  deadlines are times on m_time, which is never reset.
     Stopwatch            m_time;
     Timers                m_timers;
-    TimerQueue            m_timerQueue;
+    TimerHeap            m_timerHeap;
     TimerEvent            m_timerEvent;
 
-    // event handlers
-    HandlerTable        m_handlers;
+    // event handlers.  the table is never changed once published so
+    // dispatch can use it without locking.  changes copy it under
+    // m_mutex and publish the copy.
+    HandlerTablePtr        m_handlers;
 
 public:
     //
@@ -23,10 +23,12 @@
 #include "base/log_outputters.h"
 #include "common/Version.h"
 
+#include <chrono>
 #include <cstdio>
 #include <cstring>
 #include <iostream>
 #include <ctime> 
+#include <string>
 
 // names of priorities
 static const char*        g_priority[] = {
@@ -46,6 +48,15 @@ static const char*        g_priority[] = {
 // number of priorities
 static const int g_numPriority = (int)(sizeof(g_priority) / sizeof(g_priority[0]));
 
+// names of formats
+static const char*        g_format[] = {
+    "text",
+    "json"
+};
+
+// number of formats
+static const int g_numFormat = (int)(sizeof(g_format) / sizeof(g_format[0]));
+
 // the default priority
 #ifndef NDEBUG
 static const int        g_defaultMaxPriority = kDEBUG;
@@ -53,6 +64,102 @@ static const int        g_defaultMaxPriority = kDEBUG;
 static const int        g_defaultMaxPriority = kINFO;
 #endif
 
+//
+// LogLineBuffer
+//
+
+// each thread formats its messages in one of these so the space is
+// reused from line to line, and the local time is only formatted again
+// when the second changes.
+class LogLineBuffer {
+public:
+    LogLineBuffer() : m_inUse(false), m_second(-1) { m_timestamp[0] = '\0'; }
+
+    const char*            getTimestamp();
+
+public:
+    bool                m_inUse;
+    std::string            m_message;
+    std::string            m_line;
+
+private:
+    time_t                m_second;
+    char                m_timestamp[32];
+};
+
+const char*
+LogLineBuffer::getTimestamp()
+{
+    time_t t = time(NULL);
+    if (t != m_second) {
+        struct tm tm;
+#if SYSAPI_WIN32
+        localtime_s(&tm, &t);
+#else
+        localtime_r(&t, &tm);
+#endif
+        // strftime() writes nothing, rather than truncating, if the
+        // result wouldn't fit
+        if (strftime(m_timestamp, sizeof(m_timestamp),
+                            "%Y-%m-%dT%H:%M:%S", &tm) == 0) {
+            m_timestamp[0] = '\0';
+        }
+        m_second = t;
+    }
+    return m_timestamp;
+}
+
+static thread_local LogLineBuffer s_lineBuffer;
+
+// appends s as the contents of a json string
+static void
+appendJsonString(std::string& line, const char* s)
+{
+    static const char* s_hex = "0123456789abcdef";
+    while (*s != '\0') {
+        // copy everything up to the next character to escape at once
+        const char* run = s;
+        while ((unsigned char)*s >= 0x20 && *s != '"' && *s != '\\') {
+            ++s;
+        }
+        line.append(run, s - run);
+
+        unsigned char c = (unsigned char)*s;
+        switch (c) {
+        case '\0': return;
+        case '"':  line += "\\\""; break;
+        case '\\': line += "\\\\"; break;
+        case '\n': line += "\\n"; break;
+        case '\r': line += "\\r"; break;
+        case '\t': line += "\\t"; break;
+        default:
+            line += "\\u00";
+            line += s_hex[c >> 4];
+            line += s_hex[c & 15];
+            break;
+        }
+        ++s;
+    }
+}
+
+// appends n in decimal
+static void
+appendNumber(std::string& line, long long n)
+{
+    char digits[24];
+    char* end   = digits + sizeof(digits);
+    char* start = end;
+    unsigned long long u = (n < 0) ? 0ull - (unsigned long long)n : n;
+    do {
+        *--start = (char)('0' + u % 10);
+        u /= 10;
+    } while (u != 0);
+    if (n < 0) {
+        *--start = '-';
+    }
+    line.append(start, end - start);
+}
+
 //
 // Log
 //
@@ -68,7 +175,7 @@ Log::Log()
 
     // other initalization
     m_maxPriority = g_defaultMaxPriority;
-    m_maxNewlineLength = 0;
+    m_format = kFormatText;
     insert(new ConsoleLogOutputter);
 
     s_log = this;
@@ -93,13 +200,6 @@ Log::~Log()
     ARCH->closeMutex(m_mutex);
 }
 
-Log*
-Log::getInstance()
-{
-    assert(s_log != NULL);
-    return s_log;
-}
-
 const char*
 Log::getFilterName() const
 {
@@ -119,94 +219,122 @@ void
 Log::print(const char* file, int line, const char* fmt, ...)
 {
     // check if fmt begins with a priority argument
-    ELevel priority = kINFO;
+    int priority = kINFO;
     if ((strlen(fmt) > 2) && (fmt[0] == '%' && fmt[1] == 'z')) {
 
         // 060 in octal is 0 (48 in decimal), so subtracting this converts ascii
         // number it a true number. we could use atoi instead, but this is how
         // it was done originally.
-        priority = (ELevel)(fmt[2] - '\060');
+        priority = fmt[2] - '\060';
 
         // move the pointer on past the debug priority char
         fmt += 3;
     }
 
     // done if below priority threshold
-    if (priority > getFilter()) {
+    if (!isEnabled(priority)) {
+        return;
+    }
+
+    va_list args;
+    va_start(args, fmt);
+    vprint(priority, file, line, fmt, args);
+    va_end(args);
+}
+
+void
+Log::printLevel(int level, const char* file, int line, const char* fmt, ...)
+{
+    // done if below priority threshold
+    if (!isEnabled(level)) {
         return;
     }
 
-    // compute prefix padding length
-    char stack[1024];
+    va_list args;
+    va_start(args, fmt);
+    vprint(level, file, line, fmt, args);
+    va_end(args);
+}
+
+void
+Log::vprint(int level, const char* file, int line, const char* fmt, va_list args)
+{
+    ELevel priority = (ELevel)level;
 
-    // compute suffix padding length
-    int sPad = m_maxNewlineLength;
+    // an outputter that logs would find this thread's buffer in use
+    LogLineBuffer nested;
+    LogLineBuffer* buffer = &s_lineBuffer;
+    if (buffer->m_inUse) {
+        buffer = &nested;
+    }
+    buffer->m_inUse = true;
 
-    // print to buffer, leaving space for a newline at the end and prefix
-    // at the beginning.
-    char* buffer = stack;
-    int len            = (int)(sizeof(stack) / sizeof(stack[0]));
+    // print the message, growing the buffer until it fits
+    std::string& message = buffer->m_message;
+    if (message.size() < 256) {
+        message.resize(256);
+    }
     while (true) {
-        // try printing into the buffer
-        va_list args;
-        va_start(args, fmt);
-        int n = ARCH->vsnprintf(buffer, len    - sPad, fmt, args);
-        va_end(args);
-
-        // if the buffer wasn't big enough then make it bigger and try again
-        if (n < 0 || n > (int)len) {
-            if (buffer != stack) {
-                delete[] buffer;
-            }
-            len     *= 2;
-            buffer = new char[len];
-        }
+        va_list copy;
+        va_copy(copy, args);
+        int n = ARCH->vsnprintf(&message[0], (int)message.size(), fmt, copy);
+        va_end(copy);
 
-        // if the buffer was big enough then continue
-        else {
+        if (n >= 0 && n < (int)message.size()) {
             break;
         }
+        message.resize(n >= 0 ? n + 1 : message.size() * 2);
     }
+    const char* text = message.c_str();
 
-    // print the prefix to the buffer.    leave space for priority label.
     // do not prefix time and file for kPRINT (CLOG_PRINT)
-    if (priority != kPRINT) {
-
-        struct tm *tm;
-        char timestamp[50];
-        time_t t;
-        time(&t);
-        tm = localtime(&t);
-        sprintf(timestamp, "%04i-%02i-%02iT%02i:%02i:%02i", tm->tm_year + 1900, tm->tm_mon+1, tm->tm_mday, tm->tm_hour, tm->tm_min, tm->tm_sec);
-
-        // square brackets, spaces, comma and null terminator take about 10
-        int size = 10;
-        size += strlen(timestamp);
-        size += strlen(g_priority[priority]);
-        size += strlen(buffer);
-#ifndef NDEBUG
-        size += strlen(file);
-        // assume there is no file contains over 100k lines of code
-        size += 6;
-#endif
-        char* message = new char[size];
-
-#ifndef NDEBUG
-        sprintf(message, "[%s] %s: %s\n\t%s,%d", timestamp, g_priority[priority], buffer, file, line);
-#else
-        sprintf(message, "[%s] %s: %s", timestamp, g_priority[priority], buffer);
-#endif
-
-        output(priority, message);
-        delete[] message;
-    } else {
-        output(priority, buffer);
+    if (priority == kPRINT) {
+        output(priority, text);
+        buffer->m_inUse = false;
+        return;
     }
 
-    // clean up
-    if (buffer != stack) {
-        delete[] buffer;
+    std::string& out = buffer->m_line;
+    out.clear();
+    if (getFormat() == kFormatJson) {
+        long long now = (long long)std::chrono::duration_cast<
+                            std::chrono::microseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch()).count();
+
+        out += "{\"time\":\"";
+        out += buffer->getTimestamp();
+        out += "\",\"monotonic_us\":";
+        appendNumber(out, now);
+        out += ",\"level\":\"";
+        out += g_priority[priority];
+        out += "\",\"message\":\"";
+        appendJsonString(out, text);
+        out += "\"";
+        if (file != NULL) {
+            out += ",\"file\":\"";
+            appendJsonString(out, file);
+            out += "\",\"line\":";
+            appendNumber(out, line);
+        }
+        out += "}";
     }
+    else {
+        out += "[";
+        out += buffer->getTimestamp();
+        out += "] ";
+        out += g_priority[priority];
+        out += ": ";
+        out += text;
+        if (file != NULL) {
+            out += "\n\t";
+            out += file;
+            out += ",";
+            appendNumber(out, line);
+        }
+    }
+
+    output(priority, out.c_str());
+    buffer->m_inUse = false;
 }
 
 void
@@ -271,19 +399,38 @@ Log::setFilter(const char* maxPriority)
 void
 Log::setFilter(int maxPriority)
 {
-    ArchMutexLock lock(m_mutex);
-    m_maxPriority = maxPriority;
+    m_maxPriority.store(maxPriority, std::memory_order_relaxed);
 }
 
-int
-Log::getFilter() const
+bool
+Log::setFormat(const char* name)
 {
-    ArchMutexLock lock(m_mutex);
-    return m_maxPriority;
+    if (name != NULL) {
+        for (int i = 0; i < g_numFormat; ++i) {
+            if (strcmp(name, g_format[i]) == 0) {
+                setFormat((EFormat)i);
+                return true;
+            }
+        }
+        return false;
+    }
+    return true;
+}
+
+void
+Log::setFormat(EFormat format)
+{
+    m_format.store(format, std::memory_order_relaxed);
+}
+
+Log::EFormat
+Log::getFormat() const
+{
+    return (EFormat)m_format.load(std::memory_order_relaxed);
 }
 
 void
-Log::output(ELevel priority, char* msg)
+Log::output(ELevel priority, const char* msg)
 {
     assert(priority >= -1 && priority < g_numPriority);
     assert(msg != NULL);
@@ -20,9 +20,11 @@
 
 #include "arch/IArchMultithread.h"
 #include "arch/Arch.h"
+#include "base/ELevel.h"
 #include "common/common.h"
 #include "common/stdlist.h"
 
+#include <atomic>
 #include <stdarg.h>
 
 #define CLOG (Log::getInstance())
@@ -40,6 +42,12 @@ LOGC() provide convenient access.
 */
 class Log {
 public:
+    //! Line formats
+    enum EFormat {
+        kFormatText,            //!< \c [timestamp] LEVEL: message
+        kFormatJson                //!< One JSON object per line
+    };
+
     Log();
     Log(Log* src);
     ~Log();
@@ -94,6 +102,22 @@ public:
     //! Set the minimum priority filter (by ordinal).
     void                setFilter(int);
 
+    //! Set the line format
+    /*!
+    Set the format messages are written in.  The default is \c text,
+    which prefixes each message with the local time and priority.
+    \c json writes each message as an object with the local time, a
+    monotonic timestamp in microseconds, the priority and the message,
+    so logs from the server and clients can be lined up.  CLOG_PRINT
+    messages are written as they are either way.  setFormat(const char*)
+    returns true if the format \c name was recognized;  if \c name is
+    NULL then it simply returns true.
+    */
+    bool                setFormat(const char* name);
+
+    //! Set the line format (by enumerant).
+    void                setFormat(EFormat);
+
     //@}
     //! @name accessors
     //@{
@@ -107,8 +131,33 @@ public:
     void                print(const char* file, int line,
                             const char* format, ...);
 
+    //! Print a log message at a priority
+    /*!
+    Like print() except the priority is given by \c level rather than a
+    \c %z prefix on \c format.  The LOG() macro uses this once it has
+    checked the priority is enabled.
+    */
+    void                printLevel(int level, const char* file, int line,
+                            const char* format, ...);
+
     //! Get the minimum priority level.
-    int                    getFilter() const;
+    int                    getFilter() const
+    {
+        return m_maxPriority.load(std::memory_order_relaxed);
+    }
+
+    //! Check if a priority is enabled
+    /*!
+    Returns true if messages with priority \c level would be printed.
+    This doesn't lock so it's cheap enough to check before formatting.
+    */
+    bool                isEnabled(int level) const
+    {
+        return level <= getFilter();
+    }
+
+    //! Get the line format.
+    EFormat                getFormat() const;
 
     //! Get the filter name of the current filter level.
     const char*            getFilterName() const;
@@ -117,7 +166,11 @@ public:
     const char*            getFilterName(int level) const;
 
     //! Get the singleton instance of the log
-    static Log*        getInstance();
+    static Log*        getInstance()
+    {
+        assert(s_log != NULL);
+        return s_log;
+    }
 
     //! Get the console filter level (messages above this are not sent to console).
     int                    getConsoleMaxLevel() const { return kDEBUG2; }
@@ -125,7 +178,9 @@ public:
     //@}
 
 private:
-    void                output(ELevel priority, char* msg);
+    void                vprint(int level, const char* file, int line,
+                            const char* format, va_list args);
+    void                output(ELevel priority, const char* msg);
 
 private:
     typedef std::list<ILogOutputter*> OutputterList;
@@ -135,8 +190,8 @@ private:
     ArchMutex            m_mutex;
     OutputterList        m_outputters;
     OutputterList        m_alwaysOutputters;
-    int                    m_maxNewlineLength;
-    int                    m_maxPriority;
+    std::atomic<int>    m_maxPriority;
+    std::atomic<int>    m_format;
 };
 
 /*!
@@ -152,10 +207,13 @@ replaced by one of enumerants in \c Log::ELevel without the leading
 \c k.  For example, \c CLOG_INFO.  The special \c CLOG_PRINT level will
 not be filtered and is never prefixed by the filename and line number.
 
+The priority is checked before anything else so the arguments aren't
+evaluated if the message would be filtered out.  Messages with a
+priority above \c LOG_MAX_LEVEL aren't compiled in at all.
+
 If \c NOLOGGING is defined during the build then this macro expands to
-nothing.  If \c NDEBUG is defined during the build then it expands to a
-call to Log::print.  Otherwise it expands to a call to Log::printt,
-which includes the filename and line number.
+nothing.  If \c NDEBUG is defined during the build then the filename
+and line number are not passed to Log::printLevel.
 */
 
 /*!
@@ -174,38 +232,47 @@ filename and line number.
 
 If \c NOLOGGING is defined during the build then this macro expands to
 nothing.  If \c NDEBUG is not defined during the build then it expands
-to a call to Log::print that prints the filename and line number,
-otherwise it expands to a call that doesn't.
+to a call that prints the filename and line number, otherwise it
+expands to a call that doesn't.
 */
 
+// the most verbose priority compiled in.  building with LOG_MAX_LEVEL set
+// to kDEBUG2 leaves out the DEBUG3 to DEBUG5 messages.
+#if !defined(LOG_MAX_LEVEL)
+#define LOG_MAX_LEVEL    kDEBUG5
+#endif
+
+// the CLOG_* defines are the priority followed by the file and line, so
+// LOG() can pull the priority out of its argument and check it first.
+// LOG_EXPAND_ makes msvc split __VA_ARGS__ into separate arguments.
+#define LOG_EXPAND_(_a)    _a
+#define LOG_PRINT_(_level, ...) \
+    ((_level) > LOG_MAX_LEVEL || !CLOG->isEnabled(_level) ? \
+        (void)0 : CLOG->printLevel(_level, __VA_ARGS__))
+
 #if defined(NOLOGGING)
 #define LOG(_a1)
 #define LOGC(_a1, _a2)
 #define CLOG_TRACE
 #elif defined(NDEBUG)
-#define LOG(_a1)        CLOG->print _a1
-#define LOGC(_a1, _a2)    if (_a1) CLOG->print _a2
+#define LOG(_a1)        LOG_EXPAND_(LOG_PRINT_ _a1)
+#define LOGC(_a1, _a2)    if (_a1) LOG(_a2)
 #define CLOG_TRACE        NULL, 0,
 #else
-#define LOG(_a1)        CLOG->print _a1
-#define LOGC(_a1, _a2)    if (_a1) CLOG->print _a2
+#define LOG(_a1)        LOG_EXPAND_(LOG_PRINT_ _a1)
+#define LOGC(_a1, _a2)    if (_a1) LOG(_a2)
 #define CLOG_TRACE        __FILE__, __LINE__,
 #endif
 
-// the CLOG_* defines are line and file plus %z and an octal number (060=0, 
-// 071=9), but the limitation is that once we run out of numbers at either 
-// end, then we resort to using non-numerical chars. this still works (since 
-// to deduce the number we subtract octal \060, so '/' is -1, and ':' is 10
-
-#define CLOG_PRINT        CLOG_TRACE "%z\057" // char is '/'
-#define CLOG_CRIT        CLOG_TRACE "%z\060" // char is '0'
-#define CLOG_ERR        CLOG_TRACE "%z\061"
-#define CLOG_WARN        CLOG_TRACE "%z\062"
-#define CLOG_NOTE        CLOG_TRACE "%z\063"
-#define CLOG_INFO        CLOG_TRACE "%z\064"
-#define CLOG_DEBUG        CLOG_TRACE "%z\065"
-#define CLOG_DEBUG1        CLOG_TRACE "%z\066"
-#define CLOG_DEBUG2        CLOG_TRACE "%z\067"
-#define CLOG_DEBUG3        CLOG_TRACE "%z\070"
-#define CLOG_DEBUG4        CLOG_TRACE "%z\071" // char is '9'
-#define CLOG_DEBUG5        CLOG_TRACE "%z\072" // char is ':'
+#define CLOG_PRINT        kPRINT, CLOG_TRACE ""
+#define CLOG_CRIT        kFATAL, CLOG_TRACE ""
+#define CLOG_ERR        kERROR, CLOG_TRACE ""
+#define CLOG_WARN        kWARNING, CLOG_TRACE ""
+#define CLOG_NOTE        kNOTE, CLOG_TRACE ""
+#define CLOG_INFO        kINFO, CLOG_TRACE ""
+#define CLOG_DEBUG        kDEBUG, CLOG_TRACE ""
+#define CLOG_DEBUG1        kDEBUG1, CLOG_TRACE ""
+#define CLOG_DEBUG2        kDEBUG2, CLOG_TRACE ""
+#define CLOG_DEBUG3        kDEBUG3, CLOG_TRACE ""
+#define CLOG_DEBUG4        kDEBUG4, CLOG_TRACE ""
+#define CLOG_DEBUG5        kDEBUG5, CLOG_TRACE ""
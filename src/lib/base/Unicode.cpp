@@ -21,6 +21,11 @@
 
 #include <cstring>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UNICODE_SSE2 1
+#include <emmintrin.h>
+#endif
+
 //
 // local utility functions
 //
@@ -69,6 +74,34 @@ decode32(const UInt8* n, bool byteSwapped)
     return c.n32;
 }
 
+inline
+static
+void
+store16(UInt8* dst, UInt16 c)
+{
+    memcpy(dst, &c, 2);
+}
+
+inline
+static
+void
+store32(UInt8* dst, UInt32 c)
+{
+    memcpy(dst, &c, 4);
+}
+
+inline
+static
+void
+advance(UInt8*& dst, UInt32& size, UInt32 n)
+{
+    // count n bytes of output and, if they were written, skip them
+    size += n;
+    if (dst != NULL) {
+        dst += n;
+    }
+}
+
 inline
 static
 void
@@ -90,6 +123,197 @@ setError(bool* errors)
 }
 
 
+
+//
+// ASCII runs
+//
+// these convert the run of ASCII characters at the start of src, a
+// block at a time where SSE2 is available, and return its length in
+// characters.  text is mostly ASCII so most of it goes through here.
+// the wide characters are in native byte order, little endian with
+// SSE2, unless byteSwapped.
+//
+
+#if UNICODE_SSE2
+
+inline
+static
+__m128i
+load128(const UInt8* src)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+}
+
+inline
+static
+void
+store128(UInt8* dst, __m128i v)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), v);
+}
+
+// true iff every byte of v is zero
+inline
+static
+bool
+isZero128(__m128i v)
+{
+    return (_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) ==
+                            0xffff);
+}
+
+#endif
+
+// the length of the ASCII run in UTF-8 src
+static
+UInt32
+countASCII(const UInt8* src, UInt32 n)
+{
+    UInt32 i = 0;
+#if UNICODE_SSE2
+    for (; i + 16 <= n; i += 16) {
+        if (_mm_movemask_epi8(load128(src + i)) != 0) {
+            break;
+        }
+    }
+#endif
+    while (i < n && src[i] < 0x80) {
+        ++i;
+    }
+    return i;
+}
+
+// copy the ASCII run in UTF-8 src to 16 bit characters in dst
+static
+UInt32
+widenASCII16(UInt8* dst, const UInt8* src, UInt32 n)
+{
+    UInt32 i = 0;
+#if UNICODE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = load128(src + i);
+        if (_mm_movemask_epi8(v) != 0) {
+            break;
+        }
+        store128(dst + 2 * i,      _mm_unpacklo_epi8(v, zero));
+        store128(dst + 2 * i + 16, _mm_unpackhi_epi8(v, zero));
+    }
+#endif
+    for (; i < n && src[i] < 0x80; ++i) {
+        store16(dst + 2 * i, src[i]);
+    }
+    return i;
+}
+
+// copy the ASCII run in UTF-8 src to 32 bit characters in dst
+static
+UInt32
+widenASCII32(UInt8* dst, const UInt8* src, UInt32 n)
+{
+    UInt32 i = 0;
+#if UNICODE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = load128(src + i);
+        if (_mm_movemask_epi8(v) != 0) {
+            break;
+        }
+        __m128i lo = _mm_unpacklo_epi8(v, zero);
+        __m128i hi = _mm_unpackhi_epi8(v, zero);
+        store128(dst + 4 * i,      _mm_unpacklo_epi16(lo, zero));
+        store128(dst + 4 * i + 16, _mm_unpackhi_epi16(lo, zero));
+        store128(dst + 4 * i + 32, _mm_unpacklo_epi16(hi, zero));
+        store128(dst + 4 * i + 48, _mm_unpackhi_epi16(hi, zero));
+    }
+#endif
+    for (; i < n && src[i] < 0x80; ++i) {
+        store32(dst + 4 * i, src[i]);
+    }
+    return i;
+}
+
+// copy the ASCII run in 16 bit src to UTF-8 in dst, unless it's NULL
+static
+UInt32
+narrowASCII16(UInt8* dst, const UInt8* src, UInt32 n, bool byteSwapped)
+{
+    UInt32 i = 0;
+#if UNICODE_SSE2
+    // a character is ASCII iff none of the bits in mask are set
+    const __m128i mask = _mm_set1_epi16(
+                            static_cast<short>(byteSwapped ? 0x80ff : 0xff80));
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = load128(src + 2 * i);
+        __m128i b = load128(src + 2 * i + 16);
+        if (!isZero128(_mm_and_si128(_mm_or_si128(a, b), mask))) {
+            break;
+        }
+        if (dst != NULL) {
+            if (byteSwapped) {
+                a = _mm_srli_epi16(a, 8);
+                b = _mm_srli_epi16(b, 8);
+            }
+            store128(dst + i, _mm_packus_epi16(a, b));
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        UInt16 c = decode16(src + 2 * i, byteSwapped);
+        if (c >= 0x80) {
+            break;
+        }
+        if (dst != NULL) {
+            dst[i] = static_cast<UInt8>(c);
+        }
+    }
+    return i;
+}
+
+// copy the ASCII run in 32 bit src to UTF-8 in dst, unless it's NULL
+static
+UInt32
+narrowASCII32(UInt8* dst, const UInt8* src, UInt32 n, bool byteSwapped)
+{
+    UInt32 i = 0;
+#if UNICODE_SSE2
+    // a character is ASCII iff none of the bits in mask are set
+    const __m128i mask = _mm_set1_epi32(
+                            static_cast<int>(byteSwapped ? 0x80ffffff : 0xffffff80));
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = load128(src + 4 * i);
+        __m128i b = load128(src + 4 * i + 16);
+        __m128i c = load128(src + 4 * i + 32);
+        __m128i d = load128(src + 4 * i + 48);
+        if (!isZero128(_mm_and_si128(_mm_or_si128(_mm_or_si128(a, b),
+                            _mm_or_si128(c, d)), mask))) {
+            break;
+        }
+        if (dst != NULL) {
+            if (byteSwapped) {
+                a = _mm_srli_epi32(a, 24);
+                b = _mm_srli_epi32(b, 24);
+                c = _mm_srli_epi32(c, 24);
+                d = _mm_srli_epi32(d, 24);
+            }
+            store128(dst + i, _mm_packus_epi16(_mm_packs_epi32(a, b),
+                            _mm_packs_epi32(c, d)));
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        UInt32 c = decode32(src + 4 * i, byteSwapped);
+        if (c >= 0x80) {
+            break;
+        }
+        if (dst != NULL) {
+            dst[i] = static_cast<UInt8>(c);
+        }
+    }
+    return i;
+}
+
+
 //
 // Unicode
 //
@@ -103,7 +327,13 @@ Unicode::isUTF8(const String& src)
     // convert and test each character
     const UInt8* data = reinterpret_cast<const UInt8*>(src.c_str());
     for (UInt32 n = (UInt32)src.size(); n > 0; ) {
-        if (fromUTF8(data, n) == s_invalid) {
+        if (data[0] < 0x80) {
+            // skip the whole run of ASCII
+            UInt32 ascii = countASCII(data, n);
+            data += ascii;
+            n    -= ascii;
+        }
+        else if (fromUTF8(data, n) == s_invalid) {
             return false;
         }
     }
@@ -116,14 +346,26 @@ Unicode::UTF8ToUCS2(const String& src, bool* errors)
     // default to success
     resetError(errors);
 
-    // get size of input string and reserve some space in output
+    // make exactly enough space in output
     UInt32 n = (UInt32)src.size();
-    String dst;
-    dst.reserve(2 * n);
+    const UInt8* data = reinterpret_cast<const UInt8*>(src.c_str());
+    String dst(2 * countUTF8(data, n, false), '\0');
+    if (dst.empty()) {
+        return dst;
+    }
 
     // convert each character
-    const UInt8* data = reinterpret_cast<const UInt8*>(src.c_str());
+    UInt8* out = reinterpret_cast<UInt8*>(&dst[0]);
     while (n > 0) {
+        if (data[0] < 0x80) {
+            // convert the whole run of ASCII at once
+            UInt32 ascii = widenASCII16(out, data, n);
+            out  += 2 * ascii;
+            data += ascii;
+            n    -= ascii;
+            continue;
+        }
+
         UInt32 c = fromUTF8(data, n);
         if (c == s_invalid) {
             c = s_replacement;
@@ -132,8 +374,8 @@ Unicode::UTF8ToUCS2(const String& src, bool* errors)
             setError(errors);
             c = s_replacement;
         }
-        UInt16 ucs2 = static_cast<UInt16>(c);
-        dst.append(reinterpret_cast<const char*>(&ucs2), 2);
+        store16(out, static_cast<UInt16>(c));
+        out += 2;
     }
 
     return dst;
@@ -145,19 +387,32 @@ Unicode::UTF8ToUCS4(const String& src, bool* errors)
     // default to success
     resetError(errors);
 
-    // get size of input string and reserve some space in output
+    // make exactly enough space in output
     UInt32 n = (UInt32)src.size();
-    String dst;
-    dst.reserve(4 * n);
+    const UInt8* data = reinterpret_cast<const UInt8*>(src.c_str());
+    String dst(4 * countUTF8(data, n, false), '\0');
+    if (dst.empty()) {
+        return dst;
+    }
 
     // convert each character
-    const UInt8* data = reinterpret_cast<const UInt8*>(src.c_str());
+    UInt8* out = reinterpret_cast<UInt8*>(&dst[0]);
     while (n > 0) {
+        if (data[0] < 0x80) {
+            // convert the whole run of ASCII at once
+            UInt32 ascii = widenASCII32(out, data, n);
+            out  += 4 * ascii;
+            data += ascii;
+            n    -= ascii;
+            continue;
+        }
+
         UInt32 c = fromUTF8(data, n);
         if (c == s_invalid) {
             c = s_replacement;
         }
-        dst.append(reinterpret_cast<const char*>(&c), 4);
+        store32(out, c);
+        out += 4;
     }
 
     return dst;
@@ -169,14 +424,26 @@ Unicode::UTF8ToUTF16(const String& src, bool* errors)
     // default to success
     resetError(errors);
 
-    // get size of input string and reserve some space in output
+    // make exactly enough space in output
     UInt32 n = (UInt32)src.size();
-    String dst;
-    dst.reserve(2 * n);
+    const UInt8* data = reinterpret_cast<const UInt8*>(src.c_str());
+    String dst(2 * countUTF8(data, n, true), '\0');
+    if (dst.empty()) {
+        return dst;
+    }
 
     // convert each character
-    const UInt8* data = reinterpret_cast<const UInt8*>(src.c_str());
+    UInt8* out = reinterpret_cast<UInt8*>(&dst[0]);
     while (n > 0) {
+        if (data[0] < 0x80) {
+            // convert the whole run of ASCII at once
+            UInt32 ascii = widenASCII16(out, data, n);
+            out  += 2 * ascii;
+            data += ascii;
+            n    -= ascii;
+            continue;
+        }
+
         UInt32 c = fromUTF8(data, n);
         if (c == s_invalid) {
             c = s_replacement;
@@ -186,15 +453,14 @@ Unicode::UTF8ToUTF16(const String& src, bool* errors)
             c = s_replacement;
         }
         if (c < 0x00010000) {
-            UInt16 ucs2 = static_cast<UInt16>(c);
-            dst.append(reinterpret_cast<const char*>(&ucs2), 2);
+            store16(out, static_cast<UInt16>(c));
+            out += 2;
         }
         else {
             c -= 0x00010000;
-            UInt16 utf16h = static_cast<UInt16>((c >> 10) + 0xd800);
-            UInt16 utf16l = static_cast<UInt16>((c & 0x03ff) + 0xdc00);
-            dst.append(reinterpret_cast<const char*>(&utf16h), 2);
-            dst.append(reinterpret_cast<const char*>(&utf16l), 2);
+            store16(out,     static_cast<UInt16>((c >> 10) + 0xd800));
+            store16(out + 2, static_cast<UInt16>((c & 0x03ff) + 0xdc00));
+            out += 4;
         }
     }
 
@@ -207,14 +473,26 @@ Unicode::UTF8ToUTF32(const String& src, bool* errors)
     // default to success
     resetError(errors);
 
-    // get size of input string and reserve some space in output
+    // make exactly enough space in output
     UInt32 n = (UInt32)src.size();
-    String dst;
-    dst.reserve(4 * n);
+    const UInt8* data = reinterpret_cast<const UInt8*>(src.c_str());
+    String dst(4 * countUTF8(data, n, false), '\0');
+    if (dst.empty()) {
+        return dst;
+    }
 
     // convert each character
-    const UInt8* data = reinterpret_cast<const UInt8*>(src.c_str());
+    UInt8* out = reinterpret_cast<UInt8*>(&dst[0]);
     while (n > 0) {
+        if (data[0] < 0x80) {
+            // convert the whole run of ASCII at once
+            UInt32 ascii = widenASCII32(out, data, n);
+            out  += 4 * ascii;
+            data += ascii;
+            n    -= ascii;
+            continue;
+        }
+
         UInt32 c = fromUTF8(data, n);
         if (c == s_invalid) {
             c = s_replacement;
@@ -223,7 +501,8 @@ Unicode::UTF8ToUTF32(const String& src, bool* errors)
             setError(errors);
             c = s_replacement;
         }
-        dst.append(reinterpret_cast<const char*>(&c), 4);
+        store32(out, c);
+        out += 4;
     }
 
     return dst;
@@ -381,10 +660,6 @@ Unicode::wideCharToUTF8(const wchar_t* src, UInt32 size, bool* errors)
 String
 Unicode::doUCS2ToUTF8(const UInt8* data, UInt32 n, bool* errors)
 {
-    // make some space
-    String dst;
-    dst.reserve(n);
-
     // check if first character is 0xfffe or 0xfeff
     bool byteSwapped = false;
     if (n >= 1) {
@@ -405,22 +680,18 @@ Unicode::doUCS2ToUTF8(const UInt8* data, UInt32 n, bool* errors)
         }
     }
 
-    // convert each character
-    for (; n > 0; data += 2, --n) {
-        UInt32 c = decode16(data, byteSwapped);
-        toUTF8(dst, c, errors);
+    // make exactly enough space in output then convert
+    String dst(doUCS2ToUTF8(NULL, data, n, byteSwapped, NULL), '\0');
+    if (!dst.empty()) {
+        doUCS2ToUTF8(reinterpret_cast<UInt8*>(&dst[0]),
+                            data, n, byteSwapped, errors);
     }
-
     return dst;
 }
 
 String
 Unicode::doUCS4ToUTF8(const UInt8* data, UInt32 n, bool* errors)
 {
-    // make some space
-    String dst;
-    dst.reserve(n);
-
     // check if first character is 0xfffe or 0xfeff
     bool byteSwapped = false;
     if (n >= 1) {
@@ -441,22 +712,18 @@ Unicode::doUCS4ToUTF8(const UInt8* data, UInt32 n, bool* errors)
         }
     }
 
-    // convert each character
-    for (; n > 0; data += 4, --n) {
-        UInt32 c = decode32(data, byteSwapped);
-        toUTF8(dst, c, errors);
+    // make exactly enough space in output then convert
+    String dst(doUCS4ToUTF8(NULL, data, n, byteSwapped, NULL), '\0');
+    if (!dst.empty()) {
+        doUCS4ToUTF8(reinterpret_cast<UInt8*>(&dst[0]),
+                            data, n, byteSwapped, errors);
     }
-
     return dst;
 }
 
 String
 Unicode::doUTF16ToUTF8(const UInt8* data, UInt32 n, bool* errors)
 {
-    // make some space
-    String dst;
-    dst.reserve(n);
-
     // check if first character is 0xfffe or 0xfeff
     bool byteSwapped = false;
     if (n >= 1) {
@@ -477,48 +744,18 @@ Unicode::doUTF16ToUTF8(const UInt8* data, UInt32 n, bool* errors)
         }
     }
 
-    // convert each character
-    for (; n > 0; data += 2, --n) {
-        UInt32 c = decode16(data, byteSwapped);
-        if (c < 0x0000d800 || c > 0x0000dfff) {
-            toUTF8(dst, c, errors);
-        }
-        else if (n == 1) {
-            // error -- missing second word
-            setError(errors);
-            toUTF8(dst, s_replacement, NULL);
-        }
-        else if (c >= 0x0000d800 && c <= 0x0000dbff) {
-            UInt32 c2 = decode16(data, byteSwapped);
-            data += 2;
-            --n;
-            if (c2 < 0x0000dc00 || c2 > 0x0000dfff) {
-                // error -- [d800,dbff] not followed by [dc00,dfff]
-                setError(errors);
-                toUTF8(dst, s_replacement, NULL);
-            }
-            else {
-                c = (((c - 0x0000d800) << 10) | (c2 - 0x0000dc00)) + 0x00010000;
-                toUTF8(dst, c, errors);
-            }
-        }
-        else {
-            // error -- [dc00,dfff] without leading [d800,dbff]
-            setError(errors);
-            toUTF8(dst, s_replacement, NULL);
-        }
+    // make exactly enough space in output then convert
+    String dst(doUTF16ToUTF8(NULL, data, n, byteSwapped, NULL), '\0');
+    if (!dst.empty()) {
+        doUTF16ToUTF8(reinterpret_cast<UInt8*>(&dst[0]),
+                            data, n, byteSwapped, errors);
     }
-
     return dst;
 }
 
 String
 Unicode::doUTF32ToUTF8(const UInt8* data, UInt32 n, bool* errors)
 {
-    // make some space
-    String dst;
-    dst.reserve(n);
-
     // check if first character is 0xfffe or 0xfeff
     bool byteSwapped = false;
     if (n >= 1) {
@@ -539,17 +776,151 @@ Unicode::doUTF32ToUTF8(const UInt8* data, UInt32 n, bool* errors)
         }
     }
 
-    // convert each character
+    // make exactly enough space in output then convert
+    String dst(doUTF32ToUTF8(NULL, data, n, byteSwapped, NULL), '\0');
+    if (!dst.empty()) {
+        doUTF32ToUTF8(reinterpret_cast<UInt8*>(&dst[0]),
+                            data, n, byteSwapped, errors);
+    }
+    return dst;
+}
+
+UInt32
+Unicode::doUCS2ToUTF8(UInt8* dst, const UInt8* data, UInt32 n,
+                bool byteSwapped, bool* errors)
+{
+    UInt32 size = 0;
+    for (; n > 0; data += 2, --n) {
+        UInt32 c = decode16(data, byteSwapped);
+        if (c < 0x00000080) {
+            // convert the whole run of ASCII at once, less the
+            // character the loop steps over
+            UInt32 ascii = narrowASCII16(dst, data, n, byteSwapped);
+            advance(dst, size, ascii);
+            data += 2 * (ascii - 1);
+            n    -= ascii - 1;
+        }
+        else {
+            advance(dst, size, toUTF8(dst, c, errors));
+        }
+    }
+    return size;
+}
+
+UInt32
+Unicode::doUCS4ToUTF8(UInt8* dst, const UInt8* data, UInt32 n,
+                bool byteSwapped, bool* errors)
+{
+    UInt32 size = 0;
     for (; n > 0; data += 4, --n) {
         UInt32 c = decode32(data, byteSwapped);
-        if (c >= 0x00110000) {
+        if (c < 0x00000080) {
+            // convert the whole run of ASCII at once, less the
+            // character the loop steps over
+            UInt32 ascii = narrowASCII32(dst, data, n, byteSwapped);
+            advance(dst, size, ascii);
+            data += 4 * (ascii - 1);
+            n    -= ascii - 1;
+        }
+        else {
+            advance(dst, size, toUTF8(dst, c, errors));
+        }
+    }
+    return size;
+}
+
+UInt32
+Unicode::doUTF16ToUTF8(UInt8* dst, const UInt8* data, UInt32 n,
+                bool byteSwapped, bool* errors)
+{
+    UInt32 size = 0;
+    for (; n > 0; data += 2, --n) {
+        UInt32 c = decode16(data, byteSwapped);
+        if (c < 0x00000080) {
+            // convert the whole run of ASCII at once, less the
+            // character the loop steps over
+            UInt32 ascii = narrowASCII16(dst, data, n, byteSwapped);
+            advance(dst, size, ascii);
+            data += 2 * (ascii - 1);
+            n    -= ascii - 1;
+        }
+        else if (c < 0x0000d800 || c > 0x0000dfff) {
+            advance(dst, size, toUTF8(dst, c, errors));
+        }
+        else if (n == 1) {
+            // error -- missing second word
             setError(errors);
-            c = s_replacement;
+            advance(dst, size, toUTF8(dst, s_replacement, NULL));
+        }
+        else if (c >= 0x0000d800 && c <= 0x0000dbff) {
+            UInt32 c2 = decode16(data, byteSwapped);
+            data += 2;
+            --n;
+            if (c2 < 0x0000dc00 || c2 > 0x0000dfff) {
+                // error -- [d800,dbff] not followed by [dc00,dfff]
+                setError(errors);
+                advance(dst, size, toUTF8(dst, s_replacement, NULL));
+            }
+            else {
+                c = (((c - 0x0000d800) << 10) | (c2 - 0x0000dc00)) + 0x00010000;
+                advance(dst, size, toUTF8(dst, c, errors));
+            }
+        }
+        else {
+            // error -- [dc00,dfff] without leading [d800,dbff]
+            setError(errors);
+            advance(dst, size, toUTF8(dst, s_replacement, NULL));
         }
-        toUTF8(dst, c, errors);
     }
+    return size;
+}
 
-    return dst;
+UInt32
+Unicode::doUTF32ToUTF8(UInt8* dst, const UInt8* data, UInt32 n,
+                bool byteSwapped, bool* errors)
+{
+    UInt32 size = 0;
+    for (; n > 0; data += 4, --n) {
+        UInt32 c = decode32(data, byteSwapped);
+        if (c < 0x00000080) {
+            // convert the whole run of ASCII at once, less the
+            // character the loop steps over
+            UInt32 ascii = narrowASCII32(dst, data, n, byteSwapped);
+            advance(dst, size, ascii);
+            data += 4 * (ascii - 1);
+            n    -= ascii - 1;
+        }
+        else {
+            if (c >= 0x00110000) {
+                setError(errors);
+                c = s_replacement;
+            }
+            advance(dst, size, toUTF8(dst, c, errors));
+        }
+    }
+    return size;
+}
+
+UInt32
+Unicode::countUTF8(const UInt8* data, UInt32 n, bool pairs)
+{
+    UInt32 count = 0;
+    while (n > 0) {
+        if (data[0] < 0x80) {
+            UInt32 ascii = countASCII(data, n);
+            count += ascii;
+            data  += ascii;
+            n     -= ascii;
+        }
+        else {
+            UInt32 c = fromUTF8(data, n);
+            if (pairs && c >= 0x00010000 && c < 0x00110000) {
+                ++count;
+            }
+            ++count;
+        }
+    }
+    return count;
 }
 
 UInt32
@@ -727,58 +1098,79 @@ Unicode::fromUTF8(const UInt8*& data, UInt32& n)
     return c;
 }
 
-void
-Unicode::toUTF8(String& dst, UInt32 c, bool* errors)
+UInt32
+Unicode::toUTF8(UInt8* dst, UInt32 c, bool* errors)
 {
-    UInt8 data[6];
-
     // handle characters outside the valid range
     if ((c >= 0x0000d800 && c <= 0x0000dfff) || c >= 0x80000000) {
         setError(errors);
         c = s_replacement;
     }
 
-    // convert to UTF-8
+    // compute the encoding length
+    UInt32 size;
     if (c < 0x00000080) {
-        data[0] = static_cast<UInt8>(c);
-        dst.append(reinterpret_cast<char*>(data), 1);
+        size = 1;
     }
     else if (c < 0x00000800) {
-        data[0] = static_cast<UInt8>(((c >>  6) & 0x0000001f) + 0xc0);
-        data[1] = static_cast<UInt8>((c         & 0x0000003f) + 0x80);
-        dst.append(reinterpret_cast<char*>(data), 2);
+        size = 2;
     }
     else if (c < 0x00010000) {
-        data[0] = static_cast<UInt8>(((c >> 12) & 0x0000000f) + 0xe0);
-        data[1] = static_cast<UInt8>(((c >>  6) & 0x0000003f) + 0x80);
-        data[2] = static_cast<UInt8>((c         & 0x0000003f) + 0x80);
-        dst.append(reinterpret_cast<char*>(data), 3);
+        size = 3;
     }
     else if (c < 0x00200000) {
-        data[0] = static_cast<UInt8>(((c >> 18) & 0x00000007) + 0xf0);
-        data[1] = static_cast<UInt8>(((c >> 12) & 0x0000003f) + 0x80);
-        data[2] = static_cast<UInt8>(((c >>  6) & 0x0000003f) + 0x80);
-        data[3] = static_cast<UInt8>((c         & 0x0000003f) + 0x80);
-        dst.append(reinterpret_cast<char*>(data), 4);
+        size = 4;
     }
     else if (c < 0x04000000) {
-        data[0] = static_cast<UInt8>(((c >> 24) & 0x00000003) + 0xf8);
-        data[1] = static_cast<UInt8>(((c >> 18) & 0x0000003f) + 0x80);
-        data[2] = static_cast<UInt8>(((c >> 12) & 0x0000003f) + 0x80);
-        data[3] = static_cast<UInt8>(((c >>  6) & 0x0000003f) + 0x80);
-        data[4] = static_cast<UInt8>((c         & 0x0000003f) + 0x80);
-        dst.append(reinterpret_cast<char*>(data), 5);
-    }
-    else if (c < 0x80000000) {
-        data[0] = static_cast<UInt8>(((c >> 30) & 0x00000001) + 0xfc);
-        data[1] = static_cast<UInt8>(((c >> 24) & 0x0000003f) + 0x80);
-        data[2] = static_cast<UInt8>(((c >> 18) & 0x0000003f) + 0x80);
-        data[3] = static_cast<UInt8>(((c >> 12) & 0x0000003f) + 0x80);
-        data[4] = static_cast<UInt8>(((c >>  6) & 0x0000003f) + 0x80);
-        data[5] = static_cast<UInt8>((c         & 0x0000003f) + 0x80);
-        dst.append(reinterpret_cast<char*>(data), 6);
+        size = 5;
     }
     else {
-        assert(0 && "character out of range");
+        size = 6;
+    }
+    if (dst == NULL) {
+        return size;
+    }
+
+    // convert to UTF-8
+    switch (size) {
+    case 1:
+        dst[0] = static_cast<UInt8>(c);
+        break;
+
+    case 2:
+        dst[0] = static_cast<UInt8>(((c >>  6) & 0x0000001f) + 0xc0);
+        dst[1] = static_cast<UInt8>((c         & 0x0000003f) + 0x80);
+        break;
+
+    case 3:
+        dst[0] = static_cast<UInt8>(((c >> 12) & 0x0000000f) + 0xe0);
+        dst[1] = static_cast<UInt8>(((c >>  6) & 0x0000003f) + 0x80);
+        dst[2] = static_cast<UInt8>((c         & 0x0000003f) + 0x80);
+        break;
+
+    case 4:
+        dst[0] = static_cast<UInt8>(((c >> 18) & 0x00000007) + 0xf0);
+        dst[1] = static_cast<UInt8>(((c >> 12) & 0x0000003f) + 0x80);
+        dst[2] = static_cast<UInt8>(((c >>  6) & 0x0000003f) + 0x80);
+        dst[3] = static_cast<UInt8>((c         & 0x0000003f) + 0x80);
+        break;
+
+    case 5:
+        dst[0] = static_cast<UInt8>(((c >> 24) & 0x00000003) + 0xf8);
+        dst[1] = static_cast<UInt8>(((c >> 18) & 0x0000003f) + 0x80);
+        dst[2] = static_cast<UInt8>(((c >> 12) & 0x0000003f) + 0x80);
+        dst[3] = static_cast<UInt8>(((c >>  6) & 0x0000003f) + 0x80);
+        dst[4] = static_cast<UInt8>((c         & 0x0000003f) + 0x80);
+        break;
+
+    case 6:
+        dst[0] = static_cast<UInt8>(((c >> 30) & 0x00000001) + 0xfc);
+        dst[1] = static_cast<UInt8>(((c >> 24) & 0x0000003f) + 0x80);
+        dst[2] = static_cast<UInt8>(((c >> 18) & 0x0000003f) + 0x80);
+        dst[3] = static_cast<UInt8>(((c >> 12) & 0x0000003f) + 0x80);
+        dst[4] = static_cast<UInt8>(((c >>  6) & 0x0000003f) + 0x80);
+        dst[5] = static_cast<UInt8>((c         & 0x0000003f) + 0x80);
+        break;
     }
+    return size;
 }
@@ -134,9 +134,26 @@ private:
     static String        doUTF16ToUTF8(const UInt8* src, UInt32 n, bool* errors);
     static String        doUTF32ToUTF8(const UInt8* src, UInt32 n, bool* errors);
 
-    // convert characters to/from UTF8
+    // convert n characters, without a byte order mark, to UTF8 in dst
+    // and return the number of bytes.  if dst is NULL then only count
+    // the bytes.
+    static UInt32        doUCS2ToUTF8(UInt8* dst, const UInt8* src,
+                            UInt32 n, bool byteSwapped, bool* errors);
+    static UInt32        doUCS4ToUTF8(UInt8* dst, const UInt8* src,
+                            UInt32 n, bool byteSwapped, bool* errors);
+    static UInt32        doUTF16ToUTF8(UInt8* dst, const UInt8* src,
+                            UInt32 n, bool byteSwapped, bool* errors);
+    static UInt32        doUTF32ToUTF8(UInt8* dst, const UInt8* src,
+                            UInt32 n, bool byteSwapped, bool* errors);
+
+    // count the characters in UTF8, counting those that need a UTF-16
+    // surrogate pair twice if pairs is true
+    static UInt32        countUTF8(const UInt8* src, UInt32 n, bool pairs);
+
+    // convert characters to/from UTF8.  toUTF8() writes to dst, unless
+    // it's NULL, and returns the number of bytes.
     static UInt32        fromUTF8(const UInt8*& src, UInt32& size);
-    static void            toUTF8(String& dst, UInt32 c, bool* errors);
+    static UInt32        toUTF8(UInt8* dst, UInt32 c, bool* errors);
 
 private:
     static UInt32        s_invalid;
@@ -23,7 +23,9 @@
 #include <fstream>
 
 enum EFileLogOutputter {
-    kFileSizeLimit = 1024 // kb
+    kFileSizeLimit   = 1024, // kb
+    kFileGenerations = 1,
+    kBufferSizeLimit = 1024  // kb
 };
 
 //
@@ -237,58 +239,196 @@ BufferedLogOutputter::write(ELevel, const char* message)
 // FileLogOutputter
 //
 
-FileLogOutputter::FileLogOutputter(const char* logFile)
+FileLogOutputter::FileLogOutputter(const char* logFile) :
+    m_fileMutex(ARCH->newMutex()),
+    m_fileSize(0),
+    m_maxFileSize(kFileSizeLimit * 1024),
+    m_generations(kFileGenerations),
+    m_bufferMutex(ARCH->newMutex()),
+    m_bufferCond(ARCH->newCondVar()),
+    m_dropped(0),
+    m_stopping(false)
 {
     setLogFilename(logFile);
+
+    // not a Thread because that logs, and this may be being destroyed
+    // by the log when it does
+    m_writer = ARCH->newThread(&FileLogOutputter::writerThread, this);
 }
 
 FileLogOutputter::~FileLogOutputter()
 {
+    {
+        ArchMutexLock lock(m_bufferMutex);
+        m_stopping = true;
+        ARCH->broadcastCondVar(m_bufferCond);
+    }
+    ARCH->wait(m_writer, -1.0);
+    ARCH->closeThread(m_writer);
+
+    close();
+    ARCH->closeCondVar(m_bufferCond);
+    ARCH->closeMutex(m_bufferMutex);
+    ARCH->closeMutex(m_fileMutex);
 }
 
 void
 FileLogOutputter::setLogFilename(const char* logFile)
 {
     assert(logFile != NULL);
+
+    // finish with the old file first
+    ArchMutexLock lock(m_fileMutex);
+    writeBuffer();
+    m_handle.close();
     m_fileName = logFile;
 }
 
+void
+FileLogOutputter::setRotation(size_t maxSize, UInt32 generations)
+{
+    ArchMutexLock lock(m_fileMutex);
+    m_maxFileSize = maxSize;
+    m_generations = generations;
+}
+
 bool
 FileLogOutputter::write(ELevel level, const char *message)
 {
-    bool moveFile = false;
-
-    std::ofstream m_handle;
-    m_handle.open(m_fileName.c_str(), std::fstream::app);
-    if (m_handle.is_open() && m_handle.fail() != true) {
-        m_handle << message << std::endl;
-
-        // when file size exceeds limits, move to 'old log' filename.
-        size_t p = m_handle.tellp();
-        if (p > (kFileSizeLimit * 1024)) {
-            moveFile = true;
+    bool wake = false;
+    {
+        ArchMutexLock lock(m_bufferMutex);
+        if (m_buffer.size() < kBufferSizeLimit * 1024) {
+            wake = m_buffer.empty();
+            m_buffer.append(message);
+            m_buffer.append(1, '\n');
+        }
+        else {
+            ++m_dropped;
+        }
+        if (wake) {
+            ARCH->broadcastCondVar(m_bufferCond);
         }
     }
-    m_handle.close();
 
-    if (moveFile) {
-        String oldLogFilename = synergy::string::sprintf("%s.1", m_fileName.c_str());
-        remove(oldLogFilename.c_str());
-        rename(m_fileName.c_str(), oldLogFilename.c_str());
+    // don't lose errors if we're about to crash
+    if (level >= kFATAL && level <= kERROR) {
+        flush();
     }
 
     return true;
 }
 
+void
+FileLogOutputter::flush()
+{
+    ArchMutexLock lock(m_fileMutex);
+    writeBuffer();
+}
+
 void
 FileLogOutputter::open(const char *title) {}
 
 void
-FileLogOutputter::close() {}
+FileLogOutputter::close()
+{
+    ArchMutexLock lock(m_fileMutex);
+    writeBuffer();
+    m_handle.close();
+}
 
 void
 FileLogOutputter::show(bool showIfEmpty) {}
 
+void*
+FileLogOutputter::writerThread(void* vself)
+{
+    FileLogOutputter* self = static_cast<FileLogOutputter*>(vself);
+    for (;;) {
+        bool stopping;
+        {
+            ArchMutexLock lock(self->m_bufferMutex);
+            while (self->m_buffer.empty() && !self->m_stopping) {
+                ARCH->waitCondVar(self->m_bufferCond, self->m_bufferMutex, -1.0);
+            }
+            stopping = self->m_stopping;
+        }
+
+        self->flush();
+        if (stopping) {
+            return NULL;
+        }
+    }
+}
+
+void
+FileLogOutputter::writeBuffer()
+{
+    // note -- m_fileMutex must be locked on entry
+
+    // take the buffered lines, leaving the buffer we wrote last time in
+    // their place so its memory gets reused
+    UInt32 dropped;
+    {
+        ArchMutexLock lock(m_bufferMutex);
+        m_writing.swap(m_buffer);
+        dropped   = m_dropped;
+        m_dropped = 0;
+    }
+    if (m_writing.empty() && dropped == 0) {
+        return;
+    }
+
+    if (!m_handle.is_open()) {
+        m_handle.open(m_fileName.c_str(), std::fstream::app);
+        m_handle.seekp(0, std::ios::end);
+        std::streamoff size = m_handle.tellp();
+        m_fileSize = (size > 0) ? static_cast<size_t>(size) : 0;
+    }
+    if (m_handle.is_open() && m_handle.fail() != true) {
+        m_handle.write(m_writing.data(), m_writing.size());
+        m_fileSize += m_writing.size();
+        if (dropped != 0) {
+            String note = synergy::string::sprintf(
+                            "%d log lines dropped\n", dropped);
+            m_handle.write(note.data(), note.size());
+            m_fileSize += note.size();
+        }
+        m_handle.flush();
+
+        // when file size exceeds limits, move to 'old log' filename.
+        if (m_fileSize > m_maxFileSize) {
+            rotate();
+        }
+    }
+    m_writing.clear();
+}
+
+void
+FileLogOutputter::rotate()
+{
+    // note -- m_fileMutex must be locked on entry
+
+    m_handle.close();
+    m_fileSize = 0;
+
+    // the oldest generation goes and the rest move up one
+    if (m_generations == 0) {
+        remove(m_fileName.c_str());
+        return;
+    }
+    String oldest = synergy::string::sprintf("%s.%d",
+                            m_fileName.c_str(), m_generations);
+    remove(oldest.c_str());
+    for (UInt32 i = m_generations; i > 1; --i) {
+        String from = synergy::string::sprintf("%s.%d", m_fileName.c_str(), i - 1);
+        String to   = synergy::string::sprintf("%s.%d", m_fileName.c_str(), i);
+        rename(from.c_str(), to.c_str());
+    }
+    String newest = synergy::string::sprintf("%s.1", m_fileName.c_str());
+    rename(m_fileName.c_str(), newest.c_str());
+}
+
 //
 // MesssageBoxLogOutputter
 //
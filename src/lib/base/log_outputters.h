@@ -19,6 +19,7 @@
 #pragma once
 
 #include "mt/Thread.h"
+#include "arch/IArchMultithread.h"
 #include "base/ILogOutputter.h"
 #include "base/String.h"
 #include "common/basic_types.h"
@@ -65,8 +66,12 @@ public:
 
 //! Write log to file
 /*!
-This outputter writes output to the file.  The level for each
-message is ignored.
+This outputter writes output to the file.  Lines are buffered and
+written by a thread of its own so logging doesn't wait on the disk,
+except that errors are written before \c write() returns.  The file is
+kept open and moved aside when it gets too big, keeping a number of
+old files.  If the buffer fills up then lines are dropped and a note
+of how many is written in their place.
 */
 
 class FileLogOutputter : public ILogOutputter {
@@ -80,10 +85,49 @@ public:
     virtual void        show(bool showIfEmpty);
     virtual bool        write(ELevel level, const char* message);
 
+    //! @name manipulators
+    //@{
+
     void                setLogFilename(const char* title);
 
+    //! Set rotation
+    /*!
+    Moves the file aside when it grows past \p maxSize bytes, keeping
+    \p generations old files named with the suffixes .1, .2 and so on.
+    */
+    void                setRotation(size_t maxSize, UInt32 generations);
+
+    //! Write buffered lines
+    /*!
+    Writes the lines buffered so far to the file before returning.
+    */
+    void                flush();
+
+    //@}
+
+private:
+    static void*        writerThread(void*);
+    void                writeBuffer();
+    void                rotate();
+
 private:
+    // guarded by m_fileMutex
+    ArchMutex            m_fileMutex;
     std::string            m_fileName;
+    std::ofstream        m_handle;
+    size_t                m_fileSize;
+    size_t                m_maxFileSize;
+    UInt32                m_generations;
+    String                m_writing;
+
+    // guarded by m_bufferMutex
+    ArchMutex            m_bufferMutex;
+    ArchCond            m_bufferCond;
+    String                m_buffer;
+    UInt32                m_dropped;
+    bool                m_stopping;
+
+    ArchThread            m_writer;
 };
 
 //! Write log to system log
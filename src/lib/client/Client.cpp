@@ -742,7 +742,7 @@ Client::handleResume(const Event&, void*)
 void
 Client::handleFileChunkSending(const Event& event, void*)
 {
-    sendFileChunk(event.getData());
+    sendFileChunk(static_cast<FileChunk*>(event.getDataObject()));
 }
 
 void
@@ -23,7 +23,7 @@
 #include "core/ClipboardChunk.h"
 #include "core/StreamChunker.h"
 #include "core/Clipboard.h"
-#include "core/ProtocolUtil.h"
+#include "core/ProtocolMessages.h"
 #include "core/option_types.h"
 #include "core/protocol_types.h"
 #include "io/IStream.h"
@@ -51,6 +51,10 @@ ServerProxy::ServerProxy(Client* client, synergy::IStream* stream, IEventQueue*
     m_ignoreMouse(false),
     m_keepAliveAlarm(0.0),
     m_keepAliveAlarmTimer(NULL),
+    m_noopReplies(kNoopRepliesPerMessage),
+    m_noopPending(false),
+    m_noopTimer(NULL),
+    m_fileChunksUnflushed(0),
     m_parser(&ServerProxy::parseHandshakeMessage),
     m_events(events)
 {
@@ -67,6 +71,12 @@ ServerProxy::ServerProxy(Client* client, synergy::IStream* stream, IEventQueue*
                             new TMethodEventJob<ServerProxy>(this,
                                 &ServerProxy::handleData));
 
+    // let the file sender know when its chunks have gone out
+    m_events->adoptHandler(m_events->forIStream().outputFlushed(),
+                            m_stream->getEventTarget(),
+                            new TMethodEventJob<ServerProxy>(this,
+                                &ServerProxy::handleOutputFlushed));
+
     m_events->adoptHandler(m_events->forClipboard().clipboardSending(),
                             this,
                             new TMethodEventJob<ServerProxy>(this,
@@ -79,8 +89,19 @@ ServerProxy::ServerProxy(Client* client, synergy::IStream* stream, IEventQueue*
 ServerProxy::~ServerProxy()
 {
     setKeepAliveRate(-1.0);
+    if (m_noopTimer != NULL) {
+        m_events->removeHandler(Event::kTimer, m_noopTimer);
+        m_events->deleteTimer(m_noopTimer);
+    }
     m_events->removeHandler(m_events->forIStream().inputReady(),
                             m_stream->getEventTarget());
+    m_events->removeHandler(m_events->forIStream().outputFlushed(),
+                            m_stream->getEventTarget());
+
+    // the chunks won't be flushed now so don't leave the sender waiting
+    if (m_fileChunksUnflushed > 0) {
+        StreamChunker::interruptFile();
+    }
 }
 
 void
@@ -107,6 +128,63 @@ ServerProxy::setKeepAliveRate(double rate)
     resetKeepAliveAlarm();
 }
 
+void
+ServerProxy::replyWithNoop()
+{
+    // send a reply.  this is intended to work around a delay when
+    // running a linux server and an OS X (any BSD?) client.  the
+    // client waits to send an ACK (if the system control flag
+    // net.inet.tcp.delayed_ack is 1) in hopes of piggybacking it
+    // on a data packet.  we provide that packet here.  i don't
+    // know why a delayed ACK should cause the server to wait since
+    // TCP_NODELAY is enabled.
+    //
+    // one packet per message doubles the traffic for mouse motion
+    // so servers that know about it can ask for fewer.
+    switch (m_noopReplies) {
+    case kNoopRepliesPerMessage:
+        synergy::protocol::CNoop::send(m_stream);
+        break;
+
+    case kNoopRepliesPerBatch:
+        // sent once the batch has been handled
+        m_noopPending = true;
+        break;
+
+    case kNoopRepliesCoalesced:
+        if (m_noopTimer == NULL) {
+            m_noopTimer = m_events->newOneShotTimer(kNoopReplyDelay, NULL);
+            m_events->adoptHandler(Event::kTimer, m_noopTimer,
+                            new TMethodEventJob<ServerProxy>(this,
+                                &ServerProxy::handleNoopTimer));
+        }
+        break;
+
+    case kNoopRepliesNone:
+        break;
+    }
+}
+
+void
+ServerProxy::setNoopReplies(OptionValue value)
+{
+    switch (value) {
+    case kNoopRepliesPerMessage:
+    case kNoopRepliesPerBatch:
+    case kNoopRepliesCoalesced:
+    case kNoopRepliesNone:
+        m_noopReplies = static_cast<ENoopReplies>(value);
+        break;
+
+    default:
+        // a policy from a newer server.  replying to everything is
+        // always safe.
+        m_noopReplies = kNoopRepliesPerMessage;
+        break;
+    }
+    LOG((CLOG_DEBUG1 "no-op replies policy %d", m_noopReplies));
+}
+
 void
 ServerProxy::handleData(const Event&, void*)
 {
@@ -141,194 +219,100 @@ ServerProxy::handleData(const Event&, void*)
     }
 
     flushCompressedMouse();
+
+    if (m_noopPending) {
+        m_noopPending = false;
+        synergy::protocol::CNoop::send(m_stream);
+    }
 }
 
 ServerProxy::EResult
 ServerProxy::parseHandshakeMessage(const UInt8* code)
 {
-    if (memcmp(code, kMsgQInfo, 4) == 0) {
-        queryInfo();
-    }
-
-    else if (memcmp(code, kMsgCInfoAck, 4) == 0) {
-        infoAcknowledgment();
-    }
-
-    else if (memcmp(code, kMsgDSetOptions, 4) == 0) {
-        setOptions();
-
-        // handshake is complete
-        m_parser = &ServerProxy::parseMessage;
-        m_client->handshakeComplete();
-    }
-
-    else if (memcmp(code, kMsgCResetOptions, 4) == 0) {
-        resetOptions();
-    }
-
-    else if (memcmp(code, kMsgCKeepAlive, 4) == 0) {
-        // echo keep alives and reset alarm
-        ProtocolUtil::writef(m_stream, kMsgCKeepAlive);
-        resetKeepAliveAlarm();
-    }
-
-    else if (memcmp(code, kMsgCNoop, 4) == 0) {
-        // accept and discard no-op
-    }
-
-    else if (memcmp(code, kMsgCClose, 4) == 0) {
-        // server wants us to hangup
-        LOG((CLOG_DEBUG1 "recv close"));
-        m_client->disconnect(NULL);
-        return kDisconnect;
-    }
-
-    else if (memcmp(code, kMsgEIncompatible, 4) == 0) {
-        SInt32 major, minor;
-        ProtocolUtil::readf(m_stream,
-                        kMsgEIncompatible + 4, &major, &minor);
-        LOG((CLOG_ERR "server has incompatible version %d.%d", major, minor));
-        m_client->disconnect("server has incompatible version");
-        return kDisconnect;
-    }
-
-    else if (memcmp(code, kMsgEBusy, 4) == 0) {
-        LOG((CLOG_ERR "server already has a connected client with name \"%s\"", m_client->getName().c_str()));
-        m_client->disconnect("server already has a connected client with our name");
-        return kDisconnect;
-    }
-
-    else if (memcmp(code, kMsgEUnknown, 4) == 0) {
-        LOG((CLOG_ERR "server refused client with name \"%s\"", m_client->getName().c_str()));
-        m_client->disconnect("server refused client with our name");
-        return kDisconnect;
-    }
-
-    else if (memcmp(code, kMsgEBad, 4) == 0) {
-        LOG((CLOG_ERR "server disconnected due to a protocol error"));
-        m_client->disconnect("server reported a protocol error");
-        return kDisconnect;
-    }
-    else {
+    const MessageEntry* entry = getHandshakeMessages().find(code);
+    if (entry == NULL) {
         return kUnknown;
     }
 
-    return kOkay;
+    (this->*entry->m_handler)();
+    return entry->m_result;
 }
 
 ServerProxy::EResult
 ServerProxy::parseMessage(const UInt8* code)
 {
-    if (memcmp(code, kMsgDMouseMove, 4) == 0) {
-        mouseMove();
-    }
-
-    else if (memcmp(code, kMsgDMouseRelMove, 4) == 0) {
-        mouseRelativeMove();
-    }
-
-    else if (memcmp(code, kMsgDMouseWheel, 4) == 0) {
-        mouseWheel();
-    }
-
-    else if (memcmp(code, kMsgDKeyDown, 4) == 0) {
-        keyDown();
-    }
-
-    else if (memcmp(code, kMsgDKeyUp, 4) == 0) {
-        keyUp();
-    }
-
-    else if (memcmp(code, kMsgDMouseDown, 4) == 0) {
-        mouseDown();
-    }
-
-    else if (memcmp(code, kMsgDMouseUp, 4) == 0) {
-        mouseUp();
-    }
-
-    else if (memcmp(code, kMsgDKeyRepeat, 4) == 0) {
-        keyRepeat();
-    }
-
-    else if (memcmp(code, kMsgCKeepAlive, 4) == 0) {
-        // echo keep alives and reset alarm
-        ProtocolUtil::writef(m_stream, kMsgCKeepAlive);
-        resetKeepAliveAlarm();
-    }
-
-    else if (memcmp(code, kMsgCNoop, 4) == 0) {
-        // accept and discard no-op
-    }
-
-    else if (memcmp(code, kMsgCEnter, 4) == 0) {
-        enter();
-    }
-
-    else if (memcmp(code, kMsgCLeave, 4) == 0) {
-        leave();
-    }
-
-    else if (memcmp(code, kMsgCClipboard, 4) == 0) {
-        grabClipboard();
-    }
-
-    else if (memcmp(code, kMsgCScreenSaver, 4) == 0) {
-        screensaver();
-    }
-
-    else if (memcmp(code, kMsgQInfo, 4) == 0) {
-        queryInfo();
-    }
-
-    else if (memcmp(code, kMsgCInfoAck, 4) == 0) {
-        infoAcknowledgment();
-    }
-
-    else if (memcmp(code, kMsgDClipboard, 4) == 0) {
-        setClipboard();
-    }
-
-    else if (memcmp(code, kMsgCResetOptions, 4) == 0) {
-        resetOptions();
+    const MessageEntry* entry = getMessages().find(code);
+    if (entry == NULL) {
+        return kUnknown;
     }
 
-    else if (memcmp(code, kMsgDSetOptions, 4) == 0) {
-        setOptions();
+    (this->*entry->m_handler)();
+    if (entry->m_result == kOkay) {
+        replyWithNoop();
     }
+    return entry->m_result;
+}
 
-    else if (memcmp(code, kMsgDFileTransfer, 4) == 0) {
-        fileChunkReceived();
-    }
-    else if (memcmp(code, kMsgDDragInfo, 4) == 0) {
-        dragInfoReceived();
-    }
+const ServerProxy::MessageTable&
+ServerProxy::getHandshakeMessages()
+{
+    static const MessageTable s_messages = makeHandshakeMessages();
+    return s_messages;
+}
 
-    else if (memcmp(code, kMsgCClose, 4) == 0) {
-        // server wants us to hangup
-        LOG((CLOG_DEBUG1 "recv close"));
-        m_client->disconnect(NULL);
-        return kDisconnect;
-    }
-    else if (memcmp(code, kMsgEBad, 4) == 0) {
-        LOG((CLOG_ERR "server disconnected due to a protocol error"));
-        m_client->disconnect("server reported a protocol error");
-        return kDisconnect;
-    }
-    else {
-        return kUnknown;
-    }
+const ServerProxy::MessageTable&
+ServerProxy::getMessages()
+{
+    static const MessageTable s_messages = makeMessages();
+    return s_messages;
+}
 
-    // send a reply.  this is intended to work around a delay when
-    // running a linux server and an OS X (any BSD?) client.  the
-    // client waits to send an ACK (if the system control flag
-    // net.inet.tcp.delayed_ack is 1) in hopes of piggybacking it
-    // on a data packet.  we provide that packet here.  i don't
-    // know why a delayed ACK should cause the server to wait since
-    // TCP_NODELAY is enabled.
-    ProtocolUtil::writef(m_stream, kMsgCNoop);
+ServerProxy::MessageTable
+ServerProxy::makeHandshakeMessages()
+{
+    MessageTable table;
+    table.add(kMsgQInfo,         MessageEntry(&ServerProxy::queryInfo));
+    table.add(kMsgCInfoAck,      MessageEntry(&ServerProxy::infoAcknowledgment));
+    table.add(kMsgDSetOptions,   MessageEntry(&ServerProxy::completeHandshake));
+    table.add(kMsgCResetOptions, MessageEntry(&ServerProxy::resetOptions));
+    table.add(kMsgCKeepAlive,    MessageEntry(&ServerProxy::keepAlive));
+    table.add(kMsgCNoop,         MessageEntry(&ServerProxy::noop));
+    table.add(kMsgCClose,        MessageEntry(&ServerProxy::close, kDisconnect));
+    table.add(kMsgEIncompatible, MessageEntry(&ServerProxy::incompatible, kDisconnect));
+    table.add(kMsgEBusy,         MessageEntry(&ServerProxy::busy, kDisconnect));
+    table.add(kMsgEUnknown,      MessageEntry(&ServerProxy::unknownClient, kDisconnect));
+    table.add(kMsgEBad,          MessageEntry(&ServerProxy::protocolError, kDisconnect));
+    return table;
+}
 
-    return kOkay;
+ServerProxy::MessageTable
+ServerProxy::makeMessages()
+{
+    MessageTable table;
+    table.add(kMsgDMouseMove,    MessageEntry(&ServerProxy::mouseMove));
+    table.add(kMsgDMouseRelMove, MessageEntry(&ServerProxy::mouseRelativeMove));
+    table.add(kMsgDMouseWheel,   MessageEntry(&ServerProxy::mouseWheel));
+    table.add(kMsgDKeyDown,      MessageEntry(&ServerProxy::keyDown));
+    table.add(kMsgDKeyUp,        MessageEntry(&ServerProxy::keyUp));
+    table.add(kMsgDMouseDown,    MessageEntry(&ServerProxy::mouseDown));
+    table.add(kMsgDMouseUp,      MessageEntry(&ServerProxy::mouseUp));
+    table.add(kMsgDKeyRepeat,    MessageEntry(&ServerProxy::keyRepeat));
+    table.add(kMsgCKeepAlive,    MessageEntry(&ServerProxy::keepAlive));
+    table.add(kMsgCNoop,         MessageEntry(&ServerProxy::noop));
+    table.add(kMsgCEnter,        MessageEntry(&ServerProxy::enter));
+    table.add(kMsgCLeave,        MessageEntry(&ServerProxy::leave));
+    table.add(kMsgCClipboard,    MessageEntry(&ServerProxy::grabClipboard));
+    table.add(kMsgCScreenSaver,  MessageEntry(&ServerProxy::screensaver));
+    table.add(kMsgQInfo,         MessageEntry(&ServerProxy::queryInfo));
+    table.add(kMsgCInfoAck,      MessageEntry(&ServerProxy::infoAcknowledgment));
+    table.add(kMsgDClipboard,    MessageEntry(&ServerProxy::setClipboard));
+    table.add(kMsgCResetOptions, MessageEntry(&ServerProxy::resetOptions));
+    table.add(kMsgDSetOptions,   MessageEntry(&ServerProxy::setOptions));
+    table.add(kMsgDFileTransfer, MessageEntry(&ServerProxy::fileChunkReceived));
+    table.add(kMsgDDragInfo,     MessageEntry(&ServerProxy::dragInfoReceived));
+    table.add(kMsgCClose,        MessageEntry(&ServerProxy::close, kDisconnect));
+    table.add(kMsgEBad,          MessageEntry(&ServerProxy::protocolError, kDisconnect));
+    return table;
 }
 
 void
@@ -338,6 +322,16 @@ ServerProxy::handleKeepAliveAlarm(const Event&, void*)
     m_client->disconnect("server is not responding");
 }
 
+void
+ServerProxy::handleNoopTimer(const Event&, void*)
+{
+    m_events->removeHandler(Event::kTimer, m_noopTimer);
+    m_events->deleteTimer(m_noopTimer);
+    m_noopTimer = NULL;
+
+    synergy::protocol::CNoop::send(m_stream);
+}
+
 void
 ServerProxy::onInfoChanged()
 {
@@ -353,7 +347,7 @@ bool
 ServerProxy::onGrabClipboard(ClipboardID id)
 {
     LOG((CLOG_DEBUG1 "sending clipboard %d changed", id));
-    ProtocolUtil::writef(m_stream, kMsgCClipboard, id, m_seqNum);
+    synergy::protocol::CClipboard::send(m_stream, id, m_seqNum);
     return true;
 }
 
@@ -385,7 +379,7 @@ void
 ServerProxy::sendInfo(const ClientInfo& info)
 {
     LOG((CLOG_DEBUG1 "sending info shape=%d,%d %dx%d", info.m_x, info.m_y, info.m_w, info.m_h));
-    ProtocolUtil::writef(m_stream, kMsgDInfo,
+    synergy::protocol::DInfo::send(m_stream,
                                 info.m_x, info.m_y,
                                 info.m_w, info.m_h, 0,
                                 info.m_mx, info.m_my);
@@ -518,7 +512,7 @@ ServerProxy::enter()
     SInt16 x, y;
     UInt16 mask;
     UInt32 seqNum;
-    ProtocolUtil::readf(m_stream, kMsgCEnter + 4, &x, &y, &seqNum, &mask);
+    synergy::protocol::CEnter::receive(m_stream, x, y, seqNum, mask);
     LOG((CLOG_DEBUG1 "recv enter, %d,%d %d %04x", x, y, seqNum, mask));
 
     // discard old compressed mouse motion, if any
@@ -577,7 +571,7 @@ ServerProxy::grabClipboard()
     // parse
     ClipboardID id;
     UInt32 seqNum;
-    ProtocolUtil::readf(m_stream, kMsgCClipboard + 4, &id, &seqNum);
+    synergy::protocol::CClipboard::receive(m_stream, id, seqNum);
     LOG((CLOG_DEBUG "recv grab clipboard %d", id));
 
     // validate
@@ -597,7 +591,7 @@ ServerProxy::keyDown()
 
     // parse
     UInt16 id, mask, button;
-    ProtocolUtil::readf(m_stream, kMsgDKeyDown + 4, &id, &mask, &button);
+    synergy::protocol::DKeyDown::receive(m_stream, id, mask, button);
     LOG((CLOG_DEBUG1 "recv key down id=0x%08x, mask=0x%04x, button=0x%04x", id, mask, button));
 
     // translate
@@ -620,8 +614,8 @@ ServerProxy::keyRepeat()
 
     // parse
     UInt16 id, mask, count, button;
-    ProtocolUtil::readf(m_stream, kMsgDKeyRepeat + 4,
-                                &id, &mask, &count, &button);
+    synergy::protocol::DKeyRepeat::receive(m_stream,
+                                id, mask, count, button);
     LOG((CLOG_DEBUG1 "recv key repeat id=0x%08x, mask=0x%04x, count=%d, button=0x%04x", id, mask, count, button));
 
     // translate
@@ -644,7 +638,7 @@ ServerProxy::keyUp()
 
     // parse
     UInt16 id, mask, button;
-    ProtocolUtil::readf(m_stream, kMsgDKeyUp + 4, &id, &mask, &button);
+    synergy::protocol::DKeyUp::receive(m_stream, id, mask, button);
     LOG((CLOG_DEBUG1 "recv key up id=0x%08x, mask=0x%04x, button=0x%04x", id, mask, button));
 
     // translate
@@ -667,7 +661,7 @@ ServerProxy::mouseDown()
 
     // parse
     SInt8 id;
-    ProtocolUtil::readf(m_stream, kMsgDMouseDown + 4, &id);
+    synergy::protocol::DMouseDown::receive(m_stream, id);
     LOG((CLOG_DEBUG1 "recv mouse down id=%d", id));
 
     // forward
@@ -682,7 +676,7 @@ ServerProxy::mouseUp()
 
     // parse
     SInt8 id;
-    ProtocolUtil::readf(m_stream, kMsgDMouseUp + 4, &id);
+    synergy::protocol::DMouseUp::receive(m_stream, id);
     LOG((CLOG_DEBUG1 "recv mouse up id=%d", id));
 
     // forward
@@ -695,7 +689,7 @@ ServerProxy::mouseMove()
     // parse
     bool ignore;
     SInt16 x, y;
-    ProtocolUtil::readf(m_stream, kMsgDMouseMove + 4, &x, &y);
+    synergy::protocol::DMouseMove::receive(m_stream, x, y);
 
     // note if we should ignore the move
     ignore = m_ignoreMouse;
@@ -728,7 +722,7 @@ ServerProxy::mouseRelativeMove()
     // parse
     bool ignore;
     SInt16 dx, dy;
-    ProtocolUtil::readf(m_stream, kMsgDMouseRelMove + 4, &dx, &dy);
+    synergy::protocol::DMouseRelMove::receive(m_stream, dx, dy);
 
     // note if we should ignore the move
     ignore = m_ignoreMouse;
@@ -760,7 +754,7 @@ ServerProxy::mouseWheel()
 
     // parse
     SInt16 xDelta, yDelta;
-    ProtocolUtil::readf(m_stream, kMsgDMouseWheel + 4, &xDelta, &yDelta);
+    synergy::protocol::DMouseWheel::receive(m_stream, xDelta, yDelta);
     LOG((CLOG_DEBUG2 "recv mouse wheel %+d,%+d", xDelta, yDelta));
 
     // forward
@@ -772,7 +766,7 @@ ServerProxy::screensaver()
 {
     // parse
     SInt8 on;
-    ProtocolUtil::readf(m_stream, kMsgCScreenSaver + 4, &on);
+    synergy::protocol::CScreenSaver::receive(m_stream, on);
     LOG((CLOG_DEBUG1 "recv screen saver on=%d", on));
 
     // forward
@@ -791,6 +785,9 @@ ServerProxy::resetOptions()
     // reset keep alive
     setKeepAliveRate(kKeepAliveRate);
 
+    // reset no-op replies
+    setNoopReplies(kNoopRepliesPerMessage);
+
     // reset modifier translation table
     for (KeyModifierID id = 0; id < kKeyModifierIDLast; ++id) {
         m_modifierTranslationTable[id] = id;
@@ -802,7 +799,7 @@ ServerProxy::setOptions()
 {
     // parse
     OptionsList options;
-    ProtocolUtil::readf(m_stream, kMsgDSetOptions + 4, &options);
+    synergy::protocol::DSetOptions::receive(m_stream, options);
     LOG((CLOG_DEBUG1 "recv set options size=%d", options.size()));
 
     // forward
@@ -833,6 +830,9 @@ ServerProxy::setOptions()
             // update keep alive
             setKeepAliveRate(1.0e-3 * static_cast<double>(options[i + 1]));
         }
+        else if (options[i] == kOptionNoopReplies) {
+            setNoopReplies(static_cast<OptionValue>(options[i + 1]));
+        }
 
         if (id != kKeyModifierIDNull) {
             m_modifierTranslationTable[id] =
@@ -842,6 +842,68 @@ ServerProxy::setOptions()
     }
 }
 
+void
+ServerProxy::completeHandshake()
+{
+    setOptions();
+
+    // handshake is complete
+    m_parser = &ServerProxy::parseMessage;
+    m_client->handshakeComplete();
+}
+
+void
+ServerProxy::keepAlive()
+{
+    // echo keep alives and reset alarm
+    synergy::protocol::CKeepAlive::send(m_stream);
+    resetKeepAliveAlarm();
+}
+
+void
+ServerProxy::noop()
+{
+    // accept and discard no-op
+}
+
+void
+ServerProxy::close()
+{
+    // server wants us to hangup
+    LOG((CLOG_DEBUG1 "recv close"));
+    m_client->disconnect(NULL);
+}
+
+void
+ServerProxy::incompatible()
+{
+    SInt32 major, minor;
+    synergy::protocol::EIncompatible::receive(m_stream, major, minor);
+    LOG((CLOG_ERR "server has incompatible version %d.%d", major, minor));
+    m_client->disconnect("server has incompatible version");
+}
+
+void
+ServerProxy::busy()
+{
+    LOG((CLOG_ERR "server already has a connected client with name \"%s\"", m_client->getName().c_str()));
+    m_client->disconnect("server already has a connected client with our name");
+}
+
+void
+ServerProxy::unknownClient()
+{
+    LOG((CLOG_ERR "server refused client with name \"%s\"", m_client->getName().c_str()));
+    m_client->disconnect("server refused client with our name");
+}
+
+void
+ServerProxy::protocolError()
+{
+    LOG((CLOG_ERR "server disconnected due to a protocol error"));
+    m_client->disconnect("server reported a protocol error");
+}
+
 void
 ServerProxy::queryInfo()
 {
@@ -883,7 +945,7 @@ ServerProxy::dragInfoReceived()
     // parse
     UInt32 fileNum = 0;
     String content;
-    ProtocolUtil::readf(m_stream, kMsgDDragInfo + 4, &fileNum, &content);
+    synergy::protocol::DDragInfo::receive(m_stream, fileNum, content);
 
     m_client->dragInfoReceived(fileNum, content);
 }
@@ -891,18 +953,29 @@ ServerProxy::dragInfoReceived()
 void
 ServerProxy::handleClipboardSendingEvent(const Event& event, void*)
 {
-    ClipboardChunk::send(m_stream, event.getData());
+    ClipboardChunk::send(m_stream,
+                            static_cast<ClipboardChunk*>(event.getDataObject()));
 }
 
 void
 ServerProxy::fileChunkSending(UInt8 mark, char* data, size_t dataSize)
 {
     FileChunk::send(m_stream, mark, data, dataSize);
+    ++m_fileChunksUnflushed;
+}
+
+void
+ServerProxy::handleOutputFlushed(const Event&, void*)
+{
+    if (m_fileChunksUnflushed > 0) {
+        StreamChunker::fileChunksFlushed(m_fileChunksUnflushed);
+        m_fileChunksUnflushed = 0;
+    }
 }
 
 void
 ServerProxy::sendDragInfo(UInt32 fileCount, const char* info, size_t size)
 {
     String data(info, size);
-    ProtocolUtil::writef(m_stream, kMsgDDragInfo, fileCount, &data);
+    synergy::protocol::DDragInfo::send(m_stream, fileCount, data);
 }
@@ -20,6 +20,8 @@
 
 #include "core/clipboard_types.h"
 #include "core/key_types.h"
+#include "core/option_types.h"
+#include "core/ProtocolMessages.h"
 #include "base/Event.h"
 #include "base/Stopwatch.h"
 #include "base/String.h"
@@ -78,6 +80,10 @@ private:
     void                resetKeepAliveAlarm();
     void                setKeepAliveRate(double);
 
+    // reply to a parsed message with a no-op as the no-op policy says
+    void                replyWithNoop();
+    void                setNoopReplies(OptionValue);
+
     // modifier key translation
     KeyID                translateKey(KeyID) const;
     KeyModifierMask            translateModifierMask(KeyModifierMask) const;
@@ -85,6 +91,8 @@ private:
     // event handlers
     void                handleData(const Event&, void*);
     void                handleKeepAliveAlarm(const Event&, void*);
+    void                handleNoopTimer(const Event&, void*);
+    void                handleOutputFlushed(const Event&, void*);
 
     // message handlers
     void                enter();
@@ -106,10 +114,38 @@ private:
     void                infoAcknowledgment();
     void                fileChunkReceived();
     void                dragInfoReceived();
+    void                completeHandshake();
+    void                keepAlive();
+    void                noop();
+    void                close();
+    void                incompatible();
+    void                busy();
+    void                unknownClient();
+    void                protocolError();
     void                handleClipboardSendingEvent(const Event&, void*);
 
 private:
     typedef EResult (ServerProxy::*MessageParser)(const UInt8*);
+    typedef void (ServerProxy::*MessageHandler)();
+
+    // a message handler and what handling the message means for the
+    // connection
+    class MessageEntry {
+    public:
+        MessageEntry(MessageHandler handler = NULL, EResult result = kOkay) :
+            m_handler(handler), m_result(result) { }
+
+    public:
+        MessageHandler    m_handler;
+        EResult            m_result;
+    };
+    typedef synergy::protocol::MessageTable<MessageEntry> MessageTable;
+
+    // the messages handled before and after the handshake completes
+    static const MessageTable&    getHandshakeMessages();
+    static const MessageTable&    getMessages();
+    static MessageTable    makeHandshakeMessages();
+    static MessageTable    makeMessages();
 
     Client*            m_client;
     synergy::IStream*    m_stream;
@@ -128,6 +164,13 @@ private:
     double                m_keepAliveAlarm;
     EventQueueTimer*    m_keepAliveAlarmTimer;
 
+    ENoopReplies        m_noopReplies;
+    bool                m_noopPending;
+    EventQueueTimer*    m_noopTimer;
+
+    // file chunks written since the stream last flushed
+    UInt32                m_fileChunksUnflushed;
+
     MessageParser        m_parser;
     IEventQueue*        m_events;
 };
@@ -183,6 +183,13 @@ App::initApp(int argc, const char** argv)
         m_bye(kExitArgs);
     }
     loggingFilterWarning();
+
+    // set log format
+    if (!CLOG->setFormat(argsBase().m_logFormat)) {
+        LOG((CLOG_PRINT "%s: unrecognized log format `%s'" BYE,
+            argsBase().m_pname, argsBase().m_logFormat, argsBase().m_pname));
+        m_bye(kExitArgs);
+    }
     
     if (argsBase().m_enableDragDrop) {
         LOG((CLOG_INFO "drag and drop enabled"));
@@ -155,6 +155,7 @@ private:
     "  -1, --no-restart         do not try to restart on failure.\n" \
     "*     --restart            restart the server automatically if it fails.\n" \
     "  -l  --log <file>         write log messages to file.\n" \
+    "      --log-format <fmt>   write log messages as text or json.\n" \
     "      --enable-drag-drop   enable file drag & drop.\n" \
     "      --enable-crypto      enable the crypto (ssl) plugin.\n"
 
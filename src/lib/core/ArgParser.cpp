@@ -221,6 +221,9 @@ ArgParser::parseGenericArgs(int argc, const char* const* argv, int& i)
     else if (isArg(i, argc, argv, "-l", "--log", 1)) {
         argsBase().m_logFile = argv[++i];
     }
+    else if (isArg(i, argc, argv, NULL, "--log-format", 1)) {
+        argsBase().m_logFormat = argv[++i];
+    }
     else if (isArg(i, argc, argv, "-f", "--no-daemon")) {
         // not a daemon
         argsBase().m_daemon = false;
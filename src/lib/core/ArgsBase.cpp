@@ -36,6 +36,7 @@ m_noHooks(false),
 m_pname(NULL),
 m_logFilter(NULL),
 m_logFile(NULL),
+m_logFormat(NULL),
 m_display(NULL),
 m_enableIpc(false),
 m_enableDragDrop(false),
@@ -33,6 +33,7 @@ public:
     const char*            m_pname;
     const char*            m_logFilter;
     const char*            m_logFile;
+    const char*            m_logFormat;
     const char*            m_display;
     String                m_name;
     bool                m_enableIpc;
@@ -25,8 +25,12 @@
 
 size_t ClipboardChunk::s_expectedSize = 0;
 
+// kMsgDClipboard, taking the data as a size and pointer
+static const char* const s_clipboardChunkFormat = "DCLP%1i%4i%1i%S";
+
 ClipboardChunk::ClipboardChunk(size_t size) :
-    Chunk(size)
+    Chunk(size),
+    m_offset(0)
 {
         m_dataSize = size - CLIPBOARD_CHUNK_META_SIZE;
 }
@@ -54,17 +58,22 @@ ClipboardChunk*
 ClipboardChunk::data(
                     ClipboardID id,
                     UInt32 sequence,
-                    const String& data)
+                    const ClipboardBuffer& buffer,
+                    size_t offset,
+                    size_t size)
 {
-    size_t dataSize = data.size();
-    ClipboardChunk* chunk = new ClipboardChunk(dataSize + CLIPBOARD_CHUNK_META_SIZE);
+    // only the meta data is kept in the chunk itself
+    ClipboardChunk* chunk = new ClipboardChunk(CLIPBOARD_CHUNK_META_SIZE);
     char* chunkData = chunk->m_chunk;
 
     chunkData[0] = id;
     std::memcpy (&chunkData[1], &sequence, 4);
     chunkData[5] = kDataChunk;
-    memcpy(&chunkData[6], data.c_str(), dataSize);
-    chunkData[dataSize + CLIPBOARD_CHUNK_META_SIZE - 1] = '\0';
+    chunkData[CLIPBOARD_CHUNK_META_SIZE - 1] = '\0';
+
+    chunk->m_buffer   = buffer;
+    chunk->m_offset   = offset;
+    chunk->m_dataSize = size;
 
     return chunk;
 }
@@ -134,15 +143,19 @@ ClipboardChunk::send(synergy::IStream* stream, void* data)
     UInt32 sequence;
     std::memcpy (&sequence, &chunk[1], 4);
     UInt8 mark = chunk[5];
-    String dataChunk(&chunk[6], clipboardData->m_dataSize);
+    UInt32 size = (UInt32)clipboardData->m_dataSize;
+    const char* chunkData = &chunk[6];
+    if (clipboardData->m_buffer) {
+        chunkData = clipboardData->m_buffer->data() + clipboardData->m_offset;
+    }
 
     switch (mark) {
     case kDataStart:
-        LOG((CLOG_DEBUG2 "sending clipboard chunk start: size=%s", dataChunk.c_str()));
+        LOG((CLOG_DEBUG2 "sending clipboard chunk start: size=%s", chunkData));
         break;
 
     case kDataChunk:
-        LOG((CLOG_DEBUG2 "sending clipboard chunk data: size=%i", dataChunk.size()));
+        LOG((CLOG_DEBUG2 "sending clipboard chunk data: size=%i", size));
         break;
 
     case kDataEnd:
@@ -150,5 +163,6 @@ ClipboardChunk::send(synergy::IStream* stream, void* data)
         break;
     }
 
-    ProtocolUtil::writef(stream, kMsgDClipboard, id, sequence, mark, &dataChunk);
+    ProtocolUtil::writef(stream, s_clipboardChunkFormat, id, sequence, mark,
+                            size, reinterpret_cast<const UInt8*>(chunkData));
 }
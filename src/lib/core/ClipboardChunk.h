@@ -22,12 +22,21 @@
 #include "base/String.h"
 #include "common/basic_types.h"
 
+#include <memory>
+
 #define CLIPBOARD_CHUNK_META_SIZE 7
 
 namespace synergy {
 class IStream;
 };
 
+//! Marshalled clipboard data
+/*!
+Shared by the chunks sending it, which refer to parts of it rather than
+copy them.  It's freed with the last chunk.
+*/
+typedef std::shared_ptr<const String> ClipboardBuffer;
+
 class ClipboardChunk : public Chunk {
 public:
     ClipboardChunk(size_t size);
@@ -41,7 +50,9 @@ public:
                         data(
                             ClipboardID id,
                             UInt32 sequence,
-                            const String& data);
+                            const ClipboardBuffer& buffer,
+                            size_t offset,
+                            size_t size);
     static ClipboardChunk*
                         end(ClipboardID id, UInt32 sequence);
 
@@ -55,6 +66,11 @@ public:
 
     static size_t        getExpectedSize() { return s_expectedSize; }
 
+public:
+    // the data of a data chunk, from m_offset for m_dataSize bytes
+    ClipboardBuffer        m_buffer;
+    size_t                m_offset;
+
 private:
     static size_t        s_expectedSize;
 };
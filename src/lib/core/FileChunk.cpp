@@ -47,10 +47,19 @@ FileChunk::start(const String& size)
 FileChunk*
 FileChunk::data(UInt8* data, size_t dataSize)
 {
+    FileChunk* chunk = FileChunk::data(dataSize);
+    memcpy(&chunk->m_chunk[1], data, dataSize);
+
+    return chunk;
+}
+
+FileChunk*
+FileChunk::data(size_t dataSize)
+{
+    // the caller fills in the data after the mark
     FileChunk* chunk = new FileChunk(dataSize + FILE_CHUNK_META_SIZE);
     char* chunkData = chunk->m_chunk;
     chunkData[0] = kDataChunk;
-    memcpy(&chunkData[1], data, dataSize);
     chunkData[dataSize + 1] = '\0';
 
     return chunk;
@@ -33,6 +33,7 @@ public:
 
     static FileChunk*    start(const String& size);
     static FileChunk*    data(UInt8* data, size_t dataSize);
+    static FileChunk*    data(size_t dataSize);
     static FileChunk*    end();
     static int            assemble(
                             synergy::IStream* stream,
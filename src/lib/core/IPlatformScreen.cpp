@@ -22,3 +22,9 @@ IPlatformScreen::fakeMediaKey(KeyID id)
 {
     return false;
 }
+
+bool
+IPlatformScreen::fetchClipboard(ClipboardID, UInt32)
+{
+    return false;
+}
@@ -87,6 +87,15 @@ public:
     */
     virtual void        checkClipboards() = 0;
 
+    //! Fetch clipboard
+    /*!
+    Start reading the system clipboard indicated by \c id without
+    waiting for it.  Returns false if the screen can't.  Otherwise a
+    clipboard changed event with sequence number \c seqNum is sent once
+    getClipboard() can return the clipboard without reading it.
+    */
+    virtual bool        fetchClipboard(ClipboardID id, UInt32 seqNum);
+
     //! Open screen saver
     /*!
     Open the screen saver.  If \c notify is true then this object must
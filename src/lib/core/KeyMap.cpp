@@ -33,7 +33,8 @@ KeyMap::ModifierToNameMap*        KeyMap::s_modifierToNameMap = NULL;
 
 KeyMap::KeyMap() :
     m_numGroups(0),
-    m_composeAcrossGroups(false)
+    m_composeAcrossGroups(false),
+    m_generation(1)
 {
     m_modifierKeyItem.m_id        = kKeyNone;
     m_modifierKeyItem.m_group     = 0;
@@ -64,6 +65,8 @@ KeyMap::swap(KeyMap& x)
     bool tmp2               = m_composeAcrossGroups;
     m_composeAcrossGroups   = x.m_composeAcrossGroups;
     x.m_composeAcrossGroups = tmp2;
+    clearMappedKeys();
+    x.clearMappedKeys();
 }
 
 void
@@ -73,6 +76,7 @@ KeyMap::addKeyEntry(const KeyItem& item)
     if (item.m_id == kKeyNone) {
         return;
     }
+    clearMappedKeys();
 
     // resize number of groups for key
     SInt32 numGroups = item.m_group + 1;
@@ -146,6 +150,7 @@ KeyMap::addKeyCombinationEntry(KeyID id, SInt32 group,
     if (id == kKeyNone) {
         return false;
     }
+    clearMappedKeys();
 
     SInt32 numGroups = group + 1;
     if (getNumGroups() > numGroups) {
@@ -203,24 +208,28 @@ void
 KeyMap::allowGroupSwitchDuringCompose()
 {
     m_composeAcrossGroups = true;
+    clearMappedKeys();
 }
 
 void
 KeyMap::addHalfDuplexButton(KeyButton button)
 {
     m_halfDuplex.insert(button);
+    clearMappedKeys();
 }
 
 void
 KeyMap::clearHalfDuplexModifiers()
 {
     m_halfDuplexMods.clear();
+    clearMappedKeys();
 }
 
 void
 KeyMap::addHalfDuplexModifier(KeyID key)
 {
     m_halfDuplexMods.insert(key);
+    clearMappedKeys();
 }
 
 void
@@ -236,11 +245,18 @@ KeyMap::finish()
 
     // compute keys that generate each modifier
     setModifierKeys();
+
+    // start remembering mapped keys
+    m_mappedKeys.resize(1 << kMappedKeyBits);
+    clearMappedKeys();
 }
 
 void
 KeyMap::foreachKey(ForeachKeyCallback cb, void* userData)
 {
+    // the callback can change the items
+    clearMappedKeys();
+
     for (KeyIDMap::iterator i = m_keyIDMap.begin();
                                 i != m_keyIDMap.end(); ++i) {
         KeyGroupTable& groupTable = i->second;
@@ -266,6 +282,86 @@ KeyMap::mapKey(Keystrokes& keys, KeyID id, SInt32 group,
 {
     LOG((CLOG_DEBUG1 "mapKey %04x (%d) with mask %04x, start state: %04x", id, id, desiredMask, currentState));
 
+    // nothing is remembered before finish() or when appending to keys
+    if (m_mappedKeys.empty() || !keys.empty()) {
+        return mapKeyUncached(keys, id, group, activeModifiers,
+                                currentState, desiredMask, isAutoRepeat);
+    }
+
+    MappedKey& mapped = getMappedKey(id, group, activeModifiers,
+                                currentState, desiredMask, isAutoRepeat);
+    if (mapped.m_generation != m_generation ||
+        mapped.m_id != id ||
+        mapped.m_group != group ||
+        mapped.m_state != currentState ||
+        mapped.m_desiredMask != desiredMask ||
+        mapped.m_isAutoRepeat != isAutoRepeat ||
+        !(mapped.m_activeModifiers == activeModifiers)) {
+        // not remembered so map it and remember the result
+        mapped.m_generation      = 0;
+        mapped.m_id              = id;
+        mapped.m_group           = group;
+        mapped.m_state           = currentState;
+        mapped.m_desiredMask     = desiredMask;
+        mapped.m_isAutoRepeat    = isAutoRepeat;
+        mapped.m_activeModifiers = activeModifiers;
+        mapped.m_item = mapKeyUncached(keys, id, group, activeModifiers,
+                                currentState, desiredMask, isAutoRepeat);
+        mapped.m_keys               = keys;
+        mapped.m_newState           = currentState;
+        mapped.m_newActiveModifiers = activeModifiers;
+        mapped.m_generation         = m_generation;
+        return mapped.m_item;
+    }
+
+    keys         = mapped.m_keys;
+    currentState = mapped.m_newState;
+    if (!(activeModifiers == mapped.m_newActiveModifiers)) {
+        activeModifiers = mapped.m_newActiveModifiers;
+    }
+    if (mapped.m_item != NULL) {
+        LOG((CLOG_DEBUG1 "mapped to %03x, new state %04x", mapped.m_item->m_button, currentState));
+    }
+    return mapped.m_item;
+}
+
+void
+KeyMap::clearMappedKeys()
+{
+    // invalidate every entry at once.  when the generation wraps the
+    // entries could look valid again so really clear them.
+    if (++m_generation == 0) {
+        for (size_t i = 0; i < m_mappedKeys.size(); ++i) {
+            m_mappedKeys[i].m_generation = 0;
+        }
+        m_generation = 1;
+    }
+}
+
+KeyMap::MappedKey&
+KeyMap::getMappedKey(KeyID id, SInt32 group,
+                const ModifierToKeys& activeModifiers,
+                KeyModifierMask currentState,
+                KeyModifierMask desiredMask,
+                bool isAutoRepeat) const
+{
+    UInt32 hash = id;
+    hash = hash * 31 + static_cast<UInt32>(group);
+    hash = hash * 31 + currentState;
+    hash = hash * 31 + desiredMask;
+    hash = hash * 31 + static_cast<UInt32>(activeModifiers.size());
+    hash = hash * 2 + (isAutoRepeat ? 1 : 0);
+    hash *= 2654435761u;
+    return m_mappedKeys[hash >> (32 - kMappedKeyBits)];
+}
+
+const KeyMap::KeyItem*
+KeyMap::mapKeyUncached(Keystrokes& keys, KeyID id, SInt32 group,
+                ModifierToKeys& activeModifiers,
+                KeyModifierMask& currentState,
+                KeyModifierMask desiredMask,
+                bool isAutoRepeat) const
+{
     // handle group change
     if (id == kKeyNextGroup) {
         keys.push_back(Keystroke(1, false, false));
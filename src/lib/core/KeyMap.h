@@ -202,7 +202,7 @@ public:
 
     //! Iterate over all added keys items
     /*!
-    Calls \p cb for every key item.
+    Calls \p cb for every key item.  \p cb may change the items.
     */
     virtual void        foreachKey(ForeachKeyCallback cb, void* userData);
 
@@ -217,6 +217,10 @@ public:
     \p desiredMask into the keystrokes necessary to synthesize that key
     event in \p keys.  It returns the \c KeyItem of the key being
     pressed/repeated, or NULL if the key cannot be mapped.
+
+    After \c finish() the result is remembered, so mapping the same key
+    from the same state again only copies the keystrokes.  Changing the
+    map forgets everything remembered.
     */
     virtual const KeyItem*    mapKey(Keystrokes& keys, KeyID id, SInt32 group,
                             ModifierToKeys& activeModifiers,
@@ -340,6 +344,7 @@ private:
     FRIEND_TEST(KeyMapTests,
                 findBestKey_onlyOneRequiredDown_matchTwoRequiredChangesItem);
     FRIEND_TEST(KeyMapTests, findBestKey_noRequiredDown_cannotMatch);
+    FRIEND_TEST(KeyMapTests, mapKey_remembered_sameAsUncached);
 
 private:
     //! Ways to synthesize a key
@@ -355,6 +360,47 @@ private:
     // A list of ways to synthesize a KeyID
     typedef std::vector<KeyItemList> KeyEntryList;
 
+    // Size of the table of mapped keys, as a power of two
+    enum { kMappedKeyBits = 9 };
+
+    // A remembered call to mapKey():  the arguments and what it returned
+    class MappedKey {
+    public:
+        MappedKey() : m_generation(0) { }
+
+    public:
+        UInt32            m_generation;
+        KeyID            m_id;
+        SInt32            m_group;
+        KeyModifierMask    m_state;
+        KeyModifierMask    m_desiredMask;
+        bool            m_isAutoRepeat;
+        ModifierToKeys    m_activeModifiers;
+        Keystrokes        m_keys;
+        const KeyItem*    m_item;
+        KeyModifierMask    m_newState;
+        ModifierToKeys    m_newActiveModifiers;
+    };
+    typedef std::vector<MappedKey> MappedKeyTable;
+
+    // forgets the mapped keys.  called whenever the map changes.
+    void                clearMappedKeys();
+
+    // returns the entry in m_mappedKeys for the arguments to mapKey()
+    MappedKey&            getMappedKey(KeyID id, SInt32 group,
+                            const ModifierToKeys& activeModifiers,
+                            KeyModifierMask currentState,
+                            KeyModifierMask desiredMask,
+                            bool isAutoRepeat) const;
+
+    // maps a key without looking in m_mappedKeys
+    const KeyItem*        mapKeyUncached(Keystrokes& keys,
+                            KeyID id, SInt32 group,
+                            ModifierToKeys& activeModifiers,
+                            KeyModifierMask& currentState,
+                            KeyModifierMask desiredMask,
+                            bool isAutoRepeat) const;
+
     // computes the number of groups
     SInt32                findNumGroups() const;
 
@@ -502,6 +548,11 @@ private:
     // dummy KeyItem for changing modifiers
     KeyItem                m_modifierKeyItem;
 
+    // mapKey() results.  an entry is only valid if its generation
+    // matches m_generation.  the table is empty until finish().
+    mutable MappedKeyTable    m_mappedKeys;
+    UInt32                m_generation;
+
     // parsing/formatting tables
     static NameToKeyMap*        s_nameToKeyMap;
     static NameToModifierMap*    s_nameToModifierMap;
@@ -72,9 +72,11 @@ PacketStreamFilter::read(void* buffer, UInt32 n)
 
     // read it
     if (buffer != NULL) {
-        memcpy(buffer, m_buffer.peek(n), n);
+        m_buffer.read(buffer, n);
+    }
+    else {
+        m_buffer.pop(n);
     }
-    m_buffer.pop(n);
     m_size -= n;
 
     // get next packet's size if we've finished with this packet and
@@ -140,8 +142,7 @@ PacketStreamFilter::readPacketSize()
 
     if (m_size == 0 && m_buffer.getSize() >= 4) {
         UInt8 buffer[4];
-        memcpy(buffer, m_buffer.peek(sizeof(buffer)), sizeof(buffer));
-        m_buffer.pop(sizeof(buffer));
+        m_buffer.read(buffer, sizeof(buffer));
         m_size = ((UInt32)buffer[0] << 24) |
                  ((UInt32)buffer[1] << 16) |
                  ((UInt32)buffer[2] <<  8) |
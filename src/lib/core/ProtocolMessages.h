@@ -0,0 +1,578 @@
+/*
+ * synergy -- mouse and keyboard sharing utility
+ * Copyright (C) 2016 Symless Ltd.
+ *
+ * This package is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * found in the file LICENSE that should have accompanied this file.
+ *
+ * This package is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "io/IStream.h"
+#include "base/String.h"
+#include "common/basic_types.h"
+#include "common/stdvector.h"
+
+#include <cstring>
+
+namespace synergy {
+namespace protocol {
+
+//! Contiguous message data
+/*!
+The bytes a message is parsed from.  Fields take what they need from
+the front.
+*/
+class View {
+public:
+    View(const void* data, UInt32 size) :
+        m_data(static_cast<const UInt8*>(data)),
+        m_end(static_cast<const UInt8*>(data) + size) { }
+
+    //! Take \c n bytes
+    /*!
+    Returns the next \c n bytes, or NULL if there aren't that many left.
+    */
+    const UInt8*        take(UInt32 n)
+    {
+        if (n > getSize()) {
+            return NULL;
+        }
+        const UInt8* data = m_data;
+        m_data += n;
+        return data;
+    }
+
+    //! Get the number of bytes left
+    UInt32                getSize() const { return (UInt32)(m_end - m_data); }
+
+private:
+    const UInt8*        m_data;
+    const UInt8*        m_end;
+};
+
+//! Message data read from a stream
+/*!
+Like View except the bytes are read from a stream as they're taken.
+Taking more than the stream has ready fails rather than blocking.
+*/
+class StreamView {
+public:
+    StreamView(synergy::IStream* stream) : m_stream(stream) { }
+
+    const UInt8*        take(UInt32 n)
+    {
+        if (n > m_stream->getSize()) {
+            return NULL;
+        }
+        UInt8* data = m_fixed;
+        if (n > sizeof(m_fixed)) {
+            m_heap.resize(n);
+            data = &m_heap[0];
+        }
+        for (UInt32 done = 0; done < n; ) {
+            UInt32 count = m_stream->read(data + done, n - done);
+            if (count == 0) {
+                return NULL;
+            }
+            done += count;
+        }
+        return data;
+    }
+
+private:
+    synergy::IStream*    m_stream;
+    UInt8                m_fixed[64];
+    std::vector<UInt8>    m_heap;
+};
+
+//! Unsigned integer of \c N bytes
+template <int N> class IntType;
+template <> class IntType<1> { public: typedef UInt8 Type; };
+template <> class IntType<2> { public: typedef UInt16 Type; };
+template <> class IntType<4> { public: typedef UInt32 Type; };
+
+//! Integer field
+/*!
+An \c N byte integer in network byte order, like \c %Ni in a
+ProtocolUtil format.  Any integer type may be written or read.
+*/
+template <int N>
+class Int {
+public:
+    enum { kSize = N, kIsFixed = 1 };
+    typedef typename IntType<N>::Type Type;
+
+    template <class T>
+    static UInt32        getSize(const T&) { return N; }
+
+    template <class T>
+    static UInt8*        write(UInt8* dst, const T& value)
+    {
+        return encode(dst, static_cast<UInt32>(value));
+    }
+
+    template <class Source, class T>
+    static bool            read(Source& src, T& value)
+    {
+        const UInt8* data = src.take(N);
+        if (data == NULL) {
+            return false;
+        }
+        value = static_cast<T>(decode(data));
+        return true;
+    }
+
+    static UInt8*        encode(UInt8* dst, UInt32 value)
+    {
+        for (int i = N - 1; i >= 0; --i) {
+            *dst++ = static_cast<UInt8>((value >> (8 * i)) & 0xff);
+        }
+        return dst;
+    }
+
+    static Type            decode(const UInt8* data)
+    {
+        UInt32 value = 0;
+        for (int i = 0; i < N; ++i) {
+            value = (value << 8) | data[i];
+        }
+        return static_cast<Type>(value);
+    }
+};
+
+//! Integer list field
+/*!
+A 4 byte count followed by that many \c N byte integers, like \c %NI
+in a ProtocolUtil format.  Written from and read into a vector of
+\c IntType<N>::Type.
+*/
+template <int N>
+class IntList {
+public:
+    enum { kSize = 4, kIsFixed = 0 };
+    typedef typename IntType<N>::Type Type;
+    typedef std::vector<Type> List;
+
+    static UInt32        getSize(const List& list)
+    {
+        return 4 + N * (UInt32)list.size();
+    }
+
+    static UInt8*        write(UInt8* dst, const List& list)
+    {
+        dst = Int<4>::encode(dst, (UInt32)list.size());
+        for (size_t i = 0; i < list.size(); ++i) {
+            dst = Int<N>::encode(dst, list[i]);
+        }
+        return dst;
+    }
+
+    template <class Source>
+    static bool            read(Source& src, List& list)
+    {
+        const UInt8* data = src.take(4);
+        if (data == NULL) {
+            return false;
+        }
+        UInt32 n = Int<4>::decode(data);
+        if (n > (UInt32)-1 / N || (data = src.take(n * N)) == NULL) {
+            return false;
+        }
+        list.resize(n);
+        for (UInt32 i = 0; i < n; ++i, data += N) {
+            list[i] = Int<N>::decode(data);
+        }
+        return true;
+    }
+};
+
+//! String field
+/*!
+A 4 byte length followed by that many bytes, like \c %s in a
+ProtocolUtil format.
+*/
+class Str {
+public:
+    enum { kSize = 4, kIsFixed = 0 };
+
+    static UInt32        getSize(const String& s)
+    {
+        return 4 + (UInt32)s.size();
+    }
+
+    static UInt8*        write(UInt8* dst, const String& s)
+    {
+        dst = Int<4>::encode(dst, (UInt32)s.size());
+        if (!s.empty()) {
+            memcpy(dst, s.data(), s.size());
+        }
+        return dst + s.size();
+    }
+
+    template <class Source>
+    static bool            read(Source& src, String& s)
+    {
+        const UInt8* data = src.take(4);
+        if (data == NULL) {
+            return false;
+        }
+        UInt32 n = Int<4>::decode(data);
+        if ((data = src.take(n)) == NULL) {
+            return false;
+        }
+        s.assign(reinterpret_cast<const char*>(data), n);
+        return true;
+    }
+};
+
+//! Message code
+/*!
+The characters a message starts with.
+*/
+template <char... Chars>
+class Code {
+public:
+    enum { kSize = sizeof...(Chars) };
+
+    static UInt8*        write(UInt8* dst)
+    {
+        static const char s_code[] = { Chars... };
+        memcpy(dst, s_code, kSize);
+        return dst + kSize;
+    }
+
+    static bool            matches(const void* data)
+    {
+        static const char s_code[] = { Chars... };
+        return (memcmp(data, s_code, kSize) == 0);
+    }
+};
+
+//! Message fields
+/*!
+Writes and reads a list of fields, one argument for each.
+*/
+template <class... Fields>
+class FieldList;
+
+template <>
+class FieldList<> {
+public:
+    enum { kSize = 0, kIsFixed = 1 };
+
+    static UInt32        getSize() { return 0; }
+    static UInt8*        write(UInt8* dst) { return dst; }
+    template <class Source>
+    static bool            read(Source&) { return true; }
+};
+
+template <class Field, class... Rest>
+class FieldList<Field, Rest...> {
+public:
+    enum {
+        kSize    = Field::kSize + FieldList<Rest...>::kSize,
+        kIsFixed = Field::kIsFixed && FieldList<Rest...>::kIsFixed
+    };
+
+    template <class Arg, class... Args>
+    static UInt32        getSize(const Arg& arg, const Args&... args)
+    {
+        return Field::getSize(arg) + FieldList<Rest...>::getSize(args...);
+    }
+
+    template <class Arg, class... Args>
+    static UInt8*        write(UInt8* dst, const Arg& arg, const Args&... args)
+    {
+        return FieldList<Rest...>::write(Field::write(dst, arg), args...);
+    }
+
+    template <class Source, class Arg, class... Args>
+    static bool            read(Source& src, Arg& arg, Args&... args)
+    {
+        return Field::read(src, arg) &&
+                FieldList<Rest...>::read(src, args...);
+    }
+};
+
+//! Protocol message
+/*!
+A message is its code followed by its fields, and each kMsg* format in
+protocol_types.h has a Message below that writes and reads the same
+bytes as ProtocolUtil does with that format.  The arguments are checked
+against the fields at compile time and the size of a message without
+strings or lists is a compile time constant, so it can be written to a
+buffer on the stack.
+*/
+template <class MessageCode, class... Fields>
+class Message {
+public:
+    typedef FieldList<Fields...> Body;
+
+    enum {
+        //! Size of the code
+        kCodeSize = MessageCode::kSize,
+        //! Size of the fields, or the least it can be
+        kBodySize = Body::kSize,
+        //! Size of the message, or the least it can be
+        kMinSize  = kCodeSize + kBodySize,
+        //! Non-zero if every message is kMinSize bytes
+        kIsFixed  = Body::kIsFixed
+    };
+
+    //! Check a message code
+    /*!
+    Returns true if \c data starts with this message's code.  \c data
+    must have at least kCodeSize bytes.
+    */
+    static bool            matches(const void* data)
+    {
+        return MessageCode::matches(data);
+    }
+
+    //! Get the size of a message
+    template <class... Args>
+    static UInt32        getSize(const Args&... args)
+    {
+        return kCodeSize + Body::getSize(args...);
+    }
+
+    //! Write a message
+    /*!
+    Writes the message to \c buffer, which must have getSize() bytes,
+    and returns the number of bytes written.
+    */
+    template <class... Args>
+    static UInt32        write(void* buffer, const Args&... args)
+    {
+        UInt8* dst = static_cast<UInt8*>(buffer);
+        return (UInt32)(Body::write(MessageCode::write(dst), args...) - dst);
+    }
+
+    //! Read a message
+    /*!
+    Parses a whole message from \c size bytes at \c data.  Returns false
+    if the code doesn't match or the data is too short.
+    */
+    template <class... Args>
+    static bool            read(const void* data, UInt32 size, Args&... args)
+    {
+        View view(data, size);
+        const UInt8* code = view.take(kCodeSize);
+        return (code != NULL && matches(code) && Body::read(view, args...));
+    }
+
+    //! Read the fields of a message
+    /*!
+    Parses the fields of a message whose code has already been taken
+    from \c view.
+    */
+    template <class Source, class... Args>
+    static bool            readBody(Source& src, Args&... args)
+    {
+        return Body::read(src, args...);
+    }
+
+    //! Send a message
+    /*!
+    Writes the message to \c stream in one write.
+    */
+    template <class... Args>
+    static void            send(synergy::IStream* stream, const Args&... args)
+    {
+        UInt8 fixed[kMinSize > 256 ? kMinSize : 256];
+        UInt32 size = getSize(args...);
+        if (size <= sizeof(fixed)) {
+            stream->write(fixed, write(fixed, args...));
+        }
+        else {
+            std::vector<UInt8> buffer(size);
+            stream->write(&buffer[0], write(&buffer[0], args...));
+        }
+    }
+
+    //! Receive a message
+    /*!
+    Reads the fields of a message whose code has already been read from
+    \c stream.  Returns false if the stream doesn't have all of them.
+    */
+    template <class... Args>
+    static bool            receive(synergy::IStream* stream, Args&... args)
+    {
+        if (kIsFixed) {
+            UInt8 buffer[kBodySize + 1];
+            if (stream->getSize() < kBodySize) {
+                return false;
+            }
+            for (UInt32 done = 0; done < kBodySize; ) {
+                UInt32 n = stream->read(buffer + done, kBodySize - done);
+                if (n == 0) {
+                    return false;
+                }
+                done += n;
+            }
+            View view(buffer, kBodySize);
+            return Body::read(view, args...);
+        }
+        else {
+            StreamView view(stream);
+            return Body::read(view, args...);
+        }
+    }
+};
+
+//! Message handler table
+/*!
+Maps message codes to handlers of type \c T.  Codes are read as 4 byte
+integers and kept sorted, so finding the handler for a message is a
+binary search rather than a compare against each code in turn.  The
+table for a later protocol version can start as a copy of an earlier
+version's and add or replace handlers.
+*/
+template <class T>
+class MessageTable {
+public:
+    //! Add a handler
+    /*!
+    Adds \c handler for messages starting with the code of \c format,
+    one of the kMsg* formats, replacing any handler it already has.
+    */
+    void                add(const char* format, const T& handler)
+    {
+        Entry entry;
+        entry.m_code    = toCode(format);
+        entry.m_handler = handler;
+        typename EntryList::iterator i = lowerBound(entry.m_code);
+        if (i != m_entries.end() && i->m_code == entry.m_code) {
+            *i = entry;
+        }
+        else {
+            m_entries.insert(i, entry);
+        }
+    }
+
+    //! Find a handler
+    /*!
+    Returns the handler for the message code at \c code, or NULL if
+    there isn't one.
+    */
+    const T*            find(const void* code) const
+    {
+        UInt32 value = toCode(code);
+        const Entry* entries = m_entries.data();
+        size_t low = 0, high = m_entries.size();
+        while (low < high) {
+            size_t mid = (low + high) / 2;
+            if (entries[mid].m_code < value) {
+                low = mid + 1;
+            }
+            else {
+                high = mid;
+            }
+        }
+        if (low < m_entries.size() && entries[low].m_code == value) {
+            return &entries[low].m_handler;
+        }
+        return NULL;
+    }
+
+    //! Read a message code
+    /*!
+    Returns the 4 byte code at \c code as an integer.
+    */
+    static UInt32        toCode(const void* code)
+    {
+        return Int<4>::decode(static_cast<const UInt8*>(code));
+    }
+
+private:
+    class Entry {
+    public:
+        UInt32            m_code;
+        T                m_handler;
+    };
+    typedef std::vector<Entry> EntryList;
+
+    typename EntryList::iterator lowerBound(UInt32 code)
+    {
+        typename EntryList::iterator i = m_entries.begin();
+        while (i != m_entries.end() && i->m_code < code) {
+            ++i;
+        }
+        return i;
+    }
+
+    EntryList            m_entries;
+};
+
+//! @name Messages
+//@{
+
+// handshake
+class Hello : public Message<Code<'S','y','n','e','r','g','y'>,
+                            Int<2>, Int<2> > { };
+class HelloBack : public Message<Code<'S','y','n','e','r','g','y'>,
+                            Int<2>, Int<2>, Str> { };
+
+// commands
+class CNoop : public Message<Code<'C','N','O','P'> > { };
+class CClose : public Message<Code<'C','B','Y','E'> > { };
+class CEnter : public Message<Code<'C','I','N','N'>,
+                            Int<2>, Int<2>, Int<4>, Int<2> > { };
+class CLeave : public Message<Code<'C','O','U','T'> > { };
+class CClipboard : public Message<Code<'C','C','L','P'>, Int<1>, Int<4> > { };
+class CScreenSaver : public Message<Code<'C','S','E','C'>, Int<1> > { };
+class CResetOptions : public Message<Code<'C','R','O','P'> > { };
+class CInfoAck : public Message<Code<'C','I','A','K'> > { };
+class CKeepAlive : public Message<Code<'C','A','L','V'> > { };
+
+// data
+class DKeyDown : public Message<Code<'D','K','D','N'>,
+                            Int<2>, Int<2>, Int<2> > { };
+class DKeyDown1_0 : public Message<Code<'D','K','D','N'>, Int<2>, Int<2> > { };
+class DKeyRepeat : public Message<Code<'D','K','R','P'>,
+                            Int<2>, Int<2>, Int<2>, Int<2> > { };
+class DKeyRepeat1_0 : public Message<Code<'D','K','R','P'>,
+                            Int<2>, Int<2>, Int<2> > { };
+class DKeyUp : public Message<Code<'D','K','U','P'>,
+                            Int<2>, Int<2>, Int<2> > { };
+class DKeyUp1_0 : public Message<Code<'D','K','U','P'>, Int<2>, Int<2> > { };
+class DMouseDown : public Message<Code<'D','M','D','N'>, Int<1> > { };
+class DMouseUp : public Message<Code<'D','M','U','P'>, Int<1> > { };
+class DMouseMove : public Message<Code<'D','M','M','V'>, Int<2>, Int<2> > { };
+class DMouseRelMove : public Message<Code<'D','M','R','M'>,
+                            Int<2>, Int<2> > { };
+class DMouseWheel : public Message<Code<'D','M','W','M'>, Int<2>, Int<2> > { };
+class DMouseWheel1_0 : public Message<Code<'D','M','W','M'>, Int<2> > { };
+class DClipboard : public Message<Code<'D','C','L','P'>,
+                            Int<1>, Int<4>, Int<1>, Str> { };
+class DInfo : public Message<Code<'D','I','N','F'>,
+                            Int<2>, Int<2>, Int<2>, Int<2>,
+                            Int<2>, Int<2>, Int<2> > { };
+class DSetOptions : public Message<Code<'D','S','O','P'>, IntList<4> > { };
+class DFileTransfer : public Message<Code<'D','F','T','R'>, Int<1>, Str> { };
+class DDragInfo : public Message<Code<'D','D','R','G'>, Int<2>, Str> { };
+
+// queries
+class QInfo : public Message<Code<'Q','I','N','F'> > { };
+
+// errors
+class EIncompatible : public Message<Code<'E','I','C','V'>,
+                            Int<2>, Int<2> > { };
+class EBusy : public Message<Code<'E','B','S','Y'> > { };
+class EUnknown : public Message<Code<'E','U','N','K'> > { };
+class EBad : public Message<Code<'E','B','A','D'> > { };
+
+//@}
+
+}
+}
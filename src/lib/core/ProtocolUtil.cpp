@@ -21,6 +21,7 @@
 #include "base/Log.h"
 #include "common/stdvector.h"
 
+#include <algorithm>
 #include <cctype>
 #include <cstring>
 
@@ -77,21 +78,19 @@ ProtocolUtil::vwritef(synergy::IStream* stream,
         return;
     }
 
-    // fill buffer
-    UInt8* buffer = new UInt8[size];
+    // fill buffer, on the stack unless the message is big
+    UInt8 fixed[256];
+    std::vector<UInt8> heap;
+    UInt8* buffer = fixed;
+    if (size > sizeof(fixed)) {
+        heap.resize(size);
+        buffer = &heap[0];
+    }
     writef(buffer, fmt, args);
 
-    try {
-        // write buffer
-        stream->write(buffer, size);
-        LOG((CLOG_DEBUG2 "wrote %d bytes", size));
-
-        delete[] buffer;
-    }
-    catch (XBase&) {
-        delete[] buffer;
-        throw;
-    }
+    // write buffer
+    stream->write(buffer, size);
+    LOG((CLOG_DEBUG2 "wrote %d bytes", size));
 }
 
 void
@@ -158,44 +157,50 @@ ProtocolUtil::vreadf(synergy::IStream* stream, const char* fmt, va_list args)
                            (static_cast<UInt32>(buffer[2]) <<  8) |
                             static_cast<UInt32>(buffer[3]);
 
-                // convert it
+                // convert it, reading the integers a block at a time
                 void* v = va_arg(args, void*);
-                switch (len) {
-                case 1:
-                    // 1 byte integer
-                    for (UInt32 i = 0; i < n; ++i) {
-                        read(stream, buffer, 1);
-                        static_cast<std::vector<UInt8>*>(v)->push_back(
-                            buffer[0]);
-                        LOG((CLOG_DEBUG2 "readf: read %d byte integer[%d]: %d (0x%x)", len, i, static_cast<std::vector<UInt8>*>(v)->back(), static_cast<std::vector<UInt8>*>(v)->back()));
+                UInt8 block[1024];
+                for (UInt32 i = 0; i < n; ) {
+                    UInt32 count = std::min(n - i, (UInt32)sizeof(block) / len);
+                    read(stream, block, count * len);
+                    const UInt8* src = block;
+                    switch (len) {
+                    case 1: {
+                        // 1 byte integers
+                        std::vector<UInt8>* list = static_cast<std::vector<UInt8>*>(v);
+                        list->insert(list->end(), src, src + count);
+                        break;
                     }
-                    break;
 
-                case 2:
-                    // 2 byte integer
-                    for (UInt32 i = 0; i < n; ++i) {
-                        read(stream, buffer, 2);
-                        static_cast<std::vector<UInt16>*>(v)->push_back(
-                            static_cast<UInt16>(
-                            (static_cast<UInt16>(buffer[0]) << 8) |
-                             static_cast<UInt16>(buffer[1])));
-                        LOG((CLOG_DEBUG2 "readf: read %d byte integer[%d]: %d (0x%x)", len, i, static_cast<std::vector<UInt16>*>(v)->back(), static_cast<std::vector<UInt16>*>(v)->back()));
+                    case 2: {
+                        // 2 byte integers
+                        std::vector<UInt16>* list = static_cast<std::vector<UInt16>*>(v);
+                        list->reserve(list->size() + count);
+                        for (UInt32 j = 0; j < count; ++j, src += 2) {
+                            list->push_back(static_cast<UInt16>(
+                                (static_cast<UInt16>(src[0]) << 8) |
+                                 static_cast<UInt16>(src[1])));
+                        }
+                        break;
                     }
-                    break;
 
-                case 4:
-                    // 4 byte integer
-                    for (UInt32 i = 0; i < n; ++i) {
-                        read(stream, buffer, 4);
-                        static_cast<std::vector<UInt32>*>(v)->push_back(
-                            (static_cast<UInt32>(buffer[0]) << 24) |
-                            (static_cast<UInt32>(buffer[1]) << 16) |
-                            (static_cast<UInt32>(buffer[2]) <<  8) |
-                             static_cast<UInt32>(buffer[3]));
-                        LOG((CLOG_DEBUG2 "readf: read %d byte integer[%d]: %d (0x%x)", len, i, static_cast<std::vector<UInt32>*>(v)->back(), static_cast<std::vector<UInt32>*>(v)->back()));
+                    case 4: {
+                        // 4 byte integers
+                        std::vector<UInt32>* list = static_cast<std::vector<UInt32>*>(v);
+                        list->reserve(list->size() + count);
+                        for (UInt32 j = 0; j < count; ++j, src += 4) {
+                            list->push_back(
+                                (static_cast<UInt32>(src[0]) << 24) |
+                                (static_cast<UInt32>(src[1]) << 16) |
+                                (static_cast<UInt32>(src[2]) <<  8) |
+                                 static_cast<UInt32>(src[3]));
+                        }
+                        break;
                     }
-                    break;
+                    }
+                    i += count;
                 }
+                LOG((CLOG_DEBUG2 "readf: read %d byte integers: %d", len, n));
                 break;
             }
 
@@ -306,7 +311,6 @@ ProtocolUtil::getLength(const char* fmt, va_list args)
             case 's':
                 assert(len == 0);
                 len = (UInt32)(va_arg(args, String*))->size() + 4;
-                (void)va_arg(args, UInt8*);
                 break;
 
             case 'S':
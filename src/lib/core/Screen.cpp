@@ -175,6 +175,12 @@ Screen::grabClipboard(ClipboardID id)
     m_screen->setClipboard(id, NULL);
 }
 
+bool
+Screen::fetchClipboard(ClipboardID id, UInt32 seqNum)
+{
+    return m_screen->fetchClipboard(id, seqNum);
+}
+
 void
 Screen::screensaver(bool activate)
 {
@@ -106,6 +106,14 @@ public:
     */
     void                grabClipboard(ClipboardID);
 
+    //! Fetch clipboard
+    /*!
+    Starts reading the system clipboard in the background.  Returns
+    false if the screen can't, otherwise sends a clipboard changed
+    event with sequence number \c seqNum when it's done.
+    */
+    bool                fetchClipboard(ClipboardID, UInt32 seqNum);
+
     //! Activate/deactivate screen saver
     /*!
     Forcibly activates the screen saver if \c activate is true otherwise
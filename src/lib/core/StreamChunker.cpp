@@ -17,6 +17,7 @@
 
 #include "core/StreamChunker.h"
 
+#include "mt/CondVar.h"
 #include "mt/Lock.h"
 #include "mt/Mutex.h"
 #include "core/FileChunk.h"
@@ -37,9 +38,29 @@ using namespace std;
 
 static const size_t g_chunkSize = 512 * 1024; //512kb
 
+// file chunks posted but not yet flushed.  this bounds the memory a
+// transfer takes to a few chunks however big the file is.
+static const UInt32 g_maxChunksInFlight = 4;
+
 bool StreamChunker::s_isChunkingFile = false;
 bool StreamChunker::s_interruptFile = false;
-Mutex* StreamChunker::s_interruptMutex = NULL;
+
+static void
+postFileChunk(
+                CondVar<UInt32>& chunksInFlight,
+                FileChunk* chunk,
+                IEventQueue* events,
+                void* eventTarget)
+{
+    {
+        Lock lock(chunksInFlight.getMutex());
+        chunksInFlight = chunksInFlight + 1;
+    }
+
+    Event event(events->forFile().fileChunkSending(), eventTarget);
+    event.setDataObject(chunk);
+    events->addEvent(event);
+}
 
 void
 StreamChunker::sendFile(
@@ -47,9 +68,7 @@ StreamChunker::sendFile(
                 IEventQueue* events,
                 void* eventTarget)
 {
-    s_isChunkingFile = true;
-    
-    std::fstream file(static_cast<char*>(filename), std::ios::in | std::ios::binary);
+    std::ifstream file(static_cast<char*>(filename), std::ios::in | std::ios::binary);
 
     if (!file.is_open()) {
         throw runtime_error("failed to open file");
@@ -58,56 +77,87 @@ StreamChunker::sendFile(
     // check file size
     file.seekg (0, std::ios::end);
     size_t size = (size_t)file.tellg();
+    file.seekg (0, std::ios::beg);
+
+    CondVar<UInt32>& chunksInFlight = getChunksInFlight();
+    {
+        Lock lock(chunksInFlight.getMutex());
+        s_isChunkingFile = true;
+        chunksInFlight   = 0;
+    }
 
     // send first message (file size)
     String fileSize = synergy::string::sizeTypeToString(size);
     FileChunk* sizeMessage = FileChunk::start(fileSize);
 
-    events->addEvent(Event(events->forFile().fileChunkSending(), eventTarget, sizeMessage));
+    postFileChunk(chunksInFlight, sizeMessage, events, eventTarget);
 
     // send chunk messages with a fixed chunk size
     size_t sentLength = 0;
     size_t chunkSize = g_chunkSize;
-    file.seekg (0, std::ios::beg);
-
-    while (true) {
-        if (s_interruptFile) {
-            s_interruptFile = false;
-            LOG((CLOG_DEBUG "file transmission interrupted"));
-            break;
+    bool failed = false;
+
+    while (sentLength < size) {
+        // wait for the chunks already posted to go out
+        {
+            Lock lock(chunksInFlight.getMutex());
+            while (chunksInFlight >= g_maxChunksInFlight && !s_interruptFile) {
+                chunksInFlight.wait();
+            }
+            if (s_interruptFile) {
+                LOG((CLOG_DEBUG "file transmission interrupted"));
+                break;
+            }
         }
         
         events->addEvent(Event(events->forFile().keepAlive(), eventTarget));
         
-        // make sure we don't read too much from the mock data.
+        // make sure we don't read past the end of the file
         if (sentLength + chunkSize > size) {
             chunkSize = size - sentLength;
         }
 
-        char* chunkData = new char[chunkSize];
-        file.read(chunkData, chunkSize);
-        UInt8* data = reinterpret_cast<UInt8*>(chunkData);
-        FileChunk* fileChunk = FileChunk::data(data, chunkSize);
-        delete[] chunkData;
+        // read straight into the chunk
+        FileChunk* fileChunk = FileChunk::data(chunkSize);
+        file.read(&fileChunk->m_chunk[1], chunkSize);
+        if ((size_t)file.gcount() != chunkSize) {
+            delete fileChunk;
+            failed = true;
+            break;
+        }
 
-        events->addEvent(Event(events->forFile().fileChunkSending(), eventTarget, fileChunk));
+        postFileChunk(chunksInFlight, fileChunk, events, eventTarget);
 
         sentLength += chunkSize;
-        file.seekg (sentLength, std::ios::beg);
-
-        if (sentLength == size) {
-            break;
-        }
     }
 
     // send last message
     FileChunk* end = FileChunk::end();
 
-    events->addEvent(Event(events->forFile().fileChunkSending(), eventTarget, end));
+    postFileChunk(chunksInFlight, end, events, eventTarget);
 
     file.close();
     
-    s_isChunkingFile = false;
+    {
+        Lock lock(chunksInFlight.getMutex());
+        s_isChunkingFile = false;
+        s_interruptFile  = false;
+    }
+
+    if (failed) {
+        throw runtime_error("failed to read file");
+    }
+}
+
+static void
+postClipboardChunk(
+                ClipboardChunk* chunk,
+                IEventQueue* events,
+                void* eventTarget)
+{
+    Event event(events->forClipboard().clipboardSending(), eventTarget);
+    event.setDataObject(chunk);
+    events->addEvent(event);
 }
 
 void
@@ -119,11 +169,17 @@ StreamChunker::sendClipboard(
                 IEventQueue* events,
                 void* eventTarget)
 {
+    // take the data rather than copy it.  the chunks share it until the
+    // last has been sent.
+    std::shared_ptr<String> marshalled = std::make_shared<String>();
+    marshalled->swap(data);
+    ClipboardBuffer buffer = marshalled;
+
     // send first message (data size)
     String dataSize = synergy::string::sizeTypeToString(size);
     ClipboardChunk* sizeMessage = ClipboardChunk::start(id, sequence, dataSize);
     
-    events->addEvent(Event(events->forClipboard().clipboardSending(), eventTarget, sizeMessage));
+    postClipboardChunk(sizeMessage, events, eventTarget);
 
     // send clipboard chunk with a fixed size
     size_t sentLength = 0;
@@ -137,10 +193,10 @@ StreamChunker::sendClipboard(
             chunkSize = size - sentLength;
         }
 
-        String chunk(data.substr(sentLength, chunkSize).c_str(), chunkSize);
-        ClipboardChunk* dataChunk = ClipboardChunk::data(id, sequence, chunk);
+        ClipboardChunk* dataChunk = ClipboardChunk::data(id, sequence,
+                            buffer, sentLength, chunkSize);
         
-        events->addEvent(Event(events->forClipboard().clipboardSending(), eventTarget, dataChunk));
+        postClipboardChunk(dataChunk, events, eventTarget);
 
         sentLength += chunkSize;
         if (sentLength == size) {
@@ -151,7 +207,7 @@ StreamChunker::sendClipboard(
     // send last message
     ClipboardChunk* end = ClipboardChunk::end(id, sequence);
 
-    events->addEvent(Event(events->forClipboard().clipboardSending(), eventTarget, end));
+    postClipboardChunk(end, events, eventTarget);
     
     LOG((CLOG_DEBUG "sent clipboard size=%d", sentLength));
 }
@@ -159,8 +215,37 @@ StreamChunker::sendClipboard(
 void
 StreamChunker::interruptFile()
 {
+    CondVar<UInt32>& chunksInFlight = getChunksInFlight();
+    Lock lock(chunksInFlight.getMutex());
     if (s_isChunkingFile) {
         s_interruptFile = true;
+        chunksInFlight.broadcast();
         LOG((CLOG_INFO "previous dragged file has become invalid"));
     }
 }
+
+void
+StreamChunker::fileChunksFlushed(UInt32 count)
+{
+    CondVar<UInt32>& chunksInFlight = getChunksInFlight();
+    Lock lock(chunksInFlight.getMutex());
+
+    // chunks posted by an earlier transfer may still be flushing
+    if (count < chunksInFlight) {
+        chunksInFlight = chunksInFlight - count;
+    }
+    else {
+        chunksInFlight = 0;
+    }
+    chunksInFlight.broadcast();
+}
+
+CondVar<UInt32>&
+StreamChunker::getChunksInFlight()
+{
+    // created on first use, once the arch layer exists, and never freed
+    // since a sending thread may still be waiting on it at exit
+    static Mutex* mutex = new Mutex;
+    static CondVar<UInt32>* chunksInFlight = new CondVar<UInt32>(mutex, 0);
+    return *chunksInFlight;
+}
@@ -21,14 +21,27 @@
 #include "base/String.h"
 
 class IEventQueue;
-class Mutex;
+template <class T> class CondVar;
 
 class StreamChunker {
 public:
+    //! Send a file
+    /*!
+    Posts the file as \c fileChunkSending events to \c eventTarget.  At
+    most a few chunks are posted and not yet flushed at a time, so this
+    blocks until fileChunksFlushed() makes room for the next.  Call it
+    on a thread of its own.
+    */
     static void            sendFile(
                             char* filename,
                             IEventQueue* events,
                             void* eventTarget);
+    //! Send a clipboard
+    /*!
+    Posts the marshalled clipboard \c data as \c clipboardSending events
+    to \c eventTarget.  The data is taken, leaving \c data empty, and
+    the chunks refer to it rather than copy it.
+    */
     static void            sendClipboard(
                             String& data,
                             size_t size,
@@ -37,9 +50,17 @@ public:
                             IEventQueue* events,
                             void* eventTarget);
     static void            interruptFile();
+
+    //! Note flushed file chunks
+    /*!
+    Called by whatever relays \c fileChunkSending events once \c count
+    of the chunks have left the process, or been dropped.
+    */
+    static void            fileChunksFlushed(UInt32 count);
     
 private:
+    static CondVar<UInt32>&    getChunksInFlight();
+
     static bool            s_isChunkingFile;
     static bool            s_interruptFile;
-    static Mutex*        s_interruptMutex;
 };
@@ -64,10 +64,26 @@ static const OptionID    kOptionScreenSwitchNeedsControl = OPTION_CODE("SSNC");
 static const OptionID    kOptionScreenSwitchNeedsAlt     = OPTION_CODE("SSNA");
 static const OptionID    kOptionScreenSaverSync            = OPTION_CODE("SSVR");
 static const OptionID    kOptionXTestXineramaUnaware        = OPTION_CODE("XTXU");
+static const OptionID    kOptionXClipboardIgnoreTargets    = OPTION_CODE("XCIT");
 static const OptionID    kOptionScreenPreserveFocus        = OPTION_CODE("SFOC");
 static const OptionID    kOptionRelativeMouseMoves        = OPTION_CODE("MDLT");
 static const OptionID    kOptionWin32KeepForeground        = OPTION_CODE("_KFW");
 static const OptionID    kOptionClipboardSharing            = OPTION_CODE("CLPS");
+static const OptionID    kOptionNoopReplies                = OPTION_CODE("NOOP");
+//@}
+
+//! @name No-op reply policies
+/*!
+When the client sends a kMsgCNoop back to the server.  Clients that
+don't get a policy from the server reply to every message.
+*/
+//@{
+enum ENoopReplies {
+    kNoopRepliesPerMessage,        //!< Reply to every message
+    kNoopRepliesPerBatch,        //!< Reply once per batch of messages read
+    kNoopRepliesCoalesced,        //!< Reply at most once per kNoopReplyDelay
+    kNoopRepliesNone            //!< Never reply
+};
 //@}
 
 //! @name Screen switch corner enumeration
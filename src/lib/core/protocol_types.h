@@ -47,6 +47,11 @@ static const double        kKeepAliveRate = 3.0;
 // number of skipped kMsgCKeepAlive messages that indicates a problem
 static const double        kKeepAlivesUntilDeath = 3.0;
 
+// time a client waits before sending a kMsgCNoop (in seconds) when
+// no-op replies are coalesced.  any other messages parsed in that time
+// share the one reply.
+static const double        kNoopReplyDelay = 0.02;
+
 // obsolete heartbeat stuff
 static const double        kHeartRate = -1.0;
 static const double        kHeartBeatsUntilDeath = 3.0;
@@ -117,6 +122,8 @@ extern const char*        kMsgHelloBack;
 //
 
 // no operation;  secondary -> primary
+// sent in reply to other messages to work around delayed ACKs.  how
+// often is set by the kOptionNoopReplies option.
 extern const char*        kMsgCNoop;
 
 // close connection;  primary -> secondary
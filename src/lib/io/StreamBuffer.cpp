@@ -18,22 +18,31 @@
 
 #include "io/StreamBuffer.h"
 
+#include <cstring>
+
 //
 // StreamBuffer
 //
 
-const UInt32            StreamBuffer::kChunkSize = 4096;
+// the most plaintext a TLS record holds, so a secure socket can hand
+// each chunk to SSL_write() as one full record
+const UInt32            StreamBuffer::kChunkSize = 16384;
+const size_t            StreamBuffer::kMaxSpareChunks = 4;
 
 StreamBuffer::StreamBuffer() :
-    m_size(0),
-    m_headUsed(0)
+    m_size(0)
 {
     // do nothing
 }
 
 StreamBuffer::~StreamBuffer()
 {
-    // do nothing
+    for (ChunkList::iterator i = m_chunks.begin(); i != m_chunks.end(); ++i) {
+        delete[] i->m_data;
+    }
+    for (size_t i = 0; i < m_spareChunks.size(); ++i) {
+        delete[] m_spareChunks[i];
+    }
 }
 
 const void*
@@ -47,19 +56,44 @@ StreamBuffer::peek(UInt32 n)
         return NULL;
     }
 
-    // reserve space in first chunk
-    ChunkList::iterator head = m_chunks.begin();
-    head->reserve(n + m_headUsed);
+    // return the data in place if it's all in the first chunk
+    const Chunk& head = m_chunks.front();
+    if (n <= head.m_end - head.m_begin) {
+        return head.m_data + head.m_begin;
+    }
 
-    // consolidate chunks into the first chunk until it has n bytes
-    ChunkList::iterator scan = head;
-    ++scan;
-    while (head->size() - m_headUsed < n && scan != m_chunks.end()) {
-        head->insert(head->end(), scan->begin(), scan->end());
-        scan = m_chunks.erase(scan);
+    // otherwise gather it
+    m_peekBuffer.resize(n);
+    UInt8* dst = &m_peekBuffer[0];
+    for (ChunkList::const_iterator i = m_chunks.begin(); n > 0; ++i) {
+        UInt32 count = i->m_end - i->m_begin;
+        if (count > n) {
+            count = n;
+        }
+        memcpy(dst, i->m_data + i->m_begin, count);
+        dst += count;
+        n   -= count;
     }
+    return &m_peekBuffer[0];
+}
 
-    return static_cast<const void*>(&(head->begin()[m_headUsed]));
+void
+StreamBuffer::read(void* vdata, UInt32 n)
+{
+    assert(n <= m_size);
+
+    UInt8* data = static_cast<UInt8*>(vdata);
+    UInt32 left = n;
+    for (ChunkList::const_iterator i = m_chunks.begin(); left > 0; ++i) {
+        UInt32 count = i->m_end - i->m_begin;
+        if (count > left) {
+            count = left;
+        }
+        memcpy(data, i->m_data + i->m_begin, count);
+        data += count;
+        left -= count;
+    }
+    pop(n);
 }
 
 void
@@ -67,9 +101,11 @@ StreamBuffer::pop(UInt32 n)
 {
     // discard all chunks if n is greater than or equal to m_size
     if (n >= m_size) {
-        m_size     = 0;
-        m_headUsed = 0;
-        m_chunks.clear();
+        while (!m_chunks.empty()) {
+            deleteChunk(m_chunks.front());
+            m_chunks.pop_front();
+        }
+        m_size = 0;
         return;
     }
 
@@ -77,19 +113,16 @@ StreamBuffer::pop(UInt32 n)
     m_size -= n;
 
     // discard chunks until more than n bytes would've been discarded
-    ChunkList::iterator scan = m_chunks.begin();
-    assert(scan != m_chunks.end());
-    while (scan->size() - m_headUsed <= n) {
-        n         -= (UInt32)scan->size() - m_headUsed;
-        m_headUsed = 0;
-        scan       = m_chunks.erase(scan);
-        assert(scan != m_chunks.end());
+    assert(!m_chunks.empty());
+    while (m_chunks.front().m_end - m_chunks.front().m_begin <= n) {
+        n -= m_chunks.front().m_end - m_chunks.front().m_begin;
+        deleteChunk(m_chunks.front());
+        m_chunks.pop_front();
+        assert(!m_chunks.empty());
     }
 
     // remove left over bytes from the head chunk
-    if (n > 0) {
-        m_headUsed += n;
-    }
+    m_chunks.front().m_begin += n;
 }
 
 void
@@ -106,36 +139,73 @@ StreamBuffer::write(const void* vdata, UInt32 n)
     // cast data to bytes
     const UInt8* data = static_cast<const UInt8*>(vdata);
 
-    // point to last chunk if it has space, otherwise append an empty chunk
-    ChunkList::iterator scan = m_chunks.end();
-    if (scan != m_chunks.begin()) {
-        --scan;
-        if (scan->size() >= kChunkSize) {
-            ++scan;
+    // fill the last chunk then append more as needed
+    while (n > 0) {
+        if (m_chunks.empty() || m_chunks.back().m_end == kChunkSize) {
+            m_chunks.push_back(newChunk());
         }
+        Chunk& tail  = m_chunks.back();
+        UInt32 count = kChunkSize - tail.m_end;
+        if (count > n) {
+            count = n;
+        }
+        memcpy(tail.m_data + tail.m_end, data, count);
+        tail.m_end += count;
+        data       += count;
+        n          -= count;
     }
-    if (scan == m_chunks.end()) {
-        scan = m_chunks.insert(scan, Chunk());
+}
+
+int
+StreamBuffer::reserve(Region* regions, int num, UInt32 n)
+{
+    // the free space at the end of the last chunk comes first
+    int used      = 0;
+    UInt32 space  = 0;
+    if (!m_chunks.empty() && m_chunks.back().m_end < kChunkSize) {
+        Chunk& tail          = m_chunks.back();
+        regions[0].m_data    = tail.m_data + tail.m_end;
+        regions[0].m_size    = kChunkSize - tail.m_end;
+        space               += regions[0].m_size;
+        ++used;
     }
 
-    // append data in chunks
-    while (n > 0) {
-        // choose number of bytes for next chunk
-        assert(scan->size() <= kChunkSize);
-        UInt32 count = kChunkSize - (UInt32)scan->size();
-        if (count > n)
-            count = n;
+    // then empty chunks.  commit() removes any left empty.
+    while (used < num && (space < n || used == 0)) {
+        m_chunks.push_back(newChunk());
+        regions[used].m_data = m_chunks.back().m_data;
+        regions[used].m_size = kChunkSize;
+        space               += kChunkSize;
+        ++used;
+    }
 
-        // transfer data
-        scan->insert(scan->end(), data, data + count);
-        n    -= count;
-        data += count;
+    return used;
+}
 
-        // append another empty chunk if we're not done yet
-        if (n > 0) {
-            ++scan;
-            scan = m_chunks.insert(scan, Chunk());
+void
+StreamBuffer::commit(UInt32 n)
+{
+    m_size += n;
+
+    // skip full chunks then fill the reserved space in order
+    ChunkList::iterator i = m_chunks.begin();
+    while (i != m_chunks.end() && i->m_end == kChunkSize) {
+        ++i;
+    }
+    for (; i != m_chunks.end() && n > 0; ++i) {
+        UInt32 count = kChunkSize - i->m_end;
+        if (count > n) {
+            count = n;
         }
+        i->m_end += count;
+        n        -= count;
+    }
+    assert(n == 0);
+
+    // release reserved chunks nothing was stored in
+    while (!m_chunks.empty() && m_chunks.back().m_end == 0) {
+        deleteChunk(m_chunks.back());
+        m_chunks.pop_back();
     }
 }
 
@@ -144,3 +214,54 @@ StreamBuffer::getSize() const
 {
     return m_size;
 }
+
+UInt32
+StreamBuffer::getHeadSize() const
+{
+    if (m_chunks.empty()) {
+        return 0;
+    }
+    return m_chunks.front().m_end - m_chunks.front().m_begin;
+}
+
+int
+StreamBuffer::getData(Region* regions, int num) const
+{
+    int used = 0;
+    for (ChunkList::const_iterator i = m_chunks.begin();
+                                i != m_chunks.end() && used < num; ++i) {
+        regions[used].m_data = i->m_data + i->m_begin;
+        regions[used].m_size = i->m_end - i->m_begin;
+        ++used;
+    }
+    return used;
+}
+
+StreamBuffer::Chunk
+StreamBuffer::newChunk()
+{
+    Chunk chunk;
+    if (m_spareChunks.empty()) {
+        chunk.m_data = new UInt8[kChunkSize];
+    }
+    else {
+        chunk.m_data = m_spareChunks.back();
+        m_spareChunks.pop_back();
+    }
+    chunk.m_begin = 0;
+    chunk.m_end   = 0;
+    return chunk;
+}
+
+void
+StreamBuffer::deleteChunk(const Chunk& chunk)
+{
+    // keep a few so a buffer that's repeatedly filled and emptied
+    // doesn't allocate each time
+    if (m_spareChunks.size() < kMaxSpareChunks) {
+        m_spareChunks.push_back(chunk.m_data);
+    }
+    else {
+        delete[] chunk.m_data;
+    }
+}
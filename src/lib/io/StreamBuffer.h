@@ -19,15 +19,28 @@
 #pragma once
 
 #include "base/EventTypes.h"
-#include "common/stdlist.h"
+#include "common/stddeque.h"
 #include "common/stdvector.h"
 
 //! FIFO of bytes
 /*!
-This class maintains a FIFO (first-in, last-out) buffer of bytes.
+This class maintains a FIFO (first-in, last-out) buffer of bytes.  The
+bytes are kept in a queue of fixed size segments so data can be written
+to and read from the buffer in place, e.g. by \c writev() and
+\c readv(), using getData(), reserve() and commit().
 */
 class StreamBuffer {
 public:
+    //! A contiguous region of the buffer
+    class Region {
+    public:
+        //! The first byte in the region
+        UInt8*            m_data;
+
+        //! The number of bytes in the region
+        UInt32            m_size;
+    };
+
     StreamBuffer();
     ~StreamBuffer();
 
@@ -38,10 +51,19 @@ public:
     /*!
     Return a pointer to memory with the next \c n bytes in the buffer
     (which must be <= getSize()).  The caller must not modify the returned
-    memory nor delete it.
+    memory nor delete it.  The memory is only valid until the buffer is
+    next changed.  The bytes are copied if they span segments, which
+    never happens if \c n <= getHeadSize().
     */
     const void*            peek(UInt32 n);
 
+    //! Read data
+    /*!
+    Copies the next \c n bytes (which must be <= getSize()) to \c data
+    and discards them.
+    */
+    void                read(void* data, UInt32 n);
+
     //! Discard data
     /*!
     Discards the next \c n bytes.  If \c n >= getSize() then the buffer
@@ -55,6 +77,24 @@ public:
     */
     void                write(const void* data, UInt32 n);
 
+    //! Reserve space
+    /*!
+    Makes room for at least \c n more bytes (or as many as fit in
+    \c num regions) after the data in the buffer and fills in up to
+    \c num regions with the free space, in order.  Returns the number
+    of regions filled in.  Bytes stored in the regions are only added
+    to the buffer by commit(), which must be called before the buffer
+    is otherwise changed.
+    */
+    int                    reserve(Region* regions, int num, UInt32 n);
+
+    //! Add reserved data
+    /*!
+    Appends the first \c n bytes stored in the regions returned by the
+    last reserve() and releases the rest of the reserved space.
+    */
+    void                commit(UInt32 n);
+
     //@}
     //! @name accessors
     //@{
@@ -65,15 +105,49 @@ public:
     */
     UInt32                getSize() const;
 
+    //! Get size of the first segment
+    /*!
+    Returns the number of bytes at the front of the buffer that peek()
+    can return without copying.  This is 0 only if the buffer is empty.
+    */
+    UInt32                getHeadSize() const;
+
+    //! Get data
+    /*!
+    Fills in up to \c num regions with the data at the front of the
+    buffer, in order, and returns the number of regions filled in.  The
+    regions are only valid until the buffer is next changed.
+    */
+    int                    getData(Region* regions, int num) const;
+
     //@}
 
 private:
-    static const UInt32    kChunkSize;
+    class Chunk {
+    public:
+        UInt8*            m_data;
+        UInt32            m_begin;
+        UInt32            m_end;
+    };
+    typedef std::deque<Chunk> ChunkList;
 
-    typedef std::vector<UInt8> Chunk;
-    typedef std::list<Chunk> ChunkList;
+    Chunk                newChunk();
+    void                deleteChunk(const Chunk&);
+
+    // not implemented
+    StreamBuffer(const StreamBuffer&);
+    StreamBuffer&        operator=(const StreamBuffer&);
+
+private:
+    static const UInt32    kChunkSize;
+    static const size_t    kMaxSpareChunks;
 
     ChunkList            m_chunks;
     UInt32                m_size;
-    UInt32                m_headUsed;
+
+    // emptied chunks kept for reuse
+    std::vector<UInt8*>    m_spareChunks;
+
+    // holds what peek() returns when it spans chunks
+    std::vector<UInt8>    m_peekBuffer;
 };
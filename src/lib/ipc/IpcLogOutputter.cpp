@@ -37,21 +37,34 @@ enum EIpcLogOutputter {
     kBufferRateTimeLimit = 1 // seconds
 };
 
+// the longest a line waits for a batch to fill, in seconds
+static const double        kBatchTime = 0.1;
+
+// the outputter sending on this thread, if any.  lines logged while
+// sending are ignored since they would cause recursion.
+static thread_local const IpcLogOutputter* s_sender = nullptr;
+
 IpcLogOutputter::IpcLogOutputter(IpcServer& ipcServer, EIpcClientType clientType, bool useThread) :
     m_ipcServer(ipcServer),
+    m_ring(kBufferMaxSize),
+    m_ringHead(0),
+    m_ringCount(0),
+    m_oldestTime(0.0),
+    m_dropped(0),
+    m_droppedTotal(0),
+    m_sentChunks(0),
     m_bufferMutex(ARCH->newMutex()),
-    m_sending(false),
     m_bufferThread(nullptr),
-    m_running(false),
+    m_running(useThread),
     m_notifyCond(ARCH->newCondVar()),
     m_notifyMutex(ARCH->newMutex()),
-    m_bufferThreadId(0),
-    m_bufferWaiting(false),
-    m_bufferMaxSize(kBufferMaxSize),
+    m_notified(false),
     m_bufferRateWriteLimit(kBufferRateWriteLimit),
     m_bufferRateTimeLimit(kBufferRateTimeLimit),
     m_bufferWriteCount(0),
     m_bufferRateStart(ARCH->time()),
+    m_batchLines(kMaxSendLines),
+    m_batchTime(kBatchTime),
     m_clientType(clientType),
     m_runningMutex(ARCH->newMutex())
 {
@@ -65,16 +78,16 @@ IpcLogOutputter::~IpcLogOutputter()
 {
     close();
 
-    ARCH->closeMutex(m_bufferMutex);
-
     if (m_bufferThread != nullptr) {
         m_bufferThread->cancel();
         m_bufferThread->wait();
         delete m_bufferThread;
     }
 
+    ARCH->closeMutex(m_bufferMutex);
     ARCH->closeCondVar(m_notifyCond);
     ARCH->closeMutex(m_notifyMutex);
+    ARCH->closeMutex(m_runningMutex);
 }
 
 void
@@ -86,8 +99,10 @@ void
 IpcLogOutputter::close()
 {
     if (m_bufferThread != nullptr) {
-        ArchMutexLock lock(m_runningMutex);
-        m_running = false;
+        {
+            ArchMutexLock lock(m_runningMutex);
+            m_running = false;
+        }
         notifyBuffer();
         m_bufferThread->wait(5);
     }
@@ -101,43 +116,65 @@ IpcLogOutputter::show(bool showIfEmpty)
 bool
 IpcLogOutputter::write(ELevel, const char* text)
 {
-    // ignore events from the buffer thread (would cause recursion).
-    if (m_bufferThread != nullptr &&
-        Thread::getCurrentThread().getID() == m_bufferThreadId) {
+    // ignore events from the sending thread (would cause recursion).
+    if (s_sender == this) {
         return true;
     }
 
-    appendBuffer(text);
-    notifyBuffer();
+    // only wake the buffer thread when it has something new to wait for
+    if (appendBuffer(text)) {
+        notifyBuffer();
+    }
 
     return true;
 }
 
-void
-IpcLogOutputter::appendBuffer(const String& text)
+bool
+IpcLogOutputter::appendBuffer(const char* text)
 {
     ArchMutexLock lock(m_bufferMutex);
 
-    double elapsed = ARCH->time() - m_bufferRateStart;
+    double now = ARCH->time();
+    double elapsed = now - m_bufferRateStart;
     if (elapsed < m_bufferRateTimeLimit) {
         if (m_bufferWriteCount >= m_bufferRateWriteLimit) {
             // discard the log line if we've logged too much.
-            return;
+            ++m_dropped;
+            ++m_droppedTotal;
+            return false;
         }
     }
     else {
         m_bufferWriteCount = 0;
-        m_bufferRateStart = ARCH->time();
+        m_bufferRateStart = now;
     }
+    m_bufferWriteCount++;
 
-    if (m_buffer.size() >= m_bufferMaxSize) {
-        // if the queue is exceeds size limit,
-        // throw away the oldest item
-        m_buffer.pop_front();
+    if (m_ring.empty()) {
+        ++m_dropped;
+        ++m_droppedTotal;
+        return false;
     }
 
-    m_buffer.push_back(text);
-    m_bufferWriteCount++;
+    size_t tail = (m_ringHead + m_ringCount) % m_ring.size();
+    if (m_ringCount == m_ring.size()) {
+        // if the ring is full, overwrite the oldest line
+        m_ringHead = (m_ringHead + 1) % m_ring.size();
+        ++m_dropped;
+        ++m_droppedTotal;
+    }
+    else {
+        ++m_ringCount;
+    }
+
+    // reuses the space of the line this slot held before
+    m_ring[tail].assign(text);
+
+    if (m_ringCount == 1) {
+        m_oldestTime = now;
+        return true;
+    }
+    return (m_ringCount == m_batchLines);
 }
 
 bool
@@ -147,21 +184,57 @@ IpcLogOutputter::isRunning()
     return m_running;
 }
 
+double
+IpcLogOutputter::getBatchWait()
+{
+    double wait;
+    {
+        ArchMutexLock lock(m_bufferMutex);
+        if (m_ringCount == 0 && m_dropped == 0) {
+            return -1.0;
+        }
+        if (m_ringCount >= m_batchLines) {
+            wait = 0.0;
+        }
+        else {
+            wait = m_oldestTime + m_batchTime - ARCH->time();
+            if (wait < 0.0) {
+                wait = 0.0;
+            }
+        }
+    }
+
+    if (!m_ipcServer.hasClients(m_clientType)) {
+        return -1.0;
+    }
+    return wait;
+}
+
 void
 IpcLogOutputter::bufferThread(void*)
 {
-    m_bufferThreadId = m_bufferThread->getID();
-    m_running = true;
+    s_sender = this;
 
     try {
         while (isRunning()) {
-            if (m_buffer.empty() || !m_ipcServer.hasClients(m_clientType)) {
+            double wait = getBatchWait();
+            if (wait != 0.0) {
+                // don't wait if notified since checking
                 ArchMutexLock lock(m_notifyMutex);
-                ARCH->waitCondVar(m_notifyCond, m_notifyMutex, -1);
+                if (!m_notified) {
+                    ARCH->waitCondVar(m_notifyCond, m_notifyMutex, wait);
+                }
+                m_notified = false;
+                continue;
             }
 
             sendBuffer();
         }
+
+        // send what's still waiting before finishing
+        while (getBatchWait() >= 0.0) {
+            sendBuffer();
+        }
     }
     catch (XArch& e) {
         LOG((CLOG_ERR "ipc log buffer thread error, %s", e.what()));
@@ -174,6 +247,7 @@ void
 IpcLogOutputter::notifyBuffer()
 {
     ArchMutexLock lock(m_notifyMutex);
+    m_notified = true;
     ARCH->broadcastCondVar(m_notifyCond);
 }
 
@@ -182,15 +256,25 @@ IpcLogOutputter::getChunk(size_t count)
 {
     ArchMutexLock lock(m_bufferMutex);
 
-    if (m_buffer.size() < count) {
-        count = m_buffer.size();
+    if (m_ringCount < count) {
+        count = m_ringCount;
     }
 
     String chunk;
+    if (m_dropped != 0) {
+        chunk = synergy::string::sprintf("%d log lines dropped\n", m_dropped);
+        m_dropped = 0;
+    }
     for (size_t i = 0; i < count; i++) {
-        chunk.append(m_buffer.front());
+        chunk.append(m_ring[m_ringHead]);
         chunk.append("\n");
-        m_buffer.pop_front();
+        m_ringHead = (m_ringHead + 1) % m_ring.size();
+    }
+    m_ringCount -= count;
+
+    // the rest of the lines start a new batch
+    if (m_ringCount != 0) {
+        m_oldestTime = ARCH->time();
     }
     return chunk;
 }
@@ -198,31 +282,83 @@ IpcLogOutputter::getChunk(size_t count)
 void
 IpcLogOutputter::sendBuffer()
 {
-    if (m_buffer.empty() || !m_ipcServer.hasClients(m_clientType)) {
+    {
+        ArchMutexLock lock(m_bufferMutex);
+        if (m_ringCount == 0 && m_dropped == 0) {
+            return;
+        }
+    }
+    if (!m_ipcServer.hasClients(m_clientType)) {
         return;
     }
 
     IpcLogLineMessage message(getChunk(kMaxSendLines));
-    m_sending = true;
+
+    const IpcLogOutputter* sender = s_sender;
+    s_sender = this;
     m_ipcServer.send(message, kIpcClientGui);
-    m_sending = false;
+    s_sender = sender;
+
+    ArchMutexLock lock(m_bufferMutex);
+    ++m_sentChunks;
 }
 
 void
 IpcLogOutputter::bufferMaxSize(UInt16 bufferMaxSize)
 {
-    m_bufferMaxSize = bufferMaxSize;
+    ArchMutexLock lock(m_bufferMutex);
+
+    // keep the newest lines that fit, in order
+    Ring ring(bufferMaxSize);
+    size_t keep = m_ringCount < ring.size() ? m_ringCount : ring.size();
+    size_t skip = m_ringCount - keep;
+    for (size_t i = 0; i < keep; ++i) {
+        ring[i].swap(m_ring[(m_ringHead + skip + i) % m_ring.size()]);
+    }
+    m_dropped      += (UInt32)skip;
+    m_droppedTotal += (UInt32)skip;
+
+    m_ring.swap(ring);
+    m_ringHead  = 0;
+    m_ringCount = keep;
 }
 
 UInt16
 IpcLogOutputter::bufferMaxSize() const
 {
-    return m_bufferMaxSize;
+    ArchMutexLock lock(m_bufferMutex);
+    return (UInt16)m_ring.size();
 }
 
 void
 IpcLogOutputter::bufferRateLimit(UInt16 writeLimit, double timeLimit)
 {
+    ArchMutexLock lock(m_bufferMutex);
     m_bufferRateWriteLimit = writeLimit;
     m_bufferRateTimeLimit = timeLimit;
 }
+
+void
+IpcLogOutputter::bufferBatch(UInt16 lines, double seconds)
+{
+    {
+        ArchMutexLock lock(m_bufferMutex);
+        m_batchLines = lines;
+        m_batchTime = seconds;
+    }
+    notifyBuffer();
+}
+
+UInt32
+IpcLogOutputter::getDroppedLines() const
+{
+    ArchMutexLock lock(m_bufferMutex);
+    return m_droppedTotal;
+}
+
+UInt32
+IpcLogOutputter::getSentChunks() const
+{
+    ArchMutexLock lock(m_bufferMutex);
+    return m_sentChunks;
+}
@@ -21,9 +21,9 @@
 #include "arch/Arch.h"
 #include "arch/IArchMultithread.h"
 #include "base/ILogOutputter.h"
+#include "base/String.h"
 #include "ipc/Ipc.h"
-
-#include <deque>
+#include "common/stdvector.h"
 
 class IpcServer;
 class Event;
@@ -31,7 +31,11 @@ class IpcClientProxy;
 
 //! Write log to GUI over IPC
 /*!
-This outputter writes output to the GUI via IPC.
+This outputter writes output to the GUI via IPC.  Lines are kept in a
+ring of fixed size and sent in batches, once enough of them are waiting
+or once the oldest has waited long enough.  Lines that don't fit in the
+ring or go over the rate limit are dropped and the GUI is told how many
+with the next batch.
 */
 class IpcLogOutputter : public ILogOutputter {
 public:
@@ -57,8 +61,8 @@ public:
 
     //! Set the buffer size
     /*!
-    Set the maximum size of the buffer to protect memory
-    from runaway logging.
+    Set the maximum number of lines in the buffer to protect memory
+    from runaway logging.  The oldest lines are dropped to make room.
     */
     void                bufferMaxSize(UInt16 bufferMaxSize);
 
@@ -68,6 +72,13 @@ public:
     */
     void                bufferRateLimit(UInt16 writeLimit, double timeLimit);
 
+    //! Set the batch window
+    /*!
+    The buffer thread sends the buffer once \p lines lines are waiting
+    or once the oldest has waited \p seconds, whichever comes first.
+    */
+    void                bufferBatch(UInt16 lines, double seconds);
+
     //! Send the buffer
     /*!
     Sends a chunk of the buffer to the IPC server, normally called
@@ -85,35 +96,48 @@ public:
     Returns the maximum size of the buffer.
     */
     UInt16                bufferMaxSize() const;
+
+    //! Get the number of dropped lines
+    /*!
+    Returns the number of lines dropped since the outputter was created.
+    */
+    UInt32                getDroppedLines() const;
+
+    //! Get the number of chunks sent
+    UInt32                getSentChunks() const;
     
     //@}
 
 private:
-    void                init();
     void                bufferThread(void*);
     String                getChunk(size_t count);
-    void                appendBuffer(const String& text);
+    bool                appendBuffer(const char* text);
+    double                getBatchWait();
     bool                isRunning();
 
 private:
-    typedef std::deque<String> Buffer;
+    typedef std::vector<String> Ring;
 
     IpcServer&            m_ipcServer;
-    Buffer                m_buffer;
+    Ring                m_ring;
+    size_t                m_ringHead;
+    size_t                m_ringCount;
+    double                m_oldestTime;
+    UInt32                m_dropped;
+    UInt32                m_droppedTotal;
+    UInt32                m_sentChunks;
     ArchMutex            m_bufferMutex;
-    bool                m_sending;
     Thread*                m_bufferThread;
     bool                m_running;
     ArchCond            m_notifyCond;
     ArchMutex            m_notifyMutex;
-    bool                m_bufferWaiting;
-    IArchMultithread::ThreadID
-                        m_bufferThreadId;
-    UInt16                m_bufferMaxSize;
+    bool                m_notified;
     UInt16                m_bufferRateWriteLimit;
     double                m_bufferRateTimeLimit;
     UInt16                m_bufferWriteCount;
     double                m_bufferRateStart;
+    UInt16                m_batchLines;
+    double                m_batchTime;
     EIpcClientType        m_clientType;
     ArchMutex            m_runningMutex;
 };
@@ -0,0 +1,98 @@
+/*
+ * synergy -- mouse and keyboard sharing utility
+ * Copyright (C) 2016 Symless Ltd.
+ * 
+ * This package is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * found in the file LICENSE that should have accompanied this file.
+ * 
+ * This package is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mt/WorkerPool.h"
+
+#include "mt/CondVar.h"
+#include "mt/Lock.h"
+#include "mt/Mutex.h"
+#include "mt/Thread.h"
+#include "base/IJob.h"
+#include "base/TMethodJob.h"
+
+//
+// WorkerPool
+//
+
+WorkerPool::WorkerPool(int numThreads) :
+    m_mutex(new Mutex),
+    m_jobAdded(new CondVarBase(m_mutex)),
+    m_stopping(false)
+{
+    assert(numThreads > 0);
+
+    for (int i = 0; i < numThreads; ++i) {
+        m_threads.push_back(new Thread(new TMethodJob<WorkerPool>(
+                                this, &WorkerPool::workerThread)));
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    // let the running jobs finish rather than cancelling them part way
+    {
+        Lock lock(m_mutex);
+        m_stopping = true;
+        m_jobAdded->broadcast();
+    }
+    for (ThreadList::iterator i = m_threads.begin();
+                        i != m_threads.end(); ++i) {
+        (*i)->wait();
+        delete *i;
+    }
+
+    for (JobQueue::iterator i = m_jobs.begin(); i != m_jobs.end(); ++i) {
+        delete *i;
+    }
+    delete m_jobAdded;
+    delete m_mutex;
+}
+
+void
+WorkerPool::addJob(IJob* adoptedJob)
+{
+    assert(adoptedJob != NULL);
+
+    Lock lock(m_mutex);
+    m_jobs.push_back(adoptedJob);
+    m_jobAdded->signal();
+}
+
+IJob*
+WorkerPool::getJob()
+{
+    Lock lock(m_mutex);
+    while (m_jobs.empty() && !m_stopping) {
+        m_jobAdded->wait();
+    }
+    if (m_stopping) {
+        return NULL;
+    }
+
+    IJob* job = m_jobs.front();
+    m_jobs.pop_front();
+    return job;
+}
+
+void
+WorkerPool::workerThread(void*)
+{
+    for (IJob* job = getJob(); job != NULL; job = getJob()) {
+        job->run();
+        delete job;
+    }
+}
@@ -0,0 +1,72 @@
+/*
+ * synergy -- mouse and keyboard sharing utility
+ * Copyright (C) 2016 Symless Ltd.
+ * 
+ * This package is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * found in the file LICENSE that should have accompanied this file.
+ * 
+ * This package is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "common/stddeque.h"
+#include "common/stdvector.h"
+
+class IJob;
+class Mutex;
+class CondVarBase;
+class Thread;
+
+//! Worker thread pool
+/*!
+Runs jobs on a fixed number of threads, in the order they were added.
+Nothing is returned to the caller;  a job that has a result should
+add an event for it.
+*/
+class WorkerPool {
+public:
+    //! Start \p numThreads threads
+    WorkerPool(int numThreads);
+    //! Stop the threads
+    /*!
+    Waits for the jobs that are running to finish.  Jobs that haven't
+    started yet are discarded.
+    */
+    ~WorkerPool();
+
+    //! @name manipulators
+    //@{
+
+    //! Add a job
+    /*!
+    Adds \p adoptedJob to be run by the first thread that's free.
+    */
+    void                addJob(IJob* adoptedJob);
+
+    //@}
+
+private:
+    // returns the next job to run, waiting for one if necessary.
+    // returns NULL when the pool is stopping.
+    IJob*                getJob();
+
+    void                workerThread(void*);
+
+private:
+    typedef std::deque<IJob*> JobQueue;
+    typedef std::vector<Thread*> ThreadList;
+
+    Mutex*                m_mutex;
+    CondVarBase*        m_jobAdded;
+    JobQueue            m_jobs;
+    bool                m_stopping;
+    ThreadList            m_threads;
+};
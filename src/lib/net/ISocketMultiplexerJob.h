@@ -44,6 +44,11 @@ public:
     socket by calling \c addSocket() or \c removeSocket() on the
     multiplexer.  It must instead return the new job.  It can,
     however, add or remove jobs for other sockets.
+
+    A job that returns itself may have changed what it's interested
+    in;  the multiplexer checks \c isReadable() and \c isWritable()
+    again after every call.  Changing interest in place is much cheaper
+    than returning a new job.
     */
     virtual ISocketMultiplexerJob*
                         run(bool readable, bool writable, bool error) = 0;
@@ -0,0 +1,267 @@
+/*
+ * synergy -- mouse and keyboard sharing utility
+ * Copyright (C) 2015-2016 Symless Ltd.
+ *
+ * This package is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * found in the file LICENSE that should have accompanied this file.
+ *
+ * This package is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "net/SecureContext.h"
+
+#include "mt/Lock.h"
+#include "base/Log.h"
+
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <fstream>
+
+#define MAX_ERROR_SIZE 65535
+
+// names the server's sessions so it only resumes its own
+static const unsigned char s_sessionIdContext[] = "synergy";
+
+//
+// SecureContext
+//
+
+SecureContext::SecureContext(bool server) :
+    m_server(server),
+    m_context(NULL),
+    m_session(NULL),
+    m_handshakes(0),
+    m_resumedHandshakes(0),
+    m_handshakeTime(0.0)
+{
+    SSL_library_init();
+
+    const SSL_METHOD* method;
+
+    // load & register all cryptos, etc.
+    OpenSSL_add_all_algorithms();
+
+    // load all error messages
+    SSL_load_error_strings();
+
+    if (CLOG->getFilter() >= kINFO) {
+        showSecureLibInfo();
+    }
+
+    // SSLv23_method uses TLSv1, with the ability to fall back to SSLv3
+    if (server) {
+        method = SSLv23_server_method();
+    }
+    else {
+        method = SSLv23_client_method();
+    }
+
+    // create new context from method
+    SSL_METHOD* m = const_cast<SSL_METHOD*>(method);
+    m_context = SSL_CTX_new(m);
+
+    if (m_context == NULL) {
+        showError(NULL);
+        return;
+    }
+
+    // drop SSLv3 support
+    SSL_CTX_set_options(m_context, SSL_OP_NO_SSLv3);
+
+    if (server) {
+        // the server keeps sessions in its cache and hands out tickets
+        // for them, both of which only work since every accepted
+        // connection shares this context
+        SSL_CTX_set_session_id_context(m_context, s_sessionIdContext,
+                                    sizeof(s_sessionIdContext) - 1);
+    }
+    else {
+        // the client keeps the newest session itself.  with TLSv1.3 the
+        // server only sends it after the handshake so it has to be
+        // caught as it arrives.
+        SSL_CTX_set_app_data(m_context, this);
+        SSL_CTX_set_session_cache_mode(m_context,
+                                    SSL_SESS_CACHE_CLIENT |
+                                    SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(m_context, &SecureContext::handleNewSession);
+    }
+}
+
+SecureContext::~SecureContext()
+{
+    if (m_session != NULL) {
+        SSL_SESSION_free(m_session);
+    }
+
+    // sockets hold their own references to the context
+    if (m_context != NULL) {
+        SSL_CTX_set_app_data(m_context, NULL);
+        SSL_CTX_free(m_context);
+    }
+}
+
+bool
+SecureContext::loadCertificates(const String& filename)
+{
+    if (m_context == NULL) {
+        return false;
+    }
+
+    if (filename.empty()) {
+        showError("ssl certificate is not specified");
+        return false;
+    }
+    else {
+        std::ifstream file(filename.c_str());
+        bool exist = file.good();
+        file.close();
+
+        if (!exist) {
+            String errorMsg("ssl certificate doesn't exist: ");
+            errorMsg.append(filename);
+            showError(errorMsg.c_str());
+            return false;
+        }
+    }
+
+    int r = 0;
+    r = SSL_CTX_use_certificate_file(m_context, filename.c_str(), SSL_FILETYPE_PEM);
+    if (r <= 0) {
+        showError("could not use ssl certificate");
+        return false;
+    }
+
+    r = SSL_CTX_use_PrivateKey_file(m_context, filename.c_str(), SSL_FILETYPE_PEM);
+    if (r <= 0) {
+        showError("could not use ssl private key");
+        return false;
+    }
+
+    r = SSL_CTX_check_private_key(m_context);
+    if (!r) {
+        showError("could not verify ssl private key");
+        return false;
+    }
+
+    return true;
+}
+
+void
+SecureContext::addHandshake(double seconds, bool resumed)
+{
+    UInt32 handshakes;
+    UInt32 resumedHandshakes;
+    double average;
+    {
+        Lock lock(&m_mutex);
+        ++m_handshakes;
+        if (resumed) {
+            ++m_resumedHandshakes;
+        }
+        m_handshakeTime  += seconds;
+        handshakes        = m_handshakes;
+        resumedHandshakes = m_resumedHandshakes;
+        average           = m_handshakeTime / m_handshakes;
+    }
+
+    LOG((CLOG_INFO "secure handshake %s in %.1f ms",
+                resumed ? "resumed session" : "completed",
+                seconds * 1000.0));
+    LOG((CLOG_DEBUG "secure handshakes: %d, resumed: %d, average time: %.1f ms",
+                handshakes, resumedHandshakes, average * 1000.0));
+}
+
+SSL_CTX*
+SecureContext::getContext() const
+{
+    return m_context;
+}
+
+SSL_SESSION*
+SecureContext::getSession() const
+{
+    Lock lock(&m_mutex);
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+    if (m_session == NULL || !SSL_SESSION_is_resumable(m_session)) {
+        return NULL;
+    }
+    SSL_SESSION_up_ref(m_session);
+#else
+    // before 1.1 a session can be resumed once it has an id
+    if (m_session == NULL || m_session->session_id_length == 0) {
+        return NULL;
+    }
+    CRYPTO_add(&m_session->references, 1, CRYPTO_LOCK_SSL_SESSION);
+#endif
+    return m_session;
+}
+
+UInt32
+SecureContext::getHandshakes() const
+{
+    Lock lock(&m_mutex);
+    return m_handshakes;
+}
+
+UInt32
+SecureContext::getResumedHandshakes() const
+{
+    Lock lock(&m_mutex);
+    return m_resumedHandshakes;
+}
+
+void
+SecureContext::setSession(SSL_SESSION* session)
+{
+    Lock lock(&m_mutex);
+    if (m_session != NULL) {
+        SSL_SESSION_free(m_session);
+    }
+    m_session = session;
+}
+
+int
+SecureContext::handleNewSession(SSL* ssl, SSL_SESSION* session)
+{
+    SecureContext* context = static_cast<SecureContext*>(
+                        SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+    if (context == NULL) {
+        return 0;
+    }
+
+    // keep the reference we're given
+    context->setSession(session);
+    return 1;
+}
+
+void
+SecureContext::showSecureLibInfo()
+{
+    LOG((CLOG_INFO "%s",SSLeay_version(SSLEAY_VERSION)));
+    LOG((CLOG_DEBUG1 "openSSL : %s",SSLeay_version(SSLEAY_CFLAGS)));
+    LOG((CLOG_DEBUG1 "openSSL : %s",SSLeay_version(SSLEAY_BUILT_ON)));
+    LOG((CLOG_DEBUG1 "openSSL : %s",SSLeay_version(SSLEAY_PLATFORM)));
+    LOG((CLOG_DEBUG1 "%s",SSLeay_version(SSLEAY_DIR)));
+}
+
+void
+SecureContext::showError(const char* reason)
+{
+    if (reason != NULL) {
+        LOG((CLOG_ERR "%s", reason));
+    }
+
+    unsigned long e = ERR_get_error();
+    if (e != 0) {
+        char error[MAX_ERROR_SIZE];
+        ERR_error_string_n(e, error, MAX_ERROR_SIZE);
+        LOG((CLOG_ERR "%s", error));
+    }
+}
@@ -0,0 +1,97 @@
+/*
+ * synergy -- mouse and keyboard sharing utility
+ * Copyright (C) 2015-2016 Symless Ltd.
+ *
+ * This package is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * found in the file LICENSE that should have accompanied this file.
+ *
+ * This package is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "mt/Mutex.h"
+#include "base/String.h"
+#include "common/basic_types.h"
+
+typedef struct ssl_st SSL;
+typedef struct ssl_ctx_st SSL_CTX;
+typedef struct ssl_session_st SSL_SESSION;
+
+//! Shared SSL state
+/*!
+Holds the SSL context shared by all the secure sockets on one end of
+a connection:  every connection a server accepts or every connection a
+client makes.  The certificate is loaded once and sessions are kept so
+that a reconnecting client can resume its last session rather than do
+a full handshake.  The context must outlive the sockets using it.
+*/
+class SecureContext {
+public:
+    SecureContext(bool server);
+    ~SecureContext();
+
+    //! @name manipulators
+    //@{
+
+    //! Load certificate
+    /*!
+    Loads the certificate and private key from the PEM file \c filename.
+    Only a server needs to.  Returns false on failure.
+    */
+    bool                loadCertificates(const String& filename);
+
+    //! Note a handshake
+    /*!
+    Called by a secure socket once its handshake has finished, taking
+    \c seconds, and whether it \c resumed an earlier session.
+    */
+    void                addHandshake(double seconds, bool resumed);
+
+    //@}
+    //! @name accessors
+    //@{
+
+    //! Get the openssl context
+    /*!
+    Returns the context, or NULL if it couldn't be created.
+    */
+    SSL_CTX*            getContext() const;
+
+    //! Get the session to resume
+    /*!
+    Returns a new reference to the session a client should try to
+    resume, or NULL if there isn't one.  The caller must free it.
+    */
+    SSL_SESSION*        getSession() const;
+
+    //! Get the number of handshakes
+    UInt32                getHandshakes() const;
+
+    //! Get the number of resumed handshakes
+    UInt32                getResumedHandshakes() const;
+
+    //@}
+
+private:
+    void                setSession(SSL_SESSION*);
+    static int            handleNewSession(SSL*, SSL_SESSION*);
+    static void            showSecureLibInfo();
+    static void            showError(const char* reason);
+
+private:
+    bool                m_server;
+    SSL_CTX*            m_context;
+    SSL_SESSION*        m_session;
+    Mutex                m_mutex;
+    UInt32                m_handshakes;
+    UInt32                m_resumedHandshakes;
+    double                m_handshakeTime;
+};
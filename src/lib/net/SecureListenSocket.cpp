@@ -18,6 +18,7 @@
 #include "SecureListenSocket.h"
 
 #include "SecureSocket.h"
+#include "net/SecureContext.h"
 #include "net/NetworkAddress.h"
 #include "net/SocketMultiplexer.h"
 #include "net/TSocketMultiplexerMethodJob.h"
@@ -33,7 +34,8 @@ static const char s_certificateFilename[] = { "Synergy.pem" };
 SecureListenSocket::SecureListenSocket(
         IEventQueue* events,
         SocketMultiplexer* socketMultiplexer) :
-    TCPListenSocket(events, socketMultiplexer)
+    TCPListenSocket(events, socketMultiplexer),
+    m_context(NULL)
 {
 }
 
@@ -44,6 +46,7 @@ SecureListenSocket::~SecureListenSocket()
         delete *it;
     }
     m_secureSocketSet.clear();
+    delete m_context;
 }
 
 IDataSocket*
@@ -55,23 +58,29 @@ SecureListenSocket::accept()
                         m_events,
                         m_socketMultiplexer,
                         ARCH->acceptSocket(m_socket, NULL));
-        socket->initSsl(true);
 
         if (socket != NULL) {
             setListeningJob();
         }
 
-        String certificateFilename = synergy::string::sprintf("%s/%s/%s",
+        // every accepted connection shares one context so the certificate
+        // is only loaded once and clients can resume their sessions
+        if (m_context == NULL) {
+            String certificateFilename = synergy::string::sprintf("%s/%s/%s",
                                         ARCH->getProfileDirectory().c_str(),
                                         s_certificateDir,
                                         s_certificateFilename);
 
-        bool loaded = socket->loadCertificates(certificateFilename);
-        if (!loaded) {
-            delete socket;
-            return NULL;
+            m_context = new SecureContext(true);
+            if (!m_context->loadCertificates(certificateFilename)) {
+                delete m_context;
+                m_context = NULL;
+                delete socket;
+                return NULL;
+            }
         }
 
+        socket->initSsl(m_context);
         socket->secureAccept();
 
         m_secureSocketSet.insert(socket);
@@ -23,6 +23,7 @@
 class IEventQueue;
 class SocketMultiplexer;
 class IDataSocket;
+class SecureContext;
 
 class SecureListenSocket : public TCPListenSocket{
 public:
@@ -38,4 +39,5 @@ private:
     typedef std::set<IDataSocket*> SecureSocketSet;
 
     SecureSocketSet        m_secureSocketSet;
+    SecureContext*        m_context;
 };
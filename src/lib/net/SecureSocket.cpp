@@ -17,6 +17,8 @@
 
 #include "SecureSocket.h"
 
+#include "net/SecureContext.h"
+
 #include "net/TSocketMultiplexerMethodJob.h"
 #include "base/TMethodEventJob.h"
 #include "net/TCPSocket.h"
@@ -37,7 +39,8 @@
 
 #define MAX_ERROR_SIZE 65535
 
-static const float s_retryDelay = 0.01f;
+// how long a handshake may take before the connection is dropped
+static const double s_handshakeTimeout = 30.0;
 
 enum {
     kMsgSize = 128
@@ -59,7 +62,11 @@ SecureSocket::SecureSocket(
     TCPSocket(events, socketMultiplexer),
     m_ssl(nullptr),
     m_secureReady(false),
-    m_fatal(false)
+    m_fatal(false),
+    m_writeRetrySize(0),
+    m_handshakeTimer(NULL),
+    m_secureContext(NULL),
+    m_handshakeStart(0.0)
 {
 }
 
@@ -70,13 +77,27 @@ SecureSocket::SecureSocket(
     TCPSocket(events, socketMultiplexer, socket),
     m_ssl(nullptr),
     m_secureReady(false),
-    m_fatal(false)
+    m_fatal(false),
+    m_writeRetrySize(0),
+    m_handshakeTimer(NULL),
+    m_secureContext(NULL),
+    m_handshakeStart(0.0)
 {
 }
 
 SecureSocket::~SecureSocket()
 {
     isFatal(true);
+
+    // the multiplexer is done with us once the job is removed
+    setJob(NULL);
+    stopHandshakeTimer();
+
+    // a socket can be deleted before initSsl()
+    if (m_ssl == NULL) {
+        return;
+    }
+
     if (m_ssl->m_ssl != NULL) {
         SSL_shutdown(m_ssl->m_ssl);
 
@@ -87,7 +108,6 @@ SecureSocket::~SecureSocket()
         SSL_CTX_free(m_ssl->m_context);
         m_ssl->m_context = NULL;
     }
-    ARCH->sleep(1);
     delete m_ssl;
 }
 
@@ -127,6 +147,8 @@ SecureSocket::newJob()
 void
 SecureSocket::secureConnect()
 {
+    m_handshakeStart = ARCH->time();
+    startHandshakeTimer();
     setJob(new TSocketMultiplexerMethodJob<SecureSocket>(
                     this, &SecureSocket::serviceConnect,
                     getSocket(), isReadable(), isWritable()));
@@ -135,6 +157,8 @@ SecureSocket::secureConnect()
 void
 SecureSocket::secureAccept()
 {
+    m_handshakeStart = ARCH->time();
+    startHandshakeTimer();
     setJob(new TSocketMultiplexerMethodJob<SecureSocket>(
                     this, &SecureSocket::serviceAccept,
                     getSocket(), isReadable(), isWritable()));
@@ -143,8 +167,8 @@ SecureSocket::secureAccept()
 TCPSocket::EJobResult
 SecureSocket::doRead()
 {
-    static UInt8 buffer[4096];
-    memset(buffer, 0, sizeof(buffer));
+    // big enough for all the plaintext in one record
+    UInt8 buffer[16384];
     int bytesRead = 0;
     int status = 0;
 
@@ -198,55 +222,39 @@ SecureSocket::doRead()
 TCPSocket::EJobResult
 SecureSocket::doWrite()
 {
-    static bool s_retry = false;
-    static int s_retrySize = 0;
-    static void* s_staticBuffer = NULL;
-
-    // write data
-    int bufferSize = 0;
-    int bytesWrote = 0;
-    int status = 0;
-    
-    if (s_retry) {
-        bufferSize = s_retrySize;
-    }
-    else {
-        bufferSize = m_outputBuffer.getSize();
-        s_staticBuffer = malloc(bufferSize);
-        memcpy(s_staticBuffer, m_outputBuffer.peek(bufferSize), bufferSize);
-    }
-    
-    if (bufferSize == 0) {
+    if (!isSecureReady()) {
         return kRetry;
     }
 
-    if (isSecureReady()) {
-        status = secureWrite(s_staticBuffer, bufferSize, bytesWrote);
-        if (status > 0) {
-            s_retry = false;
-            bufferSize = 0;
-            free(s_staticBuffer);
-            s_staticBuffer = NULL;
+    // hand each chunk of the output buffer to SSL_write() in place.  a
+    // write that wants a retry has to be retried with the same bytes,
+    // which stay at the front of the buffer until they're written.
+    bool wrote = false;
+    while (m_outputBuffer.getSize() > 0) {
+        UInt32 size = m_writeRetrySize;
+        if (size == 0 || size > m_outputBuffer.getSize()) {
+            size = m_outputBuffer.getHeadSize();
         }
-        else if (status < 0) {
+
+        int bytesWrote = 0;
+        int status = secureWrite(m_outputBuffer.peek(size),
+                                (int)size, bytesWrote);
+        if (status < 0) {
+            m_writeRetrySize = 0;
             return kBreak;
         }
         else if (status == 0) {
-            s_retry = true;
-            s_retrySize = bufferSize;
+            m_writeRetrySize = size;
             return kNew;
         }
-    }
-    else {
-        return kRetry;
-    }
-    
-    if (bytesWrote > 0) {
+
+        // with partial writes enabled this may be less than size
+        m_writeRetrySize = 0;
         discardWrittenData(bytesWrote);
-        return kNew;
+        wrote = true;
     }
 
-    return kRetry;
+    return wrote ? kNew : kRetry;
 }
 
 int
@@ -256,7 +264,7 @@ SecureSocket::secureRead(void* buffer, int size, int& read)
         LOG((CLOG_DEBUG2 "reading secure socket"));
         read = SSL_read(m_ssl->m_ssl, buffer, size);
         
-        static int retry;
+        int retry = 0;
 
         // Check result will cleanup the connection in the case of a fatal
         checkResult(read, retry);
@@ -283,7 +291,7 @@ SecureSocket::secureWrite(const void* buffer, int size, int& wrote)
 
         wrote = SSL_write(m_ssl->m_ssl, buffer, size);
         
-        static int retry;
+        int retry = 0;
 
         // Check result will cleanup the connection in the case of a fatal
         checkResult(wrote, retry);
@@ -309,91 +317,20 @@ SecureSocket::isSecureReady()
 }
 
 void
-SecureSocket::initSsl(bool server)
+SecureSocket::initSsl(SecureContext* context)
 {
+    m_secureContext = context;
+
+    // share the context, keeping it alive for as long as we use it
     m_ssl = new Ssl();
-    m_ssl->m_context = NULL;
+    m_ssl->m_context = context->getContext();
     m_ssl->m_ssl = NULL;
-
-    initContext(server);
-}
-
-bool
-SecureSocket::loadCertificates(String& filename)
-{
-    if (filename.empty()) {
-        showError("ssl certificate is not specified");
-        return false;
-    }
-    else {
-        std::ifstream file(filename.c_str());
-        bool exist = file.good();
-        file.close();
-
-        if (!exist) {
-            String errorMsg("ssl certificate doesn't exist: ");
-            errorMsg.append(filename);
-            showError(errorMsg.c_str());
-            return false;
-        }
-    }
-
-    int r = 0;
-    r = SSL_CTX_use_certificate_file(m_ssl->m_context, filename.c_str(), SSL_FILETYPE_PEM);
-    if (r <= 0) {
-        showError("could not use ssl certificate");
-        return false;
-    }
-
-    r = SSL_CTX_use_PrivateKey_file(m_ssl->m_context, filename.c_str(), SSL_FILETYPE_PEM);
-    if (r <= 0) {
-        showError("could not use ssl private key");
-        return false;
-    }
-
-    r = SSL_CTX_check_private_key(m_ssl->m_context);
-    if (!r) {
-        showError("could not verify ssl private key");
-        return false;
-    }
-
-    return true;
-}
-
-void
-SecureSocket::initContext(bool server)
-{
-    SSL_library_init();
-
-    const SSL_METHOD* method;
- 
-    // load & register all cryptos, etc.
-    OpenSSL_add_all_algorithms();
-
-    // load all error messages
-    SSL_load_error_strings();
-
-    if (CLOG->getFilter() >= kINFO) {
-        showSecureLibInfo();
-    }
-
-    // SSLv23_method uses TLSv1, with the ability to fall back to SSLv3
-    if (server) {
-        method = SSLv23_server_method();
-    }
-    else {
-        method = SSLv23_client_method();
-    }
-    
-    // create new context from method
-    SSL_METHOD* m = const_cast<SSL_METHOD*>(method);
-    m_ssl->m_context = SSL_CTX_new(m);
-
-    // drop SSLv3 support
-    SSL_CTX_set_options(m_ssl->m_context, SSL_OP_NO_SSLv3);
-
-    if (m_ssl->m_context == NULL) {
-        showError();
+    if (m_ssl->m_context != NULL) {
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+        SSL_CTX_up_ref(m_ssl->m_context);
+#else
+        CRYPTO_add(&m_ssl->m_context->references, 1, CRYPTO_LOCK_SSL_CTX);
+#endif
     }
 }
 
@@ -404,6 +341,20 @@ SecureSocket::createSSL()
     // get new SSL state with context
     if (m_ssl->m_ssl == NULL) {
         m_ssl->m_ssl = SSL_new(m_ssl->m_context);
+
+        // try to resume the last session rather than start a new one
+        SSL_SESSION* session = m_secureContext->getSession();
+        if (session != NULL) {
+            SSL_set_session(m_ssl->m_ssl, session);
+            SSL_SESSION_free(session);
+        }
+
+        // let SSL_write() return once a record has gone out rather than
+        // only once everything has, and let a retry pass the same bytes
+        // from a different address since the output buffer may have
+        // grown in between.
+        SSL_set_mode(m_ssl->m_ssl, SSL_MODE_ENABLE_PARTIAL_WRITE |
+                                    SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
     }
 }
 
@@ -418,17 +369,15 @@ SecureSocket::secureAccept(int socket)
     LOG((CLOG_DEBUG2 "accepting secure socket"));
     int r = SSL_accept(m_ssl->m_ssl);
     
-    static int retry;
+    int retry = 0;
 
     checkResult(r, retry);
 
     if (isFatal()) {
-        // tell user and sleep so the socket isn't hammered.
+        // tell user
         LOG((CLOG_ERR "failed to accept secure socket"));
         LOG((CLOG_INFO "client connection may not be secure"));
         m_secureReady = false;
-        ARCH->sleep(1);
-        retry = 0;
         return -1; // Failed, error out
     }
 
@@ -436,6 +385,8 @@ SecureSocket::secureAccept(int socket)
     if (retry == 0) {
         m_secureReady = true;
         LOG((CLOG_INFO "accepted secure socket"));
+        m_secureContext->addHandshake(ARCH->time() - m_handshakeStart,
+                                SSL_session_reused(m_ssl->m_ssl) != 0);
         if (CLOG->getFilter() >= kDEBUG1) {
             showSecureCipherInfo();
         }
@@ -447,7 +398,6 @@ SecureSocket::secureAccept(int socket)
     if (retry > 0) {
         LOG((CLOG_DEBUG2 "retry accepting secure socket"));
         m_secureReady = false;
-        ARCH->sleep(s_retryDelay);
         return 0;
     }
 
@@ -467,13 +417,12 @@ SecureSocket::secureConnect(int socket)
     LOG((CLOG_DEBUG2 "connecting secure socket"));
     int r = SSL_connect(m_ssl->m_ssl);
     
-    static int retry;
+    int retry = 0;
 
     checkResult(r, retry);
 
     if (isFatal()) {
         LOG((CLOG_ERR "failed to connect secure socket"));
-        retry = 0;
         return -1;
     }
 
@@ -481,11 +430,9 @@ SecureSocket::secureConnect(int socket)
     if (retry > 0) {
         LOG((CLOG_DEBUG2 "retry connect secure socket"));
         m_secureReady = false;
-        ARCH->sleep(s_retryDelay);
         return 0;
     }
 
-    retry = 0;
     // No error, set ready, process and return ok
     m_secureReady = true;
     if (verifyCertFingerprint()) {
@@ -501,6 +448,8 @@ SecureSocket::secureConnect(int socket)
         return -1; // Fingerprint failed, error
     }
     LOG((CLOG_DEBUG2 "connected secure socket"));
+    m_secureContext->addHandshake(ARCH->time() - m_handshakeStart,
+                                SSL_session_reused(m_ssl->m_ssl) != 0);
     if (CLOG->getFilter() >= kDEBUG1) {
         showSecureCipherInfo();
     }
@@ -736,14 +685,13 @@ SecureSocket::serviceConnect(ISocketMultiplexerJob* job,
 
     // If status > 0, success
     if (status > 0) {
+        stopHandshakeTimer();
         sendEvent(m_events->forIDataSocket().secureConnected());
         return newJob();
     }
 
     // Retry case
-    return new TSocketMultiplexerMethodJob<SecureSocket>(
-            this, &SecureSocket::serviceConnect,
-            getSocket(), isReadable(), isWritable());
+    return retryHandshake(job);
 }
 
 ISocketMultiplexerJob*
@@ -765,14 +713,66 @@ SecureSocket::serviceAccept(ISocketMultiplexerJob* job,
 
     // If status > 0, success
     if (status > 0) {
+        stopHandshakeTimer();
         sendEvent(m_events->forClientListener().accepted());
         return newJob();
     }
 
     // Retry case
-    return new TSocketMultiplexerMethodJob<SecureSocket>(
-            this, &SecureSocket::serviceAccept,
-            getSocket(), isReadable(), isWritable());
+    return retryHandshake(job);
+}
+
+ISocketMultiplexerJob*
+SecureSocket::retryHandshake(ISocketMultiplexerJob* job)
+{
+    // note -- must have m_mutex locked on entry
+
+    // run again only when the socket can do what openssl is waiting
+    // for.  it only ever waits for one thing and, since the socket is
+    // almost always writable, waiting for both would spin.
+    bool wantWrite = (SSL_want_write(m_ssl->m_ssl) != 0);
+    static_cast<TSocketMultiplexerMethodJob<SecureSocket>*>(job)->
+                                    setInterest(!wantWrite, wantWrite);
+    return job;
+}
+
+void
+SecureSocket::startHandshakeTimer()
+{
+    stopHandshakeTimer();
+    m_handshakeTimer = m_events->newOneShotTimer(s_handshakeTimeout, NULL);
+    m_events->adoptHandler(Event::kTimer, m_handshakeTimer,
+                new TMethodEventJob<SecureSocket>(this,
+                        &SecureSocket::handleHandshakeTimeout));
+}
+
+void
+SecureSocket::stopHandshakeTimer()
+{
+    if (m_handshakeTimer != NULL) {
+        m_events->removeHandler(Event::kTimer, m_handshakeTimer);
+        m_events->deleteTimer(m_handshakeTimer);
+        m_handshakeTimer = NULL;
+    }
+}
+
+void
+SecureSocket::handleHandshakeTimeout(const Event&, void*)
+{
+    {
+        // the handshake stops the timer under the same lock
+        Lock lock(&getMutex());
+        stopHandshakeTimer();
+        if (isSecureReady() || isFatal()) {
+            return;
+        }
+        LOG((CLOG_ERR "secure socket handshake timed out"));
+        isFatal(true);
+        disconnect();
+    }
+
+    // stop servicing the handshake
+    setJob(NULL);
 }
 
 void
@@ -825,17 +825,6 @@ SecureSocket::showSecureCipherInfo()
     return;
 }
 
-void
-SecureSocket::showSecureLibInfo()
-{
-    LOG((CLOG_INFO "%s",SSLeay_version(SSLEAY_VERSION)));
-    LOG((CLOG_DEBUG1 "openSSL : %s",SSLeay_version(SSLEAY_CFLAGS)));
-    LOG((CLOG_DEBUG1 "openSSL : %s",SSLeay_version(SSLEAY_BUILT_ON)));
-    LOG((CLOG_DEBUG1 "openSSL : %s",SSLeay_version(SSLEAY_PLATFORM)));
-    LOG((CLOG_DEBUG1 "%s",SSLeay_version(SSLEAY_DIR)));
-    return;
-}
-
 void
 SecureSocket::showSecureConnectInfo()
 {
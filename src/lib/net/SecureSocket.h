@@ -23,6 +23,8 @@
 class IEventQueue;
 class SocketMultiplexer;
 class ISocketMultiplexerJob;
+class EventQueueTimer;
+class SecureContext;
 
 struct Ssl;
 
@@ -55,12 +57,10 @@ public:
     int                    secureWrite(const void* buffer, int size, int& wrote);
     EJobResult            doRead();
     EJobResult            doWrite();
-    void                initSsl(bool server);
-    bool                loadCertificates(String& CertFile);
+    void                initSsl(SecureContext* context);
 
 private:
     // SSL
-    void                initContext(bool server);
     void                createSSL();
     int                    secureAccept(int s);
     int                    secureConnect(int s);
@@ -82,8 +82,14 @@ private:
                         serviceAccept(ISocketMultiplexerJob*,
                             bool, bool, bool);
 
+    ISocketMultiplexerJob*
+                        retryHandshake(ISocketMultiplexerJob*);
+
+    void                startHandshakeTimer();
+    void                stopHandshakeTimer();
+    void                handleHandshakeTimeout(const Event&, void*);
+
     void                showSecureConnectInfo();
-    void                showSecureLibInfo();
     void                showSecureCipherInfo();
     
     void                handleTCPConnected(const Event& event, void*);
@@ -92,4 +98,17 @@ private:
     Ssl*                m_ssl;
     bool                m_secureReady;
     bool                m_fatal;
+
+    // size of the last write that SSL_write() wants retried, or 0
+    UInt32                m_writeRetrySize;
+
+    // drops the connection if the handshake doesn't finish in time
+    EventQueueTimer*    m_handshakeTimer;
+
+    // not owned.  whoever passes it to initSsl() must keep it alive
+    // until this socket is deleted: SecureListenSocket deletes the
+    // sockets it accepted before its context, and TCPSocketFactory
+    // must outlive the sockets it creates.
+    SecureContext*        m_secureContext;
+    double                m_handshakeStart;
 };
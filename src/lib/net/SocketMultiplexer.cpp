@@ -37,17 +37,22 @@ SocketMultiplexer::SocketMultiplexer() :
     m_mutex(new Mutex),
     m_thread(NULL),
     m_update(false),
-    m_jobsReady(new CondVar<bool>(m_mutex, false)),
-    m_jobListLock(new CondVar<bool>(m_mutex, false)),
-    m_jobListLockLocked(new CondVar<bool>(m_mutex, false)),
-    m_jobListLocker(NULL),
-    m_jobListLockLocker(NULL)
+    m_stopped(false),
+    m_changesReady(new CondVar<bool>(m_mutex, false)),
+    m_changesApplied(new CondVar<bool>(m_mutex, false)),
+    m_wakeup(false),
+    m_idle(false),
+    m_pollSet(NULL)
 {
-    // this pointer just has to be unique and not NULL.  it will
-    // never be dereferenced.  it's used to identify cursor nodes
-    // in the jobs list.
-    // TODO: Remove this evilness
-    m_cursorMark = reinterpret_cast<ISocketMultiplexerJob*>(this);
+    // use a persistent poll set if the platform has one.  otherwise
+    // the poll entries are rebuilt whenever the jobs change.
+    try {
+        m_pollSet = ARCH->newPollSet();
+    }
+    catch (XArchNetwork& e) {
+        LOG((CLOG_WARN "cannot create poll set, using poll: %s", e.what()));
+        m_pollSet = NULL;
+    }
 
     // start thread
     m_thread = new Thread(new TMethodJob<SocketMultiplexer>(
@@ -60,18 +65,22 @@ SocketMultiplexer::~SocketMultiplexer()
     m_thread->unblockPollSocket();
     m_thread->wait();
     delete m_thread;
-    delete m_jobsReady;
-    delete m_jobListLock;
-    delete m_jobListLockLocked;
-    delete m_jobListLocker;
-    delete m_jobListLockLocker;
-    delete m_mutex;
 
-    // clean up jobs
+    // pick up anything posted since the thread last looked then clean
+    // up the remaining jobs
+    applyChanges();
     for (SocketJobMap::iterator i = m_socketJobMap.begin();
                         i != m_socketJobMap.end(); ++i) {
-        delete *(i->second);
+        delete i->second.m_job;
+    }
+
+    if (m_pollSet != NULL) {
+        ARCH->closePollSet(m_pollSet);
     }
+
+    delete m_changesReady;
+    delete m_changesApplied;
+    delete m_mutex;
 }
 
 void
@@ -80,36 +89,7 @@ SocketMultiplexer::addSocket(ISocket* socket, ISocketMultiplexerJob* job)
     assert(socket != NULL);
     assert(job    != NULL);
 
-    // prevent other threads from locking the job list
-    lockJobListLock();
-
-    // break thread out of poll
-    m_thread->unblockPollSocket();
-
-    // lock the job list
-    lockJobList();
-
-    // insert/replace job
-    SocketJobMap::iterator i = m_socketJobMap.find(socket);
-    if (i == m_socketJobMap.end()) {
-        // we *must* put the job at the end so the order of jobs in
-        // the list continue to match the order of jobs in pfds in
-        // serviceThread().
-        JobCursor j = m_socketJobs.insert(m_socketJobs.end(), job);
-        m_update     = true;
-        m_socketJobMap.insert(std::make_pair(socket, j));
-    }
-    else {
-        JobCursor j = i->second;
-        if (*j != job) {
-            delete *j;
-            *j = job;
-        }
-        m_update = true;
-    }
-
-    // unlock the job list
-    unlockJobList();
+    postChange(socket, job, NULL);
 }
 
 void
@@ -117,236 +97,349 @@ SocketMultiplexer::removeSocket(ISocket* socket)
 {
     assert(socket != NULL);
 
-    // prevent other threads from locking the job list
-    lockJobListLock();
-
-    // break thread out of poll
-    m_thread->unblockPollSocket();
+    // a job removing a socket can't wait for the service thread since
+    // it's running on it.  the change is applied once the job returns
+    // but the socket's job mustn't run again in the meantime as the
+    // caller may be about to delete the socket.
+    if (Thread::getCurrentThread() == *m_thread) {
+        postChange(socket, NULL, NULL);
+        markRemoved(socket);
+        return;
+    }
 
-    // lock the job list
-    lockJobList();
+    // the caller is about to close the socket so wait until the job
+    // is gone
+    bool done = false;
+    postChange(socket, NULL, &done);
 
-    // remove job.  rather than removing it from the map we put NULL
-    // in the list instead so the order of jobs in the list continues
-    // to match the order of jobs in pfds in serviceThread().
-    SocketJobMap::iterator i = m_socketJobMap.find(socket);
-    if (i != m_socketJobMap.end()) {
-        if (*(i->second) != NULL) {
-            delete *(i->second);
-            *(i->second) = NULL;
-            m_update     = true;
-        }
+    Lock lock(m_mutex);
+    while (!done) {
+        m_changesApplied->wait();
     }
-
-    // unlock the job list
-    unlockJobList();
 }
 
 void
 SocketMultiplexer::serviceThread(void*)
 {
     std::vector<IArchNetwork::PollEntry> pfds;
-    IArchNetwork::PollEntry pfd;
+    std::vector<IArchNetwork::PollSetEntry> results;
 
     // service the connections
     for (;;) {
         Thread::testCancel();
 
-        // wait until there are jobs to handle
-        {
-            Lock lock(m_mutex);
-            while (!(bool)*m_jobsReady) {
-                m_jobsReady->wait();
-            }
-        }
+        applyChanges();
 
-        // lock the job list
-        lockJobListLock();
-        lockJobList();
-
-        // collect poll entries
-        if (m_update) {
-            m_update = false;
-            pfds.clear();
-            pfds.reserve(m_socketJobMap.size());
-
-            JobCursor cursor    = newCursor();
-            JobCursor jobCursor = nextCursor(cursor);
-            while (jobCursor != m_socketJobs.end()) {
-                ISocketMultiplexerJob* job = *jobCursor;
-                if (job != NULL) {
-                    pfd.m_socket = job->getSocket();
-                    pfd.m_events = 0;
-                    if (job->isReadable()) {
-                        pfd.m_events |= IArchNetwork::kPOLLIN;
-                    }
-                    if (job->isWritable()) {
-                        pfd.m_events |= IArchNetwork::kPOLLOUT;
-                    }
-                    pfds.push_back(pfd);
-                }                
-                jobCursor = nextCursor(cursor);
-            }
-            deleteCursor(cursor);
+        if (m_pollSet != NULL) {
+            servicePollSet(results);
         }
-
-        int status;
-        try {
-            // check for status
-            if (!pfds.empty()) {
-                status = ARCH->pollSocket(&pfds[0], (int)pfds.size(), -1);
-            }
-            else {
-                status = 0;
-            }
-        }
-        catch (XArchNetwork& e) {
-            LOG((CLOG_WARN "error in socket multiplexer: %s", e.what()));
-            status = 0;
+        else {
+            servicePoll(pfds);
         }
 
-        if (status != 0) {
-            // iterate over socket jobs, invoking each and saving the
-            // new job.
-            UInt32 i             = 0;
-            JobCursor cursor    = newCursor();
-            JobCursor jobCursor = nextCursor(cursor);
-            while (i < pfds.size() && jobCursor != m_socketJobs.end()) {
-                if (*jobCursor != NULL) {
-                    // get poll state
-                    unsigned short revents = pfds[i].m_revents;
-                    bool read  = ((revents & IArchNetwork::kPOLLIN) != 0);
-                    bool write = ((revents & IArchNetwork::kPOLLOUT) != 0);
-                    bool error = ((revents & (IArchNetwork::kPOLLERR |
-                                              IArchNetwork::kPOLLNVAL)) != 0);
-
-                    // run job
-                    ISocketMultiplexerJob* job    = *jobCursor;
-                    ISocketMultiplexerJob* newJob = job->run(read, write, error);
-
-                    // save job, if different
-                    if (newJob != job) {
-                        Lock lock(m_mutex);
-                        delete job;
-                        *jobCursor = newJob;
-                        m_update   = true;
-                    }
-                    ++i;
-                }
+        if (m_stopped) {
+            removeStoppedJobs();
+        }
+    }
+}
 
-                // next job
-                jobCursor = nextCursor(cursor);
-            }
-            deleteCursor(cursor);
+void
+SocketMultiplexer::postChange(ISocket* socket,
+                ISocketMultiplexerJob* job, bool* done)
+{
+    bool wakeup;
+    {
+        Lock lock(m_mutex);
+
+        // a socket re-adds its job each time it has something to
+        // write.  if that's already waiting to be applied then the
+        // service thread will pick up the job's new interest anyway.
+        if (done == NULL && job != NULL && !m_changes.empty() &&
+            m_changes.back().m_socket == socket &&
+            m_changes.back().m_job    == job) {
+            return;
         }
 
-        // delete any removed socket jobs
-        for (SocketJobMap::iterator i = m_socketJobMap.begin();
-                            i != m_socketJobMap.end();) {
-            if (*(i->second) == NULL) {
-                m_socketJobs.erase(i->second);
-                m_socketJobMap.erase(i++);
-                m_update = true;
-            }
-            else {
-                ++i;
+        Change change;
+        change.m_socket = socket;
+        change.m_job    = job;
+        change.m_done   = done;
+        m_changes.push_back(change);
+
+        // only the first change after the service thread last looked
+        // needs to wake it
+        wakeup = !m_wakeup;
+        if (wakeup) {
+            m_wakeup = true;
+            if (m_idle) {
+                m_changesReady->signal();
             }
         }
+    }
 
-        // unlock the job list
-        unlockJobList();
+    if (wakeup) {
+        m_thread->unblockPollSocket();
     }
 }
 
-SocketMultiplexer::JobCursor
-SocketMultiplexer::newCursor()
+void
+SocketMultiplexer::applyChanges()
 {
-    Lock lock(m_mutex);
-    return m_socketJobs.insert(m_socketJobs.begin(), m_cursorMark);
-}
+    // nothing to do unless something was posted.  the changes are
+    // swapped out so neither list is reallocated once it's grown.
+    if (!m_wakeup) {
+        return;
+    }
+    {
+        Lock lock(m_mutex);
+        m_wakeup = false;
+        m_applying.swap(m_changes);
+    }
 
-SocketMultiplexer::JobCursor
-SocketMultiplexer::nextCursor(JobCursor cursor)
-{
-    Lock lock(m_mutex);
-    JobCursor j = m_socketJobs.end();
-    JobCursor i = cursor;
-    while (++i != m_socketJobs.end()) {
-        if (*i != m_cursorMark) {
-            // found a real job (as opposed to a cursor)
-            j = i;
-
-            // move our cursor just past the job
-            m_socketJobs.splice(++i, m_socketJobs, cursor);
-            break;
+    for (ChangeList::iterator change = m_applying.begin();
+                        change != m_applying.end(); ++change) {
+        SocketJobMap::iterator i = m_socketJobMap.find(change->m_socket);
+        if (change->m_job != NULL) {
+            // insert/replace job
+            if (i == m_socketJobMap.end()) {
+                SocketJob socketJob;
+                socketJob.m_socket  = change->m_socket;
+                socketJob.m_job     = NULL;
+                socketJob.m_events  = 0;
+                socketJob.m_removed = false;
+                i = m_socketJobMap.insert(
+                            std::make_pair(change->m_socket, socketJob)).first;
+            }
+            setJob(i->second, change->m_job);
+        }
+        else if (i != m_socketJobMap.end()) {
+            // remove job
+            setJob(i->second, NULL);
+            m_socketJobMap.erase(i);
+            m_update = true;
+        }
+
+        if (change->m_done != NULL) {
+            Lock lock(m_mutex);
+            *change->m_done = true;
+            m_changesApplied->broadcast();
         }
     }
-    return j;
+    m_applying.clear();
 }
 
 void
-SocketMultiplexer::deleteCursor(JobCursor cursor)
+SocketMultiplexer::markRemoved(ISocket* socket)
 {
-    Lock lock(m_mutex);
-    m_socketJobs.erase(cursor);
+    SocketJobMap::iterator i = m_socketJobMap.find(socket);
+    if (i != m_socketJobMap.end()) {
+        i->second.m_removed = true;
+    }
 }
 
 void
-SocketMultiplexer::lockJobListLock()
+SocketMultiplexer::servicePollSet(
+                std::vector<IArchNetwork::PollSetEntry>& results)
 {
-    Lock lock(m_mutex);
+    // sockets are already in the poll set.  only their events are
+    // returned, each with the SocketJob it belongs to.  leave room
+    // for the unblock pipe too.
+    if (results.size() < m_socketJobMap.size() + 1) {
+        results.resize(m_socketJobMap.size() + 1);
+    }
 
-    // wait for the lock on the lock
-    while (*m_jobListLockLocked) {
-        m_jobListLockLocked->wait();
+    int n;
+    try {
+        n = ARCH->waitPollSet(m_pollSet,
+                            &results[0], (int)results.size(), -1);
+    }
+    catch (XArchNetwork& e) {
+        LOG((CLOG_WARN "error in socket multiplexer: %s", e.what()));
+        n = 0;
     }
 
-    // take ownership of the lock on the lock
-    *m_jobListLockLocked = true;
-    m_jobListLockLocker  = new Thread(Thread::getCurrentThread());
+    for (int i = 0; i < n; ++i) {
+        SocketJob* socketJob = static_cast<SocketJob*>(results[i].m_data);
+        if (socketJob->m_job != NULL && !socketJob->m_removed) {
+            runJob(*socketJob, results[i].m_revents);
+        }
+    }
 }
 
 void
-SocketMultiplexer::lockJobList()
+SocketMultiplexer::servicePoll(std::vector<IArchNetwork::PollEntry>& pfds)
 {
-    Lock lock(m_mutex);
+    IArchNetwork::PollEntry pfd;
 
-    // make sure we're the one that called lockJobListLock()
-    assert(*m_jobListLockLocker == Thread::getCurrentThread());
+    // collect poll entries.  sockets whose job isn't interested in
+    // anything are left out, otherwise a hung up socket would keep
+    // waking us.
+    if (m_update) {
+        m_update = false;
+        pfds.clear();
+        m_pollJobs.clear();
 
-    // wait for the job list lock
-    while (*m_jobListLock) {
-        m_jobListLock->wait();
+        for (SocketJobMap::iterator i = m_socketJobMap.begin();
+                            i != m_socketJobMap.end(); ++i) {
+            SocketJob& socketJob       = i->second;
+            ISocketMultiplexerJob* job = socketJob.m_job;
+            socketJob.m_events         = 0;
+            if (job != NULL) {
+                if (job->isReadable()) {
+                    socketJob.m_events |= IArchNetwork::kPOLLIN;
+                }
+                if (job->isWritable()) {
+                    socketJob.m_events |= IArchNetwork::kPOLLOUT;
+                }
+            }
+            if (socketJob.m_events != 0) {
+                pfd.m_socket = job->getSocket();
+                pfd.m_events = socketJob.m_events;
+                pfds.push_back(pfd);
+                m_pollJobs.push_back(&socketJob);
+            }
+        }
     }
 
-    // take ownership of the lock
-    *m_jobListLock      = true;
-    m_jobListLocker     = m_jobListLockLocker;
-    m_jobListLockLocker = NULL;
+    // with nothing to poll, polling would return at once.  wait for a
+    // change instead.
+    if (pfds.empty()) {
+        Lock lock(m_mutex);
+        m_idle = true;
+        while (m_changes.empty()) {
+            m_changesReady->wait();
+        }
+        m_idle = false;
+        return;
+    }
+
+    int status;
+    try {
+        // check for status
+        status = ARCH->pollSocket(&pfds[0], (int)pfds.size(), -1);
+    }
+    catch (XArchNetwork& e) {
+        LOG((CLOG_WARN "error in socket multiplexer: %s", e.what()));
+        status = 0;
+    }
 
-    // release the lock on the lock
-    *m_jobListLockLocked = false;
-    m_jobListLockLocked->broadcast();
+    if (status != 0) {
+        // invoke the job of each socket with events and save the new
+        // job.  the jobs are in the same order as pfds.
+        for (size_t i = 0; i < pfds.size(); ++i) {
+            SocketJob* socketJob = m_pollJobs[i];
+            if (pfds[i].m_revents != 0 && socketJob->m_job != NULL &&
+                !socketJob->m_removed) {
+                runJob(*socketJob, pfds[i].m_revents);
+            }
+        }
+    }
 }
 
 void
-SocketMultiplexer::unlockJobList()
+SocketMultiplexer::runJob(SocketJob& socketJob, unsigned short revents)
 {
-    Lock lock(m_mutex);
+    // get poll state
+    bool read  = ((revents & IArchNetwork::kPOLLIN) != 0);
+    bool write = ((revents & IArchNetwork::kPOLLOUT) != 0);
+    bool error = ((revents & (IArchNetwork::kPOLLERR |
+                              IArchNetwork::kPOLLNVAL)) != 0);
+
+    // run job
+    ISocketMultiplexerJob* job    = socketJob.m_job;
+    ISocketMultiplexerJob* newJob = job->run(read, write, error);
+
+    // save job, if different, otherwise just pick up any change in
+    // what it's interested in
+    setJob(socketJob, newJob);
+    if (newJob == NULL) {
+        m_stopped = true;
+    }
+}
+
+void
+SocketMultiplexer::setJob(SocketJob& socketJob, ISocketMultiplexerJob* job)
+{
+    ISocketMultiplexerJob* oldJob = socketJob.m_job;
+    if (job != oldJob) {
+        // the poll set refers to the old job's socket so take it out
+        // while that socket is still open, unless the new job uses the
+        // same socket in which case just its events are changed.
+        if (m_pollSet != NULL && socketJob.m_events != 0 &&
+            (job == NULL || job->getSocket() != oldJob->getSocket())) {
+            try {
+                ARCH->removeFromPollSet(m_pollSet, oldJob->getSocket());
+            }
+            catch (XArchNetwork& e) {
+                LOG((CLOG_WARN "error in socket multiplexer: %s", e.what()));
+            }
+            socketJob.m_events = 0;
+        }
+
+        socketJob.m_job = job;
+        delete oldJob;
+    }
 
-    // make sure we're the one that called lockJobList()
-    assert(*m_jobListLocker == Thread::getCurrentThread());
+    updateInterest(socketJob);
+}
 
-    // release the lock
-    delete m_jobListLocker;
-    m_jobListLocker = NULL;
-    *m_jobListLock  = false;
-    m_jobListLock->signal();
+void
+SocketMultiplexer::updateInterest(SocketJob& socketJob)
+{
+    ISocketMultiplexerJob* job = socketJob.m_job;
+    unsigned short events = 0;
+    if (job != NULL) {
+        if (job->isReadable()) {
+            events |= IArchNetwork::kPOLLIN;
+        }
+        if (job->isWritable()) {
+            events |= IArchNetwork::kPOLLOUT;
+        }
+    }
+    if (events == socketJob.m_events) {
+        return;
+    }
 
-    // set new jobs ready state
-    bool isReady = !m_socketJobMap.empty();
-    if (*m_jobsReady != isReady) {
-        *m_jobsReady = isReady;
-        m_jobsReady->signal();
+    if (m_pollSet == NULL) {
+        // poll entries are rebuilt from the jobs
+        m_update = true;
+    }
+    else {
+        // a socket with no interest is taken out of the poll set
+        // rather than left in with no events so a hung up socket
+        // doesn't keep waking us.
+        try {
+            if (socketJob.m_events == 0) {
+                ARCH->addToPollSet(m_pollSet,
+                            job->getSocket(), events, &socketJob);
+            }
+            else if (events == 0) {
+                ARCH->removeFromPollSet(m_pollSet, job->getSocket());
+            }
+            else {
+                ARCH->modifyPollSet(m_pollSet,
+                            job->getSocket(), events, &socketJob);
+            }
+        }
+        catch (XArchNetwork& e) {
+            LOG((CLOG_WARN "error in socket multiplexer: %s", e.what()));
+        }
+    }
+    socketJob.m_events = events;
+}
+
+void
+SocketMultiplexer::removeStoppedJobs()
+{
+    m_stopped = false;
+    for (SocketJobMap::iterator i = m_socketJobMap.begin();
+                        i != m_socketJobMap.end();) {
+        if (i->second.m_job == NULL) {
+            m_socketJobMap.erase(i++);
+            m_update = true;
+        }
+        else {
+            ++i;
+        }
     }
 }
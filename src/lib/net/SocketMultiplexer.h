@@ -19,8 +19,10 @@
 #pragma once
 
 #include "arch/IArchNetwork.h"
-#include "common/stdlist.h"
 #include "common/stdmap.h"
+#include "common/stdvector.h"
+
+#include <atomic>
 
 template <class T>
 class CondVar;
@@ -41,8 +43,21 @@ public:
     //! @name manipulators
     //@{
 
+    //! Add or replace a socket's job
+    /*!
+    Posts the job to the service thread and returns without waiting
+    for it.  If the socket already has a different job, that job is
+    deleted once the service thread picks up the change, and it may
+    run one more time before that happens.
+    */
     void                addSocket(ISocket*, ISocketMultiplexerJob*);
 
+    //! Remove a socket
+    /*!
+    Removes the socket and deletes its job.  Unless called from a job,
+    this waits until the service thread has done so, after which the
+    job will not be run again.
+    */
     void                removeSocket(ISocket*);
 
     //@}
@@ -56,56 +71,91 @@ public:
     //@}
 
 private:
-    // list of jobs.  we use a list so we can safely iterate over it
-    // while other threads modify it.
-    typedef std::list<ISocketMultiplexerJob*> SocketJobs;
-    typedef SocketJobs::iterator JobCursor;
-    typedef std::map<ISocket*, JobCursor> SocketJobMap;
-
-    // service sockets.  the service thread will only access m_sockets
-    // and m_update while m_pollable and m_polling are true.  all other
-    // threads must only modify these when m_pollable and m_polling are
-    // false.  only the service thread sets m_polling.
+    // a socket's job and the events last handed to the poll set (or
+    // used to build the poll entries when there's no poll set) for it.
+    // the job is NULL once the job has asked to be removed.  m_removed
+    // is set when a job removes the socket so that no other job in the
+    // same batch runs it again before the removal is applied.
+    class SocketJob {
+    public:
+        ISocket*        m_socket;
+        ISocketMultiplexerJob*
+                        m_job;
+        unsigned short    m_events;
+        bool            m_removed;
+    };
+
+    // a change posted by addSocket() or removeSocket().  a NULL job
+    // removes the socket.  if m_done isn't NULL then it's set, with
+    // m_mutex locked, once the change has been applied.
+    class Change {
+    public:
+        ISocket*        m_socket;
+        ISocketMultiplexerJob*
+                        m_job;
+        bool*            m_done;
+    };
+    typedef std::vector<Change> ChangeList;
+
+    // socket jobs by socket.  only the service thread uses this.  map
+    // nodes never move so the poll set can refer to a SocketJob
+    // directly.
+    typedef std::map<ISocket*, SocketJob> SocketJobMap;
+
+    // service sockets.  other threads never touch the socket jobs;
+    // they append changes to m_changes, with m_mutex locked, and the
+    // service thread applies them between polls.  m_wakeup is set with
+    // the mutex locked but read without it so the service thread only
+    // locks when something has been posted.
     void                serviceThread(void*);
 
-    // create, iterate, and destroy a cursor.  a cursor is used to
-    // safely iterate through the job list while other threads modify
-    // the list.  it works by inserting a dummy item in the list and
-    // moving that item through the list.  the dummy item will never
-    // be removed by other edits so an iterator pointing at the item
-    // remains valid until we remove the dummy item in deleteCursor().
-    // nextCursor() finds the next non-dummy item, moves our dummy
-    // item just past it, and returns an iterator for the non-dummy
-    // item.  all cursor calls lock the mutex for their duration.
-    JobCursor            newCursor();
-    JobCursor            nextCursor(JobCursor);
-    void                deleteCursor(JobCursor);
-
-    // lock out locking the job list.  this blocks if another thread
-    // has already locked out locking.  once it returns, only the
-    // calling thread will be able to lock the job list after any
-    // current lock is released.
-    void                lockJobListLock();
-
-    // lock the job list.  this blocks if the job list is already
-    // locked.  the calling thread must have called requestJobLock.
-    void                lockJobList();
-
-    // unlock the job list and the lock out on locking.
-    void                unlockJobList();
+    // append a change and wake the service thread if it's not already
+    // been woken since it last applied changes.  re-adding the job
+    // that's already waiting to be applied for the socket, which is
+    // what a socket does each time it wants to write, adds nothing.
+    void                postChange(ISocket*, ISocketMultiplexerJob*, bool* done);
+
+    // apply the posted changes in the order they were posted
+    void                applyChanges();
+
+    // stop a socket's job from running again before its removal, which
+    // a job on the service thread has just posted, is applied
+    void                markRemoved(ISocket*);
+
+    // wait on and service the sockets, using the poll set if there is
+    // one or else rebuilding the poll entries when m_update is set.
+    void                servicePollSet(
+                            std::vector<IArchNetwork::PollSetEntry>&);
+    void                servicePoll(std::vector<IArchNetwork::PollEntry>&);
+
+    // run a job for the given poll results and save the job it returns
+    void                runJob(SocketJob&, unsigned short revents);
+
+    // replace the job for a socket, deleting the old job, and update
+    // the poll set
+    void                setJob(SocketJob&, ISocketMultiplexerJob*);
+
+    // hand any change in the events the socket's job is interested in
+    // to the poll set
+    void                updateInterest(SocketJob&);
+
+    // forget sockets whose jobs asked to be removed by returning NULL
+    void                removeStoppedJobs();
 
 private:
     Mutex*                m_mutex;
     Thread*                m_thread;
     bool                m_update;
-    CondVar<bool>*        m_jobsReady;
-    CondVar<bool>*        m_jobListLock;
-    CondVar<bool>*        m_jobListLockLocked;
-    Thread*                m_jobListLocker;
-    Thread*                m_jobListLockLocker;
+    bool                m_stopped;
+    CondVar<bool>*        m_changesReady;
+    CondVar<bool>*        m_changesApplied;
+    ChangeList            m_changes;
+    ChangeList            m_applying;
+    std::atomic<bool>    m_wakeup;
+    bool                m_idle;
 
-    SocketJobs            m_socketJobs;
     SocketJobMap        m_socketJobMap;
-    ISocketMultiplexerJob*
-                        m_cursorMark;
+    std::vector<SocketJob*>
+                        m_pollJobs;
+    ArchPollSet            m_pollSet;
 };
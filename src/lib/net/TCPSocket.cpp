@@ -33,6 +33,12 @@
 #include <cstdlib>
 #include <memory>
 
+// the most regions of a buffer passed to one read or write
+static const int s_maxIOBuffers = 16;
+
+// the least space to read into at once
+static const UInt32 s_readSize = 65536;
+
 //
 // TCPSocket
 //
@@ -42,7 +48,8 @@ TCPSocket::TCPSocket(IEventQueue* events, SocketMultiplexer* socketMultiplexer)
     m_events(events),
     m_mutex(),
     m_flushed(&m_mutex, true),
-    m_socketMultiplexer(socketMultiplexer)
+    m_socketMultiplexer(socketMultiplexer),
+    m_job(NULL)
 {
     try {
         m_socket = ARCH->newSocket(IArchNetwork::kINET, IArchNetwork::kSTREAM);
@@ -60,7 +67,8 @@ TCPSocket::TCPSocket(IEventQueue* events, SocketMultiplexer* socketMultiplexer,
     m_mutex(),
     m_socket(socket),
     m_flushed(&m_mutex, true),
-    m_socketMultiplexer(socketMultiplexer)
+    m_socketMultiplexer(socketMultiplexer),
+    m_job(NULL)
 {
     assert(m_socket != NULL);
 
@@ -137,10 +145,12 @@ TCPSocket::read(void* buffer, UInt32 n)
     if (n > size) {
         n = size;
     }
-    if (buffer != NULL && n != 0) {
-        memcpy(buffer, m_inputBuffer.peek(n), n);
+    if (buffer != NULL) {
+        m_inputBuffer.read(buffer, n);
+    }
+    else {
+        m_inputBuffer.pop(n);
     }
-    m_inputBuffer.pop(n);
 
     // if no more data and we cannot read or write then send disconnected
     if (n > 0 && m_inputBuffer.getSize() == 0 && !m_readable && !m_writable) {
@@ -155,6 +165,7 @@ void
 TCPSocket::write(const void* buffer, UInt32 n)
 {
     bool wasEmpty;
+    ISocketMultiplexerJob* job = NULL;
     {
         Lock lock(&m_mutex);
 
@@ -175,11 +186,15 @@ TCPSocket::write(const void* buffer, UInt32 n)
 
         // there's data to write
         m_flushed = false;
+
+        // make sure we're waiting to write
+        if (wasEmpty) {
+            job = newJob();
+        }
     }
 
-    // make sure we're waiting to write
     if (wasEmpty) {
-        setJob(newJob());
+        setJob(job);
     }
 }
 
@@ -196,6 +211,7 @@ void
 TCPSocket::shutdownInput()
 {
     bool useNewJob = false;
+    ISocketMultiplexerJob* job = NULL;
     {
         Lock lock(&m_mutex);
 
@@ -212,10 +228,11 @@ TCPSocket::shutdownInput()
             sendEvent(m_events->forIStream().inputShutdown());
             onInputShutdown();
             useNewJob = true;
+            job = newJob();
         }
     }
     if (useNewJob) {
-        setJob(newJob());
+        setJob(job);
     }
 }
 
@@ -223,6 +240,7 @@ void
 TCPSocket::shutdownOutput()
 {
     bool useNewJob = false;
+    ISocketMultiplexerJob* job = NULL;
     {
         Lock lock(&m_mutex);
 
@@ -239,10 +257,11 @@ TCPSocket::shutdownOutput()
             sendEvent(m_events->forIStream().outputShutdown());
             onOutputShutdown();
             useNewJob = true;
+            job = newJob();
         }
     }
     if (useNewJob) {
-        setJob(newJob());
+        setJob(job);
     }
 }
 
@@ -271,6 +290,7 @@ TCPSocket::getSize() const
 void
 TCPSocket::connect(const NetworkAddress& addr)
 {
+    ISocketMultiplexerJob* job;
     {
         Lock lock(&m_mutex);
 
@@ -293,8 +313,12 @@ TCPSocket::connect(const NetworkAddress& addr)
         catch (XArchNetwork& e) {
             throw XSocketConnect(e.what());
         }
+
+        // a new connection needs a new job
+        m_job = NULL;
+        job   = newJob();
     }
-    setJob(newJob());
+    setJob(job);
 }
 
 void
@@ -326,21 +350,18 @@ TCPSocket::init()
 TCPSocket::EJobResult
 TCPSocket::doRead()
 {
-    UInt8 buffer[4096];
-    memset(buffer, 0, sizeof(buffer));
-    size_t bytesRead = 0;
-    
-    bytesRead = ARCH->readSocket(m_socket, buffer, sizeof(buffer));
+    bool wasEmpty = (m_inputBuffer.getSize() == 0);
+
+    // read straight into the input buffer
+    size_t reserved  = 0;
+    size_t bytesRead = readIntoInputBuffer(reserved);
     
     if (bytesRead > 0) {
-        bool wasEmpty = (m_inputBuffer.getSize() == 0);
-        
-        // slurp up as much as possible
-        do {
-            m_inputBuffer.write(buffer, bytesRead);
-
-            bytesRead = ARCH->readSocket(m_socket, buffer, sizeof(buffer));
-        } while (bytesRead > 0);
+        // slurp up as much as possible.  a read that didn't fill the
+        // space we gave it has taken everything there was.
+        while (bytesRead == reserved) {
+            bytesRead = readIntoInputBuffer(reserved);
+        }
         
         // send input ready if input buffer was empty
         if (wasEmpty) {
@@ -363,16 +384,44 @@ TCPSocket::doRead()
     return kRetry;
 }
 
+size_t
+TCPSocket::readIntoInputBuffer(size_t& reserved)
+{
+    StreamBuffer::Region regions[s_maxIOBuffers];
+    IArchNetwork::IOBuffer buffers[s_maxIOBuffers];
+    int num = m_inputBuffer.reserve(regions, s_maxIOBuffers, s_readSize);
+    reserved = 0;
+    for (int i = 0; i < num; ++i) {
+        buffers[i].m_data = regions[i].m_data;
+        buffers[i].m_size = regions[i].m_size;
+        reserved         += regions[i].m_size;
+    }
+
+    size_t bytesRead = 0;
+    try {
+        bytesRead = ARCH->readSocketV(m_socket, buffers, num);
+    }
+    catch (...) {
+        m_inputBuffer.commit(0);
+        throw;
+    }
+    m_inputBuffer.commit((UInt32)bytesRead);
+    return bytesRead;
+}
+
 TCPSocket::EJobResult
 TCPSocket::doWrite()
 {
-    // write data
-    UInt32 bufferSize = 0;
-    int bytesWrote = 0;
+    // write data straight from the output buffer
+    StreamBuffer::Region regions[s_maxIOBuffers];
+    IArchNetwork::IOBuffer buffers[s_maxIOBuffers];
+    int num = m_outputBuffer.getData(regions, s_maxIOBuffers);
+    for (int i = 0; i < num; ++i) {
+        buffers[i].m_data = regions[i].m_data;
+        buffers[i].m_size = regions[i].m_size;
+    }
 
-    bufferSize = m_outputBuffer.getSize();
-    const void* buffer = m_outputBuffer.peek(bufferSize);
-    bytesWrote = (UInt32)ARCH->writeSocket(m_socket, buffer, bufferSize);
+    int bytesWrote = (int)ARCH->writeSocketV(m_socket, buffers, num);
 
     if (bytesWrote > 0) {
         discardWrittenData(bytesWrote);
@@ -385,6 +434,14 @@ TCPSocket::doWrite()
 void
 TCPSocket::setJob(ISocketMultiplexerJob* job)
 {
+    {
+        Lock lock(&m_mutex);
+        if (job != m_job) {
+            // the multiplexer will delete the job we were reusing
+            m_job = NULL;
+        }
+    }
+
     // multiplexer will delete the old job
     if (job == NULL) {
         m_socketMultiplexer->removeSocket(this);
@@ -402,6 +459,14 @@ TCPSocket::newJob()
     if (m_socket == NULL) {
         return NULL;
     }
+    else if (m_job != NULL) {
+        // keep the job we have and just change what it's interested in.
+        // it stays registered, with no interest, after a disconnect
+        // until the socket is closed.
+        m_job->setInterest(m_readable,
+                            m_writable && (m_outputBuffer.getSize() > 0));
+        return m_job;
+    }
     else if (!m_connected) {
         assert(!m_readable);
         if (!(m_readable || m_writable)) {
@@ -415,10 +480,11 @@ TCPSocket::newJob()
         if (!(m_readable || (m_writable && (m_outputBuffer.getSize() > 0)))) {
             return NULL;
         }
-        return new TSocketMultiplexerMethodJob<TCPSocket>(
+        m_job = new TSocketMultiplexerMethodJob<TCPSocket>(
                                 this, &TCPSocket::serviceConnected,
                                 m_socket, m_readable,
                                 m_writable && (m_outputBuffer.getSize() > 0));
+        return m_job;
     }
 }
 
@@ -586,5 +652,19 @@ TCPSocket::serviceConnected(ISocketMultiplexerJob* job,
         }
     }
 
-    return result == kBreak ? NULL : result == kNew ? newJob() : job;
+    if (result == kBreak && job == m_job) {
+        // another thread may be about to hand the job we're reusing to
+        // the multiplexer again so it mustn't be deleted.  leave it
+        // registered with no interest instead.
+        m_job->setInterest(false, false);
+        return job;
+    }
+
+    ISocketMultiplexerJob* nextJob =
+        (result == kBreak) ? NULL : (result == kNew) ? newJob() : job;
+    if (nextJob != m_job) {
+        // the multiplexer will delete the job we were reusing
+        m_job = NULL;
+    }
+    return nextJob;
 }
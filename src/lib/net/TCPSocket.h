@@ -29,6 +29,8 @@ class Thread;
 class ISocketMultiplexerJob;
 class IEventQueue;
 class SocketMultiplexer;
+template <class T>
+class TSocketMultiplexerMethodJob;
 
 //! TCP data socket
 /*!
@@ -87,6 +89,10 @@ protected:
 private:
     void                init();
 
+    // reads what's available into the input buffer, returning how much
+    // was read and in \c reserved how much could have been
+    size_t                readIntoInputBuffer(size_t& reserved);
+
     void                sendConnectionFailedEvent(const char*);
     void                onConnected();
     void                onInputShutdown();
@@ -113,4 +119,10 @@ private:
     ArchSocket            m_socket;
     CondVar<bool>        m_flushed;
     SocketMultiplexer*    m_socketMultiplexer;
+
+    // the job servicing the connected socket.  it's kept for as long
+    // as it's registered with the multiplexer and newJob() changes its
+    // interest rather than making a new job for every write.
+    TSocketMultiplexerMethodJob<TCPSocket>*
+                        m_job;
 };
@@ -21,6 +21,7 @@
 #include "net/TCPListenSocket.h"
 #include "net/SecureSocket.h"
 #include "net/SecureListenSocket.h"
+#include "net/SecureContext.h"
 #include "arch/Arch.h"
 #include "base/Log.h"
 
@@ -30,14 +31,15 @@
 
 TCPSocketFactory::TCPSocketFactory(IEventQueue* events, SocketMultiplexer* socketMultiplexer) :
     m_events(events),
-    m_socketMultiplexer(socketMultiplexer)
+    m_socketMultiplexer(socketMultiplexer),
+    m_secureContext(new SecureContext(false))
 {
     // do nothing
 }
 
 TCPSocketFactory::~TCPSocketFactory()
 {
-    // do nothing
+    delete m_secureContext;
 }
 
 IDataSocket*
@@ -45,7 +47,7 @@ TCPSocketFactory::create(bool secure) const
 {
     if (secure) {
         SecureSocket* secureSocket = new SecureSocket(m_events, m_socketMultiplexer);
-        secureSocket->initSsl (false);
+        secureSocket->initSsl(m_secureContext);
         return secureSocket;
     }
     else {
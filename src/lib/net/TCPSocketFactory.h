@@ -22,6 +22,7 @@
 
 class IEventQueue;
 class SocketMultiplexer;
+class SecureContext;
 
 //! Socket factory for TCP sockets
 class TCPSocketFactory : public ISocketFactory {
@@ -38,4 +39,8 @@ public:
 private:
     IEventQueue*        m_events;
     SocketMultiplexer*    m_socketMultiplexer;
+    // shared by every secure socket created so a reconnect can resume
+    // the last session.  the sockets use it so they mustn't outlive
+    // the factory.
+    SecureContext*        m_secureContext;
 };
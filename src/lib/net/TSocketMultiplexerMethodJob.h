@@ -21,6 +21,8 @@
 #include "net/ISocketMultiplexerJob.h"
 #include "arch/Arch.h"
 
+#include <atomic>
+
 //! Use a method as a socket multiplexer job
 /*!
 A socket multiplexer job class that invokes a member function.
@@ -36,6 +38,14 @@ public:
                             ArchSocket socket, bool readable, bool writeable);
     virtual ~TSocketMultiplexerMethodJob();
 
+    //! Change interest
+    /*!
+    Changes the events the job is interested in.  The multiplexer only
+    notices the change when the job is returned from \c run() or is
+    passed to \c SocketMultiplexer::addSocket() again.
+    */
+    void                setInterest(bool readable, bool writable);
+
     // IJob overrides
     virtual ISocketMultiplexerJob*
                         run(bool readable, bool writable, bool error);
@@ -47,8 +57,8 @@ private:
     T*                    m_object;
     Method                m_method;
     ArchSocket            m_socket;
-    bool                m_readable;
-    bool                m_writable;
+    std::atomic<bool>    m_readable;
+    std::atomic<bool>    m_writable;
     void*                m_arg;
 };
 
@@ -73,6 +83,15 @@ TSocketMultiplexerMethodJob<T>::~TSocketMultiplexerMethodJob()
     ARCH->closeSocket(m_socket);
 }
 
+template <class T>
+inline
+void
+TSocketMultiplexerMethodJob<T>::setInterest(bool readable, bool writable)
+{
+    m_readable = readable;
+    m_writable = writable;
+}
+
 template <class T>
 inline
 ISocketMultiplexerJob*
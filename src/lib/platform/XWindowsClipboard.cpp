@@ -30,6 +30,7 @@
 #include "base/Stopwatch.h"
 #include "common/stdvector.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <X11/Xatom.h>
@@ -47,7 +48,8 @@ XWindowsClipboard::XWindowsClipboard(Display* display,
     m_time(0),
     m_owner(false),
     m_timeOwned(0),
-    m_timeLost(0)
+    m_timeLost(0),
+    m_ignoreTargets(false)
 {
     // get some atoms
     m_atomTargets         = XInternAtom(m_display, "TARGETS", False);
@@ -57,6 +59,11 @@ XWindowsClipboard::XWindowsClipboard(Display* display,
     m_atomAtom            = XInternAtom(m_display, "ATOM", False);
     m_atomAtomPair        = XInternAtom(m_display, "ATOM_PAIR", False);
     m_atomData            = XInternAtom(m_display, "CLIP_TEMPORARY", False);
+    for (SInt32 index = 0; index < kNumFormats; ++index) {
+        char name[32];
+        sprintf(name, "CLIP_TEMPORARY_%d", index);
+        m_atomFormatData[index] = XInternAtom(m_display, name, False);
+    }
     m_atomINCR            = XInternAtom(m_display, "INCR", False);
     m_atomMotifClipLock   = XInternAtom(m_display, "_MOTIF_CLIP_LOCK", False);
     m_atomMotifClipHeader = XInternAtom(m_display, "_MOTIF_CLIP_HEADER", False);
@@ -265,6 +272,37 @@ XWindowsClipboard::getSelection() const
     return m_selection;
 }
 
+void
+XWindowsClipboard::setIgnoreTargets(bool ignore)
+{
+    if (m_ignoreTargets != ignore) {
+        m_ignoreTargets = ignore;
+
+        // look for the formats again unless the data is our own
+        if (!m_owner) {
+            clearCache();
+        }
+    }
+}
+
+void
+XWindowsClipboard::fetch(FetchedData& fetched) const
+{
+    assert(m_open);
+
+    fillCache();
+    const_cast<XWindowsClipboard*>(this)->icccmFetchFormats(fetched);
+
+    // the rest is already converted
+    for (SInt32 index = 0; index < kNumFormats; ++index) {
+        if (!fetched.m_added[index] && m_added[index]) {
+            fetched.m_added[index]     = true;
+            fetched.m_data[index]      = m_data[index];
+            fetched.m_converter[index] = NULL;
+        }
+    }
+}
+
 bool
 XWindowsClipboard::empty()
 {
@@ -379,6 +417,7 @@ XWindowsClipboard::has(EFormat format) const
     assert(m_open);
 
     fillCache();
+    fillFormat(format);
     return m_added[format];
 }
 
@@ -388,6 +427,7 @@ XWindowsClipboard::get(EFormat format) const
     assert(m_open);
 
     fillCache();
+    fillFormat(format);
     return m_data[format];
 }
 
@@ -468,9 +508,11 @@ XWindowsClipboard::doClearCache()
     m_checkCache = false;
     m_cached     = false;
     for (SInt32 index = 0; index < kNumFormats; ++index) {
-        m_data[index]  = "";
-        m_added[index] = false;
+        m_data[index]    = "";
+        m_added[index]   = false;
+        m_pending[index] = false;
     }
+    m_targets.clear();
 }
 
 void
@@ -497,56 +539,80 @@ XWindowsClipboard::doFillCache()
     m_cacheTime  = m_timeOwned;
 }
 
+void
+XWindowsClipboard::fillFormat(EFormat format) const
+{
+    // only ICCCM selections leave formats pending
+    if (m_pending[format]) {
+        const_cast<XWindowsClipboard*>(this)->icccmFillFormat(format);
+    }
+}
+
 void
 XWindowsClipboard::icccmFillCache()
 {
     LOG((CLOG_DEBUG "ICCCM fill clipboard %d", m_id));
 
     // see if we can get the list of available formats from the selection.
-    // if not then use a default list of formats.  note that some clipboard
-    // owners are broken and report TARGETS as the type of the TARGETS data
-    // instead of the correct type ATOM;  allow either.
-    const Atom atomTargets = m_atomTargets;
-    Atom target;
-    String data;
-    if (!icccmGetSelection(atomTargets, &target, &data) ||
-        (target != m_atomAtom && target != m_atomTargets)) {
-        LOG((CLOG_DEBUG1 "selection doesn't support TARGETS"));
-        data = "";
-        XWindowsUtil::appendAtomData(data, XA_STRING);
+    // if not then try every format.  note that some clipboard owners are
+    // broken and report TARGETS as the type of the TARGETS data instead
+    // of the correct type ATOM;  allow either.
+    bool useTargets = !m_ignoreTargets;
+    if (useTargets) {
+        Atom target;
+        String data;
+        if (!icccmGetSelection(m_atomTargets, &target, &data) ||
+            (target != m_atomAtom && target != m_atomTargets)) {
+            LOG((CLOG_DEBUG1 "selection doesn't support TARGETS"));
+            useTargets = false;
+        }
+        else {
+            XWindowsUtil::convertAtomProperty(data);
+            const Atom* targets = reinterpret_cast<const Atom*>(data.data());
+            const UInt32 numTargets = data.size() / sizeof(Atom);
+            LOG((CLOG_DEBUG "  available targets: %s", XWindowsUtil::atomsToString(m_display, targets, numTargets).c_str()));
+            m_targets.assign(targets, targets + numTargets);
+        }
+    }
+    if (!useTargets) {
+        m_targets.clear();
+        for (ConverterList::const_iterator index = m_converters.begin();
+                                index != m_converters.end(); ++index) {
+            m_targets.push_back((*index)->getAtom());
+        }
     }
 
-    XWindowsUtil::convertAtomProperty(data);
-    const Atom* targets = reinterpret_cast<const Atom*>(data.data()); // TODO: Safe?
-    const UInt32 numTargets = data.size() / sizeof(Atom);
-    LOG((CLOG_DEBUG "  available targets: %s", XWindowsUtil::atomsToString(m_display, targets, numTargets).c_str()));
-
-    // try each converter in order (because they're in order of
-    // preference).
+    // note the formats we can convert from the targets.  the data is
+    // only requested when the format is asked for.
     for (ConverterList::const_iterator index = m_converters.begin();
                                 index != m_converters.end(); ++index) {
         IXWindowsClipboardConverter* converter = *index;
+        if (std::find(m_targets.begin(), m_targets.end(),
+                                converter->getAtom()) != m_targets.end()) {
+            m_pending[converter->getFormat()] = true;
+        }
+    }
+}
 
-        // skip already handled targets
-        if (m_added[converter->getFormat()]) {
+void
+XWindowsClipboard::icccmFillFormat(EFormat format, Atom skipTarget)
+{
+    m_pending[format] = false;
+
+    // try each converter for the format in order (because they're in
+    // order of preference).
+    for (ConverterList::const_iterator index = m_converters.begin();
+                                index != m_converters.end(); ++index) {
+        IXWindowsClipboardConverter* converter = *index;
+        if (converter->getFormat() != format) {
             continue;
         }
 
         // see if atom is in target list
-        Atom target = None;
-        // XXX -- just ask for the converter's target to see if it's
-        // available rather than checking TARGETS.  i've seen clipboard
-        // owners that don't report all the targets they support.
-        target = converter->getAtom();
-        /*
-        for (UInt32 i = 0; i < numTargets; ++i) {
-            if (converter->getAtom() == targets[i]) {
-                target = targets[i];
-                break;
-            }
-        }
-        */
-        if (target == None) {
+        Atom target = converter->getAtom();
+        if (target == skipTarget ||
+            std::find(m_targets.begin(), m_targets.end(),
+                                target) == m_targets.end()) {
             continue;
         }
 
@@ -559,13 +625,81 @@ XWindowsClipboard::icccmFillCache()
         }
 
         // add to clipboard and note we've done it
-        IClipboard::EFormat format = converter->getFormat();
         m_data[format]  = converter->toIClipboard(targetData);
         m_added[format] = true;
         LOG((CLOG_DEBUG "added format %d for target %s (%u %s)", format, XWindowsUtil::atomToString(m_display, target).c_str(), targetData.size(), targetData.size() == 1 ? "byte" : "bytes"));
+        break;
     }
 }
 
+void
+XWindowsClipboard::icccmFetchFormats(FetchedData& fetched)
+{
+    // request the preferred target of every pending format at once so
+    // the owner's replies overlap instead of following one another
+    CICCCMGetClipboard* getters[kNumFormats];
+    IXWindowsClipboardConverter* converters[kNumFormats];
+    Atom actualTargets[kNumFormats];
+    CICCCMGetClipboard::GetterList requests;
+    for (SInt32 index = 0; index < kNumFormats; ++index) {
+        EFormat format = static_cast<EFormat>(index);
+        getters[index]    = NULL;
+        converters[index] = NULL;
+        if (m_pending[format]) {
+            converters[index] = icccmGetPendingConverter(format);
+        }
+        if (converters[index] != NULL) {
+            getters[index] = new CICCCMGetClipboard(m_window, m_time,
+                                m_atomFormatData[index]);
+            getters[index]->setTarget(m_display,
+                                converters[index]->getAtom(),
+                                &actualTargets[index], &fetched.m_data[index]);
+            requests.push_back(getters[index]);
+        }
+    }
+    if (requests.empty()) {
+        return;
+    }
+    CICCCMGetClipboard::readClipboards(m_display, m_selection, requests);
+
+    for (SInt32 index = 0; index < kNumFormats; ++index) {
+        CICCCMGetClipboard* getter = getters[index];
+        if (getter == NULL) {
+            continue;
+        }
+
+        Atom target = converters[index]->getAtom();
+        if (!getter->isFailed() && actualTargets[index] != None) {
+            fetched.m_added[index]     = true;
+            fetched.m_converter[index] = converters[index];
+            LOG((CLOG_DEBUG "fetched format %d for target %s (%u %s)", index, XWindowsUtil::atomToString(m_display, target).c_str(), fetched.m_data[index].size(), fetched.m_data[index].size() == 1 ? "byte" : "bytes"));
+        }
+        else {
+            // try the format's other targets, one at a time
+            LOG((CLOG_DEBUG1 "  no data for target %s", XWindowsUtil::atomToString(m_display, target).c_str()));
+            LOGC(getter->m_error, (CLOG_WARN "ICCCM violation by clipboard owner"));
+            fetched.m_data[index] = "";
+            icccmFillFormat(static_cast<EFormat>(index), target);
+        }
+        delete getter;
+    }
+}
+
+IXWindowsClipboardConverter*
+XWindowsClipboard::icccmGetPendingConverter(EFormat format) const
+{
+    for (ConverterList::const_iterator index = m_converters.begin();
+                                index != m_converters.end(); ++index) {
+        IXWindowsClipboardConverter* converter = *index;
+        if (converter->getFormat() == format &&
+            std::find(m_targets.begin(), m_targets.end(),
+                                converter->getAtom()) != m_targets.end()) {
+            return converter;
+        }
+    }
+    return NULL;
+}
+
 bool
 XWindowsClipboard::icccmGetSelection(Atom target,
                 Atom* actualTarget, String* data) const
@@ -1261,6 +1395,7 @@ XWindowsClipboard::CICCCMGetClipboard::CICCCMGetClipboard(
     m_requestor(requestor),
     m_time(time),
     m_property(property),
+    m_target(None),
     m_incr(false),
     m_failed(false),
     m_done(false),
@@ -1280,35 +1415,64 @@ XWindowsClipboard::CICCCMGetClipboard::~CICCCMGetClipboard()
 bool
 XWindowsClipboard::CICCCMGetClipboard::readClipboard(Display* display,
                 Atom selection, Atom target, Atom* actualTarget, String* data)
+{
+    setTarget(display, target, actualTarget, data);
+
+    GetterList getters;
+    getters.push_back(this);
+    readClipboards(display, selection, getters);
+    return !m_failed;
+}
+
+void
+XWindowsClipboard::CICCCMGetClipboard::setTarget(Display* display,
+                Atom target, Atom* actualTarget, String* data)
 {
     assert(actualTarget != NULL);
     assert(data         != NULL);
 
-    LOG((CLOG_DEBUG1 "request selection=%s, target=%s, window=%x", XWindowsUtil::atomToString(display, selection).c_str(), XWindowsUtil::atomToString(display, target).c_str(), m_requestor));
-
     m_atomNone = XInternAtom(display, "NONE", False);
     m_atomIncr = XInternAtom(display, "INCR", False);
 
-    // save output pointers
+    // save the target and output pointers
+    m_target       = target;
     m_actualTarget = actualTarget;
     m_data         = data;
 
     // assume failure
     *m_actualTarget = None;
     *m_data         = "";
+}
+
+void
+XWindowsClipboard::CICCCMGetClipboard::readClipboards(Display* display,
+                Atom selection, const GetterList& getters)
+{
+    assert(!getters.empty());
 
-    // delete target property
-    XDeleteProperty(display, m_requestor, m_property);
+    Window requestor = getters[0]->m_requestor;
+
+    // delete target properties
+    for (GetterList::const_iterator index = getters.begin();
+                                index != getters.end(); ++index) {
+        assert((*index)->m_requestor == requestor);
+        XDeleteProperty(display, requestor, (*index)->m_property);
+    }
 
     // select window for property changes
     XWindowAttributes attr;
-    XGetWindowAttributes(display, m_requestor, &attr);
-    XSelectInput(display, m_requestor,
+    XGetWindowAttributes(display, requestor, &attr);
+    XSelectInput(display, requestor,
                                 attr.your_event_mask | PropertyChangeMask);
 
-    // request data conversion
-    XConvertSelection(display, selection, target,
-                                m_property, m_requestor, m_time);
+    // request data conversions
+    for (GetterList::const_iterator index = getters.begin();
+                                index != getters.end(); ++index) {
+        CICCCMGetClipboard* getter = *index;
+        LOG((CLOG_DEBUG1 "request selection=%s, target=%s, window=%x", XWindowsUtil::atomToString(display, selection).c_str(), XWindowsUtil::atomToString(display, getter->m_target).c_str(), requestor));
+        XConvertSelection(display, selection, getter->m_target,
+                                getter->m_property, requestor, getter->m_time);
+    }
 
     // synchronize with server before we start following timeout countdown
     XSync(display, False);
@@ -1323,18 +1487,32 @@ XWindowsClipboard::CICCCMGetClipboard::readClipboard(Display* display,
     Stopwatch timeout(false);    // timer not stopped, not triggered
     static const double s_timeout = 0.25;    // FIXME -- is this too short?
     bool noWait = false;
-    while (!m_done && !m_failed) {
+    bool finished = false;
+    while (!finished) {
         // fail if timeout has expired
         if (timeout.getTime() >= s_timeout) {
-            m_failed = true;
+            for (GetterList::const_iterator index = getters.begin();
+                                index != getters.end(); ++index) {
+                if (!(*index)->isFinished()) {
+                    (*index)->m_failed = true;
+                }
+            }
             break;
         }
 
         // process events if any otherwise sleep
         if (noWait || XPending(display) > 0) {
-            while (!m_done && !m_failed && (noWait || XPending(display) > 0)) {
+            while (!finished && (noWait || XPending(display) > 0)) {
                 XNextEvent(display, &xevent);
-                if (!processEvent(display, &xevent)) {
+                bool processed = false;
+                for (GetterList::const_iterator index = getters.begin();
+                                index != getters.end(); ++index) {
+                    if (!(*index)->isFinished() &&
+                        (*index)->processEvent(display, &xevent)) {
+                        processed = true;
+                    }
+                }
+                if (!processed) {
                     // not processed so save it
                     events.push_back(xevent);
                 }
@@ -1342,11 +1520,20 @@ XWindowsClipboard::CICCCMGetClipboard::readClipboard(Display* display,
                     // reset timer since we've made some progress
                     timeout.reset();
 
+                    // once every unfinished request is being answered
                     // don't sleep anymore, just block waiting for events.
                     // we're assuming here that the clipboard owner will
                     // complete the protocol correctly.  if we continue to
                     // sleep we'll get very bad performance.
-                    noWait = true;
+                    finished = true;
+                    noWait   = true;
+                    for (GetterList::const_iterator index = getters.begin();
+                                index != getters.end(); ++index) {
+                        if (!(*index)->isFinished()) {
+                            finished = false;
+                            noWait   = noWait && (*index)->m_reading;
+                        }
+                    }
                 }
             }
         }
@@ -1361,11 +1548,25 @@ XWindowsClipboard::CICCCMGetClipboard::readClipboard(Display* display,
     }
 
     // restore mask
-    XSelectInput(display, m_requestor, attr.your_event_mask);
+    XSelectInput(display, requestor, attr.your_event_mask);
 
-    // return success or failure
-    LOG((CLOG_DEBUG1 "request %s after %fs", m_failed ? "failed" : "succeeded", timeout.getTime()));
-    return !m_failed;
+    // report success or failure
+    for (GetterList::const_iterator index = getters.begin();
+                                index != getters.end(); ++index) {
+        LOG((CLOG_DEBUG1 "request %s after %fs", (*index)->m_failed ? "failed" : "succeeded", timeout.getTime()));
+    }
+}
+
+bool
+XWindowsClipboard::CICCCMGetClipboard::isFailed() const
+{
+    return m_failed;
+}
+
+bool
+XWindowsClipboard::CICCCMGetClipboard::isFinished() const
+{
+    return m_done || m_failed;
 }
 
 bool
@@ -1386,8 +1587,9 @@ XWindowsClipboard::CICCCMGetClipboard::processEvent(
     case SelectionNotify:
         if (xevent->xselection.requestor == m_requestor) {
             // done if we can't convert
-            if (xevent->xselection.property == None ||
-                xevent->xselection.property == m_atomNone) {
+            if ((xevent->xselection.property == None ||
+                xevent->xselection.property == m_atomNone) &&
+                xevent->xselection.target == m_target) {
                 m_done = true;
                 return true;
             }
@@ -1489,6 +1691,37 @@ XWindowsClipboard::CICCCMGetClipboard::processEvent(
 }
 
 
+//
+// XWindowsClipboard::FetchedData
+//
+
+XWindowsClipboard::FetchedData::FetchedData()
+{
+    for (SInt32 index = 0; index < kNumFormats; ++index) {
+        m_added[index]     = false;
+        m_converter[index] = NULL;
+    }
+}
+
+void
+XWindowsClipboard::FetchedData::convert(IClipboard* clipboard) const
+{
+    for (SInt32 index = 0; index < kNumFormats; ++index) {
+        if (!m_added[index]) {
+            continue;
+        }
+
+        EFormat format = static_cast<EFormat>(index);
+        if (m_converter[index] != NULL) {
+            clipboard->add(format, m_converter[index]->toIClipboard(m_data[index]));
+        }
+        else {
+            clipboard->add(format, m_data[index]);
+        }
+    }
+}
+
+
 //
 // XWindowsClipboard::Reply
 //
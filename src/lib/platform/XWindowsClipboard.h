@@ -35,6 +35,33 @@ class IXWindowsClipboardConverter;
 //! X11 clipboard implementation
 class XWindowsClipboard : public IClipboard {
 public:
+    //! Unconverted clipboard data
+    /*!
+    The data of each format as the selection owner sent it, with the
+    converter that turns it into the clipboard format.  Converting it
+    uses neither the display nor the clipboard so it can be done on
+    any thread.
+    */
+    class FetchedData {
+    public:
+        FetchedData();
+
+        //! Convert the data
+        /*!
+        Converts the data and adds it to \c clipboard, which must be
+        open.
+        */
+        void            convert(IClipboard* clipboard) const;
+
+    public:
+        bool            m_added[kNumFormats];
+        String            m_data[kNumFormats];
+
+        // NULL if the data is already in the clipboard format
+        const IXWindowsClipboardConverter*
+                        m_converter[kNumFormats];
+    };
+
     /*!
     Use \c window as the window that owns or interacts with the
     clipboard identified by \c id.
@@ -86,6 +113,23 @@ public:
     */
     Atom                getSelection() const;
 
+    //! Set whether TARGETS is ignored
+    /*!
+    Normally only the formats the selection owner lists in TARGETS are
+    requested.  If \c ignore is true then every format we can convert
+    is requested instead, which works with owners that don't list all
+    the formats they support but costs a round trip per format.
+    */
+    void                setIgnoreTargets(bool ignore);
+
+    //! Fetch every format
+    /*!
+    Requests the data of every format the selection has at once and
+    waits for all of it, then stores it in \c fetched without converting
+    it.  The clipboard must be open.
+    */
+    void                fetch(FetchedData& fetched) const;
+
     // IClipboard overrides
     virtual bool        empty();
     virtual void        add(EFormat, const String& data);
@@ -127,10 +171,14 @@ private:
     void                clearCache() const;
     void                doClearCache();
 
-    // cache all formats of the selection
+    // cache the formats the selection has, without their data
     void                fillCache() const;
     void                doFillCache();
 
+    // cache the data for a format if the selection has it and it's not
+    // already cached
+    void                fillFormat(EFormat) const;
+
     //
     // helper classes
     //
@@ -148,13 +196,31 @@ private:
                             Atom selection, Atom target,
                             Atom* actualTarget, String* data);
 
+        // set the type to convert the selection to and where to put
+        // the result, for readClipboards()
+        void            setTarget(Display* display, Atom target,
+                            Atom* actualTarget, String* data);
+
+        // convert the given selection to each getter's type at once.
+        // every getter must have the same requestor and a different
+        // property.  the result of each is as for readClipboard() and
+        // is returned by isFailed().
+        typedef std::vector<CICCCMGetClipboard*> GetterList;
+        static void        readClipboards(Display* display,
+                            Atom selection, const GetterList& getters);
+
+        // true iff the last read failed
+        bool            isFailed() const;
+
     private:
+        bool            isFinished() const;
         bool            processEvent(Display* display, XEvent* event);
 
     private:
         Window            m_requestor;
         Time            m_time;
         Atom            m_property;
+        Atom            m_target;
         bool            m_incr;
         bool            m_failed;
         bool            m_done;
@@ -252,6 +318,10 @@ private:
 
     // ICCCM interoperability methods
     void                icccmFillCache();
+    void                icccmFillFormat(EFormat, Atom skipTarget = None);
+    void                icccmFetchFormats(FetchedData&);
+    IXWindowsClipboardConverter*
+                        icccmGetPendingConverter(EFormat) const;
     bool                icccmGetSelection(Atom target,
                             Atom* actualTarget, String* data) const;
     Time                icccmGetTime() const;
@@ -284,6 +354,7 @@ private:
 
 private:
     typedef std::vector<IXWindowsClipboardConverter*> ConverterList;
+    typedef std::vector<Atom> AtomList;
 
     Display*            m_display;
     Window                m_window;
@@ -305,6 +376,12 @@ private:
     bool                m_added[kNumFormats];
     String                m_data[kNumFormats];
 
+    // formats the selection has that haven't been requested yet and
+    // the targets to request them with
+    bool                m_pending[kNumFormats];
+    AtomList            m_targets;
+    bool                m_ignoreTargets;
+
     // conversion request replies
     ReplyMap            m_replies;
     ReplyEventMask        m_eventMasks;
@@ -320,6 +397,7 @@ private:
     Atom                m_atomAtom;
     Atom                m_atomAtomPair;
     Atom                m_atomData;
+    Atom                m_atomFormatData[kNumFormats];
     Atom                m_atomINCR;
     Atom                m_atomMotifClipLock;
     Atom                m_atomMotifClipHeader;
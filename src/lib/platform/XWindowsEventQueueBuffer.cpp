@@ -22,8 +22,14 @@
 #include "mt/Thread.h"
 #include "base/Event.h"
 #include "base/IEventQueue.h"
+#include "base/Log.h"
+#include "arch/Arch.h"
 
+#include <algorithm>
+#include <cmath>
+#include <errno.h>
 #include <fcntl.h>
+#include <string.h>
 #if HAVE_UNISTD_H
 #    include <unistd.h>
 #endif
@@ -54,15 +60,16 @@ class EventQueueTimer { };
 
 XWindowsEventQueueBuffer::XWindowsEventQueueBuffer(
         Display* display, Window window, IEventQueue* events) :
-    m_events(events),
     m_display(display),
     m_window(window),
-    m_waiting(false)
+    m_waiting(false),
+    m_userTurn(false),
+    m_idleWakeups(0),
+    m_events(events)
 {
     assert(m_display != NULL);
     assert(m_window  != None);
 
-    m_userEvent = XInternAtom(m_display, "SYNERGY_USER_EVENT", False);
     // set up for pipe hack
     int result = pipe(m_pipefd);
     assert(result == 0);
@@ -87,110 +94,83 @@ XWindowsEventQueueBuffer::waitForEvent(double dtimeout)
     Thread::testCancel();
 
     // clear out the pipe in preparation for waiting.
+    drainPipe();
 
-    char buf[16];
-    ssize_t read_response = read(m_pipefd[0], buf, 15);
-    
-    // with linux automake, warnings are treated as errors by default
-    if (read_response < 0)
     {
-        // todo: handle read response
+        // we're now waiting for events.  user events added from here on
+        // write to the pipe.
+        Lock lock(&m_queueMutex);
+        m_waiting = true;
     }
-
     {
+        // push out pending requests
         Lock lock(&m_mutex);
-        // we're now waiting for events
-        m_waiting = true;
-
-        // push out pending events
-        flush();
-    }
-    // calling flush may have queued up a new event.
-    if (!XWindowsEventQueueBuffer::isEmpty()) {
-        Thread::testCancel();
-        return;
+        XFlush(m_display);
     }
 
-    // use poll() to wait for a message from the X server or for timeout.
-    // this is a good deal more efficient than polling and sleeping.
-#if HAVE_POLL
-    struct pollfd pfds[2];
-    pfds[0].fd     = ConnectionNumber(m_display);
-    pfds[0].events = POLLIN;
-    pfds[1].fd     = m_pipefd[0];
-    pfds[1].events = POLLIN;
-    int timeout    = (dtimeout < 0.0) ? -1 :
-                        static_cast<int>(1000.0 * dtimeout);
-    int remaining  =  timeout;
-    int retval     =  0;
-#else
-    struct timeval timeout;
-    struct timeval* timeoutPtr;
-    if (dtimeout < 0.0) {
-        timeoutPtr = NULL;
-    }
-    else {
-        timeout.tv_sec  = static_cast<int>(dtimeout);
-        timeout.tv_usec = static_cast<int>(1.0e+6 *
-                                (dtimeout - timeout.tv_sec));
-        timeoutPtr      = &timeout;
-    }
+    // sleep until the X connection or the pipe is readable or the
+    // timeout expires.  isEmpty() reads whatever the X server has sent
+    // into xlib's queue, which poll() can't see, so nothing's left
+    // there when we block.
+    double deadline = ARCH->time() + dtimeout;
+    bool woke       = false;
+    while (XWindowsEventQueueBuffer::isEmpty()) {
+        double remaining = deadline - ARCH->time();
+        if (dtimeout >= 0.0 && remaining <= 0.0) {
+            break;
+        }
 
-    // initialize file descriptor sets
-    fd_set rfds;
-    FD_ZERO(&rfds);
-    FD_SET(ConnectionNumber(m_display), &rfds);
-    FD_SET(m_pipefd[0], &rfds);
-     int nfds;
-     if (ConnectionNumber(m_display) > m_pipefd[0]) {
-         nfds = ConnectionNumber(m_display) + 1;
-     }
-     else {
-         nfds = m_pipefd[0] + 1;
-     }
-#endif
-    // It's possible that the X server has queued events locally
-    // in xlib's event buffer and not pushed on to the fd. Hence we
-    // can't simply monitor the fd as we may never be woken up.
-    // ie addEvent calls flush, XFlush may not send via the fd hence
-    // there is an event waiting to be sent but we must exit the poll
-    // before it can.
-    // Instead we poll for a brief period of time (so if events
-    // queued locally in the xlib buffer can be processed)
-    // and continue doing this until timeout is reached.
-    // The human eye can notice 60hz (ansi) which is 16ms, however
-    // we want to give the cpu a chance s owe up this to 25ms
-#define TIMEOUT_DELAY 25
-
-    while (((dtimeout < 0.0) || (remaining > 0)) && QLength(m_display)==0 && retval==0){
-#if HAVE_POLL
-    retval = poll(pfds, 2, TIMEOUT_DELAY); //16ms = 60hz, but we make it > to play nicely with the cpu
-     if (pfds[1].revents & POLLIN) {
-         ssize_t read_response = read(m_pipefd[0], buf, 15);
-        
-        // with linux automake, warnings are treated as errors by default
-        if (read_response < 0)
-        {
-            // todo: handle read response
+        // we woke up before the timeout with nothing to do
+        if (woke) {
+            ++m_idleWakeups;
         }
 
-     }
+        // round the timeout up so we don't wake just short of it
+#if HAVE_POLL
+        struct pollfd pfds[2];
+        pfds[0].fd     = ConnectionNumber(m_display);
+        pfds[0].events = POLLIN;
+        pfds[1].fd     = m_pipefd[0];
+        pfds[1].events = POLLIN;
+        int timeout    = (dtimeout < 0.0) ? -1 :
+                            static_cast<int>(ceil(1000.0 * remaining));
+        int retval     = poll(pfds, 2, timeout);
 #else
-    retval = select(nfds,
-                        SELECT_TYPE_ARG234 &rfds,
-                        SELECT_TYPE_ARG234 NULL,
-                        SELECT_TYPE_ARG234 NULL,
-                        SELECT_TYPE_ARG5   TIMEOUT_DELAY);
-    if (FD_SET(m_pipefd[0], &rfds)) {
-        read(m_pipefd[0], buf, 15);
-    }
+        struct timeval timeout;
+        struct timeval* timeoutPtr;
+        if (dtimeout < 0.0) {
+            timeoutPtr = NULL;
+        }
+        else {
+            timeout.tv_sec  = static_cast<int>(remaining);
+            timeout.tv_usec = static_cast<int>(ceil(1.0e+6 *
+                                    (remaining - timeout.tv_sec)));
+            timeoutPtr      = &timeout;
+        }
+
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        FD_SET(ConnectionNumber(m_display), &rfds);
+        FD_SET(m_pipefd[0], &rfds);
+        int nfds = std::max(ConnectionNumber(m_display), m_pipefd[0]) + 1;
+        int retval = select(nfds,
+                            SELECT_TYPE_ARG234 &rfds,
+                            SELECT_TYPE_ARG234 NULL,
+                            SELECT_TYPE_ARG234 NULL,
+                            SELECT_TYPE_ARG5   timeoutPtr);
 #endif
-        remaining-=TIMEOUT_DELAY;
+        drainPipe();
+
+        // a signal (perhaps to cancel this thread) ends the wait
+        if (retval < 0 && errno == EINTR) {
+            break;
+        }
+        woke = true;
     }
 
     {
         // we're no longer waiting for events
-        Lock lock(&m_mutex);
+        Lock lock(&m_queueMutex);
         m_waiting = false;
     }
 
@@ -200,58 +180,42 @@ XWindowsEventQueueBuffer::waitForEvent(double dtimeout)
 IEventQueueBuffer::Type
 XWindowsEventQueueBuffer::getEvent(Event& event, UInt32& dataID)
 {
-    Lock lock(&m_mutex);
+    // take turns with the X server so a steady stream of either kind
+    // of event can't hold up the other
+    m_userTurn = !m_userTurn;
+    if (m_userTurn && popUserEvent(dataID)) {
+        return kUser;
+    }
 
-    // push out pending events
-    flush();
+    Lock lock(&m_mutex);
+    if (XPending(m_display) == 0 && popUserEvent(dataID)) {
+        return kUser;
+    }
 
     // get next event
     XNextEvent(m_display, &m_event);
-
-    // process event
-    if (m_event.xany.type == ClientMessage &&
-        m_event.xclient.message_type == m_userEvent) {
-        dataID = static_cast<UInt32>(m_event.xclient.data.l[0]);
-        return kUser;
-    }
-    else {
-        event = Event(Event::kSystem,
-                            m_events->getSystemTarget(), &m_event);
-        return kSystem;
-    }
+    event = Event(Event::kSystem, m_events->getSystemTarget(), &m_event);
+    return kSystem;
 }
 
 bool
 XWindowsEventQueueBuffer::addEvent(UInt32 dataID)
 {
-    // prepare a message
-    XEvent xevent;
-    xevent.xclient.type         = ClientMessage;
-    xevent.xclient.window       = m_window;
-    xevent.xclient.message_type = m_userEvent;
-    xevent.xclient.format       = 32;
-    xevent.xclient.data.l[0]    = static_cast<long>(dataID);
-
-    // save the message
-    Lock lock(&m_mutex);
-    m_postedEvents.push_back(xevent);
-
-    // if we're currently waiting for an event then send saved events to
-    // the X server now.  if we're not waiting then some other thread
-    // might be using the display connection so we can't safely use it
-    // too.
-    if (m_waiting) {
-        flush();
-        // Send a character through the round-trip pipe to wake a thread
-        // that is waiting for a ConnectionNumber() socket to be readable.
-        // The flush call can read incoming data from the socket and put
-        // it in Xlib's input buffer.  That sneaks it past the other thread.
-        ssize_t write_response = write(m_pipefd[1], "!", 1);
-
-        // with linux automake, warnings are treated as errors by default
-        if (write_response < 0)
-        {
-            // todo: handle read response
+    bool wake;
+    {
+        Lock lock(&m_queueMutex);
+        wake = (m_waiting && m_postedEvents.empty());
+        m_postedEvents.push_back(dataID);
+    }
+
+    // if a thread is waiting for an event then send a character through
+    // the pipe to wake it.  it checked the queue before it started
+    // waiting so only the first event since then has to.
+    if (wake) {
+        // the pipe is non-blocking.  if it's full then the waiting
+        // thread already has a wakeup to read.
+        if (write(m_pipefd[1], "!", 1) < 0 && errno != EAGAIN) {
+            LOG((CLOG_WARN "failed to wake event queue: %s", strerror(errno)));
         }
     }
 
@@ -261,6 +225,13 @@ XWindowsEventQueueBuffer::addEvent(UInt32 dataID)
 bool
 XWindowsEventQueueBuffer::isEmpty() const
 {
+    {
+        Lock lock(&m_queueMutex);
+        if (!m_postedEvents.empty()) {
+            return false;
+        }
+    }
+
     Lock lock(&m_mutex);
     return (XPending(m_display) == 0 );
 }
@@ -277,15 +248,30 @@ XWindowsEventQueueBuffer::deleteTimer(EventQueueTimer* timer) const
     delete timer;
 }
 
+UInt32
+XWindowsEventQueueBuffer::getIdleWakeups() const
+{
+    return m_idleWakeups;
+}
+
 void
-XWindowsEventQueueBuffer::flush()
+XWindowsEventQueueBuffer::drainPipe()
 {
-    // note -- m_mutex must be locked on entry
+    char buf[16];
+    ssize_t read_response;
+    do {
+        read_response = read(m_pipefd[0], buf, sizeof(buf));
+    } while (read_response == (ssize_t)sizeof(buf));
+}
 
-    // flush the posted event list to the X server
-    for (size_t i = 0; i < m_postedEvents.size(); ++i) {
-        XSendEvent(m_display, m_window, False, 0, &m_postedEvents[i]);
+bool
+XWindowsEventQueueBuffer::popUserEvent(UInt32& dataID)
+{
+    Lock lock(&m_queueMutex);
+    if (m_postedEvents.empty()) {
+        return false;
     }
-    XFlush(m_display);
-    m_postedEvents.clear();
+    dataID = m_postedEvents.front();
+    m_postedEvents.pop_front();
+    return true;
 }
@@ -20,7 +20,7 @@
 
 #include "mt/Mutex.h"
 #include "base/IEventQueueBuffer.h"
-#include "common/stdvector.h"
+#include "common/stddeque.h"
 
 #if X_DISPLAY_MISSING
 #    error X11 is required to build synergy
@@ -46,19 +46,40 @@ public:
                         newTimer(double duration, bool oneShot) const;
     virtual void        deleteTimer(EventQueueTimer*) const;
 
+    //! @name accessors
+    //@{
+
+    //! Get number of idle wakeups
+    /*!
+    Returns how many times waitForEvent() woke before its timeout
+    without an event to return.
+    */
+    UInt32                getIdleWakeups() const;
+
+    //@}
+
 private:
-    void                flush();
+    void                drainPipe();
+    bool                popUserEvent(UInt32& dataID);
 
 private:
-    typedef std::vector<XEvent> EventList;
+    typedef std::deque<UInt32> EventDeque;
 
+    // guards the display
     Mutex                m_mutex;
     Display*            m_display;
     Window                m_window;
-    Atom                m_userEvent;
     XEvent                m_event;
-    EventList            m_postedEvents;
+
+    // user events never go to the X server.  they're queued here and
+    // the pipe wakes a waiting thread.
+    Mutex                m_queueMutex;
+    EventDeque            m_postedEvents;
     bool                m_waiting;
     int                    m_pipefd[2];
+
+    // getEvent() alternates between user and X events
+    bool                m_userTurn;
+    UInt32                m_idleWakeups;
     IEventQueue*        m_events;
 };
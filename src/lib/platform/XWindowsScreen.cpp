@@ -26,12 +26,16 @@
 #include "core/Clipboard.h"
 #include "core/KeyMap.h"
 #include "core/XScreen.h"
+#include "mt/Lock.h"
+#include "mt/Mutex.h"
+#include "mt/WorkerPool.h"
 #include "arch/XArch.h"
 #include "arch/Arch.h"
 #include "base/Log.h"
 #include "base/Stopwatch.h"
 #include "base/String.h"
 #include "base/IEventQueue.h"
+#include "base/IJob.h"
 #include "base/TMethodEventJob.h"
 
 #include <cstring>
@@ -74,6 +78,46 @@
 
 static int xi_opcode;
 
+//
+// XWindowsScreen::ClipboardJob
+//
+
+class XWindowsScreen::ClipboardJob : public IJob {
+public:
+	ClipboardJob(XWindowsScreen* screen, ClipboardID id,
+							UInt32 seqNum, Time time) :
+		m_screen(screen),
+		m_id(id),
+		m_seqNum(seqNum),
+		m_fetchCount(0),
+		m_time(time) { }
+
+	// IJob overrides
+	virtual void		run()
+	{
+		Stopwatch timer(false);
+		Clipboard clipboard;
+		if (clipboard.open(m_time)) {
+			clipboard.empty();
+			m_data.convert(&clipboard);
+			clipboard.close();
+		}
+		String data = clipboard.marshall();
+		LOG((CLOG_DEBUG1 "converted clipboard %d in %fs", m_id, timer.getTime()));
+		m_screen->onClipboardConverted(m_id, m_fetchCount,
+							m_seqNum, m_time, data);
+	}
+
+public:
+	XWindowsScreen*		m_screen;
+	ClipboardID			m_id;
+	UInt32				m_seqNum;
+	UInt32				m_fetchCount;
+	Time				m_time;
+	XWindowsClipboard::FetchedData
+						m_data;
+};
+
 //
 // XWindowsScreen
 //
@@ -114,6 +158,8 @@ XWindowsScreen::XWindowsScreen(
 	m_ic(NULL),
 	m_lastKeycode(0),
 	m_sequenceNumber(0),
+	m_clipboardWorkers(NULL),
+	m_fetchedMutex(new Mutex),
 	m_screensaver(NULL),
 	m_screensaverNotify(false),
 	m_xtestIsXineramaUnaware(true),
@@ -179,7 +225,10 @@ XWindowsScreen::XWindowsScreen(
 
 	// initialize the clipboards
 	for (ClipboardID id = 0; id < kClipboardEnd; ++id) {
-		m_clipboard[id] = new XWindowsClipboard(m_display, m_window, id);
+		m_clipboard[id]   = new XWindowsClipboard(m_display, m_window, id);
+		m_fetchCount[id]  = 0;
+		m_fetched[id]     = false;
+		m_fetchedTime[id] = 0;
 	}
 
 	// install event handlers
@@ -199,9 +248,13 @@ XWindowsScreen::~XWindowsScreen()
 
 	m_events->adoptBuffer(NULL);
 	m_events->removeHandler(Event::kSystem, m_events->getSystemTarget());
+
+	// conversions use the clipboards' converters
+	delete m_clipboardWorkers;
 	for (ClipboardID id = 0; id < kClipboardEnd; ++id) {
 		delete m_clipboard[id];
 	}
+	delete m_fetchedMutex;
 	delete m_keyState;
 	delete m_screensaver;
 	m_keyState    = NULL;
@@ -384,6 +437,9 @@ XWindowsScreen::setClipboard(ClipboardID id, const IClipboard* clipboard)
 	Time timestamp = XWindowsUtil::getCurrentTime(
 								m_display, m_clipboard[id]->getWindow());
 
+	// we're taking the selection so what we fetched is out of date
+	discardFetchedClipboard(id);
+
 	if (clipboard != NULL) {
 		// save clipboard data
 		return Clipboard::copy(m_clipboard[id], clipboard, timestamp);
@@ -405,6 +461,49 @@ XWindowsScreen::checkClipboards()
 	// do nothing, we're always up to date
 }
 
+bool
+XWindowsScreen::fetchClipboard(ClipboardID id, UInt32 seqNum)
+{
+	// fail if we don't have the requested clipboard
+	if (m_clipboard[id] == NULL) {
+		return false;
+	}
+
+	// get the actual time.  ICCCM does not allow CurrentTime.
+	Time timestamp = XWindowsUtil::getCurrentTime(
+								m_display, m_clipboard[id]->getWindow());
+
+	// get the data here, where we can use the display, and leave
+	// converting it to a worker so input isn't held up meanwhile.
+	// whatever was fetched before is out of date even if this fails.
+	ClipboardJob* job = new ClipboardJob(this, id, seqNum, timestamp);
+	job->m_fetchCount = discardFetchedClipboard(id);
+	if (!m_clipboard[id]->open(timestamp)) {
+		delete job;
+		return false;
+	}
+	Stopwatch timer(false);
+	m_clipboard[id]->fetch(job->m_data);
+	m_clipboard[id]->close();
+
+	// the selection round trips still hold up input.  a slow owner can
+	// take up to the read timeout on each.
+	static const double s_slowFetch = 0.05;
+	double elapsed = timer.getTime();
+	if (elapsed >= s_slowFetch) {
+		LOG((CLOG_INFO "fetching clipboard %d held up input for %.0f ms", id, elapsed * 1000.0));
+	}
+	else {
+		LOG((CLOG_DEBUG1 "fetched clipboard %d in %fs", id, elapsed));
+	}
+
+	if (m_clipboardWorkers == NULL) {
+		m_clipboardWorkers = new WorkerPool(kClipboardEnd);
+	}
+	m_clipboardWorkers->addJob(job);
+	return true;
+}
+
 void
 XWindowsScreen::openScreensaver(bool notify)
 {
@@ -438,6 +537,9 @@ XWindowsScreen::resetOptions()
 {
 	m_xtestIsXineramaUnaware = true;
 	m_preserveFocus = false;
+	for (ClipboardID id = 0; id < kClipboardEnd; ++id) {
+		m_clipboard[id]->setIgnoreTargets(false);
+	}
 }
 
 void
@@ -452,6 +554,13 @@ XWindowsScreen::setOptions(const OptionsList& options)
 			m_preserveFocus = (options[i + 1] != 0);
 			LOG((CLOG_DEBUG1 "Preserve Focus = %s", m_preserveFocus ? "true" : "false"));
 		}
+		else if (options[i] == kOptionXClipboardIgnoreTargets) {
+			bool ignore = (options[i + 1] != 0);
+			for (ClipboardID id = 0; id < kClipboardEnd; ++id) {
+				m_clipboard[id]->setIgnoreTargets(ignore);
+			}
+			LOG((CLOG_DEBUG1 "clipboard ignores TARGETS %s", ignore ? "true" : "false"));
+		}
 	}
 }
 
@@ -483,6 +592,24 @@ XWindowsScreen::getClipboard(ClipboardID id, IClipboard* clipboard) const
 		return false;
 	}
 
+	// take the clipboard fetchClipboard() converted if it's waiting
+	bool fetched = false;
+	String data;
+	Time time = 0;
+	{
+		Lock lock(m_fetchedMutex);
+		if (m_fetched[id]) {
+			fetched       = true;
+			m_fetched[id] = false;
+			data.swap(m_fetchedData[id]);
+			time = m_fetchedTime[id];
+		}
+	}
+	if (fetched) {
+		IClipboard::unmarshall(clipboard, data, time);
+		return true;
+	}
+
 	// get the actual time.  ICCCM does not allow CurrentTime.
 	Time timestamp = XWindowsUtil::getCurrentTime(
 								m_display, m_clipboard[id]->getWindow());
@@ -1136,6 +1263,36 @@ XWindowsScreen::sendClipboardEvent(Event::Type type, ClipboardID id)
 	sendEvent(type, info);
 }
 
+void
+XWindowsScreen::onClipboardConverted(ClipboardID id, UInt32 fetchCount,
+				UInt32 seqNum, Time time, String& data)
+{
+	{
+		Lock lock(m_fetchedMutex);
+		if (fetchCount != m_fetchCount[id]) {
+			// a newer fetch will send its own event
+			return;
+		}
+		m_fetched[id] = true;
+		m_fetchedData[id].swap(data);
+		m_fetchedTime[id] = time;
+	}
+
+	ClipboardInfo* info   = (ClipboardInfo*)malloc(sizeof(ClipboardInfo));
+	info->m_id             = id;
+	info->m_sequenceNumber = seqNum;
+	sendEvent(m_events->forClipboard().clipboardChanged(), info);
+}
+
+UInt32
+XWindowsScreen::discardFetchedClipboard(ClipboardID id)
+{
+	Lock lock(m_fetchedMutex);
+	m_fetched[id]     = false;
+	m_fetchedData[id] = "";
+	return ++m_fetchCount[id];
+}
+
 IKeyState*
 XWindowsScreen::getKeyState() const
 {
@@ -1305,6 +1462,7 @@ XWindowsScreen::handleSystemEvent(const Event& event, void*)
 			ClipboardID id = getClipboardID(xevent->xselectionclear.selection);
 			if (id != kClipboardEnd) {
 				m_clipboard[id]->lost(xevent->xselectionclear.time);
+				discardFetchedClipboard(id);
 				sendClipboardEvent(m_events->forClipboard().clipboardGrabbed(), id);
 				return;
 			}
@@ -32,6 +32,8 @@
 class XWindowsClipboard;
 class XWindowsKeyState;
 class XWindowsScreenSaver;
+class WorkerPool;
+class Mutex;
 
 //! Implementation of IPlatformScreen for X11
 class XWindowsScreen : public PlatformScreen {
@@ -77,6 +79,7 @@ public:
     virtual bool        leave();
     virtual bool        setClipboard(ClipboardID, const IClipboard*);
     virtual void        checkClipboards();
+    virtual bool        fetchClipboard(ClipboardID, UInt32 seqNum);
     virtual void        openScreensaver(bool notify);
     virtual void        closeScreensaver();
     virtual void        screensaver(bool activate);
@@ -114,6 +117,21 @@ private:
     void                onError();
     static int            ioErrorHandler(Display*);
 
+    // converts a fetched clipboard on a worker thread
+    class ClipboardJob;
+
+    // keep a converted clipboard for getClipboard() and send the event
+    // saying it's ready, unless the clipboard has been fetched again.
+    // called on a worker thread.
+    void                onClipboardConverted(ClipboardID,
+                            UInt32 fetchCount, UInt32 seqNum,
+                            Time, String& data);
+
+    // forget the converted clipboard, and throw away the one a worker
+    // may be converting, because the clipboard changed.  returns the
+    // new fetch count.
+    UInt32                discardFetchedClipboard(ClipboardID);
+
 private:
     class KeyEventFilter {
     public:
@@ -211,6 +229,15 @@ private:
     XWindowsClipboard*    m_clipboard[kClipboardEnd];
     UInt32                m_sequenceNumber;
 
+    // clipboards fetched in the background.  a converted clipboard is
+    // kept until getClipboard() takes it.
+    WorkerPool*            m_clipboardWorkers;
+    Mutex*                m_fetchedMutex;
+    UInt32                m_fetchCount[kClipboardEnd];
+    mutable bool        m_fetched[kClipboardEnd];
+    mutable String        m_fetchedData[kClipboardEnd];
+    Time                m_fetchedTime[kClipboardEnd];
+
     // screen saver stuff
     XWindowsScreenSaver*    m_screensaver;
     bool                m_screensaverNotify;
@@ -18,7 +18,8 @@
 
 #include "server/ClientProxy1_0.h"
 
-#include "core/ProtocolUtil.h"
+#include "core/ProtocolMessages.h"
+#include "core/StreamChunker.h"
 #include "core/XSynergy.h"
 #include "io/IStream.h"
 #include "base/Log.h"
@@ -35,6 +36,7 @@ ClientProxy1_0::ClientProxy1_0(const String& name, synergy::IStream* stream, IEv
     ClientProxy(name, stream),
     m_heartbeatTimer(NULL),
     m_parser(&ClientProxy1_0::parseHandshakeMessage),
+    m_messages(&getMessages()),
     m_events(events)
 {
     // install event handlers
@@ -61,7 +63,7 @@ ClientProxy1_0::ClientProxy1_0(const String& name, synergy::IStream* stream, IEv
     setHeartbeatRate(kHeartRate, kHeartRate * kHeartBeatsUntilDeath);
 
     LOG((CLOG_DEBUG1 "querying client \"%s\" info", getName().c_str()));
-    ProtocolUtil::writef(getStream(), kMsgQInfo);
+    synergy::protocol::QInfo::send(getStream());
 }
 
 ClientProxy1_0::~ClientProxy1_0()
@@ -185,26 +187,32 @@ ClientProxy1_0::parseHandshakeMessage(const UInt8* code)
 bool
 ClientProxy1_0::parseMessage(const UInt8* code)
 {
-    if (memcmp(code, kMsgDInfo, 4) == 0) {
-        if (recvInfo()) {
-            m_events->addEvent(
-                            Event(m_events->forIScreen().shapeChanged(), getEventTarget()));
-            return true;
-        }
-        return false;
-    }
-    else if (memcmp(code, kMsgCNoop, 4) == 0) {
-        // discard no-ops
-        LOG((CLOG_DEBUG2 "no-op from", getName().c_str()));
-        return true;
-    }
-    else if (memcmp(code, kMsgCClipboard, 4) == 0) {
-        return recvGrabClipboard();
-    }
-    else if (memcmp(code, kMsgDClipboard, 4) == 0) {
-        return recvClipboard();
-    }
-    return false;
+    const MessageHandler* handler = m_messages->find(code);
+    return (handler != NULL && (this->*(*handler))());
+}
+
+const ClientProxy1_0::MessageTable&
+ClientProxy1_0::getMessages()
+{
+    static const MessageTable s_messages = makeMessages();
+    return s_messages;
+}
+
+ClientProxy1_0::MessageTable
+ClientProxy1_0::makeMessages()
+{
+    MessageTable table;
+    table.add(kMsgDInfo,      &ClientProxy1_0::recvInfoChanged);
+    table.add(kMsgCNoop,      &ClientProxy1_0::recvNoop);
+    table.add(kMsgCClipboard, &ClientProxy1_0::recvGrabClipboard);
+    table.add(kMsgDClipboard, &ClientProxy1_0::recvClipboard);
+    return table;
+}
+
+void
+ClientProxy1_0::setMessages(const MessageTable* messages)
+{
+    m_messages = messages;
 }
 
 void
@@ -258,7 +266,7 @@ ClientProxy1_0::enter(SInt32 xAbs, SInt32 yAbs,
                 UInt32 seqNum, KeyModifierMask mask, bool)
 {
     LOG((CLOG_DEBUG1 "send enter to \"%s\", %d,%d %d %04x", getName().c_str(), xAbs, yAbs, seqNum, mask));
-    ProtocolUtil::writef(getStream(), kMsgCEnter,
+    synergy::protocol::CEnter::send(getStream(),
                                 xAbs, yAbs, seqNum, mask);
 }
 
@@ -266,7 +274,7 @@ bool
 ClientProxy1_0::leave()
 {
     LOG((CLOG_DEBUG1 "send leave to \"%s\"", getName().c_str()));
-    ProtocolUtil::writef(getStream(), kMsgCLeave);
+    synergy::protocol::CLeave::send(getStream());
 
     // we can never prevent the user from leaving
     return true;
@@ -282,7 +290,7 @@ void
 ClientProxy1_0::grabClipboard(ClipboardID id)
 {
     LOG((CLOG_DEBUG "send grab clipboard %d to \"%s\"", id, getName().c_str()));
-    ProtocolUtil::writef(getStream(), kMsgCClipboard, id, 0);
+    synergy::protocol::CClipboard::send(getStream(), id, 0);
 
     // this clipboard is now dirty
     m_clipboard[id].m_dirty = true;
@@ -298,7 +306,7 @@ void
 ClientProxy1_0::keyDown(KeyID key, KeyModifierMask mask, KeyButton)
 {
     LOG((CLOG_DEBUG1 "send key down to \"%s\" id=%d, mask=0x%04x", getName().c_str(), key, mask));
-    ProtocolUtil::writef(getStream(), kMsgDKeyDown1_0, key, mask);
+    synergy::protocol::DKeyDown1_0::send(getStream(), key, mask);
 }
 
 void
@@ -306,35 +314,35 @@ ClientProxy1_0::keyRepeat(KeyID key, KeyModifierMask mask,
                 SInt32 count, KeyButton)
 {
     LOG((CLOG_DEBUG1 "send key repeat to \"%s\" id=%d, mask=0x%04x, count=%d", getName().c_str(), key, mask, count));
-    ProtocolUtil::writef(getStream(), kMsgDKeyRepeat1_0, key, mask, count);
+    synergy::protocol::DKeyRepeat1_0::send(getStream(), key, mask, count);
 }
 
 void
 ClientProxy1_0::keyUp(KeyID key, KeyModifierMask mask, KeyButton)
 {
     LOG((CLOG_DEBUG1 "send key up to \"%s\" id=%d, mask=0x%04x", getName().c_str(), key, mask));
-    ProtocolUtil::writef(getStream(), kMsgDKeyUp1_0, key, mask);
+    synergy::protocol::DKeyUp1_0::send(getStream(), key, mask);
 }
 
 void
 ClientProxy1_0::mouseDown(ButtonID button)
 {
     LOG((CLOG_DEBUG1 "send mouse down to \"%s\" id=%d", getName().c_str(), button));
-    ProtocolUtil::writef(getStream(), kMsgDMouseDown, button);
+    synergy::protocol::DMouseDown::send(getStream(), button);
 }
 
 void
 ClientProxy1_0::mouseUp(ButtonID button)
 {
     LOG((CLOG_DEBUG1 "send mouse up to \"%s\" id=%d", getName().c_str(), button));
-    ProtocolUtil::writef(getStream(), kMsgDMouseUp, button);
+    synergy::protocol::DMouseUp::send(getStream(), button);
 }
 
 void
 ClientProxy1_0::mouseMove(SInt32 xAbs, SInt32 yAbs)
 {
     LOG((CLOG_DEBUG2 "send mouse move to \"%s\" %d,%d", getName().c_str(), xAbs, yAbs));
-    ProtocolUtil::writef(getStream(), kMsgDMouseMove, xAbs, yAbs);
+    synergy::protocol::DMouseMove::send(getStream(), xAbs, yAbs);
 }
 
 void
@@ -348,7 +356,7 @@ ClientProxy1_0::mouseWheel(SInt32, SInt32 yDelta)
 {
     // clients prior to 1.3 only support the y axis
     LOG((CLOG_DEBUG2 "send mouse wheel to \"%s\" %+d", getName().c_str(), yDelta));
-    ProtocolUtil::writef(getStream(), kMsgDMouseWheel1_0, yDelta);
+    synergy::protocol::DMouseWheel1_0::send(getStream(), yDelta);
 }
 
 void
@@ -363,20 +371,23 @@ ClientProxy1_0::fileChunkSending(UInt8 mark, char* data, size_t dataSize)
 {
     // ignore -- not supported in protocol 1.0
     LOG((CLOG_DEBUG "fileChunkSending not supported"));
+
+    // let the sender carry on
+    StreamChunker::fileChunksFlushed(1);
 }
 
 void
 ClientProxy1_0::screensaver(bool on)
 {
     LOG((CLOG_DEBUG1 "send screen saver to \"%s\" on=%d", getName().c_str(), on ? 1 : 0));
-    ProtocolUtil::writef(getStream(), kMsgCScreenSaver, on ? 1 : 0);
+    synergy::protocol::CScreenSaver::send(getStream(), on ? 1 : 0);
 }
 
 void
 ClientProxy1_0::resetOptions()
 {
     LOG((CLOG_DEBUG1 "send reset options to \"%s\"", getName().c_str()));
-    ProtocolUtil::writef(getStream(), kMsgCResetOptions);
+    synergy::protocol::CResetOptions::send(getStream());
 
     // reset heart rate and death
     resetHeartbeatRate();
@@ -388,7 +399,7 @@ void
 ClientProxy1_0::setOptions(const OptionsList& options)
 {
     LOG((CLOG_DEBUG1 "send set options to \"%s\" size=%d", getName().c_str(), options.size()));
-    ProtocolUtil::writef(getStream(), kMsgDSetOptions, &options);
+    synergy::protocol::DSetOptions::send(getStream(), options);
 
     // check options
     for (UInt32 i = 0, n = (UInt32)options.size(); i < n; i += 2) {
@@ -409,8 +420,8 @@ ClientProxy1_0::recvInfo()
 {
     // parse the message
     SInt16 x, y, w, h, dummy1, mx, my;
-    if (!ProtocolUtil::readf(getStream(), kMsgDInfo + 4,
-                            &x, &y, &w, &h, &dummy1, &mx, &my)) {
+    if (!synergy::protocol::DInfo::receive(getStream(),
+                            x, y, w, h, dummy1, mx, my)) {
         return false;
     }
     LOG((CLOG_DEBUG "received client \"%s\" info shape=%d,%d %dx%d at %d,%d", getName().c_str(), x, y, w, h, mx, my));
@@ -434,7 +445,26 @@ ClientProxy1_0::recvInfo()
 
     // acknowledge receipt
     LOG((CLOG_DEBUG1 "send info ack to \"%s\"", getName().c_str()));
-    ProtocolUtil::writef(getStream(), kMsgCInfoAck);
+    synergy::protocol::CInfoAck::send(getStream());
+    return true;
+}
+
+bool
+ClientProxy1_0::recvInfoChanged()
+{
+    if (recvInfo()) {
+        m_events->addEvent(
+                        Event(m_events->forIScreen().shapeChanged(), getEventTarget()));
+        return true;
+    }
+    return false;
+}
+
+bool
+ClientProxy1_0::recvNoop()
+{
+    // discard no-ops
+    LOG((CLOG_DEBUG2 "no-op from", getName().c_str()));
     return true;
 }
 
@@ -451,7 +481,7 @@ ClientProxy1_0::recvGrabClipboard()
     // parse message
     ClipboardID id;
     UInt32 seqNum;
-    if (!ProtocolUtil::readf(getStream(), kMsgCClipboard + 4, &id, &seqNum)) {
+    if (!synergy::protocol::CClipboard::receive(getStream(), id, seqNum)) {
         return false;
     }
     LOG((CLOG_DEBUG "received client \"%s\" grabbed clipboard %d seqnum=%d", getName().c_str(), id, seqNum));
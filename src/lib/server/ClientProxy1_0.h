@@ -20,9 +20,10 @@
 
 #include "server/ClientProxy.h"
 #include "core/Clipboard.h"
+#include "core/ProtocolMessages.h"
 #include "core/protocol_types.h"
+#include "base/Event.h"
 
-class Event;
 class EventQueueTimer;
 class IEventQueue;
 
@@ -61,7 +62,24 @@ public:
     virtual void        sendDragInfo(UInt32 fileCount, const char* info, size_t size);
     virtual void        fileChunkSending(UInt8 mark, char* data, size_t dataSize);
 
+#ifdef TEST_ENV
+    void                handleDataForTest() { handleData(Event(), NULL); }
+#endif
+
 protected:
+    typedef bool (ClientProxy1_0::*MessageHandler)();
+    typedef synergy::protocol::MessageTable<MessageHandler> MessageTable;
+
+    //! Get the messages handled after the handshake
+    static const MessageTable&    getMessages();
+
+    //! Set the messages handled after the handshake
+    /*!
+    A proxy for a later protocol version sets a table that adds its
+    own messages to its parent's.
+    */
+    void                setMessages(const MessageTable* messages);
+
     virtual bool        parseHandshakeMessage(const UInt8* code);
     virtual bool        parseMessage(const UInt8* code);
 
@@ -81,8 +99,12 @@ private:
     void                handleFlatline(const Event&, void*);
 
     bool                recvInfo();
+    bool                recvInfoChanged();
+    bool                recvNoop();
     bool                recvGrabClipboard();
 
+    static MessageTable    makeMessages();
+
 protected:
     struct ClientClipboard {
     public:
@@ -103,5 +125,6 @@ private:
     double                m_heartbeatAlarm;
     EventQueueTimer*    m_heartbeatTimer;
     MessageParser        m_parser;
+    const MessageTable*    m_messages;
     IEventQueue*        m_events;
 };
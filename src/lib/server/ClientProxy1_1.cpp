@@ -18,7 +18,7 @@
 
 #include "server/ClientProxy1_1.h"
 
-#include "core/ProtocolUtil.h"
+#include "core/ProtocolMessages.h"
 #include "base/Log.h"
 
 #include <cstring>
@@ -42,7 +42,7 @@ void
 ClientProxy1_1::keyDown(KeyID key, KeyModifierMask mask, KeyButton button)
 {
     LOG((CLOG_DEBUG1 "send key down to \"%s\" id=%d, mask=0x%04x, button=0x%04x", getName().c_str(), key, mask, button));
-    ProtocolUtil::writef(getStream(), kMsgDKeyDown, key, mask, button);
+    synergy::protocol::DKeyDown::send(getStream(), key, mask, button);
 }
 
 void
@@ -50,12 +50,12 @@ ClientProxy1_1::keyRepeat(KeyID key, KeyModifierMask mask,
                 SInt32 count, KeyButton button)
 {
     LOG((CLOG_DEBUG1 "send key repeat to \"%s\" id=%d, mask=0x%04x, count=%d, button=0x%04x", getName().c_str(), key, mask, count, button));
-    ProtocolUtil::writef(getStream(), kMsgDKeyRepeat, key, mask, count, button);
+    synergy::protocol::DKeyRepeat::send(getStream(), key, mask, count, button);
 }
 
 void
 ClientProxy1_1::keyUp(KeyID key, KeyModifierMask mask, KeyButton button)
 {
     LOG((CLOG_DEBUG1 "send key up to \"%s\" id=%d, mask=0x%04x, button=0x%04x", getName().c_str(), key, mask, button));
-    ProtocolUtil::writef(getStream(), kMsgDKeyUp, key, mask, button);
+    synergy::protocol::DKeyUp::send(getStream(), key, mask, button);
 }
@@ -18,7 +18,7 @@
 
 #include "server/ClientProxy1_3.h"
 
-#include "core/ProtocolUtil.h"
+#include "core/ProtocolMessages.h"
 #include "base/Log.h"
 #include "base/IEventQueue.h"
 #include "base/TMethodEventJob.h"
@@ -37,6 +37,7 @@ ClientProxy1_3::ClientProxy1_3(const String& name, synergy::IStream* stream, IEv
     m_events(events)
 {
     setHeartbeatRate(kKeepAliveRate, kKeepAliveRate * kKeepAlivesUntilDeath);
+    setMessages(&getMessages());
 }
 
 ClientProxy1_3::~ClientProxy1_3()
@@ -49,21 +50,31 @@ void
 ClientProxy1_3::mouseWheel(SInt32 xDelta, SInt32 yDelta)
 {
     LOG((CLOG_DEBUG2 "send mouse wheel to \"%s\" %+d,%+d", getName().c_str(), xDelta, yDelta));
-    ProtocolUtil::writef(getStream(), kMsgDMouseWheel, xDelta, yDelta);
+    synergy::protocol::DMouseWheel::send(getStream(), xDelta, yDelta);
+}
+
+const ClientProxy1_0::MessageTable&
+ClientProxy1_3::getMessages()
+{
+    static const MessageTable s_messages = makeMessages();
+    return s_messages;
+}
+
+ClientProxy1_0::MessageTable
+ClientProxy1_3::makeMessages()
+{
+    MessageTable table(ClientProxy1_2::getMessages());
+    table.add(kMsgCKeepAlive, static_cast<MessageHandler>(
+                            &ClientProxy1_3::recvKeepAlive));
+    return table;
 }
 
 bool
-ClientProxy1_3::parseMessage(const UInt8* code)
+ClientProxy1_3::recvKeepAlive()
 {
-    // process message
-    if (memcmp(code, kMsgCKeepAlive, 4) == 0) {
-        // reset alarm
-        resetHeartbeatTimer();
-        return true;
-    }
-    else {
-        return ClientProxy1_2::parseMessage(code);
-    }
+    // reset alarm
+    resetHeartbeatTimer();
+    return true;
 }
 
 void
@@ -125,5 +136,5 @@ ClientProxy1_3::handleKeepAlive(const Event&, void*)
 void
 ClientProxy1_3::keepAlive()
 {
-    ProtocolUtil::writef(getStream(), kMsgCKeepAlive);
+    synergy::protocol::CKeepAlive::send(getStream());
 }
@@ -32,8 +32,10 @@ public:
     void                handleKeepAlive(const Event&, void*);
 
 protected:
+    //! Get the messages handled after the handshake
+    static const MessageTable&    getMessages();
+
     // ClientProxy overrides
-    virtual bool        parseMessage(const UInt8* code);
     virtual void        resetHeartbeatRate();
     virtual void        setHeartbeatRate(double rate, double alarm);
     virtual void        resetHeartbeatTimer();
@@ -41,6 +43,11 @@ protected:
     virtual void        removeHeartbeatTimer();
     virtual void        keepAlive();
 
+private:
+    bool                recvKeepAlive();
+
+    static MessageTable    makeMessages();
+
 private:
     double                m_keepAliveRate;
     EventQueueTimer*    m_keepAliveTimer;
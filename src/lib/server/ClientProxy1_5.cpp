@@ -20,7 +20,7 @@
 #include "server/Server.h"
 #include "core/FileChunk.h"
 #include "core/StreamChunker.h"
-#include "core/ProtocolUtil.h"
+#include "core/ProtocolMessages.h"
 #include "io/IStream.h"
 #include "base/TMethodEventJob.h"
 #include "base/Log.h"
@@ -33,18 +33,34 @@
 
 ClientProxy1_5::ClientProxy1_5(const String& name, synergy::IStream* stream, Server* server, IEventQueue* events) :
     ClientProxy1_4(name, stream, server, events),
-    m_events(events)
+    m_events(events),
+    m_fileChunksUnflushed(0)
 {
 
     m_events->adoptHandler(m_events->forFile().keepAlive(),
                             this,
                             new TMethodEventJob<ClientProxy1_3>(this,
                                 &ClientProxy1_3::handleKeepAlive, NULL));
+
+    // let the file sender know when its chunks have gone out
+    m_events->adoptHandler(m_events->forIStream().outputFlushed(),
+                            getStream()->getEventTarget(),
+                            new TMethodEventJob<ClientProxy1_5>(this,
+                                &ClientProxy1_5::handleOutputFlushed));
+
+    setMessages(&getMessages());
 }
 
 ClientProxy1_5::~ClientProxy1_5()
 {
     m_events->removeHandler(m_events->forFile().keepAlive(), this);
+    m_events->removeHandler(m_events->forIStream().outputFlushed(),
+                            getStream()->getEventTarget());
+
+    // the chunks won't be flushed now so don't leave the sender waiting
+    if (m_fileChunksUnflushed > 0) {
+        StreamChunker::interruptFile();
+    }
 }
 
 void
@@ -52,32 +68,44 @@ ClientProxy1_5::sendDragInfo(UInt32 fileCount, const char* info, size_t size)
 {
     String data(info, size);
 
-    ProtocolUtil::writef(getStream(), kMsgDDragInfo, fileCount, &data);
+    synergy::protocol::DDragInfo::send(getStream(), fileCount, data);
 }
 
 void
 ClientProxy1_5::fileChunkSending(UInt8 mark, char* data, size_t dataSize)
 {
     FileChunk::send(getStream(), mark, data, dataSize);
+    ++m_fileChunksUnflushed;
 }
 
-bool
-ClientProxy1_5::parseMessage(const UInt8* code)
+void
+ClientProxy1_5::handleOutputFlushed(const Event&, void*)
 {
-    if (memcmp(code, kMsgDFileTransfer, 4) == 0) {
-        fileChunkReceived();
-    }
-    else if (memcmp(code, kMsgDDragInfo, 4) == 0) {
-        dragInfoReceived();
-    }
-    else {
-        return ClientProxy1_4::parseMessage(code);
+    if (m_fileChunksUnflushed > 0) {
+        StreamChunker::fileChunksFlushed(m_fileChunksUnflushed);
+        m_fileChunksUnflushed = 0;
     }
+}
 
-    return true;
+const ClientProxy1_0::MessageTable&
+ClientProxy1_5::getMessages()
+{
+    static const MessageTable s_messages = makeMessages();
+    return s_messages;
 }
 
-void
+ClientProxy1_0::MessageTable
+ClientProxy1_5::makeMessages()
+{
+    MessageTable table(ClientProxy1_4::getMessages());
+    table.add(kMsgDFileTransfer, static_cast<MessageHandler>(
+                            &ClientProxy1_5::fileChunkReceived));
+    table.add(kMsgDDragInfo, static_cast<MessageHandler>(
+                            &ClientProxy1_5::dragInfoReceived));
+    return table;
+}
+
+bool
 ClientProxy1_5::fileChunkReceived()
 {
     Server* server = getServer();
@@ -96,15 +124,17 @@ ClientProxy1_5::fileChunkReceived()
             LOG((CLOG_DEBUG "start receiving %s", filename.c_str()));
         }
     }
+    return true;
 }
 
-void
+bool
 ClientProxy1_5::dragInfoReceived()
 {
     // parse
     UInt32 fileNum = 0;
     String content;
-    ProtocolUtil::readf(getStream(), kMsgDDragInfo + 4, &fileNum, &content);
+    synergy::protocol::DDragInfo::receive(getStream(), fileNum, content);
     
     m_server->dragInfoReceived(fileNum, content);
+    return true;
 }
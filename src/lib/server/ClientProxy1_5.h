@@ -32,10 +32,20 @@ public:
 
     virtual void        sendDragInfo(UInt32 fileCount, const char* info, size_t size);
     virtual void        fileChunkSending(UInt8 mark, char* data, size_t dataSize);
-    virtual bool        parseMessage(const UInt8* code);
-    void                fileChunkReceived();
-    void                dragInfoReceived();
+    bool                fileChunkReceived();
+    bool                dragInfoReceived();
+
+protected:
+    //! Get the messages handled after the handshake
+    static const MessageTable&    getMessages();
+
+private:
+    static MessageTable    makeMessages();
+    void                handleOutputFlushed(const Event&, void*);
 
 private:
     IEventQueue*        m_events;
+
+    // file chunks written since the stream last flushed
+    UInt32                m_fileChunksUnflushed;
 };
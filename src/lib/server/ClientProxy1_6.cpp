@@ -64,7 +64,8 @@ ClientProxy1_6::setClipboard(ClipboardID id, const IClipboard* clipboard)
 void
 ClientProxy1_6::handleClipboardSendingEvent(const Event& event, void*)
 {
-    ClipboardChunk::send(getStream(), event.getData());
+    ClipboardChunk::send(getStream(),
+                            static_cast<ClipboardChunk*>(event.getDataObject()));
 }
 
 bool
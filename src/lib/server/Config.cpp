@@ -768,6 +768,9 @@ Config::readSectionOptions(ConfigReadContext& s)
 		else if (name == "clipboardSharing") {
 			addOption("", kOptionClipboardSharing, s.parseBoolean(value));
 		}
+		else if (name == "noopReplies") {
+			addOption("", kOptionNoopReplies, s.parseNoopReplies(value));
+		}
 
 		else {
 			handled = false;
@@ -912,6 +915,10 @@ Config::readSectionScreens(ConfigReadContext& s)
 				addOption(screen, kOptionXTestXineramaUnaware,
 					s.parseBoolean(value));
 			}
+			else if (name == "clipboardIgnoreTargets") {
+				addOption(screen, kOptionXClipboardIgnoreTargets,
+					s.parseBoolean(value));
+			}
 			else if (name == "switchCorners") {
 				addOption(screen, kOptionScreenSwitchCorners,
 					s.parseCorners(value));
@@ -1371,6 +1378,9 @@ Config::getOptionName(OptionID id)
 	if (id == kOptionXTestXineramaUnaware) {
 		return "xtestIsXineramaUnaware";
 	}
+	if (id == kOptionXClipboardIgnoreTargets) {
+		return "clipboardIgnoreTargets";
+	}
 	if (id == kOptionRelativeMouseMoves) {
 		return "relativeMouseMoves";
 	}
@@ -1383,6 +1393,9 @@ Config::getOptionName(OptionID id)
 	if (id == kOptionClipboardSharing) {
 		return "clipboardSharing";
 	}
+	if (id == kOptionNoopReplies) {
+		return "noopReplies";
+	}
 	return NULL;
 }
 
@@ -1397,6 +1410,7 @@ Config::getOptionValue(OptionID id, OptionValue value)
 		id == kOptionScreenSwitchNeedsAlt ||
 		id == kOptionScreenSaverSync ||
 		id == kOptionXTestXineramaUnaware ||
+		id == kOptionXClipboardIgnoreTargets ||
 		id == kOptionRelativeMouseMoves ||
 		id == kOptionWin32KeepForeground ||
 		id == kOptionScreenPreserveFocus ||
@@ -1454,6 +1468,24 @@ Config::getOptionValue(OptionID id, OptionValue value)
 		}
 		return result;
 	}
+	if (id == kOptionNoopReplies) {
+		switch (value) {
+		case kNoopRepliesPerMessage:
+			return "message";
+
+		case kNoopRepliesPerBatch:
+			return "batch";
+
+		case kNoopRepliesCoalesced:
+			return "timer";
+
+		case kNoopRepliesNone:
+			return "none";
+
+		default:
+			return "message";
+		}
+	}
 
 	return "";
 }
@@ -1999,6 +2031,24 @@ ConfigReadContext::parseModifierKey(const String& arg) const
 	throw XConfigRead(*this, "invalid argument \"%{1}\"", arg);
 }
 
+OptionValue
+ConfigReadContext::parseNoopReplies(const String& arg) const
+{
+	if (CaselessCmp::equal(arg, "message")) {
+		return static_cast<OptionValue>(kNoopRepliesPerMessage);
+	}
+	if (CaselessCmp::equal(arg, "batch")) {
+		return static_cast<OptionValue>(kNoopRepliesPerBatch);
+	}
+	if (CaselessCmp::equal(arg, "timer")) {
+		return static_cast<OptionValue>(kNoopRepliesCoalesced);
+	}
+	if (CaselessCmp::equal(arg, "none")) {
+		return static_cast<OptionValue>(kNoopRepliesNone);
+	}
+	throw XConfigRead(*this, "invalid argument \"%{1}\"", arg);
+}
+
 OptionValue
 ConfigReadContext::parseCorner(const String& arg) const
 {
@@ -24,6 +24,7 @@
 #include "base/Log.h"
 #include "base/TMethodEventJob.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 
@@ -89,6 +90,12 @@ InputFilter::KeystrokeCondition::getMask() const
     return m_mask;
 }
 
+UInt32
+InputFilter::KeystrokeCondition::getID() const
+{
+    return m_id;
+}
+
 InputFilter::Condition*
 InputFilter::KeystrokeCondition::clone() const
 {
@@ -177,6 +184,14 @@ InputFilter::MouseButtonCondition::getMask() const
     return m_mask;
 }
 
+KeyModifierMask
+InputFilter::MouseButtonCondition::getIgnoredMask()
+{
+    // modifiers that cannot be combined with a mouse button
+    return KeyModifierAltGr | KeyModifierCapsLock |
+            KeyModifierNumLock | KeyModifierScrollLock;
+}
+
 InputFilter::Condition*
 InputFilter::MouseButtonCondition::clone() const
 {
@@ -196,10 +211,6 @@ InputFilter::MouseButtonCondition::format() const
 InputFilter::EFilterStatus        
 InputFilter::MouseButtonCondition::match(const Event& event)
 {
-    static const KeyModifierMask s_ignoreMask =
-        KeyModifierAltGr | KeyModifierCapsLock |
-        KeyModifierNumLock | KeyModifierScrollLock;
-
     EFilterStatus status;
 
     // check for hotkey events
@@ -219,7 +230,7 @@ InputFilter::MouseButtonCondition::match(const Event& event)
     IPlatformScreen::ButtonInfo* minfo =
         static_cast<IPlatformScreen::ButtonInfo*>(event.getData());
     if (minfo->m_button != m_button ||
-        (minfo->m_mask & ~s_ignoreMask) != m_mask) {
+        (minfo->m_mask & ~getIgnoredMask()) != m_mask) {
         return kNoMatch;
     }
 
@@ -889,7 +900,8 @@ InputFilter::Rule::getAction(bool onActivation, UInt32 index) const
 // -----------------------------------------------------------------------------
 InputFilter::InputFilter(IEventQueue* events) :
     m_primaryClient(NULL),
-    m_events(events)
+    m_events(events),
+    m_compiled(false)
 {
     // do nothing
 }
@@ -897,7 +909,8 @@ InputFilter::InputFilter(IEventQueue* events) :
 InputFilter::InputFilter(const InputFilter& x) :
     m_ruleList(x.m_ruleList),
     m_primaryClient(NULL),
-    m_events(x.m_events)
+    m_events(x.m_events),
+    m_compiled(false)
 {
     setPrimaryClient(x.m_primaryClient);
 }
@@ -915,6 +928,7 @@ InputFilter::operator=(const InputFilter& x)
         setPrimaryClient(NULL);
 
         m_ruleList = x.m_ruleList;
+        m_compiled = false;
 
         setPrimaryClient(oldClient);
     }
@@ -928,6 +942,7 @@ InputFilter::addFilterRule(const Rule& rule)
     if (m_primaryClient != NULL) {
         m_ruleList.back().enable(m_primaryClient);
     }
+    m_compiled = false;
 }
 
 void
@@ -937,11 +952,14 @@ InputFilter::removeFilterRule(UInt32 index)
         m_ruleList[index].disable(m_primaryClient);
     }
     m_ruleList.erase(m_ruleList.begin() + index);
+    m_compiled = false;
 }
 
 InputFilter::Rule&
 InputFilter::getRule(UInt32 index)
 {
+    // the caller may change the condition
+    m_compiled = false;
     return m_ruleList[index];
 }
 
@@ -976,7 +994,9 @@ InputFilter::setPrimaryClient(PrimaryClient* client)
                             m_primaryClient->getEventTarget());
     }
 
+    // enabling and disabling changes the hotkey ids
     m_primaryClient = client;
+    m_compiled      = false;
 
     if (m_primaryClient != NULL) {
         m_events->adoptHandler(m_events->forIKeyState().keyDown(),
@@ -1076,15 +1096,103 @@ InputFilter::handleEvent(const Event& event, void*)
                                 event.getFlags() | Event::kDontFreeData |
                                 Event::kDeliverImmediately);
 
-    // let each rule try to match the event until one does
-    for (RuleList::iterator rule  = m_ruleList.begin();
-                             rule != m_ruleList.end(); ++rule) {
-        if (rule->handleEvent(myEvent)) {
+    if (!m_compiled) {
+        compileRules();
+    }
+
+    // find the first rule for the hotkey or mouse button.  no keystroke
+    // or mouse button condition matches any other event.
+    RuleIndex::const_iterator indexed = m_ruleIndex.end();
+    Event::Type type = event.getType();
+    if (type == m_events->forIPrimaryScreen().hotKeyDown() ||
+        type == m_events->forIPrimaryScreen().hotKeyUp()) {
+        IPrimaryScreen::HotKeyInfo* kinfo =
+            static_cast<IPlatformScreen::HotKeyInfo*>(event.getData());
+        indexed = m_ruleIndex.find(RuleKey(kHotKeyRule, kinfo->m_id, 0));
+    }
+    else if (type == m_events->forIPrimaryScreen().buttonDown() ||
+             type == m_events->forIPrimaryScreen().buttonUp()) {
+        IPlatformScreen::ButtonInfo* minfo =
+            static_cast<IPlatformScreen::ButtonInfo*>(event.getData());
+        indexed = m_ruleIndex.find(RuleKey(kButtonRule, minfo->m_button,
+                    minfo->m_mask & ~MouseButtonCondition::getIgnoredMask()));
+    }
+    UInt32 first = static_cast<UInt32>(m_ruleList.size());
+    if (indexed != m_ruleIndex.end()) {
+        first = indexed->second;
+    }
+
+    // let each other rule before it try to match the event until one does
+    for (RuleIndexList::const_iterator i  = m_otherRules.begin();
+                        i != m_otherRules.end() && *i < first; ++i) {
+        if (m_ruleList[*i].handleEvent(myEvent)) {
             // handled
             return;
         }
     }
+    if (first < m_ruleList.size() && m_ruleList[first].handleEvent(myEvent)) {
+        // handled
+        return;
+    }
 
     // not handled so pass through
     m_events->addEvent(myEvent);
 }
+
+void
+InputFilter::compileRules()
+{
+    m_ruleIndex.clear();
+    m_otherRules.clear();
+    for (UInt32 i = 0; i < m_ruleList.size(); ++i) {
+        const Condition* condition = m_ruleList[i].getCondition();
+        if (condition == NULL) {
+            // never matches
+            continue;
+        }
+
+        // insert() keeps the earlier rule for a duplicate key
+        const KeystrokeCondition* keystroke =
+            dynamic_cast<const KeystrokeCondition*>(condition);
+        const MouseButtonCondition* button =
+            dynamic_cast<const MouseButtonCondition*>(condition);
+        if (keystroke != NULL) {
+            m_ruleIndex.insert(std::make_pair(
+                            RuleKey(kHotKeyRule, keystroke->getID(), 0), i));
+        }
+        else if (button != NULL) {
+            m_ruleIndex.insert(std::make_pair(
+                            RuleKey(kButtonRule, button->getButton(),
+                                button->getMask()), i));
+        }
+        else {
+            m_otherRules.push_back(i);
+        }
+    }
+    m_compiled = true;
+}
+
+//
+// InputFilter::RuleKey
+//
+
+InputFilter::RuleKey::RuleKey(ERuleKind kind,
+                UInt32 id, KeyModifierMask mask) :
+    m_kind(kind),
+    m_id(id),
+    m_mask(mask)
+{
+    // do nothing
+}
+
+bool
+InputFilter::RuleKey::operator<(const RuleKey& x) const
+{
+    if (m_kind != x.m_kind) {
+        return (m_kind < x.m_kind);
+    }
+    if (m_id != x.m_id) {
+        return (m_id < x.m_id);
+    }
+    return (m_mask < x.m_mask);
+}
@@ -25,6 +25,7 @@
 #include "base/String.h"
 #include "common/stdmap.h"
 #include "common/stdset.h"
+#include "common/stdvector.h"
 
 class PrimaryClient;
 class Event;
@@ -65,6 +66,9 @@ public:
         KeyID                    getKey() const;
         KeyModifierMask            getMask() const;
 
+        // get the id of the registered hotkey, 0 if it isn't registered
+        UInt32                    getID() const;
+
         // Condition overrides
         virtual Condition*        clone() const;
         virtual String            format() const;
@@ -89,6 +93,9 @@ public:
         ButtonID                getButton() const;
         KeyModifierMask            getMask() const;
 
+        // get the modifiers that are ignored when matching
+        static KeyModifierMask    getIgnoredMask();
+
         // Condition overrides
         virtual Condition*        clone() const;
         virtual String            format() const;
@@ -321,7 +328,7 @@ public:
     virtual ~InputFilter();
 
 #ifdef TEST_ENV
-    InputFilter() : m_primaryClient(NULL) { }
+    InputFilter() : m_primaryClient(NULL), m_compiled(false) { }
 #endif
 
     InputFilter&        operator=(const InputFilter&);
@@ -332,7 +339,7 @@ public:
     // remove a rule
     void                removeFilterRule(UInt32 index);
 
-    // get rule by index
+    // get rule by index.  the rule may be changed until the next event.
     Rule&                getRule(UInt32 index);
 
     // enable event filtering using the given primary client.  disable
@@ -351,11 +358,43 @@ public:
     bool                operator!=(const InputFilter&) const;
 
 private:
+    // what a rule is indexed by.  a keystroke is found by the id its
+    // hotkey was registered with and a mouse button by the button and
+    // modifiers.
+    enum ERuleKind {
+        kHotKeyRule,
+        kButtonRule
+    };
+
+    class RuleKey {
+    public:
+        RuleKey(ERuleKind kind, UInt32 id, KeyModifierMask mask);
+
+        bool            operator<(const RuleKey&) const;
+
+    public:
+        ERuleKind        m_kind;
+        UInt32            m_id;
+        KeyModifierMask    m_mask;
+    };
+
+    // maps a hotkey or mouse button to the first rule for it
+    typedef std::map<RuleKey, UInt32> RuleIndex;
+    typedef std::vector<UInt32> RuleIndexList;
+
     // event handling
     void                handleEvent(const Event&, void*);
 
+    // index the rules.  rules with other conditions go in m_otherRules.
+    void                compileRules();
+
 private:
     RuleList            m_ruleList;
     PrimaryClient*        m_primaryClient;
     IEventQueue*        m_events;
+
+    // the rules indexed.  only valid if m_compiled is true.
+    RuleIndex            m_ruleIndex;
+    RuleIndexList        m_otherRules;
+    bool                m_compiled;
 };
@@ -20,6 +20,7 @@
 
 #include "core/Screen.h"
 #include "core/Clipboard.h"
+#include "core/StreamChunker.h"
 #include "base/Log.h"
 
 //
@@ -76,6 +77,12 @@ PrimaryClient::fakeInputEnd()
     }
 }
 
+bool
+PrimaryClient::fetchClipboard(ClipboardID id, UInt32 seqNum)
+{
+    return m_screen->fetchClipboard(id, seqNum);
+}
+
 SInt32
 PrimaryClient::getJumpZoneSize() const
 {
@@ -258,7 +265,8 @@ PrimaryClient::sendDragInfo(UInt32 fileCount, const char* info, size_t size)
 void
 PrimaryClient::fileChunkSending(UInt8 mark, char* data, size_t dataSize)
 {
-    // ignore
+    // ignore, but let the sender carry on
+    StreamChunker::fileChunksFlushed(1);
 }
 
 void
@@ -78,6 +78,15 @@ public:
     */
     void                fakeInputEnd();
 
+    //! Fetch clipboard
+    /*!
+    Starts reading clipboard \p id in the background.  Returns false if
+    the screen can't, otherwise a clipboard changed event with sequence
+    number \p seqNum is sent when getClipboard() can return it without
+    blocking.
+    */
+    virtual bool        fetchClipboard(ClipboardID id, UInt32 seqNum);
+
     //@}
     //! @name accessors
     //@{
@@ -0,0 +1,168 @@
+/*
+ * synergy -- mouse and keyboard sharing utility
+ * Copyright (C) 2016 Symless Ltd.
+ *
+ * This package is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * found in the file LICENSE that should have accompanied this file.
+ *
+ * This package is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "server/ScreenTopology.h"
+
+#include "server/Config.h"
+
+#include <assert.h>
+
+//
+// ScreenTopology
+//
+
+ScreenTopology::ScreenTopology()
+{
+	// do nothing
+}
+
+ScreenTopology::~ScreenTopology()
+{
+	// do nothing
+}
+
+void
+ScreenTopology::compile(const Config& config)
+{
+	m_screens.clear();
+	m_links.clear();
+	m_names.clear();
+	m_clients.clear();
+
+	// number the screens by canonical name
+	for (Config::const_iterator i = config.begin(); i != config.end(); ++i) {
+		Screen screen;
+		screen.m_name   = *i;
+		screen.m_client = NULL;
+		m_names[screen.m_name] = (ScreenID)m_screens.size();
+		m_screens.push_back(screen);
+	}
+
+	// copy each screen's links.  the config orders them by side then
+	// by position so each side's links end up together.
+	for (ScreenList::iterator screen = m_screens.begin();
+								screen != m_screens.end(); ++screen) {
+		UInt32 side = 0;
+		for (Config::link_const_iterator
+								i = config.beginNeighbor(screen->m_name),
+								n = config.endNeighbor(screen->m_name);
+								i != n; ++i) {
+			const Config::CellEdge& srcEdge = i->first;
+			const Config::CellEdge& dstEdge = i->second;
+
+			// start the sides up to this link's
+			UInt32 srcSide = srcEdge.getSide() - kFirstDirection;
+			while (side <= srcSide) {
+				screen->m_sides[side++] = (UInt32)m_links.size();
+			}
+
+			NameMap::const_iterator dst =
+				m_names.find(config.getCanonicalName(dstEdge.getName()));
+			if (dst == m_names.end()) {
+				continue;
+			}
+
+			Config::Interval srcInterval = srcEdge.getInterval();
+			Config::Interval dstInterval = dstEdge.getInterval();
+			Link link;
+			link.m_start    = srcInterval.first;
+			link.m_end      = srcInterval.second;
+			link.m_dst      = dst->second;
+			link.m_dstStart = dstInterval.first;
+			link.m_dstEnd   = dstInterval.second;
+			m_links.push_back(link);
+		}
+		while (side <= kNumDirections) {
+			screen->m_sides[side++] = (UInt32)m_links.size();
+		}
+	}
+}
+
+void
+ScreenTopology::setClient(const String& name, BaseClientProxy* client)
+{
+	NameMap::const_iterator id = m_names.find(name);
+	if (id == m_names.end()) {
+		return;
+	}
+
+	Screen& screen = m_screens[id->second];
+	if (screen.m_client != NULL) {
+		m_clients.erase(screen.m_client);
+	}
+	screen.m_client = client;
+	if (client != NULL) {
+		m_clients[client] = id->second;
+	}
+}
+
+ScreenTopology::ScreenID
+ScreenTopology::getScreen(const BaseClientProxy* client) const
+{
+	ClientMap::const_iterator id = m_clients.find(client);
+	if (id == m_clients.end()) {
+		return kNoScreen;
+	}
+	return id->second;
+}
+
+BaseClientProxy*
+ScreenTopology::getClient(ScreenID id) const
+{
+	assert(id >= 0 && id < (ScreenID)m_screens.size());
+	return m_screens[id].m_client;
+}
+
+const String&
+ScreenTopology::getName(ScreenID id) const
+{
+	assert(id >= 0 && id < (ScreenID)m_screens.size());
+	return m_screens[id].m_name;
+}
+
+ScreenTopology::ScreenID
+ScreenTopology::getNeighbor(ScreenID id, EDirection dir,
+				float position, float* positionOut) const
+{
+	assert(id >= 0 && id < (ScreenID)m_screens.size());
+	assert(dir >= kFirstDirection && dir <= kLastDirection);
+
+	// a side has few links so a scan beats a search
+	const Screen& screen = m_screens[id];
+	const UInt32 side    = dir - kFirstDirection;
+	for (UInt32 i = screen.m_sides[side]; i != screen.m_sides[side + 1]; ++i) {
+		const Link& link = m_links[i];
+		if (position >= link.m_start && position < link.m_end) {
+			// same arithmetic as CellEdge::transform() and
+			// CellEdge::inverseTransform()
+			if (positionOut != NULL) {
+				float t = (position - link.m_start) /
+							(link.m_end - link.m_start);
+				*positionOut = t * (link.m_dstEnd - link.m_dstStart) +
+							link.m_dstStart;
+			}
+			return link.m_dst;
+		}
+	}
+	return kNoScreen;
+}
+
+UInt32
+ScreenTopology::getNumScreens() const
+{
+	return (UInt32)m_screens.size();
+}
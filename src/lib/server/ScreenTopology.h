@@ -0,0 +1,130 @@
+/*
+ * synergy -- mouse and keyboard sharing utility
+ * Copyright (C) 2016 Symless Ltd.
+ *
+ * This package is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * found in the file LICENSE that should have accompanied this file.
+ *
+ * This package is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "core/protocol_types.h"
+#include "base/String.h"
+#include "common/stdmap.h"
+#include "common/stdvector.h"
+
+class BaseClientProxy;
+class Config;
+
+//! Compiled screen layout
+/*!
+Holds the links between the screens of a Config in arrays indexed by
+screen, along with the client connected to each screen, so the server
+can find a neighbor when the cursor crosses an edge without looking up
+names or allocating.  It has to be compiled again when the config
+changes and told when clients connect and disconnect.
+*/
+class ScreenTopology {
+public:
+    typedef SInt32 ScreenID;
+    enum { kNoScreen = -1 };
+
+    ScreenTopology();
+    ~ScreenTopology();
+
+    //! @name manipulators
+    //@{
+
+    //! Compile a configuration
+    /*!
+    Replaces the layout with the screens and links in \c config.  No
+    screen has a client afterwards.
+    */
+    void                compile(const Config& config);
+
+    //! Set a screen's client
+    /*!
+    Sets the client on the screen with the canonical name \c name, or
+    clears it if \c client is NULL.  Does nothing if there's no such
+    screen.
+    */
+    void                setClient(const String& name, BaseClientProxy* client);
+
+    //@}
+    //! @name accessors
+    //@{
+
+    //! Get the screen a client is on
+    /*!
+    Returns the screen \c client was set on, or \c kNoScreen.
+    */
+    ScreenID            getScreen(const BaseClientProxy* client) const;
+
+    //! Get a screen's client
+    /*!
+    Returns the client on screen \c id, or NULL if it isn't connected.
+    */
+    BaseClientProxy*    getClient(ScreenID id) const;
+
+    //! Get a screen's name
+    /*!
+    Returns the canonical name of screen \c id.
+    */
+    const String&        getName(ScreenID id) const;
+
+    //! Get neighbor
+    /*!
+    Returns the neighbor of screen \c id in direction \c dir at
+    position \c position, or \c kNoScreen if there isn't one.  Saves
+    the position on the neighbor in \c positionOut if it's not NULL.
+    Same as Config::getNeighbor().
+    */
+    ScreenID            getNeighbor(ScreenID id, EDirection dir,
+                            float position, float* positionOut) const;
+
+    //! Get number of screens
+    UInt32                getNumScreens() const;
+
+    //@}
+
+private:
+    // a link from part of one screen's side to part of another's
+    class Link {
+    public:
+        float            m_start;
+        float            m_end;
+        ScreenID        m_dst;
+        float            m_dstStart;
+        float            m_dstEnd;
+    };
+
+    // a screen's links are m_links[m_sides[dir - kFirstDirection]] up to
+    // m_links[m_sides[dir - kFirstDirection + 1]]
+    class Screen {
+    public:
+        String            m_name;
+        BaseClientProxy*    m_client;
+        UInt32            m_sides[kNumDirections + 1];
+    };
+
+    typedef std::vector<Screen> ScreenList;
+    typedef std::vector<Link> LinkList;
+    typedef std::map<String, ScreenID> NameMap;
+    typedef std::map<const BaseClientProxy*, ScreenID> ClientMap;
+
+    ScreenList            m_screens;
+    LinkList            m_links;
+
+    // screens by canonical name and by connected client
+    NameMap                m_names;
+    ClientMap            m_clients;
+};
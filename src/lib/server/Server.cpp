@@ -104,6 +104,9 @@ Server::Server(
 
 	String primaryName = getName(primaryClient);
 
+	// compile the layout before any client is added to it
+	m_topology.compile(*m_config);
+
 	// clear clipboards
 	for (ClipboardID id = 0; id < kClipboardEnd; ++id) {
 		ClipboardInfo& clipboard   = m_clipboards[id];
@@ -279,6 +282,13 @@ Server::setConfig(const Config& config)
 	// configuration.
 	closeClients(config);
 
+	// recompile the layout and put the remaining clients on it
+	m_topology.compile(*m_config);
+	for (ClientList::const_iterator index = m_clients.begin();
+								index != m_clients.end(); ++index) {
+		m_topology.setClient(getName(index->second), index->second);
+	}
+
 	// cut over
 	processOptions();
 
@@ -493,11 +503,14 @@ Server::switchScreen(BaseClientProxy* dst,
 		}
 
 		// update the primary client's clipboards if we're leaving the
-		// primary screen.
+		// primary screen.  if the screen can read them in the background
+		// then they're updated when its clipboard changed event arrives.
 		if (m_active == m_primaryClient && m_enableClipboard) {
 			for (ClipboardID id = 0; id < kClipboardEnd; ++id) {
 				ClipboardInfo& clipboard = m_clipboards[id];
-				if (clipboard.m_clipboardOwner == getName(m_primaryClient)) {
+				if (clipboard.m_clipboardOwner == getName(m_primaryClient) &&
+					!m_primaryClient->fetchClipboard(id,
+						clipboard.m_clipboardSeqNum)) {
 					onClipboardChanged(m_primaryClient,
 						id, clipboard.m_clipboardSeqNum);
 				}
@@ -607,10 +620,13 @@ Server::getNeighbor(BaseClientProxy* src,
 
 	assert(src != NULL);
 
-	// get source screen name
-	String srcName = getName(src);
-	assert(!srcName.empty());
-	LOG((CLOG_DEBUG2 "find neighbor on %s of \"%s\"", Config::dirName(dir), srcName.c_str()));
+	// get source screen
+	ScreenTopology::ScreenID srcID = m_topology.getScreen(src);
+	if (srcID == ScreenTopology::kNoScreen) {
+		LOG((CLOG_DEBUG2 "no neighbor on %s of unlisted screen", Config::dirName(dir)));
+		return NULL;
+	}
+	LOG((CLOG_DEBUG2 "find neighbor on %s of \"%s\"", Config::dirName(dir), m_topology.getName(srcID).c_str()));
 
 	// convert position to fraction
 	float t = mapToFraction(src, dir, x, y);
@@ -618,29 +634,29 @@ Server::getNeighbor(BaseClientProxy* src,
 	// search for the closest neighbor that exists in direction dir
 	float tTmp;
 	for (;;) {
-		String dstName(m_config->getNeighbor(srcName, dir, t, &tTmp));
+		ScreenTopology::ScreenID dstID =
+			m_topology.getNeighbor(srcID, dir, t, &tTmp);
 
 		// if nothing in that direction then return NULL. if the
 		// destination is the source then we can make no more
 		// progress in this direction.  since we haven't found a
 		// connected neighbor we return NULL.
-		if (dstName.empty()) {
-			LOG((CLOG_DEBUG2 "no neighbor on %s of \"%s\"", Config::dirName(dir), srcName.c_str()));
+		if (dstID == ScreenTopology::kNoScreen) {
+			LOG((CLOG_DEBUG2 "no neighbor on %s of \"%s\"", Config::dirName(dir), m_topology.getName(srcID).c_str()));
 			return NULL;
 		}
 
-		// look up neighbor cell.  if the screen is connected and
-		// ready then we can stop.
-		ClientList::const_iterator index = m_clients.find(dstName);
-		if (index != m_clients.end()) {
-			LOG((CLOG_DEBUG2 "\"%s\" is on %s of \"%s\" at %f", dstName.c_str(), Config::dirName(dir), srcName.c_str(), t));
-			mapToPixel(index->second, dir, tTmp, x, y);
-			return index->second;
+		// if the neighbor is connected and ready then we can stop.
+		BaseClientProxy* dst = m_topology.getClient(dstID);
+		if (dst != NULL) {
+			LOG((CLOG_DEBUG2 "\"%s\" is on %s of \"%s\" at %f", m_topology.getName(dstID).c_str(), Config::dirName(dir), m_topology.getName(srcID).c_str(), t));
+			mapToPixel(dst, dir, tTmp, x, y);
+			return dst;
 		}
 
 		// skip over unconnected screen
-		LOG((CLOG_DEBUG2 "ignored \"%s\" on %s of \"%s\"", dstName.c_str(), Config::dirName(dir), srcName.c_str()));
-		srcName = dstName;
+		LOG((CLOG_DEBUG2 "ignored \"%s\" on %s of \"%s\"", m_topology.getName(dstID).c_str(), Config::dirName(dir), m_topology.getName(srcID).c_str()));
+		srcID = dstID;
 
 		// use position on skipped screen
 		t = tTmp;
@@ -681,7 +697,7 @@ Server::mapToNeighbor(BaseClientProxy* src,
 			if (x >= 0) {
 				break;
 			}
-			LOG((CLOG_DEBUG2 "skipping over screen %s", getName(dst).c_str()));
+			LOG((CLOG_DEBUG2 "skipping over screen %s", dst->getName().c_str()));
 			dst = getNeighbor(lastGoodScreen, srcSide, x, y);
 		}
 		assert(lastGoodScreen != NULL);
@@ -697,7 +713,7 @@ Server::mapToNeighbor(BaseClientProxy* src,
 			if (x < dw) {
 				break;
 			}
-			LOG((CLOG_DEBUG2 "skipping over screen %s", getName(dst).c_str()));
+			LOG((CLOG_DEBUG2 "skipping over screen %s", dst->getName().c_str()));
 			dst = getNeighbor(lastGoodScreen, srcSide, x, y);
 		}
 		assert(lastGoodScreen != NULL);
@@ -713,7 +729,7 @@ Server::mapToNeighbor(BaseClientProxy* src,
 			if (y >= 0) {
 				break;
 			}
-			LOG((CLOG_DEBUG2 "skipping over screen %s", getName(dst).c_str()));
+			LOG((CLOG_DEBUG2 "skipping over screen %s", dst->getName().c_str()));
 			dst = getNeighbor(lastGoodScreen, srcSide, x, y);
 		}
 		assert(lastGoodScreen != NULL);
@@ -729,7 +745,7 @@ Server::mapToNeighbor(BaseClientProxy* src,
 			if (y < dh) {
 				break;
 			}
-			LOG((CLOG_DEBUG2 "skipping over screen %s", getName(dst).c_str()));
+			LOG((CLOG_DEBUG2 "skipping over screen %s", dst->getName().c_str()));
 			dst = getNeighbor(lastGoodScreen, srcSide, x, y);
 		}
 		assert(lastGoodScreen != NULL);
@@ -763,7 +779,10 @@ Server::avoidJumpZone(BaseClientProxy* dst,
 		return;
 	}
 
-	const String dstName(getName(dst));
+	ScreenTopology::ScreenID dstID = m_topology.getScreen(dst);
+	if (dstID == ScreenTopology::kNoScreen) {
+		return;
+	}
 	SInt32 dx, dy, dw, dh;
 	dst->getShape(dx, dy, dw, dh);
 	float t = mapToFraction(dst, dir, x, y);
@@ -774,25 +793,29 @@ Server::avoidJumpZone(BaseClientProxy* dst,
 	// don't need to move inwards because that side can't provoke a jump.
 	switch (dir) {
 	case kLeft:
-		if (!m_config->getNeighbor(dstName, kRight, t, NULL).empty() &&
+		if (m_topology.getNeighbor(dstID, kRight, t, NULL) !=
+				ScreenTopology::kNoScreen &&
 			x > dx + dw - 1 - z)
 			x = dx + dw - 1 - z;
 		break;
 
 	case kRight:
-		if (!m_config->getNeighbor(dstName, kLeft, t, NULL).empty() &&
+		if (m_topology.getNeighbor(dstID, kLeft, t, NULL) !=
+				ScreenTopology::kNoScreen &&
 			x < dx + z)
 			x = dx + z;
 		break;
 
 	case kTop:
-		if (!m_config->getNeighbor(dstName, kBottom, t, NULL).empty() &&
+		if (m_topology.getNeighbor(dstID, kBottom, t, NULL) !=
+				ScreenTopology::kNoScreen &&
 			y > dy + dh - 1 - z)
 			y = dy + dh - 1 - z;
 		break;
 
 	case kBottom:
-		if (!m_config->getNeighbor(dstName, kTop, t, NULL).empty() &&
+		if (m_topology.getNeighbor(dstID, kTop, t, NULL) !=
+				ScreenTopology::kNoScreen &&
 			y < dy + z)
 			y = dy + z;
 		break;
@@ -1129,6 +1152,21 @@ Server::sendOptions(BaseClientProxy* client) const
 		}
 	}
 
+	// clients that understand it reply with one no-op per batch of
+	// messages rather than one per message unless configured otherwise.
+	// older clients ignore the option.
+	bool hasNoopReplies = false;
+	for (size_t i = 0; i < optionsList.size(); i += 2) {
+		if (optionsList[i] == kOptionNoopReplies) {
+			hasNoopReplies = true;
+			break;
+		}
+	}
+	if (!hasNoopReplies) {
+		optionsList.push_back(kOptionNoopReplies);
+		optionsList.push_back(static_cast<UInt32>(kNoopRepliesPerBatch));
+	}
+
 	// send the options
 	client->resetOptions();
 	client->setOptions(optionsList);
@@ -1513,7 +1551,7 @@ Server::handleFakeInputEndEvent(const Event&, void*)
 void
 Server::handleFileChunkSendingEvent(const Event& event, void*)
 {
-	onFileChunkSending(event.getData());
+	onFileChunkSending(static_cast<FileChunk*>(event.getDataObject()));
 }
 
 void
@@ -2119,6 +2157,7 @@ Server::addClient(BaseClientProxy* client)
 	// add to list
 	m_clientSet.insert(client);
 	m_clients.insert(std::make_pair(name, client));
+	m_topology.setClient(name, client);
 
 	// initialize client data
 	SInt32 x, y;
@@ -2149,6 +2188,10 @@ Server::removeClient(BaseClientProxy* client)
 							client->getEventTarget());
 
 	// remove from list
+	ScreenTopology::ScreenID id = m_topology.getScreen(client);
+	if (id != ScreenTopology::kNoScreen) {
+		m_topology.setClient(m_topology.getName(id), NULL);
+	}
 	m_clients.erase(getName(client));
 	m_clientSet.erase(i);
 
@@ -19,6 +19,7 @@
 #pragma once
 
 #include "server/Config.h"
+#include "server/ScreenTopology.h"
 #include "core/clipboard_types.h"
 #include "core/Clipboard.h"
 #include "core/key_types.h"
@@ -416,6 +417,10 @@ private:
     // current configuration
     Config*                m_config;
 
+    // the configuration's layout compiled for finding neighbors, with
+    // the connected clients
+    ScreenTopology        m_topology;
+
     // input filter (from m_config);
     InputFilter*        m_inputFilter;
 
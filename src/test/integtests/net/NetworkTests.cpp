@@ -427,7 +427,9 @@ NetworkTests::sendMockData(void* eventTarget)
     String size = synergy::string::sizeTypeToString(kMockDataSize);
     FileChunk* sizeMessage = FileChunk::start(size);
     
-    m_events.addEvent(Event(m_events.forFile().fileChunkSending(), eventTarget, sizeMessage));
+    Event sizeEvent(m_events.forFile().fileChunkSending(), eventTarget);
+    sizeEvent.setDataObject(sizeMessage);
+    m_events.addEvent(sizeEvent);
 
     // send chunk messages with incrementing chunk size
     size_t lastSize = 0;
@@ -442,7 +444,9 @@ NetworkTests::sendMockData(void* eventTarget)
 
         // first byte is the chunk mark, last is \0
         FileChunk* chunk = FileChunk::data(m_mockData, dataSize);
-        m_events.addEvent(Event(m_events.forFile().fileChunkSending(), eventTarget, chunk));
+        Event chunkEvent(m_events.forFile().fileChunkSending(), eventTarget);
+        chunkEvent.setDataObject(chunk);
+        m_events.addEvent(chunkEvent);
 
         sentLength += dataSize;
         lastSize = dataSize;
@@ -455,7 +459,9 @@ NetworkTests::sendMockData(void* eventTarget)
     
     // send last message
     FileChunk* transferFinished = FileChunk::end();
-    m_events.addEvent(Event(m_events.forFile().fileChunkSending(), eventTarget, transferFinished));
+    Event finishedEvent(m_events.forFile().fileChunkSending(), eventTarget);
+    finishedEvent.setDataObject(transferFinished);
+    m_events.addEvent(finishedEvent);
 }
 
 UInt8*
@@ -0,0 +1,478 @@
+/*
+ * synergy -- mouse and keyboard sharing utility
+ * Copyright (C) 2016 Symless Ltd.
+ *
+ * This package is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * found in the file LICENSE that should have accompanied this file.
+ *
+ * This package is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_ENV
+
+#include "test/global/TestEventQueue.h"
+#include "net/SecureSocket.h"
+#include "net/SecureListenSocket.h"
+#include "net/SecureContext.h"
+#include "net/SocketMultiplexer.h"
+#include "net/NetworkAddress.h"
+#include "base/TMethodEventJob.h"
+#include "arch/Arch.h"
+#include "base/Log.h"
+#include "base/String.h"
+#include "common/stdvector.h"
+
+#include "test/global/gtest.h"
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+
+#if SYSAPI_UNIX
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TEST_PORT 24805
+#define TEST_HOST "127.0.0.1"
+
+const UInt32 kWriteSize   = 16 * 1024;
+const UInt32 kWindowSize  = 1024 * 1024;
+const UInt32 kTotalSize   = 64 * 1024 * 1024;
+
+// about the size of a mouse move message
+const UInt32 kPacketSize  = 16;
+const int kPacketCount    = 500;
+
+class SecureSocketTests : public ::testing::Test
+{
+public:
+    // makes a profile directory holding a self-signed certificate the
+    // client trusts
+    virtual void        SetUp();
+    virtual void        TearDown();
+
+    // connects and disconnects twice, sending a byte each time so the
+    // client gets the server's session ticket, and returns the number
+    // of handshakes the client resumed
+    UInt32                measureResumedHandshakes();
+
+    // sends data from the server end of a tls connection over loopback
+    // and returns the megabytes per second the client read
+    double                measureThroughput();
+
+    // sends mouse move sized packets over a tls connection while the
+    // same multiplexer services handshakes that never finish, and sets
+    // the mean seconds each took to arrive.  returns false if the
+    // connection failed or a packet didn't arrive.
+    bool                measureLatency(int handshakes, double& latency);
+
+    // drops the events the sockets sent
+    void                flushEvents();
+
+private:
+    void                writeCertificate();
+    ArchSocket            newListener();
+    ArchSocket            accept(ArchSocket listener);
+    SecureSocket*        newServer(SocketMultiplexer*, ArchSocket);
+    bool                connectPair(SocketMultiplexer*, ArchSocket listener,
+                            SecureSocket*& client, SecureSocket*& server);
+    void                handleSecure(const Event&, void*);
+
+public:
+    TestEventQueue        m_events;
+    String                m_profileDir;
+    SecureContext*        m_serverContext;
+    SecureContext*        m_clientContext;
+    String                m_oldProfileDir;
+    int                    m_secureCount;
+};
+
+void
+SecureSocketTests::SetUp()
+{
+    char dir[] = "/tmp/synergy-tls-XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != NULL);
+    m_profileDir = dir;
+    mkdir((m_profileDir + "/SSL").c_str(), 0700);
+    mkdir((m_profileDir + "/SSL/Fingerprints").c_str(), 0700);
+    writeCertificate();
+
+    m_oldProfileDir = ARCH->getProfileDirectory();
+    ARCH->setProfileDirectory(m_profileDir);
+
+    m_serverContext = new SecureContext(true);
+    EXPECT_TRUE(m_serverContext->loadCertificates(
+                            m_profileDir + "/SSL/Synergy.pem"));
+    m_clientContext = new SecureContext(false);
+}
+
+void
+SecureSocketTests::TearDown()
+{
+    delete m_clientContext;
+    delete m_serverContext;
+    ARCH->setProfileDirectory(m_oldProfileDir);
+    unlink((m_profileDir + "/SSL/Fingerprints/TrustedServers.txt").c_str());
+    unlink((m_profileDir + "/SSL/Synergy.pem").c_str());
+    rmdir((m_profileDir + "/SSL/Fingerprints").c_str());
+    rmdir((m_profileDir + "/SSL").c_str());
+    rmdir(m_profileDir.c_str());
+}
+
+void
+SecureSocketTests::writeCertificate()
+{
+    EVP_PKEY* key = NULL;
+    EVP_PKEY_CTX* keyContext = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, NULL);
+    EVP_PKEY_keygen_init(keyContext);
+    EVP_PKEY_CTX_set_rsa_keygen_bits(keyContext, 2048);
+    EVP_PKEY_keygen(keyContext, &key);
+    EVP_PKEY_CTX_free(keyContext);
+    ASSERT_TRUE(key != NULL);
+
+    X509* cert = X509_new();
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_get_notBefore(cert), 0);
+    X509_gmtime_adj(X509_get_notAfter(cert), 3600);
+    X509_set_pubkey(cert, key);
+    X509_NAME* name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                            (const unsigned char*)"Synergy", -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    X509_sign(cert, key, EVP_sha256());
+
+    FILE* file = fopen((m_profileDir + "/SSL/Synergy.pem").c_str(), "w");
+    ASSERT_TRUE(file != NULL);
+    PEM_write_PrivateKey(file, key, NULL, NULL, 0, NULL, NULL);
+    PEM_write_X509(file, cert);
+    fclose(file);
+
+    // the client only trusts servers listed by fingerprint
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digestSize = 0;
+    X509_digest(cert, EVP_sha1(), digest, &digestSize);
+    String fingerprint(reinterpret_cast<char*>(digest), digestSize);
+    synergy::string::toHex(fingerprint, 2);
+    synergy::string::uppercase(fingerprint);
+    for (size_t i = 1; i < digestSize; i++) {
+        fingerprint.insert(i * 3 - 1, ":");
+    }
+
+    file = fopen((m_profileDir + "/SSL/Fingerprints/TrustedServers.txt").c_str(), "w");
+    ASSERT_TRUE(file != NULL);
+    fprintf(file, "%s\n", fingerprint.c_str());
+    fclose(file);
+
+    X509_free(cert);
+    EVP_PKEY_free(key);
+}
+
+void
+SecureSocketTests::handleSecure(const Event&, void*)
+{
+    // quit once both ends have finished the handshake
+    if (++m_secureCount == 2) {
+        m_events.raiseQuitEvent();
+    }
+}
+
+ArchSocket
+SecureSocketTests::newListener()
+{
+    NetworkAddress address(TEST_HOST, TEST_PORT);
+    address.resolve();
+
+    ArchSocket listener = ARCH->newSocket(
+                            IArchNetwork::kINET, IArchNetwork::kSTREAM);
+    ARCH->setReuseAddrOnSocket(listener, true);
+    ARCH->bindSocket(listener, address.getAddress());
+    ARCH->listenOnSocket(listener);
+    return listener;
+}
+
+ArchSocket
+SecureSocketTests::accept(ArchSocket listener)
+{
+    ArchSocket accepted;
+    while ((accepted = ARCH->acceptSocket(listener, NULL)) == NULL) {
+        ARCH->sleep(0.001);
+    }
+    return accepted;
+}
+
+SecureSocket*
+SecureSocketTests::newServer(SocketMultiplexer* multiplexer, ArchSocket socket)
+{
+    SecureSocket* server = new SecureSocket(&m_events, multiplexer, socket);
+    server->initSsl(m_serverContext);
+    return server;
+}
+
+bool
+SecureSocketTests::connectPair(SocketMultiplexer* multiplexer,
+                ArchSocket listener, SecureSocket*& client, SecureSocket*& server)
+{
+    NetworkAddress address(TEST_HOST, TEST_PORT);
+    address.resolve();
+
+    client = new SecureSocket(&m_events, multiplexer);
+    client->initSsl(m_clientContext);
+
+    // the client starts its handshake from the connected event
+    m_secureCount = 0;
+    m_events.adoptHandler(
+        m_events.forIDataSocket().secureConnected(), client->getEventTarget(),
+        new TMethodEventJob<SecureSocketTests>(
+            this, &SecureSocketTests::handleSecure));
+    client->connect(address);
+
+    server = newServer(multiplexer, accept(listener));
+    m_events.adoptHandler(
+        m_events.forClientListener().accepted(), server->getEventTarget(),
+        new TMethodEventJob<SecureSocketTests>(
+            this, &SecureSocketTests::handleSecure));
+    server->secureAccept();
+
+    m_events.initQuitTimeout(10);
+    m_events.loop();
+    m_events.removeHandler(
+        m_events.forIDataSocket().secureConnected(), client->getEventTarget());
+    m_events.removeHandler(
+        m_events.forClientListener().accepted(), server->getEventTarget());
+    m_events.cleanupQuitTimeout();
+
+    EXPECT_TRUE(client->isSecureReady());
+    EXPECT_TRUE(server->isSecureReady());
+    return client->isSecureReady() && server->isSecureReady();
+}
+
+void
+SecureSocketTests::flushEvents()
+{
+    Event event;
+    while (m_events.getEvent(event, 0.0)) {
+        Event::deleteData(event);
+    }
+}
+
+double
+SecureSocketTests::measureThroughput()
+{
+    SocketMultiplexer multiplexer;
+    ArchSocket listener = newListener();
+    SecureSocket* client;
+    SecureSocket* server;
+    bool connected = connectPair(&multiplexer, listener, client, server);
+    ARCH->closeSocket(listener);
+
+    double result = 0.0;
+    if (connected) {
+        UInt8* data = new UInt8[kWriteSize];
+        for (UInt32 i = 0; i < kWriteSize; ++i) {
+            data[i] = (UInt8)i;
+        }
+
+        UInt8* buffer = new UInt8[kWindowSize];
+        UInt32 sent = 0;
+        UInt32 received = 0;
+        bool intact = true;
+
+        // logging each read and write would be most of what's measured
+        int filter = CLOG->getFilter();
+        CLOG->setFilter(kINFO);
+        double start = ARCH->time();
+        while (received < kTotalSize && ARCH->time() - start < 60.0) {
+            // keep at most a window of data in flight
+            if (sent < kTotalSize && sent - received < kWindowSize) {
+                server->write(data, kWriteSize);
+                sent += kWriteSize;
+            }
+
+            UInt32 n = client->read(buffer, kWindowSize);
+            for (UInt32 i = 0; i < n; i += 4093) {
+                intact = intact && (buffer[i] == (UInt8)(received + i));
+            }
+            received += n;
+        }
+        double elapsed = ARCH->time() - start;
+        CLOG->setFilter(filter);
+
+        EXPECT_EQ(kTotalSize, received);
+        EXPECT_TRUE(intact);
+        result = received / elapsed / (1024.0 * 1024.0);
+
+        delete[] buffer;
+        delete[] data;
+    }
+
+    delete client;
+    delete server;
+
+    // drop the events sent while the sockets were open
+    flushEvents();
+
+    return result;
+}
+
+bool
+SecureSocketTests::measureLatency(int handshakes, double& latency)
+{
+    SocketMultiplexer multiplexer;
+    ArchSocket listener = newListener();
+    SecureSocket* client;
+    SecureSocket* server;
+    bool connected = connectPair(&multiplexer, listener, client, server);
+
+    // clients that trickle a client hello one byte at a time so the
+    // server's handshakes never finish
+    NetworkAddress address(TEST_HOST, TEST_PORT);
+    address.resolve();
+    std::vector<ArchSocket> slowClients;
+    std::vector<SecureSocket*> slowServers;
+    for (int i = 0; i < handshakes; ++i) {
+        ArchSocket slowClient = ARCH->newSocket(
+                            IArchNetwork::kINET, IArchNetwork::kSTREAM);
+        ARCH->connectSocket(slowClient, address.getAddress());
+        slowClients.push_back(slowClient);
+
+        SecureSocket* slowServer = newServer(&multiplexer, accept(listener));
+        slowServer->secureAccept();
+        slowServers.push_back(slowServer);
+    }
+    ARCH->closeSocket(listener);
+
+    // a record header for a client hello, then the start of its body
+    static const UInt8 s_hello[] = { 0x16, 0x03, 0x01, 0x02, 0x00 };
+
+    bool delivered = connected;
+    latency        = 0.0;
+    if (connected) {
+        int filter = CLOG->getFilter();
+        CLOG->setFilter(kINFO);
+        UInt8 packet[kPacketSize] = { 0 };
+        double total    = 0.0;
+        double deadline = ARCH->time() + 60.0;
+        for (int i = 0; delivered && i < kPacketCount; ++i) {
+            if (handshakes > 0) {
+                int n = i / handshakes;
+                UInt8 byte = (n < (int)sizeof(s_hello)) ? s_hello[n] : 0;
+                ARCH->writeSocket(slowClients[i % handshakes], &byte, 1);
+            }
+
+            double start = ARCH->time();
+            server->write(packet, kPacketSize);
+            while (client->getSize() < kPacketSize) {
+                // spin until the multiplexer has delivered it
+                if (ARCH->time() > deadline) {
+                    delivered = false;
+                    break;
+                }
+            }
+            total += ARCH->time() - start;
+            client->read(NULL, kPacketSize);
+        }
+        CLOG->setFilter(filter);
+        latency = total / kPacketCount;
+    }
+
+    for (int i = 0; i < handshakes; ++i) {
+        ARCH->closeSocket(slowClients[i]);
+        delete slowServers[i];
+    }
+    delete client;
+    delete server;
+    flushEvents();
+
+    return delivered;
+}
+
+UInt32
+SecureSocketTests::measureResumedHandshakes()
+{
+    SocketMultiplexer multiplexer;
+    ArchSocket listener = newListener();
+    for (int i = 0; i < 2; ++i) {
+        SecureSocket* client;
+        SecureSocket* server;
+        if (connectPair(&multiplexer, listener, client, server)) {
+            UInt8 byte = 0;
+            server->write(&byte, 1);
+            double start = ARCH->time();
+            while (client->getSize() < 1 && ARCH->time() - start < 10.0) {
+                ARCH->sleep(0.001);
+            }
+            client->read(NULL, 1);
+        }
+        delete client;
+        delete server;
+        flushEvents();
+    }
+    ARCH->closeSocket(listener);
+
+    EXPECT_EQ(2, (int)m_serverContext->getHandshakes());
+    EXPECT_EQ(2, (int)m_clientContext->getHandshakes());
+    return m_clientContext->getResumedHandshakes();
+}
+
+TEST_F(SecureSocketTests, throughput_loopback)
+{
+    double throughput = measureThroughput();
+
+    LOG((CLOG_INFO "tls throughput over loopback: %.1f MB/s", throughput));
+    EXPECT_GT(throughput, 0.0);
+}
+
+TEST_F(SecureSocketTests, latency_50Handshakes)
+{
+    double idle, busy;
+    ASSERT_TRUE(measureLatency(0, idle));
+    ASSERT_TRUE(measureLatency(50, busy));
+
+    LOG((CLOG_INFO "tls packet latency: %.1f us idle, %.1f us during 50 handshakes",
+                idle * 1.0e+6, busy * 1.0e+6));
+
+    // a handshake waiting for data must never hold up the multiplexer.
+    // the margin is wide so scheduling noise on a loaded machine doesn't
+    // fail the test; a blocked handshake costs far more than this.
+    EXPECT_LT(busy, idle + 0.05);
+}
+
+TEST_F(SecureSocketTests, accept_noCertificate_returnsNull)
+{
+    // the listener loads its certificate from the profile directory
+    unlink((m_profileDir + "/SSL/Synergy.pem").c_str());
+
+    NetworkAddress address(TEST_HOST, TEST_PORT);
+    address.resolve();
+    SocketMultiplexer multiplexer;
+    SecureListenSocket listener(&m_events, &multiplexer);
+    listener.bind(address);
+
+    ArchSocket client = ARCH->newSocket(
+                            IArchNetwork::kINET, IArchNetwork::kSTREAM);
+    ARCH->connectSocket(client, address.getAddress());
+
+    EXPECT_TRUE(listener.accept() == NULL);
+
+    ARCH->closeSocket(client);
+    flushEvents();
+}
+
+TEST_F(SecureSocketTests, resumption_reconnect_resumesSession)
+{
+    UInt32 resumed = measureResumedHandshakes();
+
+    EXPECT_EQ(1, (int)resumed);
+    EXPECT_EQ(resumed, m_serverContext->getResumedHandshakes());
+}
+#endif
@@ -0,0 +1,319 @@
+/*
+ * synergy -- mouse and keyboard sharing utility
+ * Copyright (C) 2016 Symless Ltd.
+ *
+ * This package is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * found in the file LICENSE that should have accompanied this file.
+ *
+ * This package is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_ENV
+
+#include "test/global/TestEventQueue.h"
+#include "net/SocketMultiplexer.h"
+#include "net/ISocketMultiplexerJob.h"
+#include "net/TCPSocket.h"
+#include "net/NetworkAddress.h"
+#include "mt/Thread.h"
+#include "arch/Arch.h"
+#include "base/Log.h"
+#include "base/TMethodJob.h"
+#include "common/stdvector.h"
+
+#include "test/global/gtest.h"
+
+#include <atomic>
+
+#define TEST_PORT 24804
+#define TEST_HOST "127.0.0.1"
+
+// about the size of a mouse move message
+const UInt32 kPacketSize = 16;
+const int kPacketCount = 10000;
+
+// how long to wait for the service thread before giving up
+const double kTimeout = 5.0;
+
+// how long to wait for a job that shouldn't run
+const double kQuietTime = 0.1;
+
+// reads whatever arrives on a socket and counts the times it's run.
+// if m_other is set the first run removes that socket.
+class CountingJob : public ISocketMultiplexerJob {
+public:
+    CountingJob(ArchSocket socket, std::atomic<int>& runs) :
+        m_socket(socket), m_runs(runs),
+        m_multiplexer(NULL), m_other(NULL) { }
+
+    virtual ISocketMultiplexerJob*
+                        run(bool readable, bool, bool)
+    {
+        if (readable) {
+            UInt8 buffer[256];
+            ARCH->readSocket(m_socket, buffer, sizeof(buffer));
+        }
+        if (m_other != NULL) {
+            m_multiplexer->removeSocket(m_other);
+            m_other = NULL;
+        }
+        ++m_runs;
+        return this;
+    }
+    virtual ArchSocket    getSocket() const { return m_socket; }
+    virtual bool        isReadable() const { return true; }
+    virtual bool        isWritable() const { return false; }
+
+    // the multiplexer only uses the socket as a key
+    ISocket*            key() { return reinterpret_cast<ISocket*>(this); }
+
+public:
+    ArchSocket            m_socket;
+    std::atomic<int>&    m_runs;
+    SocketMultiplexer*    m_multiplexer;
+    ISocket*            m_other;
+};
+
+class SocketMultiplexerTests : public ::testing::Test
+{
+public:
+    SocketMultiplexerTests() : m_multiplexer(NULL), m_job(NULL) { }
+
+    // connects an unbuffered socket pair
+    void                connectPair(ArchSocket& client, ArchSocket& server);
+
+    // waits until the counter reaches the target, returning false if
+    // it doesn't in time
+    bool                waitForRuns(const std::atomic<int>& runs, int target);
+
+    // connects socket pairs through one multiplexer and sets the
+    // seconds taken per packet sent over the first pair while the
+    // others sit idle.  returns false if a packet doesn't arrive.
+    bool                measurePacketOverhead(int pairs, double& perPacket);
+
+    // adds m_job to m_multiplexer, for running on another thread
+    void                addJobThread(void*);
+
+public:
+    TestEventQueue        m_events;
+    SocketMultiplexer*    m_multiplexer;
+    CountingJob*        m_job;
+};
+
+void
+SocketMultiplexerTests::connectPair(ArchSocket& client, ArchSocket& server)
+{
+    NetworkAddress address(TEST_HOST, TEST_PORT);
+    address.resolve();
+
+    ArchSocket listener = ARCH->newSocket(
+                            IArchNetwork::kINET, IArchNetwork::kSTREAM);
+    ARCH->setReuseAddrOnSocket(listener, true);
+    ARCH->bindSocket(listener, address.getAddress());
+    ARCH->listenOnSocket(listener);
+
+    client = ARCH->newSocket(IArchNetwork::kINET, IArchNetwork::kSTREAM);
+    ARCH->connectSocket(client, address.getAddress());
+    while ((server = ARCH->acceptSocket(listener, NULL)) == NULL) {
+        ARCH->sleep(0.001);
+    }
+    ARCH->closeSocket(listener);
+}
+
+bool
+SocketMultiplexerTests::waitForRuns(const std::atomic<int>& runs, int target)
+{
+    double deadline = ARCH->time() + kTimeout;
+    while (runs < target) {
+        if (ARCH->time() > deadline) {
+            return false;
+        }
+        ARCH->sleep(0.001);
+    }
+    return true;
+}
+
+bool
+SocketMultiplexerTests::measurePacketOverhead(int pairs, double& perPacket)
+{
+    SocketMultiplexer multiplexer;
+    NetworkAddress address(TEST_HOST, TEST_PORT);
+    address.resolve();
+
+    ArchSocket listener = ARCH->newSocket(
+                            IArchNetwork::kINET, IArchNetwork::kSTREAM);
+    ARCH->setReuseAddrOnSocket(listener, true);
+    ARCH->bindSocket(listener, address.getAddress());
+    ARCH->listenOnSocket(listener);
+
+    std::vector<TCPSocket*> clients;
+    std::vector<TCPSocket*> servers;
+    for (int i = 0; i < pairs; ++i) {
+        TCPSocket* client = new TCPSocket(&m_events, &multiplexer);
+        client->connect(address);
+
+        ArchSocket accepted;
+        while ((accepted = ARCH->acceptSocket(listener, NULL)) == NULL) {
+            ARCH->sleep(0.001);
+        }
+
+        clients.push_back(client);
+        servers.push_back(new TCPSocket(&m_events, &multiplexer, accepted));
+    }
+    ARCH->closeSocket(listener);
+
+    UInt8 packet[kPacketSize] = { 0 };
+    TCPSocket* server = servers[0];
+    TCPSocket* client = clients[0];
+
+    bool delivered = true;
+    double start    = ARCH->time();
+    double deadline = start + kTimeout;
+    for (int i = 0; delivered && i < kPacketCount; ++i) {
+        server->write(packet, kPacketSize);
+        while (client->getSize() < kPacketSize) {
+            // spin until the multiplexer has delivered it
+            if (ARCH->time() > deadline) {
+                delivered = false;
+                break;
+            }
+        }
+        client->read(NULL, kPacketSize);
+    }
+    perPacket = (ARCH->time() - start) / kPacketCount;
+
+    for (size_t i = 0; i < clients.size(); ++i) {
+        delete clients[i];
+        delete servers[i];
+    }
+
+    return delivered;
+}
+
+void
+SocketMultiplexerTests::addJobThread(void*)
+{
+    m_multiplexer->addSocket(m_job->key(), m_job);
+}
+
+TEST_F(SocketMultiplexerTests, addSocket_fromOtherThread_jobRuns)
+{
+    ArchSocket client, server;
+    connectPair(client, server);
+
+    std::atomic<int> runs(0);
+    {
+        SocketMultiplexer multiplexer;
+        m_multiplexer = &multiplexer;
+        m_job         = new CountingJob(server, runs);
+
+        Thread thread(new TMethodJob<SocketMultiplexerTests>(
+                            this, &SocketMultiplexerTests::addJobThread));
+        thread.wait();
+
+        UInt8 byte = 0;
+        ARCH->writeSocket(client, &byte, 1);
+        EXPECT_TRUE(waitForRuns(runs, 1));
+    }
+
+    ARCH->closeSocket(client);
+    ARCH->closeSocket(server);
+}
+
+TEST_F(SocketMultiplexerTests, removeSocket_noMoreRuns)
+{
+    ArchSocket client, server;
+    connectPair(client, server);
+
+    std::atomic<int> runs(0);
+    {
+        SocketMultiplexer multiplexer;
+        CountingJob* job = new CountingJob(server, runs);
+        multiplexer.addSocket(job->key(), job);
+
+        UInt8 byte = 0;
+        ARCH->writeSocket(client, &byte, 1);
+        ASSERT_TRUE(waitForRuns(runs, 1));
+
+        // the job is deleted once removeSocket returns
+        multiplexer.removeSocket(job->key());
+        int removedRuns = runs;
+
+        ARCH->writeSocket(client, &byte, 1);
+        ARCH->sleep(kQuietTime);
+        EXPECT_EQ(removedRuns, runs);
+    }
+
+    ARCH->closeSocket(client);
+    ARCH->closeSocket(server);
+}
+
+TEST_F(SocketMultiplexerTests, removeSocket_fromJob_otherJobNotRunInSameBatch)
+{
+    ArchSocket client1, server1, client2, server2;
+    connectPair(client1, server1);
+    connectPair(client2, server2);
+
+    // both sockets are readable before they're added so the first
+    // poll returns both.  whichever job runs first removes the other's
+    // socket, after which the other job must not run.
+    UInt8 byte = 0;
+    ARCH->writeSocket(client1, &byte, 1);
+    ARCH->writeSocket(client2, &byte, 1);
+
+    std::atomic<int> runs(0);
+    {
+        SocketMultiplexer multiplexer;
+        CountingJob* job1   = new CountingJob(server1, runs);
+        CountingJob* job2   = new CountingJob(server2, runs);
+        job1->m_multiplexer = &multiplexer;
+        job1->m_other       = job2->key();
+        job2->m_multiplexer = &multiplexer;
+        job2->m_other       = job1->key();
+        multiplexer.addSocket(job1->key(), job1);
+        multiplexer.addSocket(job2->key(), job2);
+
+        ASSERT_TRUE(waitForRuns(runs, 1));
+        ARCH->sleep(kQuietTime);
+        EXPECT_EQ(1, runs);
+    }
+
+    ARCH->closeSocket(client1);
+    ARCH->closeSocket(server1);
+    ARCH->closeSocket(client2);
+    ARCH->closeSocket(server2);
+}
+
+// the packet overhead tests are benchmarks.  they only log the time
+// taken, for comparing before and after a change, since the absolute
+// numbers depend on the machine.
+TEST_F(SocketMultiplexerTests, packetOverhead_1Pair)
+{
+    double perPacket;
+    ASSERT_TRUE(measurePacketOverhead(1, perPacket));
+
+    LOG((CLOG_INFO "per packet with 1 socket pair: %.2f us", perPacket * 1.0e+6));
+}
+
+TEST_F(SocketMultiplexerTests, packetOverhead_16Pairs)
+{
+    double perPacket;
+    ASSERT_TRUE(measurePacketOverhead(16, perPacket));
+
+    LOG((CLOG_INFO "per packet with 16 socket pairs: %.2f us", perPacket * 1.0e+6));
+}
+
+TEST_F(SocketMultiplexerTests, packetOverhead_256Pairs)
+{
+    double perPacket;
+    ASSERT_TRUE(measurePacketOverhead(256, perPacket));
+
+    LOG((CLOG_INFO "per packet with 256 socket pairs: %.2f us", perPacket * 1.0e+6));
+}
@@ -0,0 +1,320 @@
+/*
+ * synergy -- mouse and keyboard sharing utility
+ * Copyright (C) 2016 Symless Ltd.
+ *
+ * This package is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * found in the file LICENSE that should have accompanied this file.
+ *
+ * This package is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_ENV
+
+#include "test/global/TestEventQueue.h"
+#include "core/Clipboard.h"
+#include "core/ClipboardChunk.h"
+#include "core/FileChunk.h"
+#include "core/StreamChunker.h"
+#include "core/protocol_types.h"
+#include "io/IStream.h"
+#include "mt/Thread.h"
+#include "base/TMethodEventJob.h"
+#include "base/TMethodJob.h"
+#include "base/Log.h"
+#include "common/stdexcept.h"
+
+#include "test/global/gtest.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+
+const char* kChunkerFilename = "StreamChunkerTests.mock";
+const size_t kBigFileSize    = (size_t)2 * 1024 * 1024 * 1024; // 2GB
+const size_t kFileSize       = 64 * 1024 * 1024; // 64MB
+
+// the most the big transfer may grow the process by
+const size_t kMaxGrowth      = 32 * 1024 * 1024;
+
+// at most a few chunks of 512KB should be sent without being flushed
+const size_t kMaxUnflushed   = 8 * 512 * 1024;
+
+const size_t kBitmapSize     = 50 * 1024 * 1024; // 50MB
+const size_t kHtmlSize       = 20 * 1024 * 1024; // 20MB
+
+// discards what's written, counting it
+class NullStream : public synergy::IStream {
+public:
+    NullStream() : m_written(0) { }
+
+    virtual void        close() { }
+    virtual UInt32        read(void*, UInt32) { return 0; }
+    virtual void        write(const void*, UInt32 n) { m_written += n; }
+    virtual void        flush() { }
+    virtual void        shutdownInput() { }
+    virtual void        shutdownOutput() { }
+    virtual void*        getEventTarget() const
+    {
+        return const_cast<void*>(static_cast<const void*>(this));
+    }
+    virtual bool        isReady() const { return false; }
+    virtual UInt32        getSize() const { return 0; }
+
+public:
+    size_t                m_written;
+};
+
+class StreamChunkerTests : public ::testing::Test
+{
+public:
+    StreamChunkerTests() :
+        m_flush(true),
+        m_dataSize(0),
+        m_dataSizeAtInterrupt(0),
+        m_peakSize(0) { }
+
+    ~StreamChunkerTests()
+    {
+        remove(kChunkerFilename);
+    }
+
+    // makes a file of zeros without writing them, where supported
+    void                createSparseFile(size_t size);
+
+    // sends the file on a thread of its own, relaying chunks on this
+    // one until the last, and returns the bytes of data relayed
+    size_t                sendFile();
+
+    // puts \c data on a clipboard and sends it marshalled to a stream,
+    // returning how much the process grew by while chunking it
+    size_t                sendClipboard(IClipboard::EFormat, const String& data);
+
+    // returns the resident size of the process, or 0 if unknown
+    static size_t        getResidentSize();
+
+    void                sendFileThread(void*);
+    void                handleFileChunk(const Event&, void*);
+    void                handleClipboardChunk(const Event&, void*);
+    void                handleInterrupt(const Event&, void*);
+
+public:
+    TestEventQueue        m_events;
+    bool                m_flush;
+    size_t                m_dataSize;
+    size_t                m_dataSizeAtInterrupt;
+    size_t                m_peakSize;
+    NullStream            m_stream;
+};
+
+void
+StreamChunkerTests::createSparseFile(size_t size)
+{
+    std::ofstream file(kChunkerFilename,
+                            std::ios::out | std::ios::binary | std::ios::trunc);
+    file.seekp(size - 1);
+    file.put('\0');
+    ASSERT_TRUE(file.good());
+}
+
+size_t
+StreamChunkerTests::sendFile()
+{
+    m_events.adoptHandler(m_events.forFile().fileChunkSending(), this,
+                            new TMethodEventJob<StreamChunkerTests>(this,
+                                &StreamChunkerTests::handleFileChunk));
+
+    Thread thread(new TMethodJob<StreamChunkerTests>(
+                            this, &StreamChunkerTests::sendFileThread));
+
+    m_events.initQuitTimeout(120);
+    m_events.loop();
+    m_events.cleanupQuitTimeout();
+    thread.wait();
+
+    m_events.removeHandler(m_events.forFile().fileChunkSending(), this);
+    return m_dataSize;
+}
+
+size_t
+StreamChunkerTests::sendClipboard(IClipboard::EFormat format, const String& data)
+{
+    String marshalled;
+    {
+        Clipboard clipboard;
+        clipboard.open(0);
+        clipboard.add(format, data);
+        clipboard.close();
+        marshalled = clipboard.marshall();
+    }
+    size_t size = marshalled.size();
+
+    m_events.adoptHandler(m_events.forClipboard().clipboardSending(), this,
+                            new TMethodEventJob<StreamChunkerTests>(this,
+                                &StreamChunkerTests::handleClipboardChunk));
+
+    size_t baseSize = getResidentSize();
+    StreamChunker::sendClipboard(marshalled, size, kClipboardClipboard, 0,
+                            &m_events, this);
+    m_peakSize = std::max(baseSize, getResidentSize());
+
+    m_events.initQuitTimeout(10);
+    m_events.loop();
+    m_events.cleanupQuitTimeout();
+
+    m_events.removeHandler(m_events.forClipboard().clipboardSending(), this);
+
+    EXPECT_LT(size, m_stream.m_written);
+    return m_peakSize - baseSize;
+}
+
+size_t
+StreamChunkerTests::getResidentSize()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmRSS:") == 0) {
+            std::istringstream value(line.substr(6));
+            size_t kilobytes = 0;
+            value >> kilobytes;
+            return kilobytes * 1024;
+        }
+    }
+    return 0;
+}
+
+void
+StreamChunkerTests::sendFileThread(void*)
+{
+    try {
+        StreamChunker::sendFile(const_cast<char*>(kChunkerFilename),
+                            &m_events, this);
+    }
+    catch (std::runtime_error& error) {
+        ADD_FAILURE() << "failed sending file: " << error.what();
+        m_events.raiseQuitEvent();
+    }
+}
+
+void
+StreamChunkerTests::handleFileChunk(const Event& event, void*)
+{
+    FileChunk* chunk = static_cast<FileChunk*>(event.getDataObject());
+    m_peakSize = std::max(m_peakSize, getResidentSize());
+
+    switch (chunk->m_chunk[0]) {
+    case kDataChunk:
+        m_dataSize += chunk->m_dataSize;
+        break;
+
+    case kDataEnd:
+        m_events.raiseQuitEvent();
+        break;
+    }
+
+    // as a client proxy would once the chunk has left the process
+    if (m_flush) {
+        StreamChunker::fileChunksFlushed(1);
+    }
+}
+
+void
+StreamChunkerTests::handleClipboardChunk(const Event& event, void*)
+{
+    ClipboardChunk* chunk = static_cast<ClipboardChunk*>(event.getDataObject());
+    ClipboardChunk::send(&m_stream, chunk);
+    m_peakSize = std::max(m_peakSize, getResidentSize());
+
+    if (chunk->m_chunk[5] == kDataEnd) {
+        m_events.raiseQuitEvent();
+    }
+}
+
+void
+StreamChunkerTests::handleInterrupt(const Event&, void*)
+{
+    m_dataSizeAtInterrupt = m_dataSize;
+    StreamChunker::interruptFile();
+}
+
+TEST_F(StreamChunkerTests, sendFile_2GB_residentSizeStaysFlat)
+{
+    createSparseFile(kBigFileSize);
+    size_t baseSize = getResidentSize();
+    m_peakSize = baseSize;
+
+    size_t dataSize = sendFile();
+
+    EXPECT_EQ(kBigFileSize, dataSize);
+    if (baseSize == 0) {
+        LOG((CLOG_INFO "resident size unknown on this platform"));
+        return;
+    }
+
+    LOG((CLOG_INFO "resident size grew by %.1f MB sending a 2 GB file",
+                (m_peakSize - baseSize) / (1024.0 * 1024.0)));
+    EXPECT_LT(m_peakSize - baseSize, kMaxGrowth);
+}
+
+TEST_F(StreamChunkerTests, sendFile_notFlushed_waitsForFlush)
+{
+    createSparseFile(kFileSize);
+    m_flush = false;
+
+    // nothing is flushed so the sender should soon stop until it's told
+    // the file has become invalid
+    EventQueueTimer* timer = m_events.newOneShotTimer(0.5, NULL);
+    m_events.adoptHandler(Event::kTimer, timer,
+                            new TMethodEventJob<StreamChunkerTests>(this,
+                                &StreamChunkerTests::handleInterrupt));
+
+    size_t dataSize = sendFile();
+
+    m_events.removeHandler(Event::kTimer, timer);
+    m_events.deleteTimer(timer);
+
+    EXPECT_GT(m_dataSizeAtInterrupt, (size_t)0);
+    EXPECT_LE(m_dataSizeAtInterrupt, kMaxUnflushed);
+    EXPECT_EQ(m_dataSizeAtInterrupt, dataSize);
+}
+
+TEST_F(StreamChunkerTests, sendClipboard_50MBBitmap_noCopies)
+{
+    // image data doesn't compress or repeat
+    String bitmap(kBitmapSize, '\0');
+    UInt32 seed = 1;
+    for (size_t i = 0; i < bitmap.size(); ++i) {
+        seed = seed * 1103515245 + 12345;
+        bitmap[i] = (char)(seed >> 24);
+    }
+
+    size_t growth = sendClipboard(IClipboard::kBitmap, bitmap);
+
+    LOG((CLOG_INFO "resident size grew by %.1f MB chunking a 50 MB bitmap",
+                growth / (1024.0 * 1024.0)));
+    EXPECT_LT(growth, kBitmapSize / 4);
+}
+
+TEST_F(StreamChunkerTests, sendClipboard_20MBHtml_noCopies)
+{
+    const String row("<tr><td>synergy</td><td>clipboard</td></tr>\n");
+    String html;
+    html.reserve(kHtmlSize);
+    while (html.size() + row.size() <= kHtmlSize) {
+        html += row;
+    }
+
+    size_t growth = sendClipboard(IClipboard::kHTML, html);
+
+    LOG((CLOG_INFO "resident size grew by %.1f MB chunking a 20 MB html page",
+                growth / (1024.0 * 1024.0)));
+    EXPECT_LT(growth, kHtmlSize / 4);
+}
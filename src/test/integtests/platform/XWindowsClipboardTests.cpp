@@ -16,142 +16,322 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-// TODO: fix tests - compile error on linux
-#if 0
+#define TEST_ENV
+
+// gtest has to come first since X11 defines None
+#include "test/global/gtest.h"
 
 #include "platform/XWindowsClipboard.h"
+#include "core/Clipboard.h"
+#include "mt/Thread.h"
+#include "mt/Mutex.h"
+#include "mt/Lock.h"
+#include "arch/Arch.h"
+#include "base/TMethodJob.h"
+#include "base/Unicode.h"
+#include "common/stdmap.h"
+#include "common/stdvector.h"
 
-#include "test/global/gtest.h"
-#include <iostream>
+#include <X11/Xatom.h>
+#include <errno.h>
 
-class CXWindowsClipboardTests : public ::testing::Test
+// run against Xvfb, e.g. xvfb-run integtests
+class XWindowsClipboardTests : public ::testing::Test
 {
-protected:
+public:
+    typedef std::map<String, String> TargetMap;
+
+    XWindowsClipboardTests() :
+        m_display(NULL),
+        m_window(None),
+        m_ownerDisplay(NULL),
+        m_ownerWindow(None),
+        m_thread(NULL),
+        m_stop(false),
+        m_hold(0) { }
+
     virtual void
     SetUp()
     {
-        m_display = XOpenDisplay(NULL);
-        int screen = DefaultScreen(m_display);
-        Window root = XRootWindow(m_display, screen);
-        
-        XSetWindowAttributes attr;
-        attr.do_not_propagate_mask = 0;
-        attr.override_redirect = True;
-        attr.cursor = Cursor();
-        
-        m_window = XCreateWindow(
-            m_display, root, 0, 0, 1, 1, 0, 0,
-            InputOnly, CopyFromParent, 0, &attr);
+        m_display      = XOpenDisplay(NULL);
+        m_ownerDisplay = XOpenDisplay(NULL);
+        ASSERT_TRUE(m_display != NULL && m_ownerDisplay != NULL)
+            << "unable to open display: " << errno;
+
+        m_window      = createWindow(m_display);
+        m_ownerWindow = createWindow(m_ownerDisplay);
     }
 
     virtual void
     TearDown()
     {
-        XDestroyWindow(m_display, m_window);
-        XCloseDisplay(m_display);
+        if (m_thread != NULL) {
+            m_stop = true;
+            m_thread->wait();
+            delete m_thread;
+        }
+        if (m_ownerDisplay != NULL) {
+            XDestroyWindow(m_ownerDisplay, m_ownerWindow);
+            XCloseDisplay(m_ownerDisplay);
+        }
+        if (m_display != NULL) {
+            XDestroyWindow(m_display, m_window);
+            XCloseDisplay(m_display);
+        }
     }
 
-    CXWindowsClipboard&
-    createClipboard()
-    {
-        CXWindowsClipboard* clipboard;
-        clipboard = new CXWindowsClipboard(m_display, m_window, 0);
-        clipboard->open(0); // needed to empty the clipboard
-        clipboard->empty(); // needed to own the clipboard
-        return *clipboard;
-    }
+    static Window        createWindow(Display* display);
+
+    // takes the primary selection and answers requests for TARGETS,
+    // TIMESTAMP and \p targets until the test ends
+    void                own(const TargetMap& targets);
+
+    // returns the names of the targets requested, except TIMESTAMP
+    std::vector<String>    getRequests() const;
+
+    // returns true if \p target was requested
+    bool                wasRequested(const String& target) const;
+
+    // don't answer requests for data until \p count of them are waiting
+    void                holdAnswers(size_t count) { m_hold = count; }
 
-    Display* m_display;
-    Window m_window;
+private:
+    void                ownerThread(void*);
+    void                request(const XSelectionRequestEvent&);
+    void                answer(const XSelectionRequestEvent&);
+
+public:
+    Display*            m_display;
+    Window                m_window;
+    Display*            m_ownerDisplay;
+    Window                m_ownerWindow;
+
+private:
+    TargetMap            m_targets;
+    Thread*                m_thread;
+    volatile bool        m_stop;
+    size_t                m_hold;
+    std::vector<XSelectionRequestEvent>    m_held;
+    Mutex                m_mutex;
+    std::vector<String>    m_requests;
 };
 
-TEST_F(CXWindowsClipboardTests, empty_openCalled_returnsTrue)
+Window
+XWindowsClipboardTests::createWindow(Display* display)
 {
-    CXWindowsClipboard clipboard = createClipboard();
-    
-    bool actual = clipboard.empty();
-    
-    EXPECT_EQ(true, actual);
+    XSetWindowAttributes attr;
+    attr.override_redirect = True;
+    return XCreateWindow(display,
+                            XRootWindow(display, DefaultScreen(display)),
+                            0, 0, 1, 1, 0, 0, InputOnly, CopyFromParent,
+                            CWOverrideRedirect, &attr);
 }
 
-TEST_F(CXWindowsClipboardTests, empty_singleFormat_hasReturnsFalse)
+void
+XWindowsClipboardTests::own(const TargetMap& targets)
 {
-    CXWindowsClipboard clipboard = createClipboard();
-    clipboard.add(CXWindowsClipboard::kText, "synergy rocks!");
-    
-    clipboard.empty();
-    
-    bool actual = clipboard.has(CXWindowsClipboard::kText);
-    EXPECT_FALSE(actual);
+    m_targets = targets;
+    XSetSelectionOwner(m_ownerDisplay, XA_PRIMARY, m_ownerWindow, CurrentTime);
+    XSync(m_ownerDisplay, False);
+    m_thread = new Thread(new TMethodJob<XWindowsClipboardTests>(
+                            this, &XWindowsClipboardTests::ownerThread));
 }
 
-TEST_F(CXWindowsClipboardTests, add_newValue_valueWasStored)
+std::vector<String>
+XWindowsClipboardTests::getRequests() const
 {
-    CXWindowsClipboard clipboard = createClipboard();
-    
-    clipboard.add(IClipboard::kText, "synergy rocks!");
-    
-    String actual = clipboard.get(IClipboard::kText);
-    EXPECT_EQ("synergy rocks!", actual);
+    Lock lock(&m_mutex);
+    return m_requests;
 }
 
-TEST_F(CXWindowsClipboardTests, add_replaceValue_valueWasReplaced)
+bool
+XWindowsClipboardTests::wasRequested(const String& target) const
 {
-    CXWindowsClipboard clipboard = createClipboard();
-    
-    clipboard.add(IClipboard::kText, "synergy rocks!");
-    clipboard.add(IClipboard::kText, "maxivista sucks"); // haha, just kidding.
-    
-    String actual = clipboard.get(IClipboard::kText);
-    EXPECT_EQ("maxivista sucks", actual);
+    std::vector<String> requests = getRequests();
+    for (size_t i = 0; i < requests.size(); ++i) {
+        if (requests[i] == target) {
+            return true;
+        }
+    }
+    return false;
 }
 
-TEST_F(CXWindowsClipboardTests, close_isOpen_noErrors)
+void
+XWindowsClipboardTests::ownerThread(void*)
 {
-    CXWindowsClipboard clipboard = createClipboard();
-    
-    // clipboard opened in createClipboard()
-    clipboard.close();
-    
-    // can't assert anything
+    while (!m_stop) {
+        if (XPending(m_ownerDisplay) == 0) {
+            ARCH->sleep(0.001);
+            continue;
+        }
+        XEvent xevent;
+        XNextEvent(m_ownerDisplay, &xevent);
+        if (xevent.type == SelectionRequest) {
+            request(xevent.xselectionrequest);
+        }
+    }
 }
 
-TEST_F(CXWindowsClipboardTests, has_withFormatAdded_returnsTrue)
+void
+XWindowsClipboardTests::request(const XSelectionRequestEvent& request)
 {
-    CXWindowsClipboard clipboard = createClipboard();
-    clipboard.add(IClipboard::kText, "synergy rocks!");
-    
-    bool actual = clipboard.has(IClipboard::kText);
-    
-    EXPECT_EQ(true, actual);
+    char* name = XGetAtomName(m_ownerDisplay, request.target);
+    String target(name);
+    XFree(name);
+
+    if (target == "TIMESTAMP") {
+        answer(request);
+        return;
+    }
+    {
+        Lock lock(&m_mutex);
+        m_requests.push_back(target);
+    }
+
+    if (target == "TARGETS" || m_hold == 0) {
+        answer(request);
+        return;
+    }
+    m_held.push_back(request);
+    if (m_held.size() >= m_hold) {
+        for (size_t i = 0; i < m_held.size(); ++i) {
+            answer(m_held[i]);
+        }
+        m_held.clear();
+    }
 }
 
-TEST_F(CXWindowsClipboardTests, has_withNoFormats_returnsFalse)
+void
+XWindowsClipboardTests::answer(const XSelectionRequestEvent& request)
 {
-    CXWindowsClipboard clipboard = createClipboard();
-    
-    bool actual = clipboard.has(IClipboard::kText);
-    
-    EXPECT_FALSE(actual);
+    char* name = XGetAtomName(m_ownerDisplay, request.target);
+    String target(name);
+    XFree(name);
+
+    Atom property = request.property;
+    if (target == "TARGETS") {
+        std::vector<Atom> atoms;
+        atoms.push_back(request.target);
+        for (TargetMap::const_iterator index = m_targets.begin();
+                                index != m_targets.end(); ++index) {
+            atoms.push_back(XInternAtom(m_ownerDisplay,
+                                index->first.c_str(), False));
+        }
+        XChangeProperty(m_ownerDisplay, request.requestor, property,
+                            XA_ATOM, 32, PropModeReplace,
+                            reinterpret_cast<unsigned char*>(&atoms[0]),
+                            (int)atoms.size());
+    }
+    else if (target == "TIMESTAMP") {
+        long timestamp = 1;
+        XChangeProperty(m_ownerDisplay, request.requestor, property,
+                            XA_INTEGER, 32, PropModeReplace,
+                            reinterpret_cast<unsigned char*>(&timestamp), 1);
+    }
+    else if (m_targets.count(target) != 0) {
+        const String& data = m_targets[target];
+        XChangeProperty(m_ownerDisplay, request.requestor, property,
+                            request.target, 8, PropModeReplace,
+                            reinterpret_cast<const unsigned char*>(data.data()),
+                            (int)data.size());
+    }
+    else {
+        property = None;
+    }
+
+    XEvent xevent;
+    xevent.xselection.type      = SelectionNotify;
+    xevent.xselection.display   = m_ownerDisplay;
+    xevent.xselection.requestor = request.requestor;
+    xevent.xselection.selection = request.selection;
+    xevent.xselection.target    = request.target;
+    xevent.xselection.property  = property;
+    xevent.xselection.time      = request.time;
+    XSendEvent(m_ownerDisplay, request.requestor, False, 0, &xevent);
+    XFlush(m_ownerDisplay);
 }
 
-TEST_F(CXWindowsClipboardTests, get_withNoFormats_returnsEmpty)
+TEST_F(XWindowsClipboardTests, has_textOnlyOwner_requestsListedTargets)
 {
-    CXWindowsClipboard clipboard = createClipboard();
-    
-    String actual = clipboard.get(IClipboard::kText);
-    
-    EXPECT_EQ("", actual);
+    TargetMap targets;
+    targets["UTF8_STRING"] = "synergy rocks!";
+    targets["STRING"]      = "synergy rocks!";
+    own(targets);
+
+    XWindowsClipboard clipboard(m_display, m_window, kClipboardSelection);
+    ASSERT_TRUE(clipboard.open(CurrentTime));
+    EXPECT_FALSE(clipboard.has(IClipboard::kHTML));
+    EXPECT_FALSE(clipboard.has(IClipboard::kBitmap));
+    EXPECT_TRUE(clipboard.has(IClipboard::kText));
+    EXPECT_EQ("synergy rocks!", clipboard.get(IClipboard::kText));
+    clipboard.close();
+
+    // one round trip for the formats and one for the text
+    std::vector<String> requests = getRequests();
+    ASSERT_EQ(2, (int)requests.size());
+    EXPECT_EQ("TARGETS", requests[0]);
+    EXPECT_EQ("UTF8_STRING", requests[1]);
 }
 
-TEST_F(CXWindowsClipboardTests, get_withFormatAdded_returnsExpected)
+TEST_F(XWindowsClipboardTests, has_oneFormatAsked_requestsOnlyThatFormat)
 {
-    CXWindowsClipboard clipboard = createClipboard();
-    clipboard.add(IClipboard::kText, "synergy rocks!");
-    
-    String actual = clipboard.get(IClipboard::kText);
-    
-    EXPECT_EQ("synergy rocks!", actual);
+    TargetMap targets;
+    targets["text/html"]   = "<b>synergy</b>";
+    targets["UTF8_STRING"] = "synergy";
+    own(targets);
+
+    XWindowsClipboard clipboard(m_display, m_window, kClipboardSelection);
+    ASSERT_TRUE(clipboard.open(CurrentTime));
+    EXPECT_TRUE(clipboard.has(IClipboard::kText));
+    clipboard.close();
+
+    EXPECT_TRUE(wasRequested("TARGETS"));
+    EXPECT_TRUE(wasRequested("UTF8_STRING"));
+    EXPECT_FALSE(wasRequested("text/html"));
 }
 
-#endif
+TEST_F(XWindowsClipboardTests, has_ignoreTargets_requestsEveryFormat)
+{
+    TargetMap targets;
+    targets["UTF8_STRING"] = "synergy rocks!";
+    own(targets);
+
+    XWindowsClipboard clipboard(m_display, m_window, kClipboardSelection);
+    clipboard.setIgnoreTargets(true);
+    ASSERT_TRUE(clipboard.open(CurrentTime));
+    EXPECT_FALSE(clipboard.has(IClipboard::kHTML));
+    EXPECT_FALSE(clipboard.has(IClipboard::kBitmap));
+    EXPECT_EQ("synergy rocks!", clipboard.get(IClipboard::kText));
+    clipboard.close();
+
+    EXPECT_FALSE(wasRequested("TARGETS"));
+    EXPECT_TRUE(wasRequested("text/html"));
+    EXPECT_TRUE(wasRequested("image/bmp"));
+    EXPECT_TRUE(wasRequested("text/plain;charset=UTF-8"));
+}
+
+TEST_F(XWindowsClipboardTests, fetch_severalFormats_requestsThemAtOnce)
+{
+    TargetMap targets;
+    targets["text/html"]   = Unicode::UTF8ToUTF16("<b>synergy</b>");
+    targets["UTF8_STRING"] = "synergy";
+    own(targets);
+
+    // one at a time the first request would time out
+    holdAnswers(2);
+    XWindowsClipboard clipboard(m_display, m_window, kClipboardSelection);
+    XWindowsClipboard::FetchedData fetched;
+    ASSERT_TRUE(clipboard.open(CurrentTime));
+    clipboard.fetch(fetched);
+    clipboard.close();
+
+    Clipboard converted;
+    ASSERT_TRUE(converted.open(0));
+    converted.empty();
+    fetched.convert(&converted);
+    EXPECT_FALSE(converted.has(IClipboard::kBitmap));
+    EXPECT_EQ("synergy", converted.get(IClipboard::kText));
+    EXPECT_EQ("<b>synergy</b>", converted.get(IClipboard::kHTML));
+    converted.close();
+    EXPECT_EQ(3, (int)getRequests().size());
+}
@@ -0,0 +1,209 @@
+/*
+ * synergy -- mouse and keyboard sharing utility
+ * Copyright (C) 2016 Symless Ltd.
+ *
+ * This package is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * found in the file LICENSE that should have accompanied this file.
+ *
+ * This package is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_ENV
+
+// gtest has to come first since X11 defines None
+#include "test/global/gtest.h"
+
+#include "test/global/TestEventQueue.h"
+#include "platform/XWindowsEventQueueBuffer.h"
+#include "mt/Thread.h"
+#include "arch/Arch.h"
+#include "base/TMethodJob.h"
+#include "base/Log.h"
+
+#include <X11/Xatom.h>
+#include <errno.h>
+#include <stdlib.h>
+
+// run against Xvfb, e.g. xvfb-run integtests
+const int kLatencyCount = 10000;
+const double kIdleTime  = 2.0;
+const double kTimeout   = 0.033;
+
+class XWindowsEventQueueBufferTests : public ::testing::Test
+{
+public:
+    XWindowsEventQueueBufferTests() :
+        m_display(NULL),
+        m_window(None),
+        m_buffer(NULL) { }
+
+    virtual void
+    SetUp()
+    {
+        m_display = XOpenDisplay(NULL);
+        ASSERT_TRUE(m_display != NULL)
+            << "unable to open display: " << errno;
+
+        XSetWindowAttributes attr;
+        attr.override_redirect = True;
+        m_window = XCreateWindow(m_display,
+                            XRootWindow(m_display, DefaultScreen(m_display)),
+                            0, 0, 1, 1, 0, 0, InputOnly, CopyFromParent,
+                            CWOverrideRedirect, &attr);
+        m_buffer = new XWindowsEventQueueBuffer(m_display, m_window, &m_events);
+    }
+
+    virtual void
+    TearDown()
+    {
+        delete m_buffer;
+        if (m_display != NULL) {
+            XDestroyWindow(m_display, m_window);
+            XCloseDisplay(m_display);
+        }
+    }
+
+    // sends a client message through the X server, the way user events
+    // used to be sent
+    void                sendClientMessage(long data);
+
+    // waits for and gets the next event
+    IEventQueueBuffer::Type
+                        nextEvent(UInt32& dataID);
+
+    void                addEventThread(void*);
+
+public:
+    TestEventQueue        m_events;
+    Display*            m_display;
+    Window                m_window;
+    XWindowsEventQueueBuffer*
+                        m_buffer;
+};
+
+void
+XWindowsEventQueueBufferTests::sendClientMessage(long data)
+{
+    XEvent xevent;
+    xevent.xclient.type         = ClientMessage;
+    xevent.xclient.window       = m_window;
+    xevent.xclient.message_type = XA_PRIMARY;
+    xevent.xclient.format       = 32;
+    xevent.xclient.data.l[0]    = data;
+    XSendEvent(m_display, m_window, False, 0, &xevent);
+    XFlush(m_display);
+}
+
+IEventQueueBuffer::Type
+XWindowsEventQueueBufferTests::nextEvent(UInt32& dataID)
+{
+    while (m_buffer->isEmpty()) {
+        m_buffer->waitForEvent(-1.0);
+    }
+    Event event;
+    return m_buffer->getEvent(event, dataID);
+}
+
+void
+XWindowsEventQueueBufferTests::addEventThread(void*)
+{
+    ARCH->sleep(0.1);
+    m_buffer->addEvent(42);
+}
+
+TEST_F(XWindowsEventQueueBufferTests, addEvent_whileWaiting_wakesWaiter)
+{
+    Thread thread(new TMethodJob<XWindowsEventQueueBufferTests>(
+                            this, &XWindowsEventQueueBufferTests::addEventThread));
+
+    double start = ARCH->time();
+    UInt32 dataID = 0;
+    IEventQueueBuffer::Type type = nextEvent(dataID);
+    double elapsed = ARCH->time() - start;
+    thread.wait();
+
+    EXPECT_EQ(IEventQueueBuffer::kUser, type);
+    EXPECT_EQ(42u, dataID);
+    EXPECT_LT(elapsed, 1.0);
+}
+
+TEST_F(XWindowsEventQueueBufferTests, waitForEvent_idle_noWakeups)
+{
+    double start = ARCH->time();
+    m_buffer->waitForEvent(kIdleTime);
+    double elapsed = ARCH->time() - start;
+
+    LOG((CLOG_INFO "idle wakeups: %.1f per second",
+                m_buffer->getIdleWakeups() / elapsed));
+    EXPECT_EQ(0u, m_buffer->getIdleWakeups());
+    EXPECT_GE(elapsed, kIdleTime);
+}
+
+TEST_F(XWindowsEventQueueBufferTests, waitForEvent_timeout_wakesOnDeadline)
+{
+    double start = ARCH->time();
+    m_buffer->waitForEvent(kTimeout);
+    double elapsed = ARCH->time() - start;
+
+    // only check it didn't wait far past the deadline.  a loaded
+    // machine can be slow to schedule us again so the margin is wide.
+    EXPECT_GE(elapsed, kTimeout);
+    EXPECT_LT(elapsed, kTimeout + 0.25);
+}
+
+TEST_F(XWindowsEventQueueBufferTests, getEvent_userAndSystemEvents_takesTurns)
+{
+    for (int i = 0; i < 3; ++i) {
+        m_buffer->addEvent(i);
+        sendClientMessage(i);
+    }
+    XSync(m_display, False);
+
+    int user = 0, system = 0;
+    for (int i = 0; i < 6; ++i) {
+        UInt32 dataID;
+        if (nextEvent(dataID) == IEventQueueBuffer::kUser) {
+            EXPECT_EQ((UInt32)user, dataID);
+            ++user;
+        }
+        else {
+            ++system;
+        }
+        EXPECT_LE(abs(user - system), 1);
+    }
+    EXPECT_TRUE(m_buffer->isEmpty());
+}
+
+TEST_F(XWindowsEventQueueBufferTests, benchmark_addEventToDispatch)
+{
+    // through the X server, as user events used to go
+    double start = ARCH->time();
+    for (int i = 0; i < kLatencyCount; ++i) {
+        UInt32 dataID;
+        sendClientMessage(i);
+        ASSERT_EQ(IEventQueueBuffer::kSystem, nextEvent(dataID));
+    }
+    double serverTime = ARCH->time() - start;
+
+    // and straight to the queue
+    start = ARCH->time();
+    for (int i = 0; i < kLatencyCount; ++i) {
+        UInt32 dataID;
+        m_buffer->addEvent(i);
+        ASSERT_EQ(IEventQueueBuffer::kUser, nextEvent(dataID));
+        ASSERT_EQ((UInt32)i, dataID);
+    }
+    double queueTime = ARCH->time() - start;
+
+    LOG((CLOG_INFO "user event latency: %.1f us through X server, %.1f us queued",
+                serverTime / kLatencyCount * 1.0e+6,
+                queueTime / kLatencyCount * 1.0e+6));
+    EXPECT_LT(queueTime, serverTime);
+}
@@ -33,7 +33,9 @@ class MockIpcServer : public IpcServer
 public:
     MockIpcServer() :
         m_sendCond(ARCH->newCondVar()),
-        m_sendMutex(ARCH->newMutex()) { }
+        m_sendMutex(ARCH->newMutex()),
+        m_sends(0),
+        m_waitedSends(0) { }
     
     ~MockIpcServer() {
         if (m_sendCond != NULL) {
@@ -53,16 +55,27 @@ public:
         ON_CALL(*this, send(_, _)).WillByDefault(Invoke(this, &MockIpcServer::mockSend));
     }
 
+    // waits up to 5 seconds for a send not already waited for
     void waitForSend() {
-        ARCH->waitCondVar(m_sendCond, m_sendMutex, 5);
+        ArchMutexLock lock(m_sendMutex);
+        double timeout = ARCH->time() + 5;
+        while (m_sends == m_waitedSends && ARCH->time() < timeout) {
+            ARCH->waitCondVar(m_sendCond, m_sendMutex, 5);
+        }
+        if (m_sends != m_waitedSends) {
+            ++m_waitedSends;
+        }
     }
 
 private:
     void mockSend(const IpcMessage&, EIpcClientType) {
         ArchMutexLock lock(m_sendMutex);
+        ++m_sends;
         ARCH->broadcastCondVar(m_sendCond);
     }
 
     ArchCond            m_sendCond;
     ArchMutex            m_sendMutex;
+    int                    m_sends;
+    int                    m_waitedSends;
 };
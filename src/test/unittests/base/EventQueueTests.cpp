@@ -0,0 +1,287 @@
+/*
+ * synergy -- mouse and keyboard sharing utility
+ * Copyright (C) 2016 Symless Ltd.
+ *
+ * This package is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * found in the file LICENSE that should have accompanied this file.
+ *
+ * This package is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "base/EventQueue.h"
+#include "base/TMethodEventJob.h"
+#include "base/TMethodJob.h"
+#include "base/Log.h"
+#include "mt/Thread.h"
+#include "arch/Arch.h"
+#include "common/stdvector.h"
+
+#include "test/global/gtest.h"
+
+const int kEventCount    = 1000000;
+const int kEventsInFlight = 64;
+const int kProducerCount = 4;
+
+const int kTimerCount    = 10000;
+const int kTimerChecks   = 10000;
+
+class EventQueueTests : public ::testing::Test
+{
+public:
+    EventQueueTests() :
+        m_type(Event::kUnknown),
+        m_dispatched(0),
+        m_added(0) { }
+
+    virtual void
+    SetUp()
+    {
+        m_events.registerTypeOnce(m_type, "EventQueueTests::m_type");
+    }
+
+    // counts the event and keeps kEventsInFlight queued until all have
+    // been added
+    void                handleReplace(const Event&, void*);
+
+    // counts the event and quits after the last
+    void                handleCount(const Event&, void*);
+
+    // counts the event and removes the handler for m_events
+    void                handleRemove(const Event&, void*);
+
+    // records the timer and quits after the third
+    void                handleTimer(const Event&, void*);
+
+    void                produceThread(void*);
+
+public:
+    EventQueue            m_events;
+    Event::Type            m_type;
+    int                    m_dispatched;
+    int                    m_added;
+    std::vector<EventQueueTimer*>
+                        m_expired;
+};
+
+void
+EventQueueTests::handleReplace(const Event&, void*)
+{
+    ++m_dispatched;
+    if (m_added < kEventCount) {
+        ++m_added;
+        m_events.addEvent(Event(m_type, this));
+    }
+    else if (m_dispatched == kEventCount) {
+        m_events.addEvent(Event(Event::kQuit));
+    }
+}
+
+void
+EventQueueTests::handleCount(const Event&, void*)
+{
+    if (++m_dispatched == kEventCount) {
+        m_events.addEvent(Event(Event::kQuit));
+    }
+}
+
+void
+EventQueueTests::handleRemove(const Event&, void*)
+{
+    ++m_dispatched;
+    m_events.removeHandler(m_type, &m_events);
+}
+
+void
+EventQueueTests::handleTimer(const Event& event, void*)
+{
+    IEventQueue::TimerEvent* timerEvent =
+        static_cast<IEventQueue::TimerEvent*>(event.getData());
+    m_expired.push_back(timerEvent->m_timer);
+    if (m_expired.size() == 3) {
+        m_events.addEvent(Event(Event::kQuit));
+    }
+}
+
+void
+EventQueueTests::produceThread(void*)
+{
+    m_events.waitForReady();
+    for (int i = 0; i < kEventCount / kProducerCount; ++i) {
+        m_events.addEvent(Event(m_type, this));
+    }
+}
+
+TEST_F(EventQueueTests, dispatchEvent_noHandlerForType_usesAnyTypeHandler)
+{
+    m_events.adoptHandler(Event::kUnknown, this,
+                            new TMethodEventJob<EventQueueTests>(this,
+                                &EventQueueTests::handleCount));
+
+    EXPECT_TRUE(m_events.dispatchEvent(Event(m_type, this)));
+    EXPECT_FALSE(m_events.dispatchEvent(Event(m_type, &m_events)));
+    EXPECT_EQ(1, m_dispatched);
+
+    m_events.removeHandlers(this);
+    EXPECT_FALSE(m_events.dispatchEvent(Event(m_type, this)));
+    EXPECT_TRUE(m_events.getHandler(Event::kUnknown, this) == NULL);
+}
+
+TEST_F(EventQueueTests, removeHandler_whileDispatching_othersStillRun)
+{
+    m_events.adoptHandler(m_type, this,
+                            new TMethodEventJob<EventQueueTests>(this,
+                                &EventQueueTests::handleRemove));
+    m_events.adoptHandler(m_type, &m_events,
+                            new TMethodEventJob<EventQueueTests>(this,
+                                &EventQueueTests::handleCount));
+    m_events.adoptHandler(m_type, &m_expired,
+                            new TMethodEventJob<EventQueueTests>(this,
+                                &EventQueueTests::handleCount));
+
+    // the first handler removes the second's while it's running, after
+    // its event has already been queued
+    m_events.addEvent(Event(m_type, this));
+    m_events.addEvent(Event(m_type, &m_events));
+    m_events.addEvent(Event(m_type, &m_expired));
+    m_events.addEvent(Event(Event::kQuit));
+    m_events.loop();
+
+    EXPECT_EQ(2, m_dispatched);
+    EXPECT_TRUE(m_events.getHandler(m_type, &m_events) == NULL);
+
+    m_events.removeHandler(m_type, this);
+    m_events.removeHandler(m_type, &m_expired);
+}
+
+TEST_F(EventQueueTests, newOneShotTimer_deleteOne_othersExpireInOrder)
+{
+    EventQueueTimer* timers[4];
+    timers[0] = m_events.newOneShotTimer(0.03, NULL);
+    timers[1] = m_events.newOneShotTimer(0.01, NULL);
+    timers[2] = m_events.newOneShotTimer(0.015, NULL);
+    timers[3] = m_events.newOneShotTimer(0.02, NULL);
+    m_events.deleteTimer(timers[2]);
+    for (int i = 0; i < 4; ++i) {
+        m_events.adoptHandler(Event::kTimer, timers[i],
+                            new TMethodEventJob<EventQueueTests>(this,
+                                &EventQueueTests::handleTimer));
+    }
+
+    m_events.loop();
+
+    ASSERT_EQ(3u, m_expired.size());
+    EXPECT_EQ(timers[1], m_expired[0]);
+    EXPECT_EQ(timers[3], m_expired[1]);
+    EXPECT_EQ(timers[0], m_expired[2]);
+
+    for (int i = 0; i < 4; ++i) {
+        m_events.removeHandler(Event::kTimer, timers[i]);
+        if (i != 2) {
+            m_events.deleteTimer(timers[i]);
+        }
+    }
+}
+
+TEST_F(EventQueueTests, newTimer_periodic_expiresRepeatedly)
+{
+    EventQueueTimer* timer = m_events.newTimer(0.01, NULL);
+    m_events.adoptHandler(Event::kTimer, timer,
+                            new TMethodEventJob<EventQueueTests>(this,
+                                &EventQueueTests::handleTimer));
+
+    double start = ARCH->time();
+    m_events.loop();
+    double elapsed = ARCH->time() - start;
+
+    EXPECT_EQ(3u, m_expired.size());
+    EXPECT_GE(elapsed, 0.03);
+    m_events.removeHandler(Event::kTimer, timer);
+    m_events.deleteTimer(timer);
+}
+
+TEST_F(EventQueueTests, benchmark_10kTimers)
+{
+    // long timers, as for keep alives and heartbeats, that never expire
+    // here
+    std::vector<EventQueueTimer*> timers;
+    for (int i = 0; i < kTimerCount; ++i) {
+        timers.push_back(m_events.newTimer(100.0 + (i * 7919 % kTimerCount) *
+                            0.01, NULL));
+    }
+
+    // each check is a pass of the event loop without events
+    Event event;
+    double start = ARCH->time();
+    for (int i = 0; i < kTimerChecks; ++i) {
+        EXPECT_FALSE(m_events.getEvent(event, 0.0));
+    }
+    double checkTime = ARCH->time() - start;
+
+    // delete in an order unrelated to the deadlines
+    start = ARCH->time();
+    for (int i = 0; i < kTimerCount; ++i) {
+        m_events.deleteTimer(timers[i * 4271 % kTimerCount]);
+    }
+    double deleteTime = ARCH->time() - start;
+
+    LOG((CLOG_INFO "with %d timers: %.2f us per loop pass, %.2f us per delete",
+                kTimerCount,
+                checkTime / kTimerChecks * 1.0e+6,
+                deleteTime / kTimerCount * 1.0e+6));
+    EXPECT_TRUE(m_events.isEmpty());
+}
+
+TEST_F(EventQueueTests, benchmark_singleThread)
+{
+    m_events.adoptHandler(m_type, this,
+                            new TMethodEventJob<EventQueueTests>(this,
+                                &EventQueueTests::handleReplace));
+
+    // the handler adds an event for each one it gets
+    for (m_added = 0; m_added < kEventsInFlight; ++m_added) {
+        m_events.addEvent(Event(m_type, this));
+    }
+
+    double start = ARCH->time();
+    m_events.loop();
+    double elapsed = ARCH->time() - start;
+
+    LOG((CLOG_INFO "event queue on one thread: %.0f events/s",
+                kEventCount / elapsed));
+    EXPECT_EQ(kEventCount, m_dispatched);
+    m_events.removeHandler(m_type, this);
+}
+
+TEST_F(EventQueueTests, benchmark_producers)
+{
+    m_events.adoptHandler(m_type, this,
+                            new TMethodEventJob<EventQueueTests>(this,
+                                &EventQueueTests::handleCount));
+
+    std::vector<Thread*> producers;
+    for (int i = 0; i < kProducerCount; ++i) {
+        producers.push_back(new Thread(new TMethodJob<EventQueueTests>(
+                            this, &EventQueueTests::produceThread)));
+    }
+
+    double start = ARCH->time();
+    m_events.loop();
+    double elapsed = ARCH->time() - start;
+
+    for (int i = 0; i < kProducerCount; ++i) {
+        producers[i]->wait();
+        delete producers[i];
+    }
+
+    LOG((CLOG_INFO "event queue with %d producers: %.0f events/s",
+                kProducerCount, kEventCount / elapsed));
+    EXPECT_EQ(kEventCount, m_dispatched);
+    m_events.removeHandler(m_type, this);
+}
@@ -0,0 +1,135 @@
+/*
+ * synergy -- mouse and keyboard sharing utility
+ * Copyright (C) 2016 Symless Ltd.
+ *
+ * This package is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * found in the file LICENSE that should have accompanied this file.
+ *
+ * This package is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "base/log_outputters.h"
+#include "base/Log.h"
+#include "base/String.h"
+#include "arch/Arch.h"
+
+#include "test/global/gtest.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+
+const char* kLogFilename = "LogOutputtersTests.log";
+
+// about a DEBUG1 line
+const char* kLogLine     = "[2016-01-01T00:00:00] DEBUG1: "
+                            "sending mouse move to \"desk\" 1234,567";
+const int kLogLineCount  = 100000;
+
+static String
+readFile(const String& filename)
+{
+    std::ifstream file(filename.c_str());
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+static bool
+fileExists(const String& filename)
+{
+    std::ifstream file(filename.c_str());
+    return file.good();
+}
+
+class FileLogOutputterTests : public ::testing::Test
+{
+public:
+    virtual void
+    TearDown()
+    {
+        removeFiles();
+    }
+
+    static void
+    removeFiles()
+    {
+        remove(kLogFilename);
+        for (int i = 1; i <= 5; ++i) {
+            remove(synergy::string::sprintf("%s.%d", kLogFilename, i).c_str());
+        }
+    }
+};
+
+TEST_F(FileLogOutputterTests, write_error_writtenBeforeReturning)
+{
+    FileLogOutputter outputter(kLogFilename);
+    outputter.write(kINFO, "first");
+    outputter.write(kERROR, "second");
+
+    EXPECT_EQ("first\nsecond\n", readFile(kLogFilename));
+}
+
+TEST_F(FileLogOutputterTests, write_thenDestroyed_allLinesWritten)
+{
+    {
+        FileLogOutputter outputter(kLogFilename);
+        for (int i = 0; i < 1000; ++i) {
+            outputter.write(kDEBUG1, "line");
+        }
+    }
+
+    String contents = readFile(kLogFilename);
+    EXPECT_EQ(1000, std::count(contents.begin(), contents.end(), '\n'));
+}
+
+TEST_F(FileLogOutputterTests, write_pastMaxSize_keepsGenerations)
+{
+    FileLogOutputter outputter(kLogFilename);
+    outputter.setRotation(4096, 3);
+    for (int i = 0; i < 500; ++i) {
+        outputter.write(kINFO, kLogLine);
+        outputter.flush();
+    }
+
+    EXPECT_TRUE(fileExists(kLogFilename));
+    EXPECT_TRUE(fileExists(synergy::string::sprintf("%s.3", kLogFilename)));
+    EXPECT_FALSE(fileExists(synergy::string::sprintf("%s.4", kLogFilename)));
+    EXPECT_LE(readFile(kLogFilename).size(), 4096u + strlen(kLogLine) + 1);
+}
+
+TEST_F(FileLogOutputterTests, benchmark_write)
+{
+    FileLogOutputter outputter(kLogFilename);
+    outputter.setRotation(64 * 1024 * 1024, 1);
+
+    // the time in write() is time the event thread isn't handling input
+    double slowest = 0.0;
+    double start   = ARCH->time();
+    for (int i = 0; i < kLogLineCount; ++i) {
+        double lineStart = ARCH->time();
+        outputter.write(kDEBUG1, kLogLine);
+        slowest = std::max(slowest, ARCH->time() - lineStart);
+    }
+    double elapsed = ARCH->time() - start;
+    outputter.flush();
+    double flushed = ARCH->time() - start;
+
+    LOG((CLOG_INFO "file log: %.0f lines/s written, %.0f lines/s to disk, "
+                "%.2f us per line, slowest %.0f us",
+                kLogLineCount / elapsed, kLogLineCount / flushed,
+                elapsed / kLogLineCount * 1.0e+6, slowest * 1.0e+6));
+
+    // lines may have been dropped if the disk couldn't keep up but the
+    // last line is always there
+    String contents = readFile(kLogFilename);
+    EXPECT_LT(0, std::count(contents.begin(), contents.end(), '\n'));
+}
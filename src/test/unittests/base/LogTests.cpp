@@ -0,0 +1,297 @@
+/*
+ * synergy -- mouse and keyboard sharing utility
+ * Copyright (C) 2016 Symless Ltd.
+ *
+ * This package is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * found in the file LICENSE that should have accompanied this file.
+ *
+ * This package is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "base/Log.h"
+#include "base/ILogOutputter.h"
+#include "arch/Arch.h"
+#include "common/stdvector.h"
+
+#include "test/global/gtest.h"
+
+#include <cstdio>
+#include <string>
+
+const int kFilteredCount = 10000000;
+const int kFormatCount   = 1000000;
+
+// keeps what's written
+class CaptureLogOutputter : public ILogOutputter {
+public:
+    virtual void        open(const char*) { }
+    virtual void        close() { }
+    virtual void        show(bool) { }
+    virtual bool        write(ELevel level, const char* message)
+    {
+        m_levels.push_back(level);
+        m_messages.push_back(message);
+        return true;
+    }
+
+public:
+    std::vector<ELevel>        m_levels;
+    std::vector<std::string>    m_messages;
+};
+
+// counts what's written and stops it going any further
+class NullLogOutputter : public ILogOutputter {
+public:
+    NullLogOutputter() : m_count(0) { }
+
+    virtual void        open(const char*) { }
+    virtual void        close() { }
+    virtual void        show(bool) { }
+    virtual bool        write(ELevel, const char*)
+    {
+        ++m_count;
+        return false;
+    }
+
+public:
+    int                    m_count;
+};
+
+class LogTests : public ::testing::Test
+{
+public:
+    LogTests() : m_evaluated(0)
+    {
+        m_filter = CLOG->getFilter();
+        CLOG->insert(&m_outputter);
+    }
+
+    ~LogTests()
+    {
+        CLOG->remove(&m_outputter);
+        CLOG->setFilter(m_filter);
+        CLOG->setFormat(Log::kFormatText);
+    }
+
+    // returns the monotonic timestamp of a json line
+    static long long    getMonotonic(const std::string& line);
+
+    // an argument that counts how often it's evaluated
+    const char*            name()
+    {
+        ++m_evaluated;
+        return "screen";
+    }
+
+public:
+    CaptureLogOutputter    m_outputter;
+    int                    m_filter;
+    int                    m_evaluated;
+};
+
+long long
+LogTests::getMonotonic(const std::string& line)
+{
+    long long monotonic = -1;
+    size_t index = line.find("\"monotonic_us\":");
+    if (index != std::string::npos) {
+        sscanf(line.c_str() + index, "\"monotonic_us\":%lld", &monotonic);
+    }
+    return monotonic;
+}
+
+TEST_F(LogTests, log_enabled_writesMessage)
+{
+    CLOG->setFilter(kDEBUG2);
+
+    LOG((CLOG_DEBUG2 "mouse move on \"%s\" to %d,%d", name(), 10, 20));
+
+    EXPECT_EQ(1, m_evaluated);
+    ASSERT_EQ(1, (int)m_outputter.m_messages.size());
+    EXPECT_EQ(kDEBUG2, m_outputter.m_levels[0]);
+    EXPECT_NE(std::string::npos, m_outputter.m_messages[0].find(
+                            "DEBUG2: mouse move on \"screen\" to 10,20"));
+}
+
+TEST_F(LogTests, log_filtered_argumentsNotEvaluated)
+{
+    CLOG->setFilter(kINFO);
+
+    LOG((CLOG_DEBUG2 "mouse move on \"%s\"", name()));
+    LOGC(true, (CLOG_DEBUG "mouse move on \"%s\"", name()));
+
+    EXPECT_EQ(0, m_evaluated);
+    EXPECT_TRUE(m_outputter.m_messages.empty());
+}
+
+TEST_F(LogTests, log_print_neverFiltered)
+{
+    CLOG->setFilter(kFATAL);
+
+    LOG((CLOG_PRINT "%s", name()));
+
+    EXPECT_EQ(1, m_evaluated);
+    ASSERT_EQ(1, (int)m_outputter.m_messages.size());
+    EXPECT_EQ(kPRINT, m_outputter.m_levels[0]);
+    EXPECT_EQ("screen", m_outputter.m_messages[0]);
+}
+
+TEST_F(LogTests, log_inIfElse_bindsToOuterIf)
+{
+    CLOG->setFilter(kINFO);
+
+    bool otherwise = false;
+    if (m_evaluated != 0)
+        LOG((CLOG_INFO "%s", name()));
+    else
+        otherwise = true;
+
+    EXPECT_TRUE(otherwise);
+    EXPECT_EQ(0, m_evaluated);
+}
+
+TEST_F(LogTests, print_priorityPrefix_stillFiltered)
+{
+    CLOG->setFilter(kINFO);
+
+    CLOG->print(NULL, 0, "%z\067%s", "filtered");
+    CLOG->print(NULL, 0, "%z\064%s", "written");
+
+    ASSERT_EQ(1, (int)m_outputter.m_messages.size());
+    EXPECT_EQ(kINFO, m_outputter.m_levels[0]);
+}
+
+TEST_F(LogTests, setFilter_name_isEnabled)
+{
+    EXPECT_TRUE(CLOG->setFilter("DEBUG1"));
+    EXPECT_TRUE(CLOG->isEnabled(kDEBUG1));
+    EXPECT_FALSE(CLOG->isEnabled(kDEBUG2));
+    EXPECT_STREQ("DEBUG1", CLOG->getFilterName());
+
+    EXPECT_FALSE(CLOG->setFilter("LOUD"));
+    EXPECT_EQ(kDEBUG1, CLOG->getFilter());
+}
+
+TEST_F(LogTests, log_textFormat_prefixesTimestampAndLevel)
+{
+    LOG((CLOG_NOTE "connected to %s", name()));
+
+    ASSERT_EQ(1, (int)m_outputter.m_messages.size());
+    const std::string& line = m_outputter.m_messages[0];
+    int year, month, day, hour, minute, second;
+    char rest[64] = "";
+    EXPECT_EQ(7, sscanf(line.c_str(), "[%4d-%2d-%2dT%2d:%2d:%2d] %63[^\n]",
+                            &year, &month, &day, &hour, &minute, &second, rest));
+    EXPECT_STREQ("NOTE: connected to screen", rest);
+}
+
+TEST_F(LogTests, log_jsonFormat_writesObject)
+{
+    EXPECT_TRUE(CLOG->setFormat("json"));
+
+    LOG((CLOG_WARN "say \"%s\"\tthen\\%c", name(), 1));
+
+    ASSERT_EQ(1, (int)m_outputter.m_messages.size());
+    const std::string& line = m_outputter.m_messages[0];
+    EXPECT_EQ(0u, line.find("{\"time\":\""));
+    EXPECT_EQ('}', line[line.size() - 1]);
+    EXPECT_NE(std::string::npos, line.find("\"level\":\"WARNING\""));
+    EXPECT_NE(std::string::npos, line.find(
+                            "\"message\":\"say \\\"screen\\\"\\tthen\\\\\\u0001\""));
+    EXPECT_EQ(std::string::npos, line.find('\n'));
+    EXPECT_LT(0, getMonotonic(line));
+}
+
+TEST_F(LogTests, log_jsonFormat_monotonicIncreases)
+{
+    CLOG->setFormat(Log::kFormatJson);
+
+    LOG((CLOG_INFO "first"));
+    ARCH->sleep(0.002);
+    LOG((CLOG_INFO "second"));
+
+    ASSERT_EQ(2, (int)m_outputter.m_messages.size());
+    long long first  = getMonotonic(m_outputter.m_messages[0]);
+    long long second = getMonotonic(m_outputter.m_messages[1]);
+    EXPECT_GE(second - first, 2000);
+}
+
+TEST_F(LogTests, log_jsonFormat_printNotFormatted)
+{
+    CLOG->setFormat(Log::kFormatJson);
+
+    LOG((CLOG_PRINT "usage: %s", name()));
+
+    ASSERT_EQ(1, (int)m_outputter.m_messages.size());
+    EXPECT_EQ("usage: screen", m_outputter.m_messages[0]);
+}
+
+TEST_F(LogTests, log_longMessage_notTruncated)
+{
+    std::string text(100000, 'x');
+    text[text.size() - 1] = 'y';
+
+    LOG((CLOG_INFO "%s", text.c_str()));
+    LOG((CLOG_INFO "%s", "short"));
+
+    ASSERT_EQ(2, (int)m_outputter.m_messages.size());
+    EXPECT_NE(std::string::npos, m_outputter.m_messages[0].find(text));
+    EXPECT_NE(std::string::npos, m_outputter.m_messages[1].find("INFO: short"));
+    EXPECT_EQ(std::string::npos, m_outputter.m_messages[1].find('x'));
+}
+
+TEST_F(LogTests, setFormat_unknownName_unchanged)
+{
+    EXPECT_TRUE(CLOG->setFormat("json"));
+    EXPECT_FALSE(CLOG->setFormat("xml"));
+    EXPECT_TRUE(CLOG->setFormat(NULL));
+    EXPECT_EQ(Log::kFormatJson, CLOG->getFormat());
+}
+
+TEST_F(LogTests, benchmark_format)
+{
+    NullLogOutputter null;
+    CLOG->insert(&null);
+
+    double start = ARCH->time();
+    for (int i = 0; i < kFormatCount; ++i) {
+        LOG((CLOG_INFO "mouse move on \"%s\" to %d,%d", "screen", i, i));
+    }
+    double text = ARCH->time() - start;
+
+    CLOG->setFormat(Log::kFormatJson);
+    start = ARCH->time();
+    for (int i = 0; i < kFormatCount; ++i) {
+        LOG((CLOG_INFO "mouse move on \"%s\" to %d,%d", "screen", i, i));
+    }
+    double json = ARCH->time() - start;
+
+    CLOG->remove(&null);
+    CLOG->setFormat(Log::kFormatText);
+
+    LOG((CLOG_INFO "formatted log line: %.0f ns as text, %.0f ns as json",
+                text / kFormatCount * 1.0e+9, json / kFormatCount * 1.0e+9));
+    EXPECT_EQ(2 * kFormatCount, null.m_count);
+}
+
+TEST_F(LogTests, benchmark_filtered)
+{
+    CLOG->setFilter(kINFO);
+
+    double start = ARCH->time();
+    for (int i = 0; i < kFilteredCount; ++i) {
+        LOG((CLOG_DEBUG2 "mouse move on \"%s\" to %d,%d", name(), i, i));
+    }
+    double elapsed = ARCH->time() - start;
+
+    LOG((CLOG_INFO "filtered log call: %.2f ns",
+                elapsed / kFilteredCount * 1.0e+9));
+    EXPECT_EQ(0, m_evaluated);
+}
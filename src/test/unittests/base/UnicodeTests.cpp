@@ -0,0 +1,981 @@
+/*
+ * synergy -- mouse and keyboard sharing utility
+ * Copyright (C) 2016 Symless Ltd.
+ *
+ * This package is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * found in the file LICENSE that should have accompanied this file.
+ *
+ * This package is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "base/Unicode.h"
+#include "base/Log.h"
+#include "arch/Arch.h"
+
+#include "test/global/gtest.h"
+
+#include <algorithm>
+#include <cstring>
+
+const int kFuzzStrings     = 5000;
+const int kBenchmarkSizes[] = { 1, 10, 100 };
+
+//
+// the conversions as they were before they were vectorized, one
+// character at a time.  the fuzz tests check the output is the same
+// byte for byte, quirks included.
+//
+
+class ReferenceUnicode {
+public:
+    static bool            isUTF8(const String&);
+    static String        UTF8ToUCS2(const String&, bool* errors = NULL);
+    static String        UTF8ToUCS4(const String&, bool* errors = NULL);
+    static String        UTF8ToUTF16(const String&, bool* errors = NULL);
+    static String        UTF8ToUTF32(const String&, bool* errors = NULL);
+    static String        UCS2ToUTF8(const String&, bool* errors = NULL);
+    static String        UCS4ToUTF8(const String&, bool* errors = NULL);
+    static String        UTF16ToUTF8(const String&, bool* errors = NULL);
+    static String        UTF32ToUTF8(const String&, bool* errors = NULL);
+
+private:
+    static String        doUCS2ToUTF8(const UInt8* src, UInt32 n, bool* errors);
+    static String        doUCS4ToUTF8(const UInt8* src, UInt32 n, bool* errors);
+    static String        doUTF16ToUTF8(const UInt8* src, UInt32 n, bool* errors);
+    static String        doUTF32ToUTF8(const UInt8* src, UInt32 n, bool* errors);
+    static UInt32        fromUTF8(const UInt8*& src, UInt32& size);
+    static void            toUTF8(String& dst, UInt32 c, bool* errors);
+
+private:
+    static UInt32        s_invalid;
+    static UInt32        s_replacement;
+};
+
+inline
+static
+UInt16
+decode16(const UInt8* n, bool byteSwapped)
+{
+    union x16 {
+        UInt8    n8[2];
+        UInt16    n16;
+    } c;
+    if (byteSwapped) {
+        c.n8[0] = n[1];
+        c.n8[1] = n[0];
+    }
+    else {
+        c.n8[0] = n[0];
+        c.n8[1] = n[1];
+    }
+    return c.n16;
+}
+
+inline
+static
+UInt32
+decode32(const UInt8* n, bool byteSwapped)
+{
+    union x32 {
+        UInt8    n8[4];
+        UInt32    n32;
+    } c;
+    if (byteSwapped) {
+        c.n8[0] = n[3];
+        c.n8[1] = n[2];
+        c.n8[2] = n[1];
+        c.n8[3] = n[0];
+    }
+    else {
+        c.n8[0] = n[0];
+        c.n8[1] = n[1];
+        c.n8[2] = n[2];
+        c.n8[3] = n[3];
+    }
+    return c.n32;
+}
+
+inline
+static
+void
+resetError(bool* errors)
+{
+    if (errors != NULL) {
+        *errors = false;
+    }
+}
+
+inline
+static
+void
+setError(bool* errors)
+{
+    if (errors != NULL) {
+        *errors = true;
+    }
+}
+
+UInt32                    ReferenceUnicode::s_invalid     = 0x0000ffff;
+UInt32                    ReferenceUnicode::s_replacement = 0x0000fffd;
+
+bool
+ReferenceUnicode::isUTF8(const String& src)
+{
+    // convert and test each character
+    const UInt8* data = reinterpret_cast<const UInt8*>(src.c_str());
+    for (UInt32 n = (UInt32)src.size(); n > 0; ) {
+        if (fromUTF8(data, n) == s_invalid) {
+            return false;
+        }
+    }
+    return true;
+}
+
+String
+ReferenceUnicode::UTF8ToUCS2(const String& src, bool* errors)
+{
+    // default to success
+    resetError(errors);
+
+    // get size of input string and reserve some space in output
+    UInt32 n = (UInt32)src.size();
+    String dst;
+    dst.reserve(2 * n);
+
+    // convert each character
+    const UInt8* data = reinterpret_cast<const UInt8*>(src.c_str());
+    while (n > 0) {
+        UInt32 c = fromUTF8(data, n);
+        if (c == s_invalid) {
+            c = s_replacement;
+        }
+        else if (c >= 0x00010000) {
+            setError(errors);
+            c = s_replacement;
+        }
+        UInt16 ucs2 = static_cast<UInt16>(c);
+        dst.append(reinterpret_cast<const char*>(&ucs2), 2);
+    }
+
+    return dst;
+}
+
+String
+ReferenceUnicode::UTF8ToUCS4(const String& src, bool* errors)
+{
+    // default to success
+    resetError(errors);
+
+    // get size of input string and reserve some space in output
+    UInt32 n = (UInt32)src.size();
+    String dst;
+    dst.reserve(4 * n);
+
+    // convert each character
+    const UInt8* data = reinterpret_cast<const UInt8*>(src.c_str());
+    while (n > 0) {
+        UInt32 c = fromUTF8(data, n);
+        if (c == s_invalid) {
+            c = s_replacement;
+        }
+        dst.append(reinterpret_cast<const char*>(&c), 4);
+    }
+
+    return dst;
+}
+
+String
+ReferenceUnicode::UTF8ToUTF16(const String& src, bool* errors)
+{
+    // default to success
+    resetError(errors);
+
+    // get size of input string and reserve some space in output
+    UInt32 n = (UInt32)src.size();
+    String dst;
+    dst.reserve(2 * n);
+
+    // convert each character
+    const UInt8* data = reinterpret_cast<const UInt8*>(src.c_str());
+    while (n > 0) {
+        UInt32 c = fromUTF8(data, n);
+        if (c == s_invalid) {
+            c = s_replacement;
+        }
+        else if (c >= 0x00110000) {
+            setError(errors);
+            c = s_replacement;
+        }
+        if (c < 0x00010000) {
+            UInt16 ucs2 = static_cast<UInt16>(c);
+            dst.append(reinterpret_cast<const char*>(&ucs2), 2);
+        }
+        else {
+            c -= 0x00010000;
+            UInt16 utf16h = static_cast<UInt16>((c >> 10) + 0xd800);
+            UInt16 utf16l = static_cast<UInt16>((c & 0x03ff) + 0xdc00);
+            dst.append(reinterpret_cast<const char*>(&utf16h), 2);
+            dst.append(reinterpret_cast<const char*>(&utf16l), 2);
+        }
+    }
+
+    return dst;
+}
+
+String
+ReferenceUnicode::UTF8ToUTF32(const String& src, bool* errors)
+{
+    // default to success
+    resetError(errors);
+
+    // get size of input string and reserve some space in output
+    UInt32 n = (UInt32)src.size();
+    String dst;
+    dst.reserve(4 * n);
+
+    // convert each character
+    const UInt8* data = reinterpret_cast<const UInt8*>(src.c_str());
+    while (n > 0) {
+        UInt32 c = fromUTF8(data, n);
+        if (c == s_invalid) {
+            c = s_replacement;
+        }
+        else if (c >= 0x00110000) {
+            setError(errors);
+            c = s_replacement;
+        }
+        dst.append(reinterpret_cast<const char*>(&c), 4);
+    }
+
+    return dst;
+}
+
+String
+ReferenceUnicode::UCS2ToUTF8(const String& src, bool* errors)
+{
+    // default to success
+    resetError(errors);
+
+    // convert
+    UInt32 n = (UInt32)src.size() >> 1;
+    return doUCS2ToUTF8(reinterpret_cast<const UInt8*>(src.data()), n, errors);
+}
+
+String
+ReferenceUnicode::UCS4ToUTF8(const String& src, bool* errors)
+{
+    // default to success
+    resetError(errors);
+
+    // convert
+    UInt32 n = (UInt32)src.size() >> 2;
+    return doUCS4ToUTF8(reinterpret_cast<const UInt8*>(src.data()), n, errors);
+}
+
+String
+ReferenceUnicode::UTF16ToUTF8(const String& src, bool* errors)
+{
+    // default to success
+    resetError(errors);
+
+    // convert
+    UInt32 n = (UInt32)src.size() >> 1;
+    return doUTF16ToUTF8(reinterpret_cast<const UInt8*>(src.data()), n, errors);
+}
+
+String
+ReferenceUnicode::UTF32ToUTF8(const String& src, bool* errors)
+{
+    // default to success
+    resetError(errors);
+
+    // convert
+    UInt32 n = (UInt32)src.size() >> 2;
+    return doUTF32ToUTF8(reinterpret_cast<const UInt8*>(src.data()), n, errors);
+}
+
+String
+ReferenceUnicode::doUCS2ToUTF8(const UInt8* data, UInt32 n, bool* errors)
+{
+    // make some space
+    String dst;
+    dst.reserve(n);
+
+    // check if first character is 0xfffe or 0xfeff
+    bool byteSwapped = false;
+    if (n >= 1) {
+        switch (decode16(data, false)) {
+        case 0x0000feff:
+            data += 2;
+            --n;
+            break;
+
+        case 0x0000fffe:
+            byteSwapped = true;
+            data += 2;
+            --n;
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    // convert each character
+    for (; n > 0; data += 2, --n) {
+        UInt32 c = decode16(data, byteSwapped);
+        toUTF8(dst, c, errors);
+    }
+
+    return dst;
+}
+
+String
+ReferenceUnicode::doUCS4ToUTF8(const UInt8* data, UInt32 n, bool* errors)
+{
+    // make some space
+    String dst;
+    dst.reserve(n);
+
+    // check if first character is 0xfffe or 0xfeff
+    bool byteSwapped = false;
+    if (n >= 1) {
+        switch (decode32(data, false)) {
+        case 0x0000feff:
+            data += 4;
+            --n;
+            break;
+
+        case 0x0000fffe:
+            byteSwapped = true;
+            data += 4;
+            --n;
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    // convert each character
+    for (; n > 0; data += 4, --n) {
+        UInt32 c = decode32(data, byteSwapped);
+        toUTF8(dst, c, errors);
+    }
+
+    return dst;
+}
+
+String
+ReferenceUnicode::doUTF16ToUTF8(const UInt8* data, UInt32 n, bool* errors)
+{
+    // make some space
+    String dst;
+    dst.reserve(n);
+
+    // check if first character is 0xfffe or 0xfeff
+    bool byteSwapped = false;
+    if (n >= 1) {
+        switch (decode16(data, false)) {
+        case 0x0000feff:
+            data += 2;
+            --n;
+            break;
+
+        case 0x0000fffe:
+            byteSwapped = true;
+            data += 2;
+            --n;
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    // convert each character
+    for (; n > 0; data += 2, --n) {
+        UInt32 c = decode16(data, byteSwapped);
+        if (c < 0x0000d800 || c > 0x0000dfff) {
+            toUTF8(dst, c, errors);
+        }
+        else if (n == 1) {
+            // error -- missing second word
+            setError(errors);
+            toUTF8(dst, s_replacement, NULL);
+        }
+        else if (c >= 0x0000d800 && c <= 0x0000dbff) {
+            UInt32 c2 = decode16(data, byteSwapped);
+            data += 2;
+            --n;
+            if (c2 < 0x0000dc00 || c2 > 0x0000dfff) {
+                // error -- [d800,dbff] not followed by [dc00,dfff]
+                setError(errors);
+                toUTF8(dst, s_replacement, NULL);
+            }
+            else {
+                c = (((c - 0x0000d800) << 10) | (c2 - 0x0000dc00)) + 0x00010000;
+                toUTF8(dst, c, errors);
+            }
+        }
+        else {
+            // error -- [dc00,dfff] without leading [d800,dbff]
+            setError(errors);
+            toUTF8(dst, s_replacement, NULL);
+        }
+    }
+
+    return dst;
+}
+
+String
+ReferenceUnicode::doUTF32ToUTF8(const UInt8* data, UInt32 n, bool* errors)
+{
+    // make some space
+    String dst;
+    dst.reserve(n);
+
+    // check if first character is 0xfffe or 0xfeff
+    bool byteSwapped = false;
+    if (n >= 1) {
+        switch (decode32(data, false)) {
+        case 0x0000feff:
+            data += 4;
+            --n;
+            break;
+
+        case 0x0000fffe:
+            byteSwapped = true;
+            data += 4;
+            --n;
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    // convert each character
+    for (; n > 0; data += 4, --n) {
+        UInt32 c = decode32(data, byteSwapped);
+        if (c >= 0x00110000) {
+            setError(errors);
+            c = s_replacement;
+        }
+        toUTF8(dst, c, errors);
+    }
+
+    return dst;
+}
+
+UInt32
+ReferenceUnicode::fromUTF8(const UInt8*& data, UInt32& n)
+{
+    assert(data != NULL);
+    assert(n    != 0);
+
+    // compute character encoding length, checking for overlong
+    // sequences (i.e. characters that don't use the shortest
+    // possible encoding).
+    UInt32 size;
+    if (data[0] < 0x80) {
+        // 0xxxxxxx
+        size = 1;
+    }
+    else if (data[0] < 0xc0) {
+        // 10xxxxxx -- in the middle of a multibyte character.  counts
+        // as one invalid character.
+        --n;
+        ++data;
+        return s_invalid;
+    }
+    else if (data[0] < 0xe0) {
+        // 110xxxxx
+        size = 2;
+    }
+    else if (data[0] < 0xf0) {
+        // 1110xxxx
+        size = 3;
+    }
+    else if (data[0] < 0xf8) {
+        // 11110xxx
+        size = 4;
+    }
+    else if (data[0] < 0xfc) {
+        // 111110xx
+        size = 5;
+    }
+    else if (data[0] < 0xfe) {
+        // 1111110x
+        size = 6;
+    }
+    else {
+        // invalid sequence.  dunno how many bytes to skip so skip one.
+        --n;
+        ++data;
+        return s_invalid;
+    }
+
+    // make sure we have enough data
+    if (size > n) {
+        data += n;
+        n     = 0;
+        return s_invalid;
+    }
+
+    // extract character
+    UInt32 c;
+    switch (size) {
+    case 1:
+        c = static_cast<UInt32>(data[0]);
+        break;
+
+    case 2:
+        c = ((static_cast<UInt32>(data[0]) & 0x1f) <<  6) |
+            ((static_cast<UInt32>(data[1]) & 0x3f)      );
+        break;
+
+    case 3:
+        c = ((static_cast<UInt32>(data[0]) & 0x0f) << 12) |
+            ((static_cast<UInt32>(data[1]) & 0x3f) <<  6) |
+            ((static_cast<UInt32>(data[2]) & 0x3f)      );
+        break;
+
+    case 4:
+        c = ((static_cast<UInt32>(data[0]) & 0x07) << 18) |
+            ((static_cast<UInt32>(data[1]) & 0x3f) << 12) |
+            ((static_cast<UInt32>(data[1]) & 0x3f) <<  6) |
+            ((static_cast<UInt32>(data[1]) & 0x3f)      );
+        break;
+
+    case 5:
+        c = ((static_cast<UInt32>(data[0]) & 0x03) << 24) |
+            ((static_cast<UInt32>(data[1]) & 0x3f) << 18) |
+            ((static_cast<UInt32>(data[1]) & 0x3f) << 12) |
+            ((static_cast<UInt32>(data[1]) & 0x3f) <<  6) |
+            ((static_cast<UInt32>(data[1]) & 0x3f)      );
+        break;
+
+    case 6:
+        c = ((static_cast<UInt32>(data[0]) & 0x01) << 30) |
+            ((static_cast<UInt32>(data[1]) & 0x3f) << 24) |
+            ((static_cast<UInt32>(data[1]) & 0x3f) << 18) |
+            ((static_cast<UInt32>(data[1]) & 0x3f) << 12) |
+            ((static_cast<UInt32>(data[1]) & 0x3f) <<  6) |
+            ((static_cast<UInt32>(data[1]) & 0x3f)      );
+        break;
+
+    default:
+        assert(0 && "invalid size");
+        return s_invalid;
+    }
+
+    // check that all bytes after the first have the pattern 10xxxxxx.
+    // truncated sequences are treated as a single malformed character.
+    bool truncated = false;
+    switch (size) {
+    case 6:
+        if ((data[5] & 0xc0) != 0x80) {
+            truncated = true;
+            size = 5;
+        }
+        // fall through
+
+    case 5:
+        if ((data[4] & 0xc0) != 0x80) {
+            truncated = true;
+            size = 4;
+        }
+        // fall through
+
+    case 4:
+        if ((data[3] & 0xc0) != 0x80) {
+            truncated = true;
+            size = 3;
+        }
+        // fall through
+
+    case 3:
+        if ((data[2] & 0xc0) != 0x80) {
+            truncated = true;
+            size = 2;
+        }
+        // fall through
+
+    case 2:
+        if ((data[1] & 0xc0) != 0x80) {
+            truncated = true;
+            size = 1;
+        }
+    }
+
+    // update parameters
+    data += size;
+    n    -= size;
+
+    // invalid if sequence was truncated
+    if (truncated) {
+        return s_invalid;
+    }
+
+    // check for characters that didn't use the smallest possible encoding
+    static UInt32 s_minChar[] = {
+        0,
+        0x00000000,
+        0x00000080,
+        0x00000800,
+        0x00010000,
+        0x00200000,
+        0x04000000
+    };
+    if (c < s_minChar[size]) {
+        return s_invalid;
+    }
+
+    // check for characters not in ISO-10646
+    if (c >= 0x0000d800 && c <= 0x0000dfff) {
+        return s_invalid;
+    }
+    if (c >= 0x0000fffe && c <= 0x0000ffff) {
+        return s_invalid;
+    }
+
+    return c;
+}
+
+void
+ReferenceUnicode::toUTF8(String& dst, UInt32 c, bool* errors)
+{
+    UInt8 data[6];
+
+    // handle characters outside the valid range
+    if ((c >= 0x0000d800 && c <= 0x0000dfff) || c >= 0x80000000) {
+        setError(errors);
+        c = s_replacement;
+    }
+
+    // convert to UTF-8
+    if (c < 0x00000080) {
+        data[0] = static_cast<UInt8>(c);
+        dst.append(reinterpret_cast<char*>(data), 1);
+    }
+    else if (c < 0x00000800) {
+        data[0] = static_cast<UInt8>(((c >>  6) & 0x0000001f) + 0xc0);
+        data[1] = static_cast<UInt8>((c         & 0x0000003f) + 0x80);
+        dst.append(reinterpret_cast<char*>(data), 2);
+    }
+    else if (c < 0x00010000) {
+        data[0] = static_cast<UInt8>(((c >> 12) & 0x0000000f) + 0xe0);
+        data[1] = static_cast<UInt8>(((c >>  6) & 0x0000003f) + 0x80);
+        data[2] = static_cast<UInt8>((c         & 0x0000003f) + 0x80);
+        dst.append(reinterpret_cast<char*>(data), 3);
+    }
+    else if (c < 0x00200000) {
+        data[0] = static_cast<UInt8>(((c >> 18) & 0x00000007) + 0xf0);
+        data[1] = static_cast<UInt8>(((c >> 12) & 0x0000003f) + 0x80);
+        data[2] = static_cast<UInt8>(((c >>  6) & 0x0000003f) + 0x80);
+        data[3] = static_cast<UInt8>((c         & 0x0000003f) + 0x80);
+        dst.append(reinterpret_cast<char*>(data), 4);
+    }
+    else if (c < 0x04000000) {
+        data[0] = static_cast<UInt8>(((c >> 24) & 0x00000003) + 0xf8);
+        data[1] = static_cast<UInt8>(((c >> 18) & 0x0000003f) + 0x80);
+        data[2] = static_cast<UInt8>(((c >> 12) & 0x0000003f) + 0x80);
+        data[3] = static_cast<UInt8>(((c >>  6) & 0x0000003f) + 0x80);
+        data[4] = static_cast<UInt8>((c         & 0x0000003f) + 0x80);
+        dst.append(reinterpret_cast<char*>(data), 5);
+    }
+    else if (c < 0x80000000) {
+        data[0] = static_cast<UInt8>(((c >> 30) & 0x00000001) + 0xfc);
+        data[1] = static_cast<UInt8>(((c >> 24) & 0x0000003f) + 0x80);
+        data[2] = static_cast<UInt8>(((c >> 18) & 0x0000003f) + 0x80);
+        data[3] = static_cast<UInt8>(((c >> 12) & 0x0000003f) + 0x80);
+        data[4] = static_cast<UInt8>(((c >>  6) & 0x0000003f) + 0x80);
+        data[5] = static_cast<UInt8>((c         & 0x0000003f) + 0x80);
+        dst.append(reinterpret_cast<char*>(data), 6);
+    }
+    else {
+        assert(0 && "character out of range");
+    }
+}
+
+
+//
+// UnicodeTests
+//
+
+typedef String (*Conversion)(const String&, bool* errors);
+
+// the same numbers on every run so a failure can be reproduced
+static UInt32
+nextRandom(UInt32& seed)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+// appends a 2 or 4 byte character in native byte order or swapped
+static void
+appendWide(String& dst, UInt32 c, int size, bool byteSwapped)
+{
+    UInt8 data[4];
+    if (size == 2) {
+        UInt16 c16 = static_cast<UInt16>(c);
+        memcpy(data, &c16, 2);
+    }
+    else {
+        memcpy(data, &c, 4);
+    }
+    for (int i = 0; byteSwapped && i < size / 2; ++i) {
+        std::swap(data[i], data[size - 1 - i]);
+    }
+    dst.append(reinterpret_cast<const char*>(data), size);
+}
+
+// runs of ASCII, long enough to span blocks, among valid and broken
+// multibyte sequences
+static String
+randomUTF8(UInt32& seed)
+{
+    String text;
+    for (UInt32 n = nextRandom(seed) % 12; n > 0; --n) {
+        UInt32 r = nextRandom(seed);
+        UInt32 trail;
+        switch (r % 6) {
+        case 0:
+        case 1:
+            for (UInt32 m = (r >> 3) % 70; m > 0; --m) {
+                text += static_cast<char>(0x20 + nextRandom(seed) % 0x5f);
+            }
+            continue;
+
+        case 2:
+        case 3:
+            // mostly valid
+            text += static_cast<char>(0xc2 + (r >> 3) % (0xf5 - 0xc2));
+            trail = (UInt8)text[text.size() - 1] < 0xe0 ? 1 :
+                    (UInt8)text[text.size() - 1] < 0xf0 ? 2 : 3;
+            break;
+
+        case 4:
+            // any lead byte and any number of trailing bytes
+            text += static_cast<char>(0xc0 + (r >> 3) % 0x40);
+            trail = (r >> 9) % 6;
+            break;
+
+        default:
+            text += static_cast<char>(r >> 3);
+            continue;
+        }
+        for (; trail > 0; --trail) {
+            text += static_cast<char>(0x80 + nextRandom(seed) % 0x40);
+        }
+    }
+    return text;
+}
+
+// runs of ASCII among other characters, surrogates and byte order
+// marks, of size bytes each, in either byte order
+static String
+randomWide(UInt32& seed, int size)
+{
+    String text;
+    UInt32 r = nextRandom(seed);
+    bool byteSwapped = false;
+    if (r % 3 == 0) {
+        // 0xfffe in native order marks the rest as byte swapped
+        byteSwapped = ((r >> 2) % 2 == 0);
+        appendWide(text, byteSwapped ? 0xfffe : 0xfeff, size, false);
+    }
+    for (UInt32 n = nextRandom(seed) % 12; n > 0; --n) {
+        r = nextRandom(seed);
+        switch (r % 6) {
+        case 0:
+        case 1:
+            for (UInt32 m = (r >> 3) % 70; m > 0; --m) {
+                appendWide(text, 0x20 + nextRandom(seed) % 0x5f,
+                            size, byteSwapped);
+            }
+            break;
+
+        case 2:
+            appendWide(text, 0xd800 + (r >> 3) % 0x800, size, byteSwapped);
+            break;
+
+        case 3:
+            appendWide(text, 0x80 + (r >> 3) % 0x800, size, byteSwapped);
+            break;
+
+        case 4:
+            appendWide(text, 0x10000 + (r >> 3) % 0x110000,
+                            size, byteSwapped);
+            break;
+
+        default:
+            appendWide(text, (r << 8) ^ nextRandom(seed), size, byteSwapped);
+            break;
+        }
+    }
+
+    // an odd byte at the end now and then
+    if (nextRandom(seed) % 8 == 0) {
+        text += 'x';
+    }
+    return text;
+}
+
+// checks actual converts text as expected does, errors included
+static void
+expectSame(Conversion actual, Conversion expected,
+                const String& text, const char* name)
+{
+    bool actualErrors   = true;
+    bool expectedErrors = false;
+    String actualResult   = actual(text, &actualErrors);
+    String expectedResult = expected(text, &expectedErrors);
+    EXPECT_TRUE(expectedResult == actualResult) << name << " differs";
+    EXPECT_EQ(expectedErrors, actualErrors) << name << " errors differ";
+}
+
+TEST(UnicodeTests, UTF8ToUTF16_longASCIIRun_widens)
+{
+    String text(100, 'a');
+    text += "\xc3\xa9" "b";
+
+    String expected;
+    for (int i = 0; i < 100; ++i) {
+        appendWide(expected, 'a', 2, false);
+    }
+    appendWide(expected, 0xe9, 2, false);
+    appendWide(expected, 'b', 2, false);
+
+    bool errors = true;
+    EXPECT_TRUE(expected == Unicode::UTF8ToUTF16(text, &errors));
+    EXPECT_FALSE(errors);
+}
+
+TEST(UnicodeTests, UTF16ToUTF8_byteSwappedASCIIRun_narrows)
+{
+    String text;
+    appendWide(text, 0xfffe, 2, false);
+    for (int i = 0; i < 40; ++i) {
+        appendWide(text, 'a' + i % 26, 2, true);
+    }
+    appendWide(text, 0xe9, 2, true);
+
+    String expected;
+    for (int i = 0; i < 40; ++i) {
+        expected += static_cast<char>('a' + i % 26);
+    }
+    expected += "\xc3\xa9";
+
+    EXPECT_EQ(expected, Unicode::UTF16ToUTF8(text));
+}
+
+TEST(UnicodeTests, UCS4ToUTF8_byteSwappedASCIIRun_narrows)
+{
+    String text;
+    appendWide(text, 0xfffe, 4, false);
+    for (int i = 0; i < 40; ++i) {
+        appendWide(text, 'a' + i % 26, 4, true);
+    }
+    appendWide(text, 0x20ac, 4, true);
+
+    String expected;
+    for (int i = 0; i < 40; ++i) {
+        expected += static_cast<char>('a' + i % 26);
+    }
+    expected += "\xe2\x82\xac";
+
+    EXPECT_EQ(expected, Unicode::UCS4ToUTF8(text));
+}
+
+TEST(UnicodeTests, isUTF8_invalidAfterASCIIRun_false)
+{
+    String text(50, 'a');
+    EXPECT_TRUE(Unicode::isUTF8(text));
+
+    text += "\xc3";
+    EXPECT_FALSE(Unicode::isUTF8(text));
+}
+
+TEST(UnicodeTests, fuzz_fromUTF8_matchesReference)
+{
+    UInt32 seed = 1;
+    for (int i = 0; i < kFuzzStrings && !::testing::Test::HasFailure(); ++i) {
+        String text = randomUTF8(seed);
+        EXPECT_EQ(ReferenceUnicode::isUTF8(text), Unicode::isUTF8(text));
+        expectSame(&Unicode::UTF8ToUCS2, &ReferenceUnicode::UTF8ToUCS2,
+                            text, "UTF8ToUCS2");
+        expectSame(&Unicode::UTF8ToUCS4, &ReferenceUnicode::UTF8ToUCS4,
+                            text, "UTF8ToUCS4");
+        expectSame(&Unicode::UTF8ToUTF16, &ReferenceUnicode::UTF8ToUTF16,
+                            text, "UTF8ToUTF16");
+        expectSame(&Unicode::UTF8ToUTF32, &ReferenceUnicode::UTF8ToUTF32,
+                            text, "UTF8ToUTF32");
+    }
+}
+
+TEST(UnicodeTests, fuzz_toUTF8_matchesReference)
+{
+    UInt32 seed = 2;
+    for (int i = 0; i < kFuzzStrings && !::testing::Test::HasFailure(); ++i) {
+        String text = randomWide(seed, 2);
+        expectSame(&Unicode::UCS2ToUTF8, &ReferenceUnicode::UCS2ToUTF8,
+                            text, "UCS2ToUTF8");
+        expectSame(&Unicode::UTF16ToUTF8, &ReferenceUnicode::UTF16ToUTF8,
+                            text, "UTF16ToUTF8");
+
+        text = randomWide(seed, 4);
+        expectSame(&Unicode::UCS4ToUTF8, &ReferenceUnicode::UCS4ToUTF8,
+                            text, "UCS4ToUTF8");
+        expectSame(&Unicode::UTF32ToUTF8, &ReferenceUnicode::UTF32ToUTF8,
+                            text, "UTF32ToUTF8");
+    }
+}
+
+TEST(UnicodeTests, benchmark_transcode)
+{
+    // mostly ASCII, like most clipboards
+    const String line("Caf\xc3\xa9 na\xc3\xafvet\xc3\xa9: the quick brown fox "
+                            "jumps over the lazy dog, 0123456789.\n");
+
+    const int numSizes = sizeof(kBenchmarkSizes) / sizeof(kBenchmarkSizes[0]);
+    for (int i = 0; i < numSizes; ++i) {
+        size_t size = static_cast<size_t>(kBenchmarkSizes[i]) << 20;
+        String utf8;
+        utf8.reserve(size + line.size());
+        while (utf8.size() < size) {
+            utf8 += line;
+        }
+
+        double start = ARCH->time();
+        String utf16 = Unicode::UTF8ToUTF16(utf8);
+        double toUTF16 = ARCH->time() - start;
+        start = ARCH->time();
+        String back = Unicode::UTF16ToUTF8(utf16);
+        double toUTF8 = ARCH->time() - start;
+
+        start = ARCH->time();
+        String utf16Reference = ReferenceUnicode::UTF8ToUTF16(utf8);
+        double toUTF16Reference = ARCH->time() - start;
+        start = ARCH->time();
+        String backReference = ReferenceUnicode::UTF16ToUTF8(utf16);
+        double toUTF8Reference = ARCH->time() - start;
+
+        double mb = static_cast<double>(utf8.size()) / (1 << 20);
+        LOG((CLOG_INFO "transcoded %d MB: UTF-8 to UTF-16 %.0f MB/s (was %.0f), UTF-16 to UTF-8 %.0f MB/s (was %.0f)",
+                    kBenchmarkSizes[i], mb / toUTF16, mb / toUTF16Reference,
+                    mb / toUTF8, mb / toUTF8Reference));
+        EXPECT_TRUE(utf16Reference == utf16);
+        EXPECT_TRUE(backReference == back);
+        EXPECT_TRUE(utf8 == back);
+    }
+}
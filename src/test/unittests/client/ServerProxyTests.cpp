@@ -0,0 +1,412 @@
+/*
+ * synergy -- mouse and keyboard sharing utility
+ * Copyright (C) 2016 Symless Ltd.
+ *
+ * This package is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * found in the file LICENSE that should have accompanied this file.
+ *
+ * This package is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_ENV
+
+#include "test/mock/synergy/MockScreen.h"
+#include "test/global/TestEventQueue.h"
+#include "client/Client.h"
+#include "client/ServerProxy.h"
+#include "core/ClientArgs.h"
+#include "core/ProtocolMessages.h"
+#include "core/ProtocolUtil.h"
+#include "core/option_types.h"
+#include "core/protocol_types.h"
+#include "net/NetworkAddress.h"
+#include "net/TCPSocketFactory.h"
+#include "io/IStream.h"
+#include "arch/Arch.h"
+#include "base/Log.h"
+
+#include "test/global/gtest.h"
+
+#include <cstring>
+
+const int kMouseMoves = 1000;
+const int kMovesPerBatch = 10;
+
+const int kFuzzMessages = 10000;
+const int kFuzzStreams = 2000;
+const int kDispatchMessages = 200000;
+
+// the codes of the messages a server sends
+static const char* const s_serverCodes[] = {
+    kMsgCNoop, kMsgCClose, kMsgCEnter, kMsgCLeave, kMsgCClipboard,
+    kMsgCScreenSaver, kMsgCResetOptions, kMsgCInfoAck, kMsgCKeepAlive,
+    kMsgDKeyDown, kMsgDKeyRepeat, kMsgDKeyUp, kMsgDMouseDown, kMsgDMouseUp,
+    kMsgDMouseMove, kMsgDMouseRelMove, kMsgDMouseWheel, kMsgDClipboard,
+    kMsgDSetOptions, kMsgDFileTransfer, kMsgDDragInfo, kMsgQInfo,
+    kMsgEIncompatible, kMsgEBusy, kMsgEUnknown, kMsgEBad
+};
+
+// a client that counts and drops everything the server proxy forwards
+// to it
+class TestClient : public Client {
+public:
+    TestClient(IEventQueue* events, synergy::Screen* screen) :
+        Client(events, "stub", NetworkAddress(),
+               new TCPSocketFactory(events, NULL), screen, ClientArgs()),
+        m_calls(0) { }
+
+    virtual void        handshakeComplete() { }
+    virtual void        getShape(SInt32& x, SInt32& y,
+                            SInt32& w, SInt32& h) const
+    {
+        x = y = 0;
+        w = 1920;
+        h = 1080;
+    }
+    virtual void        getCursorPos(SInt32& x, SInt32& y) const { x = y = 0; }
+    virtual void        enter(SInt32, SInt32, UInt32, KeyModifierMask, bool)
+    {
+        ++m_calls;
+    }
+    virtual bool        leave() { ++m_calls; return true; }
+    virtual void        setClipboard(ClipboardID, const IClipboard*)
+    {
+        ++m_calls;
+    }
+    virtual void        grabClipboard(ClipboardID) { ++m_calls; }
+    virtual void        keyDown(KeyID, KeyModifierMask, KeyButton)
+    {
+        ++m_calls;
+    }
+    virtual void        keyRepeat(KeyID, KeyModifierMask, SInt32, KeyButton)
+    {
+        ++m_calls;
+    }
+    virtual void        keyUp(KeyID, KeyModifierMask, KeyButton)
+    {
+        ++m_calls;
+    }
+    virtual void        mouseDown(ButtonID) { ++m_calls; }
+    virtual void        mouseUp(ButtonID) { ++m_calls; }
+    virtual void        mouseMove(SInt32, SInt32) { ++m_calls; }
+    virtual void        mouseRelativeMove(SInt32, SInt32) { ++m_calls; }
+    virtual void        mouseWheel(SInt32, SInt32) { ++m_calls; }
+    virtual void        screensaver(bool) { ++m_calls; }
+    virtual void        resetOptions() { ++m_calls; }
+    virtual void        setOptions(const OptionsList&) { ++m_calls; }
+
+public:
+    int                    m_calls;
+};
+
+// reads what's been queued with queue() and keeps what's written
+class BufferStream : public synergy::IStream {
+public:
+    BufferStream() : m_readPos(0) { }
+
+    void                queue(const String& data) { m_input += data; }
+
+    virtual void        close() { }
+    virtual UInt32        read(void* buffer, UInt32 n)
+    {
+        n = std::min(n, getSize());
+        if (buffer != NULL) {
+            memcpy(buffer, m_input.data() + m_readPos, n);
+        }
+        m_readPos += n;
+        return n;
+    }
+    virtual void        write(const void* buffer, UInt32 n)
+    {
+        m_output.append(static_cast<const char*>(buffer), n);
+    }
+    virtual void        flush() { }
+    virtual void        shutdownInput() { }
+    virtual void        shutdownOutput() { }
+    virtual void*        getEventTarget() const
+    {
+        return const_cast<void*>(static_cast<const void*>(this));
+    }
+    virtual bool        isReady() const { return getSize() > 0; }
+    virtual UInt32        getSize() const
+    {
+        return static_cast<UInt32>(m_input.size() - m_readPos);
+    }
+
+public:
+    String                m_input;
+    size_t                m_readPos;
+    String                m_output;
+};
+
+// the same numbers on every run so a failure can be reproduced
+static UInt32
+nextRandom(UInt32& seed)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+class ServerProxyTests : public ::testing::Test
+{
+public:
+    // sends the options that complete the handshake
+    static void            completeHandshake(BufferStream& stream,
+                            ServerProxy& proxy);
+
+    // appends a random but well formed message that the proxy should
+    // reply to with a no-op, returning the bytes of any other reply
+    static int            writeRandomMessage(BufferStream& message,
+                            UInt32& seed);
+
+    // appends a message code, mostly a known one, followed by random
+    // bytes
+    static void            writeRandomBytes(BufferStream& message,
+                            UInt32& seed);
+
+    // completes the handshake, sending the no-op replies policy unless
+    // it's negative, then sends mouse moves in batches and returns the
+    // bytes the client wrote in reply.
+    size_t                measureReplyBytes(int noopReplies);
+
+public:
+    TestEventQueue        m_events;
+};
+
+void
+ServerProxyTests::completeHandshake(BufferStream& stream, ServerProxy& proxy)
+{
+    BufferStream message;
+    synergy::protocol::DSetOptions::send(&message, OptionsList());
+    stream.queue(message.m_output);
+    proxy.handleDataForTest();
+    stream.m_output.clear();
+}
+
+int
+ServerProxyTests::writeRandomMessage(BufferStream& message, UInt32& seed)
+{
+    using namespace synergy::protocol;
+
+    UInt32 r = nextRandom(seed);
+    SInt16 a = static_cast<SInt16>(r);
+    SInt16 b = static_cast<SInt16>(nextRandom(seed));
+    switch (r % 16) {
+    case 0:  DMouseMove::send(&message, a, b); break;
+    case 1:  DMouseRelMove::send(&message, a, b); break;
+    case 2:  DMouseWheel::send(&message, a, b); break;
+    case 3:  DMouseDown::send(&message, a & 0xff); break;
+    case 4:  DMouseUp::send(&message, a & 0xff); break;
+    case 5:  DKeyDown::send(&message, a, b, r >> 16); break;
+    case 6:  DKeyRepeat::send(&message, a, b, r & 0x7f, r >> 16); break;
+    case 7:  DKeyUp::send(&message, a, b, r >> 16); break;
+    case 8:  CEnter::send(&message, a, b, r, r >> 16); break;
+    case 9:  CLeave::send(&message); break;
+    case 10: CClipboard::send(&message, r % kClipboardEnd, r); break;
+    case 11: CScreenSaver::send(&message, r & 1); break;
+    case 12: CResetOptions::send(&message); break;
+    case 13: DSetOptions::send(&message, OptionsList()); break;
+    case 14: CNoop::send(&message); break;
+
+    default:
+        // echoed as well as replied to
+        CKeepAlive::send(&message);
+        return 4;
+    }
+    return 0;
+}
+
+void
+ServerProxyTests::writeRandomBytes(BufferStream& message, UInt32& seed)
+{
+    const int numCodes = sizeof(s_serverCodes) / sizeof(s_serverCodes[0]);
+
+    UInt32 r = nextRandom(seed);
+    if (r % 8 != 0) {
+        message.write(s_serverCodes[(r >> 3) % numCodes], 4);
+    }
+    else {
+        for (int i = 0; i < 4; ++i) {
+            UInt8 byte = static_cast<UInt8>(nextRandom(seed));
+            message.write(&byte, 1);
+        }
+    }
+    for (UInt32 n = nextRandom(seed) % 25; n > 0; --n) {
+        UInt8 byte = static_cast<UInt8>(nextRandom(seed));
+        message.write(&byte, 1);
+    }
+}
+
+size_t
+ServerProxyTests::measureReplyBytes(int noopReplies)
+{
+    MockScreen screen;
+    TestClient client(&m_events, &screen);
+    BufferStream stream;
+    ServerProxy proxy(&client, &stream, &m_events);
+
+    BufferStream message;
+    OptionsList options;
+    if (noopReplies >= 0) {
+        options.push_back(kOptionNoopReplies);
+        options.push_back(static_cast<UInt32>(noopReplies));
+    }
+    ProtocolUtil::writef(&message, kMsgDSetOptions, &options);
+    stream.queue(message.m_output);
+    proxy.handleDataForTest();
+    stream.m_output.clear();
+
+    for (int i = 0; i < kMouseMoves; ++i) {
+        message.m_output.clear();
+        ProtocolUtil::writef(&message, kMsgDMouseMove, i % 100, i % 50);
+        stream.queue(message.m_output);
+        if ((i + 1) % kMovesPerBatch == 0) {
+            proxy.handleDataForTest();
+        }
+    }
+
+    // let any coalesced reply go out
+    double start = ARCH->time();
+    Event event;
+    while (ARCH->time() - start < 5.0 * kNoopReplyDelay) {
+        if (m_events.getEvent(event, kNoopReplyDelay)) {
+            m_events.dispatchEvent(event);
+        }
+    }
+
+    return stream.m_output.size();
+}
+
+TEST_F(ServerProxyTests, noopReplies_oldServer_replyPerMessage)
+{
+    size_t bytes = measureReplyBytes(-1);
+
+    LOG((CLOG_INFO "reply bytes per %d mouse moves from old server: %d",
+                kMouseMoves, (int)bytes));
+    EXPECT_EQ(4 * kMouseMoves, (int)bytes);
+}
+
+TEST_F(ServerProxyTests, noopReplies_perMessage_replyPerMessage)
+{
+    size_t bytes = measureReplyBytes(kNoopRepliesPerMessage);
+
+    EXPECT_EQ(4 * kMouseMoves, (int)bytes);
+}
+
+TEST_F(ServerProxyTests, noopReplies_perBatch_replyPerBatch)
+{
+    size_t bytes = measureReplyBytes(kNoopRepliesPerBatch);
+
+    LOG((CLOG_INFO "reply bytes per %d mouse moves, one per batch: %d",
+                kMouseMoves, (int)bytes));
+    EXPECT_EQ(4 * kMouseMoves / kMovesPerBatch, (int)bytes);
+}
+
+TEST_F(ServerProxyTests, noopReplies_coalesced_fewerThanPerBatch)
+{
+    size_t bytes = measureReplyBytes(kNoopRepliesCoalesced);
+
+    LOG((CLOG_INFO "reply bytes per %d mouse moves, coalesced: %d",
+                kMouseMoves, (int)bytes));
+    EXPECT_GT((int)bytes, 0);
+    EXPECT_LT((int)bytes, 4 * kMouseMoves / kMovesPerBatch);
+}
+
+TEST_F(ServerProxyTests, noopReplies_none_noReplies)
+{
+    size_t bytes = measureReplyBytes(kNoopRepliesNone);
+
+    EXPECT_EQ(0, (int)bytes);
+}
+
+TEST_F(ServerProxyTests, noopReplies_unknownPolicy_replyPerMessage)
+{
+    size_t bytes = measureReplyBytes(kNoopRepliesNone + 1);
+
+    EXPECT_EQ(4 * kMouseMoves, (int)bytes);
+}
+
+TEST_F(ServerProxyTests, handleData_randomMessages_allHandled)
+{
+    MockScreen screen;
+    TestClient client(&m_events, &screen);
+    BufferStream stream;
+    ServerProxy proxy(&client, &stream, &m_events);
+    completeHandshake(stream, proxy);
+
+    BufferStream message;
+    UInt32 seed = 1;
+    int extraReplyBytes = 0;
+    for (int i = 0; i < kFuzzMessages; ++i) {
+        extraReplyBytes += writeRandomMessage(message, seed);
+    }
+    stream.queue(message.m_output);
+    proxy.handleDataForTest();
+
+    // every message was read and replied to
+    EXPECT_EQ(0, (int)stream.getSize());
+    EXPECT_EQ(4 * kFuzzMessages + extraReplyBytes, (int)stream.m_output.size());
+    EXPECT_LT(0, client.m_calls);
+}
+
+TEST_F(ServerProxyTests, handleData_randomBytes_survives)
+{
+    MockScreen screen;
+    TestClient client(&m_events, &screen);
+    UInt32 seed = 2;
+    size_t total = 0;
+    for (int i = 0; i < kFuzzStreams; ++i) {
+        BufferStream stream;
+        ServerProxy proxy(&client, &stream, &m_events);
+
+        // fuzz both the handshake and the messages after it
+        if (i % 2 != 0) {
+            completeHandshake(stream, proxy);
+        }
+
+        BufferStream message;
+        for (UInt32 n = 1 + nextRandom(seed) % 8; n > 0; --n) {
+            writeRandomBytes(message, seed);
+        }
+        stream.queue(message.m_output);
+        proxy.handleDataForTest();
+
+        EXPECT_LE(stream.m_readPos, stream.m_input.size());
+        total += stream.m_readPos;
+        }
+    EXPECT_LT((size_t)0, total);
+}
+
+TEST_F(ServerProxyTests, benchmark_dispatch)
+{
+    MockScreen screen;
+    TestClient client(&m_events, &screen);
+    BufferStream stream;
+    ServerProxy proxy(&client, &stream, &m_events);
+    completeHandshake(stream, proxy);
+
+    BufferStream message;
+    UInt32 seed = 3;
+    for (int i = 0; i < kDispatchMessages; ++i) {
+        writeRandomMessage(message, seed);
+    }
+    stream.queue(message.m_output);
+
+    int filter = CLOG->getFilter();
+    CLOG->setFilter(kINFO);
+    double start = ARCH->time();
+    proxy.handleDataForTest();
+    double elapsed = ARCH->time() - start;
+    CLOG->setFilter(filter);
+
+    LOG((CLOG_INFO "server proxy per message: %.0f ns",
+                elapsed / kDispatchMessages * 1.0e+9));
+    EXPECT_EQ(0, (int)stream.getSize());
+}
@@ -0,0 +1,198 @@
+/*
+ * synergy -- mouse and keyboard sharing utility
+ * Copyright (C) 2016 Symless Ltd.
+ *
+ * This package is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * found in the file LICENSE that should have accompanied this file.
+ *
+ * This package is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "io/StreamBuffer.h"
+#include "arch/Arch.h"
+#include "base/Log.h"
+#include "common/stdvector.h"
+
+#include "test/global/gtest.h"
+
+#include <cstring>
+
+// about the size of a mouse move message
+const UInt32 kSmallSize = 16;
+const int kSmallCount   = 1000000;
+
+// the size of a clipboard chunk
+const UInt32 kBulkSize  = 512 * 1024;
+const int kBulkCount    = 200;
+
+const int kMaxRegions   = 16;
+
+static std::vector<UInt8>
+makeData(UInt32 n)
+{
+    std::vector<UInt8> data(n);
+    for (UInt32 i = 0; i < n; ++i) {
+        data[i] = (UInt8)(i * 7 + (i >> 8));
+    }
+    return data;
+}
+
+// drains the buffer the way a socket writes it, returning the bytes
+static UInt32
+drain(StreamBuffer& buffer)
+{
+    StreamBuffer::Region regions[kMaxRegions];
+    UInt32 total = 0;
+    while (buffer.getSize() > 0) {
+        int num = buffer.getData(regions, kMaxRegions);
+        UInt32 n = 0;
+        for (int i = 0; i < num; ++i) {
+            n += regions[i].m_size;
+        }
+        buffer.pop(n);
+        total += n;
+    }
+    return total;
+}
+
+TEST(StreamBufferTests, write_oddSizes_readBack)
+{
+    std::vector<UInt8> data = makeData(100000);
+    StreamBuffer buffer;
+    for (UInt32 i = 0, n = 1; i < data.size(); i += n, n = n * 3 % 9973) {
+        n = std::min(n, (UInt32)data.size() - i);
+        buffer.write(&data[i], n);
+    }
+    EXPECT_EQ(data.size(), buffer.getSize());
+
+    std::vector<UInt8> result(data.size());
+    for (UInt32 i = 0, n = 5; i < result.size(); i += n, n = n * 5 % 7919) {
+        n = std::min(n, (UInt32)result.size() - i);
+        buffer.read(&result[i], n);
+    }
+    EXPECT_EQ(0, (int)buffer.getSize());
+    EXPECT_TRUE(data == result);
+}
+
+TEST(StreamBufferTests, peek_spansSegments_returnsData)
+{
+    std::vector<UInt8> data = makeData(50000);
+    StreamBuffer buffer;
+    buffer.write(&data[0], (UInt32)data.size());
+    buffer.pop(100);
+
+    EXPECT_GT(buffer.getSize(), buffer.getHeadSize());
+    const void* peeked = buffer.peek(buffer.getSize());
+    EXPECT_EQ(0, memcmp(peeked, &data[100], data.size() - 100));
+}
+
+TEST(StreamBufferTests, getData_coversDataInOrder)
+{
+    std::vector<UInt8> data = makeData(70000);
+    StreamBuffer buffer;
+    buffer.write(&data[0], (UInt32)data.size());
+    buffer.pop(3);
+
+    StreamBuffer::Region regions[kMaxRegions];
+    int num = buffer.getData(regions, kMaxRegions);
+    std::vector<UInt8> result;
+    for (int i = 0; i < num; ++i) {
+        result.insert(result.end(), regions[i].m_data,
+                            regions[i].m_data + regions[i].m_size);
+    }
+    EXPECT_TRUE(std::equal(result.begin(), result.end(), data.begin() + 3));
+    EXPECT_EQ(buffer.getSize(), result.size());
+    EXPECT_EQ(buffer.getHeadSize(), regions[0].m_size);
+}
+
+TEST(StreamBufferTests, reserve_commitPart_appendsPart)
+{
+    std::vector<UInt8> data = makeData(40000);
+    StreamBuffer buffer;
+    buffer.write(&data[0], 10);
+
+    StreamBuffer::Region regions[kMaxRegions];
+    int num = buffer.reserve(regions, kMaxRegions, 30000);
+    UInt32 space = 0;
+    for (int i = 0; i < num; ++i) {
+        space += regions[i].m_size;
+    }
+    EXPECT_GE(space, 30000u);
+
+    // store as if read from a socket
+    UInt32 stored = 0;
+    for (int i = 0; i < num && stored < 20000; ++i) {
+        UInt32 n = std::min(regions[i].m_size, 20000 - stored);
+        memcpy(regions[i].m_data, &data[10 + stored], n);
+        stored += n;
+    }
+    buffer.commit(stored);
+    EXPECT_EQ(20010, (int)buffer.getSize());
+
+    buffer.write(&data[20010], 10);
+    std::vector<UInt8> result(20020);
+    buffer.read(&result[0], (UInt32)result.size());
+    EXPECT_TRUE(std::equal(result.begin(), result.end(), data.begin()));
+}
+
+TEST(StreamBufferTests, reserve_commitNothing_leavesData)
+{
+    StreamBuffer buffer;
+    StreamBuffer::Region regions[kMaxRegions];
+    buffer.reserve(regions, kMaxRegions, 100000);
+    buffer.commit(0);
+    EXPECT_EQ(0, (int)buffer.getSize());
+    EXPECT_EQ(0, (int)buffer.getHeadSize());
+}
+
+TEST(StreamBufferTests, benchmark_smallMessages)
+{
+    std::vector<UInt8> message = makeData(kSmallSize);
+    UInt8 result[kSmallSize];
+    StreamBuffer output;
+    StreamBuffer input;
+    StreamBuffer::Region regions[kMaxRegions];
+
+    // each message is written then sent, then received then read
+    double start = ARCH->time();
+    for (int i = 0; i < kSmallCount; ++i) {
+        output.write(&message[0], kSmallSize);
+        drain(output);
+
+        input.reserve(regions, kMaxRegions, kSmallSize);
+        memcpy(regions[0].m_data, &message[0], kSmallSize);
+        input.commit(kSmallSize);
+        input.read(result, kSmallSize);
+    }
+    double elapsed = ARCH->time() - start;
+
+    LOG((CLOG_INFO "stream buffer per %d byte message: %.1f ns",
+                kSmallSize, elapsed / kSmallCount * 1.0e+9));
+    EXPECT_EQ(0, memcmp(result, &message[0], kSmallSize));
+}
+
+TEST(StreamBufferTests, benchmark_bulk)
+{
+    std::vector<UInt8> chunk = makeData(kBulkSize);
+    StreamBuffer buffer;
+
+    // each chunk is written then sent
+    UInt32 total = 0;
+    double start = ARCH->time();
+    for (int i = 0; i < kBulkCount; ++i) {
+        buffer.write(&chunk[0], kBulkSize);
+        total += drain(buffer);
+    }
+    double elapsed = ARCH->time() - start;
+
+    LOG((CLOG_INFO "stream buffer with %d KB chunks: %.0f MB/s",
+                kBulkSize / 1024, total / elapsed / (1024.0 * 1024.0)));
+    EXPECT_EQ(kBulkSize * kBulkCount, total);
+}
@@ -24,6 +24,8 @@
 #include "base/String.h"
 #include "common/common.h"
 
+#include <ctime>
+
 #include "test/global/gmock.h"
 #include "test/global/gtest.h"
 
@@ -37,6 +39,8 @@ using ::testing::MatcherCast;
 using ::testing::Property;
 using ::testing::StrEq;
 using ::testing::AtLeast;
+using ::testing::NiceMock;
+using ::testing::Invoke;
 
 using namespace synergy;
 
@@ -70,7 +74,8 @@ TEST(IpcLogOutputterTests, write_overBufferMaxSize_firstLineTruncated)
     
     ON_CALL(mockServer, hasClients(_)).WillByDefault(Return(true));
     EXPECT_CALL(mockServer, hasClients(_)).Times(1);
-    EXPECT_CALL(mockServer, send(IpcLogLineMessageEq("mock 2\nmock 3\n"), _)).Times(1);
+    EXPECT_CALL(mockServer, send(IpcLogLineMessageEq(
+        "1 log lines dropped\nmock 2\nmock 3\n"), _)).Times(1);
 
     IpcLogOutputter outputter(mockServer, kIpcClientUnknown, false);
     outputter.bufferMaxSize(2);
@@ -80,6 +85,8 @@ TEST(IpcLogOutputterTests, write_overBufferMaxSize_firstLineTruncated)
     outputter.write(kNOTE, "mock 2");
     outputter.write(kNOTE, "mock 3");
     outputter.sendBuffer();
+
+    EXPECT_EQ(1, (int)outputter.getDroppedLines());
 }
 
 TEST(IpcLogOutputterTests, write_underBufferMaxSize_allLinesAreSent)
@@ -162,4 +169,85 @@ TEST(IpcLogOutputterTests, write_underBufferRateLimit_allLinesAreSent)
     outputter.sendBuffer();
 }
 
+TEST(IpcLogOutputterTests, write_withinBatchWindow_linesSentTogether)
+{
+    MockIpcServer mockServer;
+    mockServer.delegateToFake();
+
+    ON_CALL(mockServer, hasClients(_)).WillByDefault(Return(true));
+    EXPECT_CALL(mockServer, hasClients(_)).Times(AtLeast(1));
+    EXPECT_CALL(mockServer, send(IpcLogLineMessageEq(
+        "mock 1\nmock 2\nmock 3\n"), _)).Times(1);
+
+    IpcLogOutputter outputter(mockServer, kIpcClientUnknown, true);
+    outputter.bufferBatch(100, 0.5);
+    outputter.write(kNOTE, "mock 1");
+    outputter.write(kNOTE, "mock 2");
+    outputter.write(kNOTE, "mock 3");
+    mockServer.waitForSend();
+
+    EXPECT_EQ(1, (int)outputter.getSentChunks());
+}
+
+TEST(IpcLogOutputterTests, write_overRateLimit_droppedLinesReported)
+{
+    MockIpcServer mockServer;
+
+    ON_CALL(mockServer, hasClients(_)).WillByDefault(Return(true));
+    EXPECT_CALL(mockServer, hasClients(_)).Times(1);
+    EXPECT_CALL(mockServer, send(IpcLogLineMessageEq(
+        "1 log lines dropped\nmock 1\nmock 2\n"), _)).Times(1);
+
+    IpcLogOutputter outputter(mockServer, kIpcClientUnknown, false);
+    outputter.bufferRateLimit(2, 60);
+
+    outputter.write(kNOTE, "mock 1");
+    outputter.write(kNOTE, "mock 2");
+    outputter.write(kNOTE, "mock 3");
+    outputter.sendBuffer();
+}
+
+// the gui is connected and the daemon logs at DEBUG2, a burst of lines
+// at a time.  the lines should go in a few large chunks, so logging
+// costs about the same as it would with no gui connected.
+TEST(IpcLogOutputterTests, write_debug2Bursts_cpuStaysFlat)
+{
+    const int kBursts = 20;
+    const int kBurstLines = 500;
+
+    double cpu[2];
+    UInt32 chunks = 0;
+    for (int connected = 0; connected < 2; ++connected) {
+        NiceMock<MockIpcServer> mockServer;
+        mockServer.delegateToFake();
+        ON_CALL(mockServer, hasClients(_)).WillByDefault(Return(connected != 0));
+
+        IpcLogOutputter outputter(mockServer, kIpcClientGui, true);
+        outputter.bufferRateLimit(60000, 1);
+
+        String line("[2016-01-01T00:00:00] DEBUG2: mouse move on \"screen\" to 100,200");
+        std::clock_t start = std::clock();
+        for (int i = 0; i < kBursts; ++i) {
+            for (int j = 0; j < kBurstLines; ++j) {
+                outputter.write(kDEBUG2, line.c_str());
+            }
+            ARCH->sleep(0.01);
+        }
+        outputter.close();
+        cpu[connected] = (double)(std::clock() - start) / CLOCKS_PER_SEC;
+
+        if (connected) {
+            chunks = outputter.getSentChunks();
+            EXPECT_EQ(0, (int)outputter.getDroppedLines());
+        }
+    }
+
+    LOG((CLOG_INFO "ipc log cpu for %d lines: %.1f ms with no gui, "
+                "%.1f ms with gui in %d chunks",
+                kBursts * kBurstLines, cpu[0] * 1000.0, cpu[1] * 1000.0,
+                chunks));
+    EXPECT_LE(chunks, (UInt32)(kBursts * kBurstLines / 100 + kBursts * 2));
+    EXPECT_LT(cpu[1], cpu[0] * 3 + 0.05);
+}
+
 #endif // WINAPI_MSWINDOWS
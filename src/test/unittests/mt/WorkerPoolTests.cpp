@@ -0,0 +1,297 @@
+/*
+ * synergy -- mouse and keyboard sharing utility
+ * Copyright (C) 2016 Symless Ltd.
+ *
+ * This package is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * found in the file LICENSE that should have accompanied this file.
+ *
+ * This package is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test/global/TestEventQueue.h"
+#include "mt/WorkerPool.h"
+#include "mt/Lock.h"
+#include "mt/Mutex.h"
+#include "mt/Thread.h"
+#include "core/Clipboard.h"
+#include "base/TMethodEventJob.h"
+#include "base/TMethodJob.h"
+#include "base/Unicode.h"
+#include "base/Log.h"
+#include "arch/Arch.h"
+
+#include "test/global/gtest.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+const int kNumJobs          = 1000;
+const int kClipboardSize    = 8 * 1024 * 1024;
+const double kMotionInterval = 0.001;
+
+// how long to wait for jobs before giving up
+const double kTimeout       = 10.0;
+
+class WorkerPoolTests : public ::testing::Test
+{
+public:
+    WorkerPoolTests() :
+        m_count(0),
+        m_running(0),
+        m_met(0),
+        m_events(NULL),
+        m_pool(NULL),
+        m_converting(false),
+        m_longest(0.0),
+        m_stopMotion(false) { }
+
+    void                countJob(void*);
+    void                slowJob(void*);
+
+    // waits for the other of two meetJob()s to start and counts a
+    // meeting if it does before the timeout
+    void                meetJob(void*);
+
+    // returns m_count, read with m_mutex locked
+    int                    getCount();
+
+    // waits until m_count reaches \p count, returning false if it
+    // doesn't in time
+    bool                waitForCount(int count);
+
+    // converts a large clipboard then adds a clipboard changed event.
+    // this only models XWindowsScreen's fetch and convert: without an
+    // X server there's no selection to fetch, so only the conversion,
+    // the part moved to a worker, is done.
+    void                convertJob(void*);
+
+    // adds a motion event holding the time it was sent, every
+    // kMotionInterval seconds until m_stopMotion is set
+    void                motionThread(void*);
+
+    // runs an event loop while a large clipboard is converted, on
+    // \p pool or in the loop if it's NULL.  returns the longest a
+    // motion event waited to be handled.
+    double                runEventLoop(WorkerPool* pool);
+
+    void                handleMotion(const Event&, void*);
+    void                handleConverted(const Event&, void*);
+
+public:
+    Mutex                m_mutex;
+    int                    m_count;
+    int                    m_running;
+    int                    m_met;
+    String                m_ucs2;
+
+    TestEventQueue*        m_events;
+    WorkerPool*            m_pool;
+    bool                m_converting;
+    double                m_longest;
+    volatile bool        m_stopMotion;
+};
+
+void
+WorkerPoolTests::countJob(void*)
+{
+    Lock lock(&m_mutex);
+    ++m_count;
+}
+
+void
+WorkerPoolTests::slowJob(void*)
+{
+    ARCH->sleep(0.1);
+    countJob(NULL);
+}
+
+void
+WorkerPoolTests::meetJob(void*)
+{
+    {
+        Lock lock(&m_mutex);
+        ++m_running;
+    }
+
+    double deadline = ARCH->time() + kTimeout;
+    while (ARCH->time() < deadline) {
+        Lock lock(&m_mutex);
+        if (m_running == 2) {
+            ++m_met;
+            break;
+        }
+    }
+    countJob(NULL);
+}
+
+int
+WorkerPoolTests::getCount()
+{
+    Lock lock(&m_mutex);
+    return m_count;
+}
+
+bool
+WorkerPoolTests::waitForCount(int count)
+{
+    double deadline = ARCH->time() + kTimeout;
+    while (getCount() < count) {
+        if (ARCH->time() > deadline) {
+            return false;
+        }
+        ARCH->sleep(0.001);
+    }
+    return true;
+}
+
+void
+WorkerPoolTests::convertJob(void*)
+{
+    Clipboard clipboard;
+    clipboard.open(0);
+    clipboard.empty();
+    clipboard.add(IClipboard::kText, Unicode::UCS2ToUTF8(m_ucs2));
+    clipboard.close();
+    String data = clipboard.marshall();
+
+    m_events->addEvent(Event(m_events->forClipboard().clipboardChanged(),
+                            this));
+}
+
+void
+WorkerPoolTests::motionThread(void*)
+{
+    m_events->waitForReady();
+    while (!m_stopMotion) {
+        double* sent = static_cast<double*>(malloc(sizeof(double)));
+        *sent = ARCH->time();
+        m_events->addEvent(Event(m_events->forIPrimaryScreen().motionOnPrimary(),
+                            this, sent));
+        ARCH->sleep(kMotionInterval);
+    }
+}
+
+double
+WorkerPoolTests::runEventLoop(WorkerPool* pool)
+{
+    if (m_ucs2.empty()) {
+        m_ucs2.assign(kClipboardSize, '\0');
+        for (int i = 0; i < kClipboardSize; i += 2) {
+            m_ucs2[i] = static_cast<char>('a' + i / 2 % 26);
+        }
+    }
+
+    TestEventQueue events;
+    m_events     = &events;
+    m_pool       = pool;
+    m_converting = false;
+    m_longest    = 0.0;
+    m_stopMotion = false;
+    events.adoptHandler(events.forIPrimaryScreen().motionOnPrimary(), this,
+                            new TMethodEventJob<WorkerPoolTests>(this,
+                                &WorkerPoolTests::handleMotion));
+    events.adoptHandler(events.forClipboard().clipboardChanged(), this,
+                            new TMethodEventJob<WorkerPoolTests>(this,
+                                &WorkerPoolTests::handleConverted));
+
+    Thread motion(new TMethodJob<WorkerPoolTests>(
+                            this, &WorkerPoolTests::motionThread));
+    events.initQuitTimeout(10);
+    events.loop();
+    events.cleanupQuitTimeout();
+
+    m_stopMotion = true;
+    motion.wait();
+    events.removeHandlers(this);
+    m_events = NULL;
+    return m_longest;
+}
+
+void
+WorkerPoolTests::handleMotion(const Event& event, void*)
+{
+    double sent = *static_cast<double*>(event.getData());
+    m_longest = std::max(m_longest, ARCH->time() - sent);
+
+    // the clipboard comes in with the first motion
+    if (!m_converting) {
+        m_converting = true;
+        if (m_pool != NULL) {
+            m_pool->addJob(new TMethodJob<WorkerPoolTests>(
+                            this, &WorkerPoolTests::convertJob));
+        }
+        else {
+            convertJob(NULL);
+        }
+    }
+}
+
+void
+WorkerPoolTests::handleConverted(const Event&, void*)
+{
+    m_events->raiseQuitEvent();
+}
+
+TEST_F(WorkerPoolTests, addJob_manyJobs_allRun)
+{
+    {
+        WorkerPool pool(4);
+        for (int i = 0; i < kNumJobs; ++i) {
+            pool.addJob(new TMethodJob<WorkerPoolTests>(
+                            this, &WorkerPoolTests::countJob));
+        }
+        EXPECT_TRUE(waitForCount(kNumJobs));
+    }
+
+    EXPECT_EQ(kNumJobs, m_count);
+}
+
+TEST_F(WorkerPoolTests, destructor_runningJob_waitsForIt)
+{
+    {
+        WorkerPool pool(1);
+        pool.addJob(new TMethodJob<WorkerPoolTests>(
+                            this, &WorkerPoolTests::slowJob));
+        ARCH->sleep(0.01);
+    }
+
+    EXPECT_EQ(1, m_count);
+}
+
+TEST_F(WorkerPoolTests, addJob_twoJobs_runConcurrently)
+{
+    WorkerPool pool(2);
+    for (int i = 0; i < 2; ++i) {
+        pool.addJob(new TMethodJob<WorkerPoolTests>(
+                            this, &WorkerPoolTests::meetJob));
+    }
+    ASSERT_TRUE(waitForCount(2));
+
+    // run one at a time neither would see the other running
+    EXPECT_EQ(2, m_met);
+}
+
+TEST_F(WorkerPoolTests, benchmark_motionLatencyWhileConverting)
+{
+    int filter = CLOG->getFilter();
+    CLOG->setFilter(kINFO);
+
+    double inLoop = runEventLoop(NULL);
+    double onWorker;
+    {
+        WorkerPool pool(1);
+        onWorker = runEventLoop(&pool);
+    }
+    CLOG->setFilter(filter);
+
+    LOG((CLOG_INFO "longest motion latency converting a %d MB clipboard: %.1f ms in the event loop, %.1f ms on a worker",
+                kClipboardSize / (1024 * 1024), inLoop * 1.0e+3, onWorker * 1.0e+3));
+    EXPECT_LT(onWorker, inLoop);
+}
@@ -0,0 +1,209 @@
+/*
+ * synergy -- mouse and keyboard sharing utility
+ * Copyright (C) 2016 Symless Ltd.
+ *
+ * This package is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * found in the file LICENSE that should have accompanied this file.
+ *
+ * This package is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_ENV
+
+#include "test/global/TestEventQueue.h"
+#include "server/ClientProxy1_3.h"
+#include "core/ProtocolMessages.h"
+#include "core/protocol_types.h"
+#include "io/IStream.h"
+#include "base/Log.h"
+
+#include "test/global/gtest.h"
+
+#include <algorithm>
+#include <cstring>
+
+const int kFuzzMessages = 10000;
+const int kFuzzStreams  = 2000;
+
+// the codes of the messages a client sends
+static const char* const s_clientCodes[] = {
+    kMsgCNoop, kMsgCClipboard, kMsgCKeepAlive, kMsgDClipboard, kMsgDInfo
+};
+
+// reads what's been queued with queue() and keeps what's written
+class ClientStream : public synergy::IStream {
+public:
+    ClientStream() : m_readPos(0), m_closed(false) { }
+
+    void                queue(const String& data) { m_input += data; }
+
+    virtual void        close() { m_closed = true; }
+    virtual UInt32        read(void* buffer, UInt32 n)
+    {
+        n = std::min(n, getSize());
+        if (buffer != NULL) {
+            memcpy(buffer, m_input.data() + m_readPos, n);
+        }
+        m_readPos += n;
+        return n;
+    }
+    virtual void        write(const void* buffer, UInt32 n)
+    {
+        m_output.append(static_cast<const char*>(buffer), n);
+    }
+    virtual void        flush() { }
+    virtual void        shutdownInput() { }
+    virtual void        shutdownOutput() { }
+    virtual void*        getEventTarget() const
+    {
+        return const_cast<void*>(static_cast<const void*>(this));
+    }
+    virtual bool        isReady() const { return getSize() > 0; }
+    virtual UInt32        getSize() const
+    {
+        return static_cast<UInt32>(m_input.size() - m_readPos);
+    }
+
+public:
+    String                m_input;
+    size_t                m_readPos;
+    String                m_output;
+    bool                m_closed;
+};
+
+// the same numbers on every run so a failure can be reproduced
+static UInt32
+nextRandom(UInt32& seed)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+class ClientProxyTests : public ::testing::Test
+{
+public:
+    // sends the client's info, which completes the handshake
+    static void            completeHandshake(ClientStream* stream,
+                            ClientProxy1_3& proxy);
+
+public:
+    TestEventQueue        m_events;
+};
+
+void
+ClientProxyTests::completeHandshake(ClientStream* stream, ClientProxy1_3& proxy)
+{
+    String message(4 + 14, '\0');
+    synergy::protocol::DInfo::write(&message[0], 0, 0, 1920, 1080, 0, 5, 5);
+    stream->queue(message);
+    proxy.handleDataForTest();
+    stream->m_output.clear();
+}
+
+TEST_F(ClientProxyTests, handleData_randomMessages_allHandled)
+{
+    ClientStream* stream = new ClientStream;
+    ClientProxy1_3 proxy("stub", stream, &m_events);
+    completeHandshake(stream, proxy);
+
+    String message;
+    UInt32 seed = 1;
+    int infos = 0;
+    for (int i = 0; i < kFuzzMessages; ++i) {
+        UInt32 r = nextRandom(seed);
+        UInt8 buffer[32];
+        UInt32 n = 0;
+        switch (r % 4) {
+        case 0:
+            n = synergy::protocol::DInfo::write(buffer,
+                            r & 0xff, 0, 1 + (r >> 16), 1 + (r >> 8 & 0xff),
+                            0, 0, 0);
+            ++infos;
+            break;
+
+        case 1:
+            n = synergy::protocol::CClipboard::write(buffer,
+                            r % kClipboardEnd, r);
+            break;
+
+        case 2:
+            n = synergy::protocol::CNoop::write(buffer);
+            break;
+
+        default:
+            n = synergy::protocol::CKeepAlive::write(buffer);
+            break;
+        }
+        message.append(reinterpret_cast<const char*>(buffer), n);
+    }
+    stream->queue(message);
+    proxy.handleDataForTest();
+
+    // every message was read and every info acknowledged
+    EXPECT_EQ(0, (int)stream->getSize());
+    EXPECT_FALSE(stream->m_closed);
+    EXPECT_EQ(4 * infos, (int)stream->m_output.size());
+}
+
+TEST_F(ClientProxyTests, handleData_unknownMessage_disconnects)
+{
+    ClientStream* stream = new ClientStream;
+    ClientProxy1_3 proxy("stub", stream, &m_events);
+    completeHandshake(stream, proxy);
+
+    // file transfers aren't part of protocol 1.3
+    String message(kMsgCNoop, 4);
+    message.append(kMsgDFileTransfer, 4);
+    message.append(kMsgCNoop, 4);
+    stream->queue(message);
+    proxy.handleDataForTest();
+
+    EXPECT_TRUE(stream->m_closed);
+    EXPECT_EQ(4, (int)stream->getSize());
+}
+
+TEST_F(ClientProxyTests, handleData_randomBytes_survives)
+{
+    const int numCodes = sizeof(s_clientCodes) / sizeof(s_clientCodes[0]);
+
+    UInt32 seed = 2;
+    size_t total = 0;
+    for (int i = 0; i < kFuzzStreams; ++i) {
+        ClientStream* stream = new ClientStream;
+        ClientProxy1_3 proxy("stub", stream, &m_events);
+
+        // fuzz both the handshake and the messages after it
+        if (i % 2 != 0) {
+            completeHandshake(stream, proxy);
+        }
+
+        String message;
+        for (UInt32 n = 1 + nextRandom(seed) % 8; n > 0; --n) {
+            UInt32 r = nextRandom(seed);
+            if (r % 8 != 0) {
+                message.append(s_clientCodes[(r >> 3) % numCodes], 4);
+            }
+            else {
+                for (int j = 0; j < 4; ++j) {
+                    message += static_cast<char>(nextRandom(seed));
+                }
+            }
+            for (UInt32 m = nextRandom(seed) % 25; m > 0; --m) {
+                message += static_cast<char>(nextRandom(seed));
+            }
+        }
+        stream->queue(message);
+        proxy.handleDataForTest();
+
+        EXPECT_LE(stream->m_readPos, stream->m_input.size());
+        total += stream->m_readPos;
+    }
+    EXPECT_LT((size_t)0, total);
+}
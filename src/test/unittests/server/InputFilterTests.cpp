@@ -0,0 +1,298 @@
+/*
+ * synergy -- mouse and keyboard sharing utility
+ * Copyright (C) 2016 Symless Ltd.
+ *
+ * This package is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * found in the file LICENSE that should have accompanied this file.
+ *
+ * This package is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define TEST_ENV
+
+#include "test/global/TestEventQueue.h"
+#include "server/InputFilter.h"
+#include "server/PrimaryClient.h"
+#include "server/Server.h"
+#include "base/TMethodEventJob.h"
+#include "base/Log.h"
+#include "arch/Arch.h"
+#include "common/stdvector.h"
+
+#include "test/global/gtest.h"
+
+#include <cstdlib>
+
+const int kBenchmarkKeystrokeRules = 460;
+const int kBenchmarkButtonRules    = 30;
+const int kBenchmarkOtherRules     = 10;
+const int kBenchmarkEvents         = 100000;
+
+// matches every event
+class AnyCondition : public InputFilter::Condition {
+public:
+    virtual Condition*    clone() const { return new AnyCondition; }
+    virtual String        format() const { return "any()"; }
+    virtual InputFilter::EFilterStatus
+                        match(const Event&) { return InputFilter::kActivate; }
+};
+
+// numbers the hotkeys from 1 in the order they're registered
+class StubPrimaryClient : public PrimaryClient {
+public:
+    StubPrimaryClient() : m_nextHotKey(1) { }
+
+    virtual void*        getEventTarget() const
+    {
+        return const_cast<void*>(static_cast<const void*>(this));
+    }
+    virtual UInt32        registerHotKey(KeyID, KeyModifierMask)
+    {
+        return m_nextHotKey++;
+    }
+    virtual void        unregisterHotKey(UInt32) { }
+
+public:
+    UInt32                m_nextHotKey;
+};
+
+class InputFilterTests : public ::testing::Test
+{
+public:
+    InputFilterTests();
+    ~InputFilterTests();
+
+    // adds a rule that switches to \p screen when activated
+    void                addRule(InputFilter::Condition* adopted,
+                            const String& screen);
+
+    // registers the hotkeys, numbering them from 1 in rule order
+    void                enable();
+
+    // sends an event from the primary screen.  \p data isn't freed.
+    void                send(Event::Type type, void* data);
+
+    void                handlePassed(const Event&, void*);
+    void                handleSwitch(const Event&, void*);
+
+public:
+    TestEventQueue        m_events;
+    StubPrimaryClient    m_primary;
+    InputFilter            m_filter;
+    int                    m_passed;
+    std::vector<String>    m_switched;
+};
+
+InputFilterTests::InputFilterTests() :
+    m_filter(&m_events),
+    m_passed(0)
+{
+    Event::Type passed[] = {
+        m_events.forIKeyState().keyDown(),
+        m_events.forIKeyState().keyUp(),
+        m_events.forIPrimaryScreen().hotKeyDown(),
+        m_events.forIPrimaryScreen().hotKeyUp(),
+        m_events.forIPrimaryScreen().buttonDown(),
+        m_events.forIPrimaryScreen().buttonUp()
+    };
+    for (size_t i = 0; i < sizeof(passed) / sizeof(passed[0]); ++i) {
+        m_events.adoptHandler(passed[i], &m_filter,
+                            new TMethodEventJob<InputFilterTests>(this,
+                                &InputFilterTests::handlePassed));
+    }
+    m_events.adoptHandler(m_events.forServer().switchToScreen(), &m_filter,
+                            new TMethodEventJob<InputFilterTests>(this,
+                                &InputFilterTests::handleSwitch));
+}
+
+InputFilterTests::~InputFilterTests()
+{
+    m_filter.setPrimaryClient(NULL);
+    m_events.removeHandlers(&m_filter);
+}
+
+void
+InputFilterTests::addRule(InputFilter::Condition* adopted, const String& screen)
+{
+    InputFilter::Rule rule(adopted);
+    rule.adoptAction(new InputFilter::SwitchToScreenAction(&m_events, screen),
+                            true);
+    m_filter.addFilterRule(rule);
+}
+
+void
+InputFilterTests::enable()
+{
+    m_filter.setPrimaryClient(&m_primary);
+}
+
+void
+InputFilterTests::send(Event::Type type, void* data)
+{
+    m_events.addEvent(Event(type, m_primary.getEventTarget(), data,
+                            Event::kDeliverImmediately | Event::kDontFreeData));
+}
+
+void
+InputFilterTests::handlePassed(const Event&, void*)
+{
+    ++m_passed;
+}
+
+void
+InputFilterTests::handleSwitch(const Event& event, void*)
+{
+    Server::SwitchToScreenInfo* info =
+        static_cast<Server::SwitchToScreenInfo*>(event.getData());
+    m_switched.push_back(info->m_screen);
+}
+
+TEST_F(InputFilterTests, hotKey_indexedRule_performsActions)
+{
+    addRule(new InputFilter::KeystrokeCondition(&m_events, 'a', 0), "one");
+    addRule(new InputFilter::MouseButtonCondition(&m_events, 1, 0), "two");
+    addRule(new InputFilter::KeystrokeCondition(&m_events, 'b',
+                            KeyModifierControl), "three");
+    enable();
+
+    IPlatformScreen::HotKeyInfo* info = IPlatformScreen::HotKeyInfo::alloc(2);
+    send(m_events.forIPrimaryScreen().hotKeyDown(), info);
+    send(m_events.forIPrimaryScreen().hotKeyUp(), info);
+    free(info);
+
+    ASSERT_EQ(1, (int)m_switched.size());
+    EXPECT_EQ("three", m_switched[0]);
+    EXPECT_EQ(0, m_passed);
+}
+
+TEST_F(InputFilterTests, keyDown_noRule_passesThrough)
+{
+    addRule(new InputFilter::KeystrokeCondition(&m_events, 'a', 0), "one");
+    enable();
+
+    IPlatformScreen::KeyInfo* info =
+        IPlatformScreen::KeyInfo::alloc('a', 0, 10, 1);
+    send(m_events.forIKeyState().keyDown(), info);
+    send(m_events.forIKeyState().keyUp(), info);
+    free(info);
+
+    EXPECT_TRUE(m_switched.empty());
+    EXPECT_EQ(2, m_passed);
+}
+
+TEST_F(InputFilterTests, buttonDown_ignoredModifiers_matches)
+{
+    addRule(new InputFilter::MouseButtonCondition(&m_events, 1,
+                            KeyModifierShift), "first");
+    addRule(new InputFilter::MouseButtonCondition(&m_events, 1,
+                            KeyModifierShift), "second");
+    enable();
+
+    IPlatformScreen::ButtonInfo* info = IPlatformScreen::ButtonInfo::alloc(1,
+                            KeyModifierShift | KeyModifierCapsLock);
+    send(m_events.forIPrimaryScreen().buttonDown(), info);
+    info->m_mask = 0;
+    send(m_events.forIPrimaryScreen().buttonDown(), info);
+    free(info);
+
+    ASSERT_EQ(1, (int)m_switched.size());
+    EXPECT_EQ("first", m_switched[0]);
+    EXPECT_EQ(1, m_passed);
+}
+
+TEST_F(InputFilterTests, hotKey_otherRuleAfter_hotKeyMatches)
+{
+    addRule(new InputFilter::KeystrokeCondition(&m_events, 'a', 0), "hotkey");
+    addRule(new AnyCondition, "any");
+    enable();
+
+    IPlatformScreen::HotKeyInfo* info = IPlatformScreen::HotKeyInfo::alloc(1);
+    send(m_events.forIPrimaryScreen().hotKeyDown(), info);
+    free(info);
+
+    ASSERT_EQ(1, (int)m_switched.size());
+    EXPECT_EQ("hotkey", m_switched[0]);
+}
+
+TEST_F(InputFilterTests, hotKey_otherRuleFirst_otherRuleMatches)
+{
+    addRule(new AnyCondition, "any");
+    addRule(new InputFilter::KeystrokeCondition(&m_events, 'a', 0), "hotkey");
+    enable();
+
+    IPlatformScreen::HotKeyInfo* info = IPlatformScreen::HotKeyInfo::alloc(1);
+    send(m_events.forIPrimaryScreen().hotKeyDown(), info);
+    free(info);
+
+    ASSERT_EQ(1, (int)m_switched.size());
+    EXPECT_EQ("any", m_switched[0]);
+}
+
+TEST_F(InputFilterTests, removeFilterRule_hotKey_passesThrough)
+{
+    addRule(new InputFilter::KeystrokeCondition(&m_events, 'a', 0), "one");
+    enable();
+
+    IPlatformScreen::HotKeyInfo* info = IPlatformScreen::HotKeyInfo::alloc(1);
+    send(m_events.forIPrimaryScreen().hotKeyDown(), info);
+    m_filter.removeFilterRule(0);
+    send(m_events.forIPrimaryScreen().hotKeyDown(), info);
+    free(info);
+
+    EXPECT_EQ(1, (int)m_switched.size());
+    EXPECT_EQ(1, m_passed);
+}
+
+TEST_F(InputFilterTests, benchmark_handleEvent)
+{
+    for (int i = 0; i < kBenchmarkKeystrokeRules; ++i) {
+        addRule(new InputFilter::KeystrokeCondition(&m_events,
+                            kKeyF1 + i % 24, i / 24), "screen");
+    }
+    for (int i = 0; i < kBenchmarkButtonRules; ++i) {
+        addRule(new InputFilter::MouseButtonCondition(&m_events,
+                            i % 5 + 1, i / 5), "screen");
+    }
+    for (int i = 0; i < kBenchmarkOtherRules; ++i) {
+        addRule(new InputFilter::ScreenConnectedCondition(&m_events,
+                            "screen"), "screen");
+    }
+    enable();
+
+    int filter = CLOG->getFilter();
+    CLOG->setFilter(kINFO);
+
+    // mostly typing with a hotkey now and then
+    IPlatformScreen::KeyInfo* key =
+        IPlatformScreen::KeyInfo::alloc('a', 0, 10, 1);
+    IPlatformScreen::HotKeyInfo* hotKey = IPlatformScreen::HotKeyInfo::alloc(1);
+    double start = ARCH->time();
+    for (int i = 0; i < kBenchmarkEvents; ++i) {
+        if (i % 20 == 0) {
+            hotKey->m_id = 1 + i % kBenchmarkKeystrokeRules;
+            send(m_events.forIPrimaryScreen().hotKeyDown(), hotKey);
+        }
+        else if (i % 2 == 0) {
+            send(m_events.forIKeyState().keyDown(), key);
+        }
+        else {
+            send(m_events.forIKeyState().keyUp(), key);
+        }
+    }
+    double elapsed = ARCH->time() - start;
+    free(hotKey);
+    free(key);
+    CLOG->setFilter(filter);
+
+    LOG((CLOG_INFO "filtered event with %d rules: %.0f ns",
+                m_filter.getNumRules(), elapsed / kBenchmarkEvents * 1.0e+9));
+    EXPECT_EQ(kBenchmarkEvents / 20, (int)m_switched.size());
+    EXPECT_EQ(kBenchmarkEvents - kBenchmarkEvents / 20, m_passed);
+}
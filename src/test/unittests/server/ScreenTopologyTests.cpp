@@ -0,0 +1,234 @@
+/*
+ * synergy -- mouse and keyboard sharing utility
+ * Copyright (C) 2016 Symless Ltd.
+ *
+ * This package is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * found in the file LICENSE that should have accompanied this file.
+ *
+ * This package is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "server/ScreenTopology.h"
+#include "server/Config.h"
+#include "arch/Arch.h"
+#include "base/Log.h"
+#include "common/stdmap.h"
+
+#include "test/global/gtest.h"
+
+#include <cstdio>
+
+// 32 screens
+const int kGridWidth  = 8;
+const int kGridHeight = 4;
+
+const int kWalkCount  = 100000;
+
+static String
+gridName(int x, int y)
+{
+    char name[32];
+    sprintf(name, "screen-%d-%d", x, y);
+    return name;
+}
+
+// lays the screens out in a grid.  screens in odd columns have their
+// right side split in two, both halves going to the top half of the
+// next screen, and each screen is linked to by an alias.
+static void
+makeGrid(Config& config)
+{
+    for (int y = 0; y < kGridHeight; ++y) {
+        for (int x = 0; x < kGridWidth; ++x) {
+            String name = gridName(x, y);
+            config.addScreen(name);
+            config.addAlias(name, name + "-alias");
+        }
+    }
+
+    for (int y = 0; y < kGridHeight; ++y) {
+        for (int x = 0; x < kGridWidth; ++x) {
+            String name = gridName(x, y);
+            String right = gridName(x + 1, y) + "-alias";
+            if (x + 1 == kGridWidth) {
+                // nothing to the right
+            }
+            else if (x % 2 == 1) {
+                config.connect(name, kRight, 0.0f, 0.5f, right, 0.0f, 0.5f);
+                config.connect(name, kRight, 0.5f, 1.0f, right, 0.0f, 0.5f);
+            }
+            else {
+                config.connect(name, kRight, 0.0f, 1.0f, right, 0.0f, 1.0f);
+            }
+            if (x > 0) {
+                config.connect(name, kLeft, 0.0f, 1.0f,
+                            gridName(x - 1, y), 0.0f, 1.0f);
+            }
+            if (y > 0) {
+                config.connect(name, kTop, 0.25f, 0.75f,
+                            gridName(x, y - 1), 0.0f, 1.0f);
+            }
+            if (y + 1 < kGridHeight) {
+                config.connect(name, kBottom, 0.0f, 1.0f,
+                            gridName(x, y + 1), 0.25f, 0.75f);
+            }
+        }
+    }
+}
+
+TEST(ScreenTopologyTests, getNeighbor_grid_sameAsConfig)
+{
+    Config config(NULL);
+    makeGrid(config);
+    ScreenTopology topology;
+    topology.compile(config);
+
+    ASSERT_EQ((UInt32)(kGridWidth * kGridHeight), topology.getNumScreens());
+    for (UInt32 id = 0; id < topology.getNumScreens(); ++id) {
+        const String& name = topology.getName(id);
+        for (int dir = kFirstDirection; dir <= kLastDirection; ++dir) {
+            for (int i = 0; i <= 20; ++i) {
+                float t = i / 20.0f;
+                float expectedOut = -1.0f, out = -1.0f;
+                String expected = config.getNeighbor(name,
+                            (EDirection)dir, t, &expectedOut);
+                ScreenTopology::ScreenID dst = topology.getNeighbor(id,
+                            (EDirection)dir, t, &out);
+
+                if (expected.empty()) {
+                    EXPECT_EQ(ScreenTopology::kNoScreen, dst);
+                }
+                else {
+                    ASSERT_NE(ScreenTopology::kNoScreen, dst);
+                    EXPECT_EQ(expected, topology.getName(dst));
+                    EXPECT_EQ(expectedOut, out);
+                }
+            }
+        }
+    }
+}
+
+TEST(ScreenTopologyTests, setClient_thenCleared_noScreen)
+{
+    Config config(NULL);
+    makeGrid(config);
+    ScreenTopology topology;
+    topology.compile(config);
+
+    // any non-NULL pointer will do as it's only compared
+    BaseClientProxy* client = reinterpret_cast<BaseClientProxy*>(&config);
+    EXPECT_EQ(ScreenTopology::kNoScreen, topology.getScreen(client));
+
+    topology.setClient(gridName(3, 2), client);
+    ScreenTopology::ScreenID id = topology.getScreen(client);
+    ASSERT_NE(ScreenTopology::kNoScreen, id);
+    EXPECT_EQ(gridName(3, 2), topology.getName(id));
+    EXPECT_EQ(client, topology.getClient(id));
+
+    topology.setClient(gridName(3, 2), NULL);
+    EXPECT_EQ(ScreenTopology::kNoScreen, topology.getScreen(client));
+    EXPECT_TRUE(topology.getClient(id) == NULL);
+
+    // recompiling disconnects everything
+    topology.setClient(gridName(0, 0), client);
+    topology.compile(config);
+    EXPECT_EQ(ScreenTopology::kNoScreen, topology.getScreen(client));
+}
+
+TEST(ScreenTopologyTests, setClient_replaced_oldClientHasNoScreen)
+{
+    Config config(NULL);
+    makeGrid(config);
+    ScreenTopology topology;
+    topology.compile(config);
+
+    BaseClientProxy* first  = reinterpret_cast<BaseClientProxy*>(&config);
+    BaseClientProxy* second = reinterpret_cast<BaseClientProxy*>(&topology);
+    topology.setClient(gridName(1, 1), first);
+    topology.setClient(gridName(1, 1), second);
+    topology.setClient("no such screen", first);
+
+    EXPECT_EQ(ScreenTopology::kNoScreen, topology.getScreen(first));
+    ScreenTopology::ScreenID id = topology.getScreen(second);
+    ASSERT_NE(ScreenTopology::kNoScreen, id);
+    EXPECT_EQ(gridName(1, 1), topology.getName(id));
+}
+
+TEST(ScreenTopologyTests, benchmark_walkGrid)
+{
+    Config config(NULL);
+    makeGrid(config);
+    ScreenTopology topology;
+    topology.compile(config);
+
+    // every other screen is connected, as Server keeps them
+    typedef std::map<String, BaseClientProxy*> ClientList;
+    ClientList clients;
+    BaseClientProxy* client = reinterpret_cast<BaseClientProxy*>(&config);
+    for (UInt32 id = 0; id < topology.getNumScreens(); id += 2) {
+        clients[topology.getName(id)] = client;
+        topology.setClient(topology.getName(id), client);
+    }
+
+    // walk round the grid crossing edges the way Server::getNeighbor()
+    // did, by name, skipping screens that aren't connected
+    int found = 0;
+    String name = topology.getName(0);
+    double start = ARCH->time();
+    for (int i = 0; i < kWalkCount; ++i) {
+        EDirection dir = (EDirection)(kFirstDirection + i % kNumDirections);
+        float t = (i % 97) / 97.0f;
+        for (;;) {
+            float tOut;
+            String dstName = config.getNeighbor(name, dir, t, &tOut);
+            if (dstName.empty()) {
+                break;
+            }
+            name = dstName;
+            t    = tOut;
+            if (clients.find(dstName) != clients.end()) {
+                ++found;
+                break;
+            }
+        }
+    }
+    double configTime = ARCH->time() - start;
+
+    // and again through the topology
+    int topologyFound = 0;
+    ScreenTopology::ScreenID id = 0;
+    start = ARCH->time();
+    for (int i = 0; i < kWalkCount; ++i) {
+        EDirection dir = (EDirection)(kFirstDirection + i % kNumDirections);
+        float t = (i % 97) / 97.0f;
+        for (;;) {
+            float tOut;
+            ScreenTopology::ScreenID dst =
+                topology.getNeighbor(id, dir, t, &tOut);
+            if (dst == ScreenTopology::kNoScreen) {
+                break;
+            }
+            id = dst;
+            t  = tOut;
+            if (topology.getClient(dst) != NULL) {
+                ++topologyFound;
+                break;
+            }
+        }
+    }
+    double topologyTime = ARCH->time() - start;
+
+    LOG((CLOG_INFO "neighbor lookup on %d screens: config %.1f ns, topology %.1f ns",
+                topology.getNumScreens(),
+                configTime / kWalkCount * 1.0e+9,
+                topologyTime / kWalkCount * 1.0e+9));
+    EXPECT_EQ(found, topologyFound);
+    EXPECT_EQ(name, topology.getName(id));
+}
@@ -20,109 +20,73 @@
 
 #include "test/global/gtest.h"
 
+#include <cstring>
+
 TEST(ClipboardChunkTests, start_formatStartChunk)
 {
-<<<<<<< HEAD
     ClipboardID id = 0;
     UInt32 sequence = 0;
     String mockDataSize("10");
     ClipboardChunk* chunk = ClipboardChunk::start(id, sequence, mockDataSize);
+    UInt32 temp_m_chunk;
+    memcpy(&temp_m_chunk, &(chunk->m_chunk[1]), 4);
 
     EXPECT_EQ(id, chunk->m_chunk[0]);
-    EXPECT_EQ(sequence, (UInt32)chunk->m_chunk[1]);
+    EXPECT_EQ(sequence, temp_m_chunk);
     EXPECT_EQ(kDataStart, chunk->m_chunk[5]);
     EXPECT_EQ('1', chunk->m_chunk[6]);
     EXPECT_EQ('0', chunk->m_chunk[7]);
     EXPECT_EQ('\0', chunk->m_chunk[8]);
-=======
-	ClipboardID id = 0;
-	UInt32 sequence = 0;
-	String mockDataSize("10");
-	ClipboardChunk* chunk = ClipboardChunk::start(id, sequence, mockDataSize);
-	UInt32 temp_m_chunk;
-	memcpy(&temp_m_chunk, &(chunk->m_chunk[1]), 4);
-
-	EXPECT_EQ(id, chunk->m_chunk[0]);
-	EXPECT_EQ(sequence, temp_m_chunk);
-	EXPECT_EQ(kDataStart, chunk->m_chunk[5]);
-	EXPECT_EQ('1', chunk->m_chunk[6]);
-	EXPECT_EQ('0', chunk->m_chunk[7]);
-	EXPECT_EQ('\0', chunk->m_chunk[8]);
->>>>>>> master
 
     delete chunk;
 }
 
 TEST(ClipboardChunkTests, data_formatDataChunk)
 {
-<<<<<<< HEAD
     ClipboardID id = 0;
     UInt32 sequence = 1;
-    String mockData("mock data");
-    ClipboardChunk* chunk = ClipboardChunk::data(id, sequence, mockData);
+    ClipboardBuffer mockData(new String("mock data"));
+    ClipboardChunk* chunk = ClipboardChunk::data(id, sequence, mockData, 5, 4);
+    UInt32 temp_m_chunk;
+    memcpy(&temp_m_chunk, &(chunk->m_chunk[1]), 4);
 
     EXPECT_EQ(id, chunk->m_chunk[0]);
-    EXPECT_EQ(sequence, (UInt32)chunk->m_chunk[1]);
+    EXPECT_EQ(sequence, temp_m_chunk);
     EXPECT_EQ(kDataChunk, chunk->m_chunk[5]);
-    EXPECT_EQ('m', chunk->m_chunk[6]);
-    EXPECT_EQ('o', chunk->m_chunk[7]);
-    EXPECT_EQ('c', chunk->m_chunk[8]);
-    EXPECT_EQ('k', chunk->m_chunk[9]);
-    EXPECT_EQ(' ', chunk->m_chunk[10]);
-    EXPECT_EQ('d', chunk->m_chunk[11]);
-    EXPECT_EQ('a', chunk->m_chunk[12]);
-    EXPECT_EQ('t', chunk->m_chunk[13]);
-    EXPECT_EQ('a', chunk->m_chunk[14]);
-    EXPECT_EQ('\0', chunk->m_chunk[15]);
-=======
-	ClipboardID id = 0;
-	UInt32 sequence = 1;
-	String mockData("mock data");
-	ClipboardChunk* chunk = ClipboardChunk::data(id, sequence, mockData);
-	UInt32 temp_m_chunk;
-	memcpy(&temp_m_chunk, &(chunk->m_chunk[1]), 4);
-
-	EXPECT_EQ(id, chunk->m_chunk[0]);
-	EXPECT_EQ(sequence, temp_m_chunk);
-	EXPECT_EQ(kDataChunk, chunk->m_chunk[5]);
-	EXPECT_EQ('m', chunk->m_chunk[6]);
-	EXPECT_EQ('o', chunk->m_chunk[7]);
-	EXPECT_EQ('c', chunk->m_chunk[8]);
-	EXPECT_EQ('k', chunk->m_chunk[9]);
-	EXPECT_EQ(' ', chunk->m_chunk[10]);
-	EXPECT_EQ('d', chunk->m_chunk[11]);
-	EXPECT_EQ('a', chunk->m_chunk[12]);
-	EXPECT_EQ('t', chunk->m_chunk[13]);
-	EXPECT_EQ('a', chunk->m_chunk[14]);
-	EXPECT_EQ('\0', chunk->m_chunk[15]);
->>>>>>> master
+    EXPECT_EQ('\0', chunk->m_chunk[6]);
+    EXPECT_EQ(mockData, chunk->m_buffer);
+    EXPECT_EQ(5, (int)chunk->m_offset);
+    EXPECT_EQ(4, (int)chunk->m_dataSize);
 
     delete chunk;
 }
 
+TEST(ClipboardChunkTests, data_lastChunkDeleted_freesBuffer)
+{
+    ClipboardBuffer mockData(new String("mock data"));
+    ClipboardChunk* first = ClipboardChunk::data(0, 1, mockData, 0, 5);
+    ClipboardChunk* second = ClipboardChunk::data(0, 1, mockData, 5, 4);
+    std::weak_ptr<const String> data = mockData;
+    mockData.reset();
+
+    delete first;
+    EXPECT_FALSE(data.expired());
+    delete second;
+    EXPECT_TRUE(data.expired());
+}
+
 TEST(ClipboardChunkTests, end_formatDataChunk)
 {
-<<<<<<< HEAD
     ClipboardID id = 1;
     UInt32 sequence = 1;
     ClipboardChunk* chunk = ClipboardChunk::end(id, sequence);
+    UInt32 temp_m_chunk;
+    memcpy(&temp_m_chunk, &(chunk->m_chunk[1]), 4);
 
     EXPECT_EQ(id, chunk->m_chunk[0]);
-    EXPECT_EQ(sequence, (UInt32)chunk->m_chunk[1]);
+    EXPECT_EQ(sequence, temp_m_chunk);
     EXPECT_EQ(kDataEnd, chunk->m_chunk[5]);
     EXPECT_EQ('\0', chunk->m_chunk[6]);
-=======
-	ClipboardID id = 1;
-	UInt32 sequence = 1;
-	ClipboardChunk* chunk = ClipboardChunk::end(id, sequence);
-	UInt32 temp_m_chunk;
-	memcpy(&temp_m_chunk, &(chunk->m_chunk[1]), 4);
-
-	EXPECT_EQ(id, chunk->m_chunk[0]);
-	EXPECT_EQ(sequence, temp_m_chunk);
-	EXPECT_EQ(kDataEnd, chunk->m_chunk[5]);
-	EXPECT_EQ('\0', chunk->m_chunk[6]);
->>>>>>> master
 
     delete chunk;
 }
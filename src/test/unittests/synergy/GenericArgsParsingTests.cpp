@@ -77,6 +77,24 @@ TEST(GenericArgsParsingTests, parseGenericArgs_logFileCmd_saveLogFilename)
     EXPECT_EQ(2, i);
 }
 
+TEST(GenericArgsParsingTests, parseGenericArgs_logFormatCmd_saveLogFormat)
+{
+    int i = 1;
+    const int argc = 3;
+    const char* kLogFormatCmd[argc] = { "stub", "--log-format", "json" };
+
+    ArgParser argParser(NULL);
+    ArgsBase argsBase;
+    argParser.setArgsBase(argsBase);
+
+    argParser.parseGenericArgs(argc, kLogFormatCmd, i);
+
+    String logFormat(argsBase.m_logFormat);
+
+    EXPECT_EQ("json", logFormat);
+    EXPECT_EQ(2, i);
+}
+
 TEST(GenericArgsParsingTests, parseGenericArgs_logFileCmdWithSpace_saveLogFilename)
 {
     int i = 1;
@@ -28,7 +28,70 @@ using ::testing::ReturnRef;
 using ::testing::SaveArg;
 
 namespace synergy {
-    
+
+const int kMappedKeyCount = 5000;
+
+// adds a key item to \p keyMap
+static void
+addKey(KeyMap& keyMap, KeyID id, KeyButton button,
+                KeyModifierMask required, KeyModifierMask sensitive)
+{
+    KeyMap::KeyItem item;
+    item.m_id        = id;
+    item.m_group     = 0;
+    item.m_button    = button;
+    item.m_required  = required;
+    item.m_sensitive = sensitive;
+    item.m_generates = 0;
+    item.m_dead      = false;
+    item.m_lock      = false;
+    item.m_client    = 0;
+    KeyMap::initModifierKey(item);
+    keyMap.addKeyEntry(item);
+}
+
+// fills \p keyMap with letters, a space and some modifiers
+static void
+addLetters(KeyMap& keyMap)
+{
+    const KeyModifierMask shift = KeyModifierShift | KeyModifierCapsLock;
+    for (KeyID i = 0; i < 26; ++i) {
+        addKey(keyMap, 'a' + i, 10 + i, 0, shift);
+        addKey(keyMap, 'A' + i, 10 + i, KeyModifierShift, shift);
+    }
+    addKey(keyMap, ' ', 40, 0, 0);
+    addKey(keyMap, kKeyShift_L, 50, 0, 0);
+    addKey(keyMap, kKeyControl_L, 51, 0, 0);
+    addKey(keyMap, kKeyAlt_L, 52, 0, 0);
+    keyMap.finish();
+}
+
+static bool
+operator==(const KeyMap::Keystroke& a, const KeyMap::Keystroke& b)
+{
+    if (a.m_type != b.m_type) {
+        return false;
+    }
+    if (a.m_type == KeyMap::Keystroke::kGroup) {
+        return (a.m_data.m_group.m_group    == b.m_data.m_group.m_group &&
+                a.m_data.m_group.m_absolute == b.m_data.m_group.m_absolute &&
+                a.m_data.m_group.m_restore  == b.m_data.m_group.m_restore);
+    }
+    return (a.m_data.m_button.m_button == b.m_data.m_button.m_button &&
+            a.m_data.m_button.m_press  == b.m_data.m_button.m_press &&
+            a.m_data.m_button.m_repeat == b.m_data.m_button.m_repeat &&
+            a.m_data.m_button.m_client == b.m_data.m_button.m_client);
+}
+
+// moves every item for 'a' to another button
+static void
+moveKeyA(KeyID id, SInt32, KeyMap::KeyItem& item, void*)
+{
+    if (id == 'a') {
+        item.m_button += 100;
+    }
+}
+
 TEST(KeyMapTests, findBestKey_requiredDown_matchExactFirstItem)
 {
     KeyMap keyMap;
@@ -213,4 +276,89 @@ TEST(KeyMapTests, isCommand_superMask_returnTrue)
     EXPECT_EQ(true, keyMap.isCommand(mask));
 }
     
+TEST(KeyMapTests, mapKey_remembered_sameAsUncached)
+{
+    static const KeyID s_ids[] = {
+        'a', 'q', 'Z', ' ', kKeyShift_L, kKeyControl_L, kKeyAlt_L,
+        kKeySetModifiers, kKeyClearModifiers, kKeyNextGroup
+    };
+    static const KeyModifierMask s_masks[] = {
+        0, KeyModifierShift, KeyModifierControl,
+        KeyModifierShift | KeyModifierAlt, KeyModifierCapsLock
+    };
+    const int numIDs   = sizeof(s_ids) / sizeof(s_ids[0]);
+    const int numMasks = sizeof(s_masks) / sizeof(s_masks[0]);
+
+    KeyMap keyMap;
+    addLetters(keyMap);
+
+    // the same numbers on every run so a failure can be reproduced
+    UInt32 seed = 1;
+    KeyModifierMask state = 0;
+    KeyMap::ModifierToKeys activeModifiers;
+    for (int i = 0; i < kMappedKeyCount; ++i) {
+        seed = seed * 1103515245 + 12345;
+        KeyID id             = s_ids[(seed >> 8) % numIDs];
+        KeyModifierMask mask = s_masks[(seed >> 16) % numMasks];
+        bool isAutoRepeat    = ((seed >> 24) % 4 == 0);
+
+        KeyMap::Keystrokes keys;
+        KeyModifierMask newState = state;
+        KeyMap::ModifierToKeys newActiveModifiers = activeModifiers;
+        const KeyMap::KeyItem* item =
+            keyMap.mapKey(keys, id, 0, newActiveModifiers,
+                                newState, mask, isAutoRepeat);
+
+        KeyMap::Keystrokes expectedKeys;
+        KeyModifierMask expectedState = state;
+        KeyMap::ModifierToKeys expectedActiveModifiers = activeModifiers;
+        const KeyMap::KeyItem* expectedItem =
+            keyMap.mapKeyUncached(expectedKeys, id, 0,
+                                expectedActiveModifiers, expectedState,
+                                mask, isAutoRepeat);
+
+        ASSERT_EQ(expectedItem, item);
+        ASSERT_EQ(expectedState, newState);
+        ASSERT_TRUE(expectedKeys == keys);
+        ASSERT_TRUE(expectedActiveModifiers == newActiveModifiers);
+
+        state           = newState;
+        activeModifiers = newActiveModifiers;
+    }
+}
+
+TEST(KeyMapTests, mapKey_mapChanged_forgetsResult)
+{
+    KeyMap keyMap;
+    addLetters(keyMap);
+
+    KeyMap::Keystrokes keys;
+    KeyModifierMask state = 0;
+    KeyMap::ModifierToKeys activeModifiers;
+    const KeyMap::KeyItem* item =
+        keyMap.mapKey(keys, 'a', 0, activeModifiers, state, 0, false);
+    ASSERT_TRUE(item != NULL);
+    EXPECT_EQ(10, item->m_button);
+
+    keyMap.foreachKey(&moveKeyA, NULL);
+
+    keys.clear();
+    item = keyMap.mapKey(keys, 'a', 0, activeModifiers, state, 0, false);
+    ASSERT_TRUE(item != NULL);
+    EXPECT_EQ(110, item->m_button);
+    ASSERT_EQ(1, (int)keys.size());
+    EXPECT_EQ(110, keys[0].m_data.m_button.m_button);
+
+    // and after a new map is swapped in
+    KeyMap other;
+    addKey(other, 'a', 20, 0, 0);
+    other.finish();
+    keyMap.swap(other);
+
+    keys.clear();
+    item = keyMap.mapKey(keys, 'a', 0, activeModifiers, state, 0, false);
+    ASSERT_TRUE(item != NULL);
+    EXPECT_EQ(20, item->m_button);
+}
+
 }
@@ -19,6 +19,8 @@
 #include "test/mock/synergy/MockKeyState.h"
 #include "test/mock/synergy/MockEventQueue.h"
 #include "test/mock/synergy/MockKeyMap.h"
+#include "arch/Arch.h"
+#include "base/Log.h"
 
 #include "test/global/gtest.h"
 #include "test/global/gmock.h"
@@ -47,6 +49,71 @@ stubMapKey(
 synergy::KeyMap::Keystroke s_stubKeystroke(1, false, false);
 synergy::KeyMap::KeyItem s_stubKeyItem;
 
+const int kTraceKeystrokes = 10000;
+
+// a key state with a small US layout that counts the keys it fakes
+class StubKeyState : public KeyState {
+public:
+    StubKeyState(IEventQueue* events) :
+        KeyState(events),
+        m_fakedKeys(0)
+    {
+    }
+
+    virtual bool        fakeCtrlAltDel() { return false; }
+    virtual KeyModifierMask
+                        pollActiveModifiers() const { return 0; }
+    virtual SInt32        pollActiveGroup() const { return 0; }
+    virtual void        pollPressedKeys(KeyButtonSet&) const { }
+
+protected:
+    virtual void        getKeyMap(synergy::KeyMap& keyMap);
+    virtual void        fakeKey(const Keystroke&) { ++m_fakedKeys; }
+
+private:
+    void                addKey(synergy::KeyMap& keyMap, KeyID id,
+                            KeyButton button, KeyModifierMask required,
+                            KeyModifierMask sensitive);
+
+public:
+    int                    m_fakedKeys;
+};
+
+void
+StubKeyState::getKeyMap(synergy::KeyMap& keyMap)
+{
+    const KeyModifierMask shift = KeyModifierShift | KeyModifierCapsLock;
+    for (KeyID i = 0; i < 26; ++i) {
+        addKey(keyMap, 'a' + i, 10 + i, 0, shift);
+        addKey(keyMap, 'A' + i, 10 + i, KeyModifierShift, shift);
+    }
+    addKey(keyMap, ' ', 40, 0, 0);
+    addKey(keyMap, ',', 41, 0, KeyModifierShift);
+    addKey(keyMap, '.', 42, 0, KeyModifierShift);
+    addKey(keyMap, kKeyShift_L, 50, 0, 0);
+    addKey(keyMap, kKeyShift_R, 51, 0, 0);
+    addKey(keyMap, kKeyControl_L, 52, 0, 0);
+    addKey(keyMap, kKeyCapsLock, 53, 0, 0);
+}
+
+void
+StubKeyState::addKey(synergy::KeyMap& keyMap, KeyID id, KeyButton button,
+                KeyModifierMask required, KeyModifierMask sensitive)
+{
+    synergy::KeyMap::KeyItem item;
+    item.m_id        = id;
+    item.m_group     = 0;
+    item.m_button    = button;
+    item.m_required  = required;
+    item.m_sensitive = sensitive;
+    item.m_generates = 0;
+    item.m_dead      = false;
+    item.m_lock      = false;
+    item.m_client    = 0;
+    synergy::KeyMap::initModifierKey(item);
+    keyMap.addKeyEntry(item);
+}
+
 TEST(CKeyStateTests, onKey_aKeyDown_keyStateOne)
 {
     MockKeyMap keyMap;
@@ -463,6 +530,37 @@ TEST(KeyStateTests, isKeyDown_noKeysDown_returnsFalse)
     ASSERT_FALSE(actual);
 }
 
+TEST(KeyStateTests, benchmark_typingTrace)
+{
+    static const char s_text[] =
+        "The quick brown fox jumps over the lazy dog. Pack my box with "
+        "five dozen liquor jugs, said Synergy.";
+
+    MockEventQueue eventQueue;
+    StubKeyState keyState(&eventQueue);
+    keyState.updateKeyMap();
+    keyState.updateKeyState();
+    int filter = CLOG->getFilter();
+    CLOG->setFilter(kINFO);
+
+    // the text typed over and over as the server would send it
+    double start = ARCH->time();
+    for (int i = 0; i < kTraceKeystrokes; ++i) {
+        char c = s_text[i % (sizeof(s_text) - 1)];
+        KeyModifierMask mask = (c >= 'A' && c <= 'Z') ? KeyModifierShift : 0;
+        KeyButton button = static_cast<KeyButton>(c);
+        keyState.fakeKeyDown(static_cast<KeyID>(c), mask, button);
+        keyState.fakeKeyUp(button);
+    }
+    double elapsed = ARCH->time() - start;
+    CLOG->setFilter(filter);
+
+    LOG((CLOG_INFO "faked keystroke: %.0f ns",
+                elapsed / kTraceKeystrokes * 1.0e+9));
+    EXPECT_LE(2 * kTraceKeystrokes, keyState.m_fakedKeys);
+    EXPECT_FALSE(keyState.isKeyDown(10));
+}
+
 void
 stubPollPressedKeys(IKeyState::KeyButtonSet& pressedKeys)
 {
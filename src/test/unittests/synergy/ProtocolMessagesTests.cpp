@@ -0,0 +1,307 @@
+/*
+ * synergy -- mouse and keyboard sharing utility
+ * Copyright (C) 2016 Symless Ltd.
+ *
+ * This package is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * found in the file LICENSE that should have accompanied this file.
+ *
+ * This package is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "core/ProtocolMessages.h"
+#include "core/ProtocolUtil.h"
+#include "core/protocol_types.h"
+#include "io/IStream.h"
+#include "arch/Arch.h"
+#include "base/Log.h"
+
+#include "test/global/gtest.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace synergy::protocol;
+
+const int kMessageCount = 200000;
+
+// reads what's been written to it, like a packet stream holding the
+// messages written so far
+class MessageStream : public synergy::IStream {
+public:
+    MessageStream() : m_readPos(0) { }
+
+    // forget what's been written and read
+    void                clear() { m_data.clear(); m_readPos = 0; }
+
+    // skip a message code
+    void                skipCode() { m_readPos += 4; }
+
+    virtual void        close() { }
+    virtual UInt32        read(void* buffer, UInt32 n)
+    {
+        n = std::min(n, getSize());
+        if (buffer != NULL) {
+            memcpy(buffer, m_data.data() + m_readPos, n);
+        }
+        m_readPos += n;
+        return n;
+    }
+    virtual void        write(const void* buffer, UInt32 n)
+    {
+        m_data.append(static_cast<const char*>(buffer), n);
+    }
+    virtual void        flush() { }
+    virtual void        shutdownInput() { }
+    virtual void        shutdownOutput() { }
+    virtual void*        getEventTarget() const
+    {
+        return const_cast<void*>(static_cast<const void*>(this));
+    }
+    virtual bool        isReady() const { return getSize() > 0; }
+    virtual UInt32        getSize() const
+    {
+        return (UInt32)(m_data.size() - m_readPos);
+    }
+
+public:
+    String                m_data;
+    size_t                m_readPos;
+};
+
+class ProtocolMessagesTests : public ::testing::Test
+{
+public:
+    MessageStream        m_writef;
+    MessageStream        m_typed;
+};
+
+TEST_F(ProtocolMessagesTests, send_noFields_sameAsWritef)
+{
+    ProtocolUtil::writef(&m_writef, kMsgCNoop);
+    ProtocolUtil::writef(&m_writef, kMsgCClose);
+    ProtocolUtil::writef(&m_writef, kMsgCLeave);
+    ProtocolUtil::writef(&m_writef, kMsgCResetOptions);
+    ProtocolUtil::writef(&m_writef, kMsgCInfoAck);
+    ProtocolUtil::writef(&m_writef, kMsgCKeepAlive);
+    ProtocolUtil::writef(&m_writef, kMsgQInfo);
+    ProtocolUtil::writef(&m_writef, kMsgEBusy);
+    ProtocolUtil::writef(&m_writef, kMsgEUnknown);
+    ProtocolUtil::writef(&m_writef, kMsgEBad);
+
+    CNoop::send(&m_typed);
+    CClose::send(&m_typed);
+    CLeave::send(&m_typed);
+    CResetOptions::send(&m_typed);
+    CInfoAck::send(&m_typed);
+    CKeepAlive::send(&m_typed);
+    QInfo::send(&m_typed);
+    EBusy::send(&m_typed);
+    EUnknown::send(&m_typed);
+    EBad::send(&m_typed);
+
+    EXPECT_EQ(40u, m_typed.m_data.size());
+    EXPECT_EQ(m_writef.m_data, m_typed.m_data);
+}
+
+TEST_F(ProtocolMessagesTests, send_integers_sameAsWritef)
+{
+    ProtocolUtil::writef(&m_writef, kMsgHello, 1, 6);
+    ProtocolUtil::writef(&m_writef, kMsgCEnter, -20, 30000, 0x89abcdef, 0x1234);
+    ProtocolUtil::writef(&m_writef, kMsgCClipboard, 1, 0xfedcba98);
+    ProtocolUtil::writef(&m_writef, kMsgCScreenSaver, 1);
+    ProtocolUtil::writef(&m_writef, kMsgDKeyDown, 0xefff, 0x2002, 38);
+    ProtocolUtil::writef(&m_writef, kMsgDKeyDown1_0, 0xefff, 0x2002);
+    ProtocolUtil::writef(&m_writef, kMsgDKeyRepeat, 'a', 0, 5, 38);
+    ProtocolUtil::writef(&m_writef, kMsgDKeyRepeat1_0, 'a', 0, 5);
+    ProtocolUtil::writef(&m_writef, kMsgDKeyUp, 'a', 1, 38);
+    ProtocolUtil::writef(&m_writef, kMsgDKeyUp1_0, 'a', 1);
+    ProtocolUtil::writef(&m_writef, kMsgDMouseDown, 3);
+    ProtocolUtil::writef(&m_writef, kMsgDMouseUp, 3);
+    ProtocolUtil::writef(&m_writef, kMsgDMouseMove, 1919, -1);
+    ProtocolUtil::writef(&m_writef, kMsgDMouseRelMove, -5, 7);
+    ProtocolUtil::writef(&m_writef, kMsgDMouseWheel, -120, 120);
+    ProtocolUtil::writef(&m_writef, kMsgDMouseWheel1_0, -120);
+    ProtocolUtil::writef(&m_writef, kMsgDInfo, -1920, 0, 3840, 1080, 0, 5, 6);
+    ProtocolUtil::writef(&m_writef, kMsgEIncompatible, 1, 3);
+
+    Hello::send(&m_typed, 1, 6);
+    CEnter::send(&m_typed, -20, 30000, 0x89abcdef, 0x1234);
+    CClipboard::send(&m_typed, 1, 0xfedcba98);
+    CScreenSaver::send(&m_typed, 1);
+    DKeyDown::send(&m_typed, 0xefff, 0x2002, 38);
+    DKeyDown1_0::send(&m_typed, 0xefff, 0x2002);
+    DKeyRepeat::send(&m_typed, 'a', 0, 5, 38);
+    DKeyRepeat1_0::send(&m_typed, 'a', 0, 5);
+    DKeyUp::send(&m_typed, 'a', 1, 38);
+    DKeyUp1_0::send(&m_typed, 'a', 1);
+    DMouseDown::send(&m_typed, 3);
+    DMouseUp::send(&m_typed, 3);
+    DMouseMove::send(&m_typed, 1919, -1);
+    DMouseRelMove::send(&m_typed, -5, 7);
+    DMouseWheel::send(&m_typed, -120, 120);
+    DMouseWheel1_0::send(&m_typed, -120);
+    DInfo::send(&m_typed, -1920, 0, 3840, 1080, 0, 5, 6);
+    EIncompatible::send(&m_typed, 1, 3);
+
+    EXPECT_EQ(m_writef.m_data, m_typed.m_data);
+}
+
+TEST_F(ProtocolMessagesTests, send_stringsAndLists_sameAsWritef)
+{
+    String big(1000, 'x');
+    String size("42");
+    String empty;
+    std::vector<UInt32> options;
+    options.push_back(0x48424254);
+    options.push_back(5000);
+
+    ProtocolUtil::writef(&m_writef, kMsgHelloBack, 1, 6, &big);
+    ProtocolUtil::writef(&m_writef, kMsgDClipboard, 0, 7, 2, &big);
+    ProtocolUtil::writef(&m_writef, kMsgDSetOptions, &options);
+    ProtocolUtil::writef(&m_writef, kMsgDFileTransfer, 1, &size);
+    ProtocolUtil::writef(&m_writef, kMsgDDragInfo, 1, &empty);
+
+    HelloBack::send(&m_typed, 1, 6, big);
+    DClipboard::send(&m_typed, 0, 7, 2, big);
+    DSetOptions::send(&m_typed, options);
+    DFileTransfer::send(&m_typed, 1, size);
+    DDragInfo::send(&m_typed, 1, empty);
+
+    EXPECT_EQ(m_writef.m_data, m_typed.m_data);
+}
+
+TEST_F(ProtocolMessagesTests, receive_writefMessage_readsFields)
+{
+    ProtocolUtil::writef(&m_writef, kMsgDInfo, -1920, 0, 3840, 1080, 0, 5, 6);
+    m_writef.skipCode();
+
+    SInt16 x, y, w, h, zone, mx, my;
+    EXPECT_TRUE(DInfo::receive(&m_writef, x, y, w, h, zone, mx, my));
+    EXPECT_EQ(-1920, x);
+    EXPECT_EQ(0, y);
+    EXPECT_EQ(3840, w);
+    EXPECT_EQ(1080, h);
+    EXPECT_EQ(5, mx);
+    EXPECT_EQ(6, my);
+    EXPECT_EQ(0u, m_writef.getSize());
+}
+
+TEST_F(ProtocolMessagesTests, receive_variableSize_readsFields)
+{
+    String data(300, 'd');
+    std::vector<UInt32> options(3, 0x12345678);
+    ProtocolUtil::writef(&m_writef, kMsgDClipboard, 1, 2, 3, &data);
+    ProtocolUtil::writef(&m_writef, kMsgDSetOptions, &options);
+
+    UInt8 id, mark;
+    UInt32 seqNum;
+    String dataOut;
+    m_writef.skipCode();
+    EXPECT_TRUE(DClipboard::receive(&m_writef, id, seqNum, mark, dataOut));
+    EXPECT_EQ(1, id);
+    EXPECT_EQ(2u, seqNum);
+    EXPECT_EQ(3, mark);
+    EXPECT_EQ(data, dataOut);
+
+    std::vector<UInt32> optionsOut;
+    m_writef.skipCode();
+    EXPECT_TRUE(DSetOptions::receive(&m_writef, optionsOut));
+    EXPECT_TRUE(options == optionsOut);
+}
+
+TEST_F(ProtocolMessagesTests, readf_typedMessage_readsFields)
+{
+    String name("screen");
+    DKeyRepeat::send(&m_typed, 0xefff, 0x2002, 5, 38);
+    HelloBack::send(&m_typed, 1, 6, name);
+
+    UInt16 id, mask, count, button;
+    SInt16 major, minor;
+    String nameOut;
+    EXPECT_TRUE(ProtocolUtil::readf(&m_typed, kMsgDKeyRepeat,
+                            &id, &mask, &count, &button));
+    EXPECT_TRUE(ProtocolUtil::readf(&m_typed, kMsgHelloBack,
+                            &major, &minor, &nameOut));
+    EXPECT_EQ(0xefff, id);
+    EXPECT_EQ(0x2002, mask);
+    EXPECT_EQ(5, count);
+    EXPECT_EQ(38, button);
+    EXPECT_EQ(1, major);
+    EXPECT_EQ(6, minor);
+    EXPECT_EQ(name, nameOut);
+}
+
+TEST_F(ProtocolMessagesTests, read_wholeMessage_checksCode)
+{
+    UInt8 buffer[DMouseMove::kMinSize];
+    EXPECT_EQ(8, (int)DMouseMove::kMinSize);
+    EXPECT_EQ(8u, DMouseMove::write(buffer, 100, -100));
+
+    SInt16 x, y;
+    EXPECT_TRUE(DMouseMove::read(buffer, sizeof(buffer), x, y));
+    EXPECT_EQ(100, x);
+    EXPECT_EQ(-100, y);
+    EXPECT_FALSE(DMouseRelMove::read(buffer, sizeof(buffer), x, y));
+    EXPECT_FALSE(DMouseMove::read(buffer, 3, x, y));
+}
+
+TEST_F(ProtocolMessagesTests, receive_truncated_returnsFalse)
+{
+    SInt16 x, y;
+    m_typed.write("\x01\x02\x03", 3);
+    EXPECT_FALSE(DMouseMove::receive(&m_typed, x, y));
+
+    // a string that claims more than there is
+    m_typed.clear();
+    m_typed.write("\x00\x00\x10\x00" "abc", 7);
+    String s;
+    EXPECT_FALSE(DFileTransfer::receive(&m_typed, x, s));
+
+    // a list that would overflow the size
+    m_typed.clear();
+    m_typed.write("\x7f\xff\xff\xff", 4);
+    std::vector<UInt32> options;
+    EXPECT_FALSE(DSetOptions::receive(&m_typed, options));
+    EXPECT_TRUE(options.empty());
+}
+
+TEST_F(ProtocolMessagesTests, benchmark_mouseMove)
+{
+    // as a release build logs by default
+    int filter = CLOG->getFilter();
+    CLOG->setFilter(kINFO);
+    SInt16 x = 0, y = 0;
+
+    double start = ARCH->time();
+    for (int i = 0; i < kMessageCount; ++i) {
+        m_writef.clear();
+        ProtocolUtil::writef(&m_writef, kMsgDMouseMove, i & 0x7fff, 10);
+        m_writef.skipCode();
+        ProtocolUtil::readf(&m_writef, kMsgDMouseMove + 4, &x, &y);
+    }
+    double formatted = ARCH->time() - start;
+    EXPECT_EQ(10, y);
+
+    y = 0;
+    start = ARCH->time();
+    for (int i = 0; i < kMessageCount; ++i) {
+        m_typed.clear();
+        DMouseMove::send(&m_typed, i & 0x7fff, 10);
+        m_typed.skipCode();
+        DMouseMove::receive(&m_typed, x, y);
+    }
+    double typed = ARCH->time() - start;
+    EXPECT_EQ(10, y);
+    CLOG->setFilter(filter);
+
+    LOG((CLOG_INFO "mouse move sent and received: %.0f ns with a format, "
+                "%.0f ns typed", formatted / kMessageCount * 1.0e+9,
+                typed / kMessageCount * 1.0e+9));
+}